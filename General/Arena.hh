@@ -0,0 +1,154 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <new>
+#include <vector>
+#include <cstdlib>
+
+#include "General/Types.hh"
+
+namespace General {
+	/**
+	 * \brief
+	 *	Monotonic allocator; memory is handed out in creation
+	 *	order from large blocks and all of it is freed at once.
+	 *
+	 * Destructors of items created in an arena are never run,
+	 * so only types which own no other memory may live there.
+	 * Create items with placement new:
+	 *	Sphere *S = new (A) Sphere(...);
+	 * One arena must not be used by several threads at once;
+	 * give each thread its own and Adopt() them afterwards.
+	 */
+	class Arena {
+	private:
+		/** \brief Memory block */
+		struct Block {
+			char *Begin;
+			size_t Size;
+		};
+
+		/** All blocks; the last one is being filled */
+		std::vector<Block> Blocks;
+
+		/** Free part of the last block */
+		char *Cur, *End;
+
+		/** Size of the next block */
+		size_t NextSize;
+
+		/** Alignment of every allocation */
+		enum { ALIGN = 16 };
+
+		/** Blocks stop growing at this size */
+		enum { MAX_BLOCK = 1 << 20 };
+
+		/** Private copy-constructor */
+		Arena(const Arena &A);
+
+		/** Private operator= */
+		void operator=(const Arena &A) const;
+
+		/** Start a new block with at least Size free bytes */
+		void Grow(size_t Size) {
+			size_t BlockSize = NextSize;
+			if (BlockSize < Size)
+				BlockSize = Size;
+			if (NextSize < MAX_BLOCK)
+				NextSize *= 2;
+
+			Block B;
+			B.Begin = (char *)malloc(BlockSize);
+			if (B.Begin == NULL)
+				throw std::bad_alloc();
+			B.Size = BlockSize;
+			Blocks.push_back(B);
+			Cur = B.Begin;
+			End = B.Begin + BlockSize;
+		}
+
+	public:
+		/** Create empty arena
+		 * \param FirstBlock	Size of the first block */
+		Arena(size_t FirstBlock = 4096)
+			: Cur(NULL), End(NULL), NextSize(FirstBlock) {}
+
+		~Arena() {
+			Release();
+		}
+
+		/** \return Size bytes of memory aligned for any type */
+		inline void *Allocate(size_t Size) {
+			Size = (Size + ALIGN - 1) & ~size_t(ALIGN - 1);
+			if (size_t(End - Cur) < Size)
+				Grow(Size);
+			void *P = Cur;
+			Cur += Size;
+			return P;
+		}
+
+		/** Make the next Size bytes of allocations contiguous */
+		void Reserve(size_t Size) {
+			if (size_t(End - Cur) < Size)
+				Grow(Size);
+		}
+
+		/** Was P allocated in this arena? Takes time linear in
+		 * the number of blocks, so it is meant for checks;
+		 * the most recently filled block is tested first */
+		Bool Owns(const void *P) const {
+			const char *C = (const char *)P;
+			for (size_t i = Blocks.size(); i-- > 0;)
+				if (C >= Blocks[i].Begin &&
+				    C < Blocks[i].Begin + Blocks[i].Size)
+					return true;
+			return false;
+		}
+
+		/** Take over all memory of another arena. Its items now
+		 * live until this arena is released; A is left empty */
+		void Adopt(Arena &A) {
+			if (A.Blocks.empty())
+				return;
+			/* Keep filling our own last block */
+			Blocks.insert(Blocks.end() - (Blocks.empty() ? 0 : 1),
+				      A.Blocks.begin(), A.Blocks.end());
+			A.Blocks.clear();
+			A.Cur = A.End = NULL;
+		}
+
+		/** Free all memory at once */
+		void Release() {
+			for (size_t i = 0; i < Blocks.size(); i++)
+				free(Blocks[i].Begin);
+			Blocks.clear();
+			Cur = End = NULL;
+		}
+	};
+};
+
+/** Placement new creating an item in an arena */
+inline void *operator new(size_t Size, General::Arena &A)
+{
+	return A.Allocate(Size);
+}
+
+/** Called only if a constructor throws; memory stays in the arena */
+inline void operator delete(void *P, General::Arena &A)
+{
+}
+
+#endif
@@ -0,0 +1,177 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _INTERNER_H_
+#define _INTERNER_H_
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "General/Types.hh"
+
+namespace General {
+	/**
+	 * \brief
+	 *	Maps names to small consecutive integer IDs.
+	 *
+	 * Names are hashed into an open addressing table, so looking
+	 * up a name given as a character range neither allocates nor
+	 * walks a tree of string compares. Each distinct name is
+	 * copied once, when first interned. Find() doesn't modify
+	 * the table and may run concurrently with other Find() calls.
+	 */
+	class Interner {
+	public:
+		/** ID of a name which was never interned */
+		enum { NONE = 0xFFFFFFFFU };
+
+	private:
+		/** Interned names, indexed by ID */
+		std::vector<std::string> Names;
+
+		/** Hash of each name, indexed by ID */
+		std::vector<UInt> Hashes;
+
+		/** Hash table of IDs (NONE for empty slots);
+		 * size is a power of two */
+		std::vector<UInt> Slots;
+
+		/** FNV-1a hash of a name */
+		static inline UInt Hash(const char *Name, size_t Len) {
+			unsigned int H = 2166136261U;
+			for (size_t i = 0; i < Len; i++) {
+				H ^= (unsigned char)Name[i];
+				H *= 16777619U;
+			}
+			return H;
+		}
+
+		/** Slot holding the name or the empty slot it belongs to */
+		inline UInt Slot(const char *Name, size_t Len, UInt H) const {
+			const UInt Mask = UInt(Slots.size()) - 1;
+			for (UInt s = H & Mask;; s = (s + 1) & Mask) {
+				const UInt ID = Slots[s];
+				if (ID == NONE)
+					return s;
+				if (Hashes[ID] == H && Names[ID].size() == Len &&
+				    memcmp(Names[ID].data(), Name, Len) == 0)
+					return s;
+			}
+		}
+
+		/** Double the table and reinsert all IDs */
+		void Grow() {
+			const UInt Size = Slots.empty() ? 64 : 2 * Slots.size();
+			Slots.assign(Size, NONE);
+			for (UInt ID = 0; ID < Names.size(); ID++) {
+				UInt s = Hashes[ID] & (Size - 1);
+				while (Slots[s] != NONE)
+					s = (s + 1) & (Size - 1);
+				Slots[s] = ID;
+			}
+		}
+
+	public:
+		Interner() {
+			Grow();
+		}
+
+		/** \return ID of the name; NONE if not interned */
+		inline UInt Find(const char *Name, size_t Len) const {
+			return Slots[Slot(Name, Len, Hash(Name, Len))];
+		}
+
+		inline UInt Find(const std::string &Name) const {
+			return Find(Name.data(), Name.size());
+		}
+
+		/** \return ID of the name, interning it if needed */
+		UInt Intern(const char *Name, size_t Len) {
+			/* Keep table at most half full */
+			if (2 * (Names.size() + 1) > Slots.size())
+				Grow();
+			const UInt H = Hash(Name, Len);
+			const UInt s = Slot(Name, Len, H);
+			if (Slots[s] != NONE)
+				return Slots[s];
+			Names.push_back(std::string(Name, Len));
+			Hashes.push_back(H);
+			return Slots[s] = UInt(Names.size() - 1);
+		}
+
+		inline UInt Intern(const std::string &Name) {
+			return Intern(Name.data(), Name.size());
+		}
+
+		/** \return Name of an interned ID */
+		inline const std::string &Name(UInt ID) const {
+			return Names[ID];
+		}
+
+		/** \return Number of interned names */
+		inline UInt Size() const {
+			return UInt(Names.size());
+		}
+
+		/** Forget all names; IDs start from 0 again */
+		void Clear() {
+			Names.clear();
+			Hashes.clear();
+			Slots.clear();
+			Grow();
+		}
+	};
+
+	/**
+	 * \brief
+	 *	Values of some IDs of an Interner.
+	 */
+	template<typename T>
+	class IDMap {
+	private:
+		std::vector<T> Values;
+		std::vector<bool> Set;
+
+	public:
+		/** \return Value of the ID or NULL if it has none */
+		inline const T *Find(UInt ID) const {
+			if (ID >= Values.size() || !Set[ID])
+				return NULL;
+			return &Values[ID];
+		}
+
+		/** Set value of the ID */
+		void Insert(UInt ID, const T &Value) {
+			if (ID >= Values.size()) {
+				Values.resize(ID + 1);
+				Set.resize(ID + 1, false);
+			}
+			Values[ID] = Value;
+			Set[ID] = true;
+		}
+
+		/** \return One past the highest ID which may have a value */
+		inline UInt Size() const {
+			return UInt(Values.size());
+		}
+
+		/** Remove all values */
+		void Clear() {
+			Values.clear();
+			Set.clear();
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,85 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace General {
+	/**
+	 * \brief
+	 *	Whole file mapped read-only; for loaders which read
+	 *	a file once from front to back.
+	 */
+	class MappedFile {
+	private:
+		const char *Data;
+		size_t Size;
+
+		/** Private copy-constructor */
+		MappedFile(const MappedFile &M);
+
+		/** Private operator= */
+		void operator=(const MappedFile &M) const;
+	public:
+		/** Map file
+		 * \throw std::runtime_error if file can't be mapped */
+		MappedFile(const std::string &Path) : Data(NULL), Size(0) {
+			const int Fd = open(Path.c_str(), O_RDONLY);
+			if (Fd < 0)
+				throw std::runtime_error(
+					"Unable to open " + Path + ": "
+					+ strerror(errno));
+			struct stat St;
+			if (fstat(Fd, &St) != 0 || St.st_size == 0) {
+				close(Fd);
+				throw std::runtime_error(
+					"Unable to read " + Path);
+			}
+			Size = St.st_size;
+			void *M = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, Fd, 0);
+			close(Fd);
+			if (M == MAP_FAILED)
+				throw std::runtime_error(
+					"Unable to map " + Path + ": "
+					+ strerror(errno));
+			madvise(M, Size, MADV_SEQUENTIAL);
+			Data = (const char *)M;
+		}
+
+		~MappedFile() {
+			munmap((void *)Data, Size);
+		}
+
+		/** File contents */
+		inline const char *GetData() const {
+			return Data;
+		}
+
+		/** File size */
+		inline size_t GetSize() const {
+			return Size;
+		}
+	};
+};
+
+#endif
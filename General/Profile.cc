@@ -0,0 +1,189 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <cstring>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "General/Thread.hh"
+#include "General/Profile.hh"
+
+namespace General {
+	namespace Profile {
+		volatile Bool Enabled = false;
+		__thread ThreadData *Local = NULL;
+
+		/** Names of phases in the report */
+		static const char *PhaseNames[PHASES] = {
+			"other", "parse", "build", "primary", "secondary",
+			"shadow", "shading", "texture", "output"
+		};
+
+		/** Names of counters in the report */
+		static const char *CounterNames[COUNTERS] = {
+			"primary", "secondary", "shadow", "texture_lookups",
+			"region_loads", "region_evictions"
+		};
+
+		/** Guards Threads and Retired */
+		static Mutex Guard;
+
+		/** Records of running threads */
+		static ThreadData *Threads = NULL;
+
+		/** Sums of records of finished threads */
+		static ThreadData Retired;
+
+		/** Threads seen during measurement */
+		static Int ThreadCount = 0;
+
+		/**@{ Measured interval */
+		static struct timeval StartTime, StopTime;
+		static unsigned long long StartTicks, StopTicks;
+		/*@}*/
+
+		/** Frees record of a finishing thread */
+		static pthread_key_t Key;
+		static pthread_once_t KeyOnce = PTHREAD_ONCE_INIT;
+
+		static void Merge(ThreadData &To, const ThreadData &From)
+		{
+			for (Int i = 0; i < PHASES; i++)
+				To.Ticks[i] += From.Ticks[i];
+			for (Int i = 0; i < COUNTERS; i++)
+				To.Counts[i] += From.Counts[i];
+		}
+
+		static void Retire(void *Data)
+		{
+			ThreadData *D = static_cast<ThreadData *>(Data);
+			D->Switch(OTHER);
+
+			Lock L(Guard);
+			Merge(Retired, *D);
+			for (ThreadData **P = &Threads; *P; P = &(*P)->Next)
+				if (*P == D) {
+					*P = D->Next;
+					break;
+				}
+			delete D;
+		}
+
+		static void CreateKey()
+		{
+			pthread_key_create(&Key, &Retire);
+		}
+
+		ThreadData *Register()
+		{
+			pthread_once(&KeyOnce, &CreateKey);
+
+			ThreadData *D = new ThreadData;
+			memset(D, 0, sizeof(*D));
+			D->Current = OTHER;
+			D->Last = Now();
+			{
+				Lock L(Guard);
+				D->Next = Threads;
+				Threads = D;
+				ThreadCount++;
+			}
+			pthread_setspecific(Key, D);
+			return Local = D;
+		}
+
+		void Start()
+		{
+			{
+				Lock L(Guard);
+				memset(&Retired, 0, sizeof(Retired));
+				ThreadCount = 0;
+				for (ThreadData *D = Threads; D; D = D->Next) {
+					memset(D->Ticks, 0, sizeof(D->Ticks));
+					memset(D->Counts, 0, sizeof(D->Counts));
+					D->Last = Now();
+					ThreadCount++;
+				}
+			}
+			gettimeofday(&StartTime, NULL);
+			StartTicks = Now();
+			Enabled = true;
+		}
+
+		void Stop()
+		{
+			/* Time of the calling thread up to now */
+			if (Local)
+				Local->Switch(Local->Current);
+			Enabled = false;
+			gettimeofday(&StopTime, NULL);
+			StopTicks = Now();
+		}
+
+		void Report(std::ostream &Out)
+		{
+			ThreadData Sum;
+			memset(&Sum, 0, sizeof(Sum));
+			Int Count;
+			{
+				Lock L(Guard);
+				Merge(Sum, Retired);
+				for (ThreadData *D = Threads; D; D = D->Next)
+					Merge(Sum, *D);
+				Count = ThreadCount;
+			}
+
+			const double Seconds =
+				(StopTime.tv_sec - StartTime.tv_sec) +
+				1e-6 * (StopTime.tv_usec - StartTime.tv_usec);
+			/* Ticks are calibrated against the wall clock */
+			const double TickMs = StopTicks > StartTicks
+				? 1000.0 * Seconds / (StopTicks - StartTicks)
+				: 0.0;
+
+			unsigned long long Rays = 0;
+			for (Int i = 0; i < COUNTERS; i++)
+				if (i < TEXTURE_LOOKUPS)
+					Rays += Sum.Counts[i];
+
+			struct rusage Usage;
+			getrusage(RUSAGE_SELF, &Usage);
+
+			Out << "{" << std::endl
+			    << "  \"seconds\": " << Seconds << "," << std::endl
+			    << "  \"threads\": " << Count << "," << std::endl
+			    << "  \"rays\": {";
+			for (Int i = 0; i < COUNTERS; i++)
+				if (i < TEXTURE_LOOKUPS)
+					Out << " \"" << CounterNames[i] << "\": "
+					    << Sum.Counts[i] << ",";
+			Out << " \"total\": " << Rays << " }," << std::endl
+			    << "  \"rays_per_second\": "
+			    << (Seconds > 0.0 ? Rays / Seconds : 0.0)
+			    << "," << std::endl
+			    << "  \"texture_lookups\": "
+			    << Sum.Counts[TEXTURE_LOOKUPS] << "," << std::endl
+			    << "  \"regions\": { \"loads\": "
+			    << Sum.Counts[REGION_LOADS] << ", \"evictions\": "
+			    << Sum.Counts[REGION_EVICTIONS] << " }," << std::endl
+			    << "  \"phases_ms\": {";
+			for (Int i = 0; i < PHASES; i++)
+				Out << (i ? ", " : " ") << "\"" << PhaseNames[i]
+				    << "\": " << Sum.Ticks[i] * TickMs;
+			Out << " }," << std::endl
+			    << "  \"peak_rss_kb\": " << Usage.ru_maxrss << std::endl
+			    << "}" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,157 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <iostream>
+#include <time.h>
+
+#include "General/Types.hh"
+
+namespace General {
+
+	/**
+	 * \brief
+	 *	Low-overhead render instrumentation.
+	 *
+	 * Each thread counts processor ticks spent in render phases
+	 * and events (rays, texture lookups) in its own record, so
+	 * nothing is shared on the hot path. Phases are exclusive:
+	 * entering a Scope pauses the enclosing phase, so phase times
+	 * add up to the time threads were running. When profiling is
+	 * disabled a Scope costs one test of a global flag.
+	 */
+	namespace Profile {
+		/** Render phases */
+		enum Phase {
+			OTHER,		/**< Anything not below */
+			PARSE,		/**< Reading XML into a document */
+			BUILD,		/**< Creating scene, photon maps */
+			PRIMARY,	/**< Eye ray intersections */
+			SECONDARY,	/**< Reflected and refracted ray
+					 * intersections */
+			SHADOW,		/**< Shadow ray intersections */
+			SHADING,	/**< Lighting at hit points */
+			TEXTURE,	/**< Texture lookups */
+			OUTPUT,		/**< Putting and saving pixels */
+			PHASES
+		};
+
+		/** Counted events */
+		enum Counter {
+			PRIMARY_RAYS,	/**< Rays shot from the camera */
+			SECONDARY_RAYS,	/**< Reflected and refracted rays */
+			SHADOW_RAYS,
+			TEXTURE_LOOKUPS,	/**< First counter which isn't a ray */
+			REGION_LOADS,	/**< Lazy scene regions read */
+			REGION_EVICTIONS, /**< Lazy scene regions dropped */
+			COUNTERS
+		};
+
+		/** Tick counter; rdtsc where available */
+		static inline unsigned long long Now() {
+#if defined(__i386__) || defined(__x86_64__)
+			unsigned int Lo, Hi;
+			__asm__ __volatile__ ("rdtsc" : "=a" (Lo), "=d" (Hi));
+			return ((unsigned long long)Hi << 32) | Lo;
+#else
+			struct timespec T;
+			clock_gettime(CLOCK_MONOTONIC, &T);
+			return T.tv_sec * 1000000000ULL + T.tv_nsec;
+#endif
+		}
+
+		/** \brief Counters of one thread */
+		struct ThreadData {
+			unsigned long long Ticks[PHASES];
+			unsigned long long Counts[COUNTERS];
+
+			/** Phase being measured and when it was entered */
+			Phase Current;
+			unsigned long long Last;
+
+			/** Registered records */
+			ThreadData *Next;
+
+			/** Charge time so far to the current phase
+			 * and switch to P; \return previous phase */
+			inline Phase Switch(Phase P) {
+				const unsigned long long T = Now();
+				Ticks[Current] += T - Last;
+				Last = T;
+				const Phase Old = Current;
+				Current = P;
+				return Old;
+			}
+		};
+
+		/** Is profiling on? */
+		extern volatile Bool Enabled;
+
+		/** Record of calling thread (NULL until first use) */
+		extern __thread ThreadData *Local;
+
+		/** Create and register record of calling thread */
+		ThreadData *Register();
+
+		/** Record of calling thread */
+		static inline ThreadData &Data() {
+			return Local ? *Local : *Register();
+		}
+
+		/** \brief Measures time until the end of a block */
+		class Scope {
+			ThreadData *D;
+			Phase Saved;
+		public:
+			inline Scope(Phase P) : D(NULL), Saved(OTHER) {
+				if (Enabled) {
+					D = &Data();
+					Saved = D->Switch(P);
+				}
+			}
+
+			inline ~Scope() {
+				if (D)
+					D->Switch(Saved);
+			}
+
+			/** Continue in another phase; cheaper than
+			 * closing this scope and opening a new one */
+			inline void Change(Phase P) {
+				if (D)
+					D->Switch(P);
+			}
+		};
+
+		/** Count N events */
+		static inline void Count(Counter C, UInt N = 1) {
+			if (Enabled)
+				Data().Counts[C] += N;
+		}
+
+		/** Clear all counters and start measuring */
+		void Start();
+
+		/** Stop measuring */
+		void Stop();
+
+		/** Write JSON report of the measured interval:
+		 * wall time, rays per second, per-phase milliseconds
+		 * (summed over threads), event counts and peak RSS */
+		void Report(std::ostream &Out);
+	}
+};
+
+#endif
@@ -0,0 +1,46 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+#include <stdlib.h>
+#include "General/Types.hh"
+
+namespace General {
+	/**
+	 * \brief
+	 *	Reentrant pseudo-random generator.
+	 *
+	 * Each thread should own its generator; the same seed
+	 * always yields the same sequence.
+	 */
+	class Random {
+	private:
+		/** erand48() state */
+		unsigned short X[3];
+	public:
+		/** Seed generator */
+		Random(UInt Seed = 0) {
+			X[0] = 0x330E;
+			X[1] = (unsigned short)(Seed & 0xFFFF);
+			X[2] = (unsigned short)((Seed >> 16) & 0xFFFF);
+		}
+
+		/** \return Number uniformly distributed in [0, 1) */
+		inline Double Next() {
+			return erand48(X);
+		}
+	};
+};
+
+#endif
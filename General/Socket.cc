@@ -0,0 +1,207 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#include "General/Socket.hh"
+
+namespace General {
+	/** Messages larger than that are treated as garbage */
+	static const UInt MaxMessage = 1U << 30;
+
+	/** \brief Resolved socket address */
+	class Address {
+		struct addrinfo *Info;
+		struct sockaddr_un Unix;
+	public:
+		int Family;
+		const struct sockaddr *Addr;
+		socklen_t Len;
+		std::string Path;
+
+		Address(const std::string &Name) : Info(NULL) {
+			if (Name.compare(0, 5, "unix:") == 0) {
+				Path = Name.substr(5);
+				if (Path.size() >= sizeof(Unix.sun_path))
+					throw std::runtime_error(
+						"Socket path too long: " + Path);
+				memset(&Unix, 0, sizeof(Unix));
+				Unix.sun_family = AF_UNIX;
+				strcpy(Unix.sun_path, Path.c_str());
+				Family = AF_UNIX;
+				Addr = (const struct sockaddr *)&Unix;
+				Len = sizeof(Unix);
+				return;
+			}
+
+			const std::string::size_type Colon = Name.rfind(':');
+			if (Colon == std::string::npos)
+				throw std::runtime_error(
+					"Address must be unix:<path> or "
+					"<host>:<port>: " + Name);
+			std::string Host = Name.substr(0, Colon);
+			const std::string Port = Name.substr(Colon + 1);
+
+			struct addrinfo Hints;
+			memset(&Hints, 0, sizeof(Hints));
+			Hints.ai_family = AF_UNSPEC;
+			Hints.ai_socktype = SOCK_STREAM;
+			Hints.ai_flags = AI_PASSIVE;
+			if (getaddrinfo(Host.empty() ? NULL : Host.c_str(),
+					Port.c_str(), &Hints, &Info) != 0)
+				throw std::runtime_error(
+					"Unable to resolve " + Name);
+			Family = Info->ai_family;
+			Addr = Info->ai_addr;
+			Len = Info->ai_addrlen;
+		}
+
+		~Address() {
+			if (Info)
+				freeaddrinfo(Info);
+		}
+	};
+
+	Socket::~Socket()
+	{
+		Close();
+	}
+
+	void Socket::Close()
+	{
+		if (Fd != -1)
+			close(Fd);
+		Fd = -1;
+	}
+
+	void Socket::SetTimeout(Int Seconds)
+	{
+		struct timeval T;
+		T.tv_sec = Seconds;
+		T.tv_usec = 0;
+		if (setsockopt(Fd, SOL_SOCKET, SO_RCVTIMEO, &T, sizeof(T)) != 0 ||
+		    setsockopt(Fd, SOL_SOCKET, SO_SNDTIMEO, &T, sizeof(T)) != 0)
+			throw std::runtime_error("Unable to set socket timeout");
+	}
+
+	Socket *Socket::Connect(const std::string &Name)
+	{
+		Address A(Name);
+		const int Fd = socket(A.Family, SOCK_STREAM, 0);
+		if (Fd == -1)
+			throw std::runtime_error("Unable to create socket");
+		if (connect(Fd, A.Addr, A.Len) != 0) {
+			close(Fd);
+			throw std::runtime_error("Unable to connect to " + Name);
+		}
+		return new Socket(Fd);
+	}
+
+	Socket *Socket::Listen(const std::string &Name)
+	{
+		Address A(Name);
+		const int Fd = socket(A.Family, SOCK_STREAM, 0);
+		if (Fd == -1)
+			throw std::runtime_error("Unable to create socket");
+
+		if (A.Family == AF_UNIX)
+			unlink(A.Path.c_str());
+		else {
+			const int On = 1;
+			setsockopt(Fd, SOL_SOCKET, SO_REUSEADDR, &On, sizeof(On));
+		}
+
+		if (bind(Fd, A.Addr, A.Len) != 0 || listen(Fd, 16) != 0) {
+			close(Fd);
+			throw std::runtime_error("Unable to listen on " + Name);
+		}
+		return new Socket(Fd);
+	}
+
+	Socket *Socket::Accept()
+	{
+		int New;
+		do {
+			New = accept(Fd, NULL, NULL);
+		} while (New == -1 && errno == EINTR);
+		if (New == -1)
+			throw std::runtime_error("Unable to accept connection");
+		return new Socket(New);
+	}
+
+	void Socket::Write(const void *Buf, UInt Len)
+	{
+		const char *Pos = (const char *)Buf;
+		while (Len > 0) {
+			/* Dead peer must not kill us with SIGPIPE */
+			const ssize_t Done = send(Fd, Pos, Len, MSG_NOSIGNAL);
+			if (Done == -1 && errno == EINTR)
+				continue;
+			if (Done == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				throw std::runtime_error("Socket write timed out");
+			if (Done <= 0)
+				throw std::runtime_error("Socket write failed");
+			Pos += Done;
+			Len -= UInt(Done);
+		}
+	}
+
+	void Socket::Read(void *Buf, UInt Len)
+	{
+		char *Pos = (char *)Buf;
+		while (Len > 0) {
+			const ssize_t Done = recv(Fd, Pos, Len, 0);
+			if (Done == -1 && errno == EINTR)
+				continue;
+			if (Done == 0)
+				throw std::runtime_error("Connection closed");
+			if (Done == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				throw std::runtime_error("Socket read timed out");
+			if (Done < 0)
+				throw std::runtime_error("Socket read failed");
+			Pos += Done;
+			Len -= UInt(Done);
+		}
+	}
+
+	void Socket::Send(UInt Type, const std::string &Payload)
+	{
+		const unsigned int Header[2] = {
+			Type, (unsigned int)Payload.size()
+		};
+		Write(Header, sizeof(Header));
+		if (!Payload.empty())
+			Write(Payload.data(), UInt(Payload.size()));
+	}
+
+	void Socket::Receive(UInt &Type, std::string &Payload)
+	{
+		unsigned int Header[2];
+		Read(Header, sizeof(Header));
+		if (Header[1] > MaxMessage)
+			throw std::runtime_error("Message too large");
+		Type = Header[0];
+		Payload.resize(Header[1]);
+		if (Header[1] > 0)
+			Read(&Payload[0], Header[1]);
+	}
+}
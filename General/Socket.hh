@@ -0,0 +1,87 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _SOCKET_H_
+#define _SOCKET_H_
+
+#include <string>
+#include "General/Types.hh"
+
+namespace General {
+
+	/**
+	 * \brief Blocking stream socket (TCP or Unix domain)
+	 *
+	 * Addresses are given as "unix:/path/to/socket" or "host:port".
+	 * All failures are reported with std::runtime_error, including
+	 * the peer closing the connection in the middle of a read.
+	 *
+	 * Besides raw reads and writes sockets exchange messages:
+	 * a 32-bit type and a 32-bit length followed by the payload,
+	 * all in host byte order (peers are expected to run the same
+	 * build).
+	 */
+	class Socket {
+	private:
+		/** Descriptor; -1 when closed */
+		int Fd;
+
+		/** Private copy-constructor */
+		Socket(const Socket &S);
+
+		/** Private operator= */
+		void operator=(const Socket &S) const;
+	public:
+		/** Take ownership of a descriptor */
+		explicit Socket(int Fd = -1) : Fd(Fd) {}
+
+		/** Closes socket */
+		~Socket();
+
+		/** Connect to a listening socket */
+		static Socket *Connect(const std::string &Address);
+
+		/** Create a listening socket; stale Unix sockets
+		 * are removed first */
+		static Socket *Listen(const std::string &Address);
+
+		/** Accept one pending connection */
+		Socket *Accept();
+
+		/** Close descriptor */
+		void Close();
+
+		/** Fail reads and writes blocked for longer than
+		 * Seconds; 0 blocks forever */
+		void SetTimeout(Int Seconds);
+
+		/** Descriptor accessor (for poll()) */
+		inline int GetFd() const {
+			return Fd;
+		}
+
+		/** Write whole buffer */
+		void Write(const void *Buf, UInt Len);
+
+		/** Read exactly Len bytes */
+		void Read(void *Buf, UInt Len);
+
+		/** Send one message */
+		void Send(UInt Type, const std::string &Payload);
+
+		/** Receive one message */
+		void Receive(UInt &Type, std::string &Payload);
+	};
+};
+
+#endif
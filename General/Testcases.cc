@@ -11,13 +11,35 @@
  *********************/
 
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <unistd.h>
+#include <utime.h>
 
 #include "General/Debug.hh"
 #include "General/Types.hh"
+#include "General/Testcases.hh"
 
 #include "Graphics/Screen.hh"
+#include "Graphics/HDRImage.hh"
+#include "Graphics/MappedImage.hh"
+#include "Graphics/CostMap.hh"
+#include "Graphics/StreamImage.hh"
 #include "World/Scene.hh"
+#include "World/Generator.hh"
+#include "World/SceneBinary.hh"
+#include "World/SceneCache.hh"
 #include "Render/Raytracer.hh"
+#include "Render/Batch.hh"
+#include "Render/PhotonGrid.hh"
+#include "Render/PhotonMap.hh"
+#include "Render/IrradianceCache.hh"
+#include "General/Random.hh"
+#include "General/Thread.hh"
+#include "General/Profile.hh"
+#include "General/Interner.hh"
+#include "Math/Abs.hh"
 
 using namespace std;
 
@@ -66,6 +88,35 @@ namespace Testcases {
 		}
 	}
 
+	/** \brief Counts writes of every pixel; one marked
+	 * rectangle is finished already */
+	class WriteCounter : public Graphics::Drawable {
+		std::vector<Int> Writes;
+		const Int FX, FY, FW, FH;
+	public:
+		WriteCounter(Int W, Int H, Int FX = 0, Int FY = 0,
+			     Int FW = 0, Int FH = 0)
+			: Drawable(W, H), Writes(W * H, 0),
+			  FX(FX), FY(FY), FW(FW), FH(FH) {}
+
+		virtual void PutPixel(Int x, Int y, const World::Color &C) {
+			__sync_fetch_and_add(&Writes[y * Width + x], 1);
+		}
+
+		virtual Bool IsFinished(Int x, Int y, Int W, Int H) const {
+			return x >= FX && y >= FY &&
+				x + W <= FX + FW && y + H <= FY + FH;
+		}
+
+		/** \return Writes of a pixel */
+		Int Count(Int x, Int y) const {
+			return Writes[y * Width + x];
+		}
+
+		virtual void Refresh() {}
+		virtual void Save(const std::string Filename) const {}
+	};
+
 	void Render()
 	{
 		using namespace Render;
@@ -97,9 +148,503 @@ namespace Testcases {
 
 		Graphics::Image Img(4,4);
 		R.Render(Img);
+
+		/* Progressive preview must not leave finished tiles:
+		 * framebuffer has to match the one of a plain render */
+		{
+			std::ostringstream Base;
+			Base << "/tmp/blaRAY-test-" << getpid();
+			const std::string PlainPath = Base.str() + "-plain";
+			const std::string PreviewPath = Base.str() + "-preview";
+			Graphics::MappedImage Plain(PlainPath, 80, 72);
+			Graphics::MappedImage Preview(PreviewPath, 80, 72);
+			unlink(PlainPath.c_str());
+			unlink(PreviewPath.c_str());
+
+			R.Render(Plain);
+			R.SetProgressive(true);
+			R.Render(Preview);
+			R.SetProgressive(false);
+
+			if (Preview.FinishedTiles() != Plain.FinishedTiles())
+				Fail("Progressive render finished tiles");
+			for (Int y = 0; y < 72; y++)
+				for (Int x = 0; x < 80; x++)
+					for (Int c = 0; c < 3; c++)
+						if (Plain.GetRGB(x, y)[c]
+						    != Preview.GetRGB(x, y)[c])
+							Fail("Progressive render "
+							     "differs from plain");
+			cout << "Progressive render OK" << endl;
+		}
+
+		/* Batch renders every tile of every view exactly once,
+		 * finished ones not at all; edges make partial tiles */
+		{
+			const Int Workers = General::Parallel::Workers();
+			General::Parallel::SetWorkers(4);
+			WriteCounter A(37, 23), B(20, 50, 8, 16, 8, 16);
+			Render::Batch Batch(S, false, 8);
+			Batch.AddView(World::Camera(Pos, Dir), A);
+			Batch.AddView(World::Camera(Pos, -Dir), B);
+			std::streambuf *Old = cout.rdbuf(NULL);
+			Batch.Render();
+			cout.rdbuf(Old);
+			General::Parallel::SetWorkers(Workers);
+			Int Wrong = 0;
+			for (Int y = 0; y < 23; y++)
+				for (Int x = 0; x < 37; x++)
+					Wrong += A.Count(x, y) != 1;
+			if (Wrong)
+				Fail("Batch pixel not written once");
+			for (Int y = 0; y < 50; y++)
+				for (Int x = 0; x < 20; x++) {
+					const Bool Done = x >= 8 && x < 16 &&
+						y >= 16 && y < 32;
+					Wrong += B.Count(x, y) != (Done ? 0 : 1);
+				}
+			if (Wrong)
+				Fail("Batch rendered finished tile");
+			cout << "Batch render OK" << endl;
+		}
+
+		Testcases::PhotonGrid();
+		Testcases::IrradianceCache();
+		Testcases::HDRImage();
+	}
+
+	/** Counts photons visited by grid query */
+	struct GridCounter {
+		Int Count;
+		GridCounter() : Count(0) {}
+		void operator()(const Render::Photon &P, Double D2) {
+			Count++;
+		}
+	};
+
+	/** Records photons visited by grid query, in order */
+	struct GridRecorder {
+		std::vector<const Render::Photon *> Seen;
+		void operator()(const Render::Photon &P, Double D2) {
+			Seen.push_back(&P);
+		}
+	};
+
+	void PhotonGrid()
+	{
+		cout << "*** Photon grid testcase ***" << endl;
+		General::Random Rnd(42);
+		std::vector<Render::Photon> Photons;
+		for (Int i = 0; i < 5000; i++)
+			Photons.push_back(Render::Photon(
+				Math::Vector(Rnd.Next() * 10.0 - 5.0,
+					     Rnd.Next() * 10.0 - 5.0,
+					     Rnd.Next() * 10.0 - 5.0),
+				Math::Vector(0.0, -1.0, 0.0),
+				World::Spectrum(1.0, 1.0, 1.0)));
+
+		const Double Radius = 0.7;
+		Render::PhotonGrid Grid;
+		Grid.Build(Photons, Radius);
+
+		/* kd-tree takes over its copy */
+		std::vector<Render::Photon> Copy(Photons);
+		Render::PhotonMap Map;
+		Map.Build(Copy, 1.0);
+		std::vector<Render::PhotonMap::Neighbour> Heap;
+
+		for (Int q = 0; q < 100; q++) {
+			const Math::Vector P(Rnd.Next() * 10.0 - 5.0,
+					     Rnd.Next() * 10.0 - 5.0,
+					     Rnd.Next() * 10.0 - 5.0);
+			Int Brute = 0;
+			for (UInt i = 0; i < Photons.size(); i++)
+				if ((Photons[i].GetPosition() - P).SquareLength()
+				    <= Radius * Radius)
+					Brute++;
+			GridCounter C;
+			Grid.Query(P, Radius, C);
+			if (C.Count != Brute)
+				Fail("Photon grid query differs from brute force");
+
+			Map.Nearest(P, Int(Photons.size()), Radius, Heap);
+			if (Int(Heap.size()) != Brute)
+				Fail("Photon map search differs from brute force");
+		}
+		cout << "Photon grid and map queries match brute force" << endl;
+
+		/* Visit order can't depend on the build's worker count;
+		 * the clustered photons make buckets long */
+		for (Int i = 0; i < 20000; i++)
+			Photons.push_back(Render::Photon(
+				Math::Vector(Rnd.Next() * 0.1,
+					     Rnd.Next() * 0.1,
+					     Rnd.Next() * 0.1),
+				Math::Vector(0.0, -1.0, 0.0),
+				World::Spectrum(1.0, 1.0, 1.0)));
+		Render::PhotonGrid One(1), Four(4);
+		One.Build(Photons, Radius);
+		Four.Build(Photons, Radius);
+		for (Int q = 0; q < 100; q++) {
+			const Math::Vector P(Rnd.Next() * 10.0 - 5.0,
+					     Rnd.Next() * 10.0 - 5.0,
+					     Rnd.Next() * 10.0 - 5.0);
+			const Math::Vector Q = q % 2 ? P : Math::Vector(P * 0.01);
+			GridRecorder A, B;
+			One.Query(Q, Radius, A);
+			Four.Query(Q, Radius, B);
+			if (A.Seen != B.Seen)
+				Fail("Photon grid order depends on workers");
+		}
+		cout << "Photon grid order is independent of workers" << endl;
+	}
+
+	/** Inserts records on a grid of the floor, one per item;
+	 * each record has its own irradiance and is out of reach of
+	 * the others */
+	struct CacheFiller : public General::Job {
+		Render::IrradianceCache &Cache;
+		CacheFiller(Render::IrradianceCache &Cache) : Cache(Cache) {}
+
+		static Math::Vector Place(Int i) {
+			return Math::Vector((i % 64) - 32.0, 0.0,
+					    (i / 64) - 32.0);
+		}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			for (Int i = From; i < To; i++) {
+				Render::IrradianceCache::Record Rec;
+				Rec.Position = Place(i);
+				Rec.Normal = Math::Vector(0.0, 1.0, 0.0);
+				Rec.E = World::Spectrum(i, Worker, 0.0);
+				Rec.R = 0.1 + 0.01 * (i % 7);
+				for (Int c = 0; c < 3; c++)
+					Rec.RotGrad[c] = Rec.TransGrad[c] =
+						Math::Vector();
+				Cache.Insert(Rec);
+			}
+		}
+	};
+
+	void IrradianceCache()
+	{
+		cout << "*** Irradiance cache testcase ***" << endl;
+		const Double Accuracy = 0.2;
+		Render::IrradianceCache Cache(Math::Vector(), 100.0, Accuracy);
+
+		/* One record on the floor, reach a * R = 0.2 */
+		Render::IrradianceCache::Record Rec;
+		Rec.Position = Math::Vector(0.0, 0.0, 0.0);
+		Rec.Normal = Math::Vector(0.0, 1.0, 0.0);
+		Rec.E = World::Spectrum(0.5, 0.5, 0.5);
+		Rec.R = 1.0;
+		for (Int c = 0; c < 3; c++)
+			Rec.RotGrad[c] = Rec.TransGrad[c] = Math::Vector();
+		Cache.Insert(Rec);
+
+		World::Spectrum E;
+		const Math::Vector Up(0.0, 1.0, 0.0);
+		if (!Cache.Lookup(Math::Vector(0.19, 0.0, 0.0), Up, E))
+			Fail("Irradiance cache misses a point within a*R");
+		if (Math::Abs(E[0] - 0.5) > 1e-9)
+			Fail("Irradiance cache interpolates a single record wrong");
+		if (Cache.Lookup(Math::Vector(0.21, 0.0, 0.0), Up, E))
+			Fail("Irradiance cache hits a point beyond a*R");
+
+		/* Close, but on the far side of a crease */
+		if (Cache.Lookup(Math::Vector(0.05, 0.0, 0.0),
+				 Math::Vector(1.0, 0.0, 0.0), E))
+			Fail("Irradiance cache hits across a crease");
+		cout << "Irradiance cache uses records within their reach"
+		     << endl;
+
+		/* Concurrent inserts lose no record */
+		const Int Records = 4096;
+		Render::IrradianceCache Shared(Math::Vector(), 64.0, Accuracy);
+		CacheFiller Filler(Shared);
+		General::Parallel::For(Filler, Records, 4);
+		if (Shared.Size() != Records)
+			Fail("Irradiance cache lost concurrent inserts");
+		for (Int i = 0; i < Records; i++)
+			if (!Shared.Lookup(CacheFiller::Place(i), Up, E) ||
+			    Math::Abs(E[0] - i) > 1e-6)
+				Fail("Irradiance cache misses a concurrent insert");
+		cout << "Irradiance cache keeps concurrent inserts" << endl;
+	}
+
+
+
+	void HDRImage()
+	{
+		cout << "*** HDR image testcase ***" << endl;
+		const World::Spectrum Bright[4] = {
+			World::Spectrum(4.0, 4.0, 4.0),
+			World::Spectrum(0.5, 2.0, 9.0),
+			World::Spectrum(4.0, 4.0, 4.0),
+			World::Spectrum(4.0, 4.0, 4.0)
+		};
+
+		/* Light above 1.0 survives the tile path... */
+		Graphics::HDRImage Img(2, 2);
+		Img.PutRadianceTile(0, 0, 2, 2, Bright);
+		if (Img.GetRGB(0, 0)[0] != 4.0f || Img.GetRGB(1, 0)[2] != 9.0f)
+			Fail("HDR tile was clamped");
+
+		/* ...and is tone mapped at output: 4 / (1 + 4) = 0.8 */
+		Graphics::HDRImage Ref(2, 2);
+		const float Mapped[3] = { 0.8f, 0.8f, 0.8f };
+		Ref.PutRGB(0, 0, Mapped);
+		unsigned char A[12], B[12];
+		Img.Quantize(Graphics::ToneMap(Graphics::ToneMap::REINHARD), A);
+		Ref.Quantize(Graphics::ToneMap(Graphics::ToneMap::CLAMP), B);
+		if (A[0] != B[0] || A[0] == 255)
+			Fail("HDR tile tone mapped wrong");
+		Img.Quantize(Graphics::ToneMap(Graphics::ToneMap::CLAMP), A);
+		if (A[0] != 255)
+			Fail("HDR tile clamped wrong");
+
+		/* Accumulation sums unclamped tiles */
+		Graphics::HDRImage Sum(2, 2, true);
+		Sum.PutRadianceTile(0, 0, 2, 2, Bright);
+		Sum.PutRadianceTile(0, 0, 2, 2, Bright);
+		if (Sum.GetRGB(1, 1)[0] != 8.0f || Sum.GetRGB(1, 0)[2] != 18.0f)
+			Fail("HDR accumulation lost light");
+		Sum.SetAccumulate(false);
+		Sum.PutRadianceTile(0, 0, 2, 2, Bright);
+		if (Sum.GetRGB(1, 1)[0] != 4.0f)
+			Fail("HDR image still accumulates");
+		cout << "HDR tiles keep and tone map light above 1.0" << endl;
+
+		/* Cost map colours are scaled to the 99th percentile of
+		 * cycles: two outliers in 200 pixels don't count */
+		{
+			Graphics::CostMap Costs(20, 10);
+			for (Int i = 0; i < 200; i++)
+				Costs.Put(i % 20, i / 20, 1.0f, 2.0f,
+					  i < 198 ? float(i + 1) : 1e6f);
+			std::ostringstream Name;
+			Name << "/tmp/blaRAY-test-" << getpid();
+			Costs.Save(Name.str());
+			const std::string PPM = Name.str() + ".cost.ppm";
+			const std::string PFM = Name.str() + ".cost.pfm";
+			std::ifstream In(PPM.c_str());
+			std::ostringstream Buf;
+			Buf << In.rdbuf();
+			unlink(PPM.c_str());
+			unlink(PFM.c_str());
+
+			const std::string Header = "P6\n20 10\n255\n";
+			const std::string Data = Buf.str();
+			if (Data.compare(0, Header.size(), Header) != 0 ||
+			    Data.size() != Header.size() + 3 * 200)
+				Fail("Cost map PPM malformed");
+			const unsigned char *RGB = (const unsigned char *)
+				Data.data() + Header.size();
+			/* Cheapest blue, 99 of 198 green, 198 and above red */
+			const unsigned char Expect[][4] = {
+				{ 0, 0, 5, 255 }, { 98, 0, 255, 0 },
+				{ 197, 255, 0, 0 }, { 199, 255, 0, 0 }
+			};
+			for (Int e = 0; e < 4; e++)
+				for (Int c = 0; c < 3; c++)
+					if (RGB[3 * Expect[e][0] + c]
+					    != Expect[e][c + 1])
+						Fail("Cost map not scaled to "
+						     "99th percentile");
+		}
+		cout << "Cost map scaled to 99th percentile" << endl;
+
+		/* Streamed rows go out in order once complete, whatever
+		 * order tiles come in; frames follow each other */
+		{
+			int Pipe[2];
+			if (pipe(Pipe) != 0)
+				Fail("Unable to create pipe");
+			Graphics::StreamImage Stream(4, 3, Pipe[1]);
+			const World::Spectrum Light[8] = {
+				World::Spectrum(2.0, 2.0, 2.0),
+				World::Spectrum(1.0, 1.0, 1.0),
+				World::Spectrum(0.0, 0.0, 0.0),
+				World::Spectrum(1.0, 0.0, 0.0),
+				World::Spectrum(0.0, 1.0, 0.0),
+				World::Spectrum(0.0, 0.0, 1.0),
+				World::Spectrum(1.0, 1.0, 0.0),
+				World::Spectrum(0.0, 1.0, 1.0)
+			};
+			Stream.PutRadianceTile(0, 2, 4, 1, Light);
+			Stream.PutRadianceTile(2, 0, 2, 2, Light + 4);
+			const Int Early = Stream.GetRowsSent();
+			Stream.PutRadianceTile(0, 0, 2, 1, Light);
+			const Int First = Stream.GetRowsSent();
+			Stream.PutRadianceTile(0, 1, 2, 1, Light + 2);
+			Stream.PutRadianceTile(0, 1, 2, 1, Light + 2);
+			const Int Last = Stream.GetRowsSent();
+			if (Early != 0 || First != 1 || Last != 3)
+				Fail("Stream sent rows out of order");
+
+			Bool Refused = false;
+			Stream.NextFrame();
+			Stream.PutRadianceTile(0, 0, 4, 2, Light);
+			try {
+				Stream.NextFrame();
+			} catch (std::logic_error &e) {
+				Refused = true;
+			}
+			Stream.PutRadianceTile(0, 2, 4, 1, Light);
+			close(Pipe[1]);
+
+			std::string Data;
+			char Buf[256];
+			ssize_t Got;
+			while ((Got = read(Pipe[0], Buf, sizeof(Buf))) > 0)
+				Data.append(Buf, Got);
+			close(Pipe[0]);
+
+			/* Rows of the first frame, clamped */
+			const std::string Header = "P6\n4 3\n255\n";
+			const unsigned char Frame[36] = {
+				255, 255, 255,	255, 255, 255,
+				0, 255, 0,	0, 0, 255,
+				0, 0, 0,	255, 0, 0,
+				255, 255, 0,	0, 255, 255,
+				255, 255, 255,	255, 255, 255,
+				0, 0, 0,	255, 0, 0
+			};
+			const std::string Expect(Header
+				+ std::string((const char *)Frame, 36));
+			if (!Refused || Data.size() != 2 * Expect.size() ||
+			    Data.compare(0, Expect.size(), Expect) != 0 ||
+			    Data.compare(Expect.size(), Header.size(), Header))
+				Fail("Stream frames differ");
+		}
+		cout << "Stream image sends complete rows in order" << endl;
 	}
 
+	/** Write all objects, materials and lights of S to Out */
+	static void SceneDump(std::ostream &Out, const World::Scene &S)
+	{
+		World::Scene::ObjectIterator OI(S);
+		while (const World::Object *O = OI.Next())
+			Out << *O << endl;
+		World::Scene::MaterialIterator MI(S);
+		while (const World::Material *M = MI.Next())
+			Out << *M << endl;
+		World::Scene::LightIterator LI(S);
+		while (const World::Light *L = LI.Next())
+			Out << *L << endl;
+	}
 
+	/** Parse XML using given number of workers; \return the
+	 * messages printed and, if parsed, the scene dump (what a
+	 * failed parse leaves behind doesn't matter) */
+	static std::string ParseDump(const std::string &XML, Int Workers)
+	{
+		General::Parallel::SetWorkers(Workers);
+		World::Scene S;
+		std::ostringstream Out;
+		std::streambuf *Old = cout.rdbuf(Out.rdbuf());
+		const Bool Ok = S.ParseMemory(XML);
+		cout.rdbuf(Old);
+		Out << (Ok ? "parsed" : "failed") << endl;
+		if (Ok)
+			SceneDump(Out, S);
+		return Out.str();
+	}
+
+	/** Load binary scene File quietly; \return the scene dump,
+	 * or "failed" */
+	static std::string BinaryDump(const std::string &File)
+	{
+		World::Scene S;
+		std::streambuf *Old = cout.rdbuf(NULL);
+		const Bool Ok = S.LoadBinary(File);
+		cout.rdbuf(Old);
+		if (!Ok)
+			return "failed";
+		std::ostringstream Out;
+		SceneDump(Out, S);
+		return Out.str();
+	}
+
+	/** Write Data to File */
+	static void WriteFile(const std::string &File, const std::string &Data)
+	{
+		std::ofstream Out(File.c_str());
+		Out << Data;
+	}
+
+	/** Fire Count random rays from inside a box of half width
+	 * Size; \return distance and object of each hit */
+	static std::string HitDump(const World::Scene &S, Double Size,
+				   Int Count)
+	{
+		General::Random Rnd(5);
+		std::ostringstream Out;
+		for (Int i = 0; i < Count; i++) {
+			const Math::Vector From((Rnd.Next() - 0.5) * Size,
+						(Rnd.Next() - 0.5) * Size,
+						(Rnd.Next() - 0.5) * Size);
+			const Math::Vector Dir(Rnd.Next() - 0.5,
+					       Rnd.Next() - 0.5,
+					       Rnd.Next() - 0.5);
+			const Render::Ray R(From, Dir);
+			Double Pos = 1e10;
+			const World::Object *O;
+			World::HitStorage Hit;
+			if (S.Collide(R, Pos, O, Hit))
+				Out << Pos << " " << *O << endl;
+			else
+				Out << "miss" << endl;
+		}
+		return Out.str();
+	}
+
+	/** \brief Fires one ray from every worker */
+	class RayJob : public General::Job {
+		const World::Scene &S;
+		const Render::Ray &R;
+	public:
+		RayJob(const World::Scene &S, const Render::Ray &R)
+			: S(S), R(R) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			Double Pos = 1e10;
+			const World::Object *O;
+			World::HitStorage Hit;
+			S.Collide(R, Pos, O, Hit);
+		}
+	};
+
+	/** \return Number of objects of S */
+	static Int ObjectCount(const World::Scene &S)
+	{
+		Int Count = 0;
+		World::Scene::ObjectIterator Iter(S);
+		while (Iter.Next())
+			Count++;
+		return Count;
+	}
+
+	/** Write generated scene of Spheres spheres to File */
+	static void WriteScene(const std::string &File, Int Spheres)
+	{
+		std::ostringstream Spec;
+		Spec << "spheres=" << Spheres << ",planes=0";
+		std::ofstream Out(File.c_str());
+		World::Generator(World::Generator::Parse(Spec.str()))
+			.WriteXML(Out);
+	}
+
+	/** Replace first From after the Nth sphere of XML with To */
+	static void BreakSphere(std::string &XML, Int Nth,
+				const std::string &From, const std::string &To)
+	{
+		std::string::size_type At = 0;
+		for (Int i = 0; i <= Nth; i++)
+			At = XML.find("<Sphere ", At + 1);
+		At = XML.find(From, At);
+		XML.replace(At, From.size(), To);
+	}
 
 	void Scene()
 	{
@@ -200,7 +745,396 @@ namespace Testcases {
 			}
 		}
 
+		/*** Generated scene: same seed, same scene ***/
+		cout << "*** Generated scene" << endl;
+		World::Generator::Config GC =
+			World::Generator::Parse("spheres=50,planes=2,layout=nested");
+		std::ostringstream XML1, XML2;
+		World::Generator(GC).WriteXML(XML1);
+		World::Generator(GC).WriteXML(XML2);
+		if (XML1.str() != XML2.str())
+			Fail("Generator is not deterministic");
+
+		World::Scene Parsed;
+		if (!Parsed.ParseMemory(XML1.str()))
+			Fail("Generated XML doesn't parse");
+		Int Count = 0;
+		World::Scene::ObjectIterator Iter(Parsed);
+		while (Iter.Next())
+			Count++;
+		if (Count != 52)
+			Fail("Generated scene has wrong object count");
+		cout << "Testcase OK" << endl;
+
+		/*** Chunked parsing matches the serial reader ***/
+		cout << "*** Chunked parsing" << endl;
+		{
+			const Int Workers = General::Parallel::Workers();
+			std::ostringstream Big;
+			World::Generator(World::Generator::Parse(
+				"spheres=3000,planes=2")).WriteXML(Big);
+			const std::string XML = Big.str();
+			const std::string Serial = ParseDump(XML, 1);
+			if (Serial.find("parsed") == std::string::npos ||
+			    ParseDump(XML, 4) != Serial)
+				Fail("Chunked parse differs from serial");
+
+			/* Errors in different chunks: the first one in
+			 * the document is reported, whichever worker
+			 * gets to its chunk first */
+			std::string Bad = XML;
+			BreakSphere(Bad, 2500, "radius=\"", "radius=\"\"\"");
+			BreakSphere(Bad, 300, "<Material id=\"",
+				    "<Material id=\"Missing");
+			const std::string Error = ParseDump(Bad, 1);
+			if (Error.find("Material doesn't exist") ==
+			    std::string::npos || ParseDump(Bad, 4) != Error)
+				Fail("Chunked parse reports other error");
+
+			/* Syntax error before a semantic one */
+			Bad = XML;
+			BreakSphere(Bad, 2500, "<Material id=\"",
+				    "<Material id=\"Missing");
+			BreakSphere(Bad, 300, "radius=\"", "radius=\"\"\"");
+			const std::string Syntax = ParseDump(Bad, 1);
+			if (Syntax.find("syntax error") == std::string::npos ||
+			    ParseDump(Bad, 4) != Syntax)
+				Fail("Chunked parse reports other syntax error");
+			General::Parallel::SetWorkers(Workers);
+		}
+		cout << "Testcase OK" << endl;
+
+		/*** Binary scene: same scene as its XML ***/
+		cout << "*** Binary scene" << endl;
+		{
+			std::ostringstream Gen, Name, Dump;
+			World::Generator(World::Generator::Parse(
+				"spheres=200,planes=2,textures=3"))
+				.WriteXML(Gen);
+			World::Scene Source;
+			if (!Source.ParseMemory(Gen.str()))
+				Fail("Generated XML doesn't parse");
+			SceneDump(Dump, Source);
+			Name << "/tmp/blaRAY-test-" << getpid() << ".bin";
+			const std::string File = Name.str();
+			Source.SaveBinary(File);
+			if (!World::Scene::IsBinary(File) ||
+			    BinaryDump(File) != Dump.str())
+				Fail("Binary scene differs from XML");
+
+			std::string Data;
+			{
+				std::ifstream In(File.c_str());
+				std::ostringstream Buf;
+				Buf << In.rdbuf();
+				Data = Buf.str();
+			}
+
+			/* Cut anywhere, even inside the section table */
+			const size_t Cuts[] = {
+				4, sizeof(World::BinaryHeader) + 8,
+				Data.size() / 2, Data.size() - 1
+			};
+			for (UInt i = 0; i < sizeof(Cuts) / sizeof(*Cuts); i++) {
+				WriteFile(File, Data.substr(0, Cuts[i]));
+				if (BinaryDump(File) != "failed")
+					Fail("Truncated binary scene accepted");
+			}
+
+			World::BinaryHeader H;
+			std::memcpy(&H, Data.data(), sizeof(H));
+			const World::BinarySection *Table =
+				(const World::BinarySection *)
+				(Data.data() + sizeof(H));
+
+			/* Top byte of the plane count */
+			std::string Bad = Data;
+			Bad[sizeof(H) + World::PLANES * sizeof(*Table) + 7] =
+				0x7F;
+			WriteFile(File, Bad);
+			if (BinaryDump(File) != "failed")
+				Fail("Section past end of file accepted");
+
+			Bad = Data;
+			World::BinaryMaterial *M = (World::BinaryMaterial *)
+				&Bad[Table[World::MATERIALS].Offset];
+			M->Textures[2] = Table[World::TEXTURES].Count;
+			WriteFile(File, Bad);
+			if (BinaryDump(File) != "failed")
+				Fail("Missing texture accepted");
+
+			Bad = Data;
+			Bad[0] = 'X';
+			WriteFile(File, Bad);
+			if (World::Scene::IsBinary(File) ||
+			    BinaryDump(File) != "failed")
+				Fail("Binary scene with bad magic accepted");
+			unlink(File.c_str());
+		}
+		cout << "Testcase OK" << endl;
+
+		/*** Scene cache: hits, LRU eviction, held scenes ***/
+		cout << "*** Scene cache" << endl;
+		{
+			std::ostringstream Base;
+			Base << "/tmp/blaRAY-test-" << getpid() << "-";
+			const std::string A = Base.str() + "a.xml";
+			const std::string B = Base.str() + "b.xml";
+			const std::string C = Base.str() + "c.xml";
+			WriteScene(A, 1);
+			WriteScene(B, 2);
+			WriteScene(C, 3);
+
+			World::SceneCache Cache(2);
+			World::SceneCache::Handle HA, HB, HC, Old;
+			std::streambuf *Out = cout.rdbuf(NULL);
+			const Bool Parsed = Cache.Acquire(A, Old) &&
+				Cache.Acquire(A, HA) && &*HA == &*Old;
+			cout.rdbuf(Out);
+			if (!Parsed || Cache.GetHits() != 1 ||
+			    Cache.GetMisses() != 1)
+				Fail("Scene cache doesn't reuse scene");
+			Cache.Release(HA);
+
+			/* A, least recently used, goes; Old still holds it */
+			cout.rdbuf(NULL);
+			Cache.Acquire(B, HB);
+			Cache.Acquire(C, HC);
+			Cache.Acquire(A, HA);
+			cout.rdbuf(Out);
+			if (Cache.GetMisses() != 4 || &*HA == &*Old ||
+			    ObjectCount(*Old) != 1 || ObjectCount(*HA) != 1)
+				Fail("Scene cache eviction");
+			Cache.Release(Old);
+			Cache.Release(HA);
+			Cache.Release(HB);
+
+			/* B went with A's return; C stays */
+			cout.rdbuf(NULL);
+			Cache.Acquire(C, Old);
+			Cache.Acquire(B, HB);
+			cout.rdbuf(Out);
+			if (Cache.GetHits() != 2 || Cache.GetMisses() != 5 ||
+			    &*Old != &*HC)
+				Fail("Scene cache evicted other scene");
+			Cache.Release(Old);
+			Cache.Release(HB);
 
+			/* Edited file is parsed again; the held copy stays */
+			WriteScene(C, 4);
+			struct utimbuf Time;
+			Time.actime = Time.modtime = time(NULL) + 10;
+			utime(C.c_str(), &Time);
+			cout.rdbuf(NULL);
+			Cache.Acquire(C, Old);
+			cout.rdbuf(Out);
+			if (ObjectCount(*Old) != 4 || ObjectCount(*HC) != 3)
+				Fail("Scene cache keeps stale scene");
+			Cache.Release(Old);
+			Cache.Release(HC);
+
+			unlink(A.c_str());
+			unlink(B.c_str());
+			unlink(C.c_str());
+			if (Cache.Acquire(A, Old))
+				Fail("Scene cache returns missing file");
+		}
+		cout << "Testcase OK" << endl;
+
+		/*** Identical definitions share one instance ***/
+		cout << "*** Shared definitions" << endl;
+		World::Scene Shared;
+		if (!Shared.ParseMemory(
+			    "<Scene>"
+			    "<Texture id=\"A\" type=\"Plain\"><Color id=\"Red\"/></Texture>"
+			    "<Texture id=\"B\" type=\"Plain\"><Color r=\"1\" g=\"0\" b=\"0\"/></Texture>"
+			    "<Material id=\"M1\" diffuse=\"A\"/>"
+			    "<Material id=\"M2\" diffuse=\"B\"/>"
+			    "<Material id=\"M3\" diffuse=\"B\" shininess=\"5\"/>"
+			    "</Scene>"))
+			Fail("Scene with shared definitions doesn't parse");
+		Int Textures = 0, Materials = 0;
+		World::Scene::TextureIterator TI(Shared);
+		while (TI.Next())
+			Textures++;
+		World::Scene::MaterialIterator MI(Shared);
+		while (MI.Next())
+			Materials++;
+		if (Textures != 1 || Materials != 2)
+			Fail("Identical definitions are not shared");
+		cout << "Testcase OK" << endl;
+
+		/*** Name interning; enough names to grow the table ***/
+		cout << "*** Name interning" << endl;
+		General::Interner Names;
+		std::vector<std::string> Keys;
+		for (Int i = 0; i < 200; i++) {
+			std::ostringstream Key;
+			Key << "Mat" << i;
+			Keys.push_back(Key.str());
+			if (Names.Intern(Keys.back()) != UInt(i))
+				Fail("Interned IDs are not consecutive");
+		}
+		if (Names.Intern(Keys[7]) != 7U ||
+		    Names.Find(Keys[199]) != 199U ||
+		    Names.Find("Mat") != UInt(General::Interner::NONE) ||
+		    Names.Name(42) != Keys[42])
+			Fail("Interner lookup");
+		cout << "Testcase OK" << endl;
+
+		/*** Triangle mesh: grid of quads at y = 0 ***/
+		cout << "*** Triangle mesh" << endl;
+		std::ostringstream OBJ;
+		for (Int z = 0; z <= 20; z++)
+			for (Int x = 0; x <= 20; x++)
+				OBJ << "v " << x << " 0 " << z << "\n";
+		OBJ << "vn 0 1 0\n";
+		for (Int z = 0; z < 20; z++)
+			for (Int x = 0; x < 20; x++) {
+				const Int V = z * 21 + x + 1;
+				OBJ << "f " << V << "//1 " << V + 21 << "//1 "
+				    << V + 22 << "//1 " << V + 1 << "//1\n";
+			}
+		World::TriangleMesh::Buffers B;
+		World::TriangleMesh::ReadOBJ(OBJ.str().data(), OBJ.str().size(),
+					     "grid", B);
+		World::TriangleMesh Mesh(B, World::MatLib::Gray());
+		if (Mesh.GetTriangles() != 800)
+			Fail("Mesh has wrong triangle count");
+		General::Random Rnd(3);
+		for (Int i = 0; i < 100; i++) {
+			const Math::Vector From(Rnd.Next() * 20.0, 5.0,
+						Rnd.Next() * 20.0);
+			Render::Ray Down(From, Math::Vector(0.1, -1.0, 0.05));
+			Double Pos = 1e10;
+			World::HitStorage Storage;
+			const World::Object *Hit = Mesh.Collide(Down, Pos,
+								Storage);
+			const Math::Vector P = Down.GetPoint(Pos);
+			const Bool Inside = P[0] <= 20.0 && P[2] <= 20.0;
+			if (Inside != (Hit != NULL))
+				Fail("Mesh ray hit/miss mismatch");
+			if (Hit && (Math::Abs(P[1]) > 1e-4 ||
+				    Hit->NormalAt(P)[1] < 0.999))
+				Fail("Mesh hit at wrong point");
+		}
+		try {
+			World::TriangleMesh::ReadOBJ("v 0 0 0\nf 1 2 3\n", 16,
+						     "bad", B);
+			Fail("Mesh index out of range not detected");
+		} catch (std::runtime_error &e) {
+		}
+		cout << "Testcase OK" << endl;
+
+		/*** Boxes: aligned, rotated 45 degrees, hit from inside ***/
+		cout << "*** Box" << endl;
+		World::Box Aligned(Math::Vector(0.0, 0.0, 10.0),
+				   Math::Vector(2.0, 2.0, 2.0));
+		World::Box Rotated(Math::Vector(0.0, 0.0, 10.0),
+				   Math::Vector(2.0, 2.0, 2.0),
+				   Math::Vector(1.0, 0.0, 1.0),
+				   Math::Vector(0.0, 1.0, 0.0));
+		if (!Aligned.Collide(Ray2, Loc) || Math::Abs(Loc - 9.0) > 1e-9 ||
+		    Aligned.NormalAt(Ray2.GetPoint(Loc))
+		    != Math::Vector(0.0, 0.0, -1.0))
+			Fail("Aligned box collision");
+		if (!Rotated.Collide(Ray2, Loc) ||
+		    Math::Abs(Loc - (10.0 - std::sqrt(2.0))) > 1e-9)
+			Fail("Rotated box collision");
+		Render::Ray Inside(Math::Vector(0.0, 0.0, 10.0),
+				   Math::Vector(0.0, 1.0, 0.0));
+		if (!Aligned.Collide(Inside, Loc) || Math::Abs(Loc - 1.0) > 1e-9)
+			Fail("Box collision from inside");
+		Render::Ray Past(Math::Vector(0.0, 1.5, 0.0),
+				 Math::Vector(0.0, 0.0, 1.0));
+		if (Aligned.Collide(Past, Loc))
+			Fail("Ray passing box collides");
+		cout << "Testcase OK" << endl;
+
+		/*** Julia set: orbit of its center is bounded ***/
+		cout << "*** Quaternion Julia" << endl;
+		World::QuaternionJulia Julia(Math::Vector(0.0, 0.0, 10.0), 1.0);
+		if (!Julia.Collide(Ray2, Loc) || Loc < 8.0 || Loc > 10.0)
+			Fail("Julia set collision");
+		const Math::Vector JN = Julia.NormalAt(Ray2.GetPoint(Loc));
+		if (Math::Abs(JN.Length() - 1.0) > 1e-9 ||
+		    JN.Dot(Ray2.Direction()) >= 0.0)
+			Fail("Julia set normal");
+		if (Julia.Collide(Past, Loc))
+			Fail("Ray passing Julia set collides");
+		cout << "Testcase OK" << endl;
+
+		/*** Lazy regions: few resident, same hits as eager ***/
+		cout << "*** Lazy regions" << endl;
+		{
+			std::ostringstream Gen, Name;
+			World::Generator(World::Generator::Parse(
+				"spheres=400,planes=1,size=10")).WriteXML(Gen);
+			World::Scene Source;
+			if (!Source.ParseMemory(Gen.str()))
+				Fail("Generated XML doesn't parse");
+			Name << "/tmp/blaRAY-test-" << getpid() << ".bin";
+			const std::string File = Name.str();
+			Source.SaveBinary(File, 8);
+
+			/* About three of fifty regions fit */
+			World::Scene Eager, Lazy;
+			World::Scene::SetRegionBudget(0);
+			const Bool EagerOk = Eager.LoadBinary(File);
+			World::Scene::SetRegionBudget(
+				3 * 8 * sizeof(World::Sphere));
+			const Bool LazyOk = Lazy.LoadBinary(File);
+			World::Scene::SetRegionBudget(0);
+			if (!EagerOk || !LazyOk)
+				Fail("Binary scene doesn't load");
+			const std::string Hits = HitDump(Eager, 20.0, 2000);
+			if (HitDump(Lazy, 20.0, 2000) != Hits ||
+			    Hits.find("Sphere") == std::string::npos)
+				Fail("Lazy regions hit other objects");
+
+			/* Material index out of range in the last sphere */
+			std::string Data;
+			{
+				std::ifstream In(File.c_str());
+				std::ostringstream Buf;
+				Buf << In.rdbuf();
+				Data = Buf.str();
+			}
+			const World::BinarySection *Table =
+				(const World::BinarySection *)
+				(Data.data() + sizeof(World::BinaryHeader));
+			const World::BinarySection &Sph = Table[World::SPHERES];
+			World::BinaryPrimitive *Last = (World::BinaryPrimitive *)
+				&Data[Sph.Offset + (Sph.Count - 1)
+				      * sizeof(World::BinaryPrimitive)];
+			Last->Material = 1000;
+			const Math::Vector Center(Last->V[0], Last->V[1],
+						  Last->V[2]);
+			WriteFile(File, Data);
+
+			World::Scene BadEager, BadLazy;
+			std::streambuf *Old = cout.rdbuf(NULL);
+			const Bool BadEagerOk = BadEager.LoadBinary(File);
+			World::Scene::SetRegionBudget(
+				3 * 8 * sizeof(World::Sphere));
+			BadLazy.LoadBinary(File);
+			World::Scene::SetRegionBudget(0);
+			cout.rdbuf(Old);
+			unlink(File.c_str());
+			if (BadEagerOk)
+				Fail("Eager load accepts missing material");
+
+			/* The ray starts in the broken region, so it is
+			 * read; the error reaches the caller of For() */
+			const Render::Ray Into(Center, Math::Vector(0.0, 1.0, 0.0));
+			RayJob Job(BadLazy, Into);
+			try {
+				General::Parallel::For(Job, 2, 2);
+				Fail("Lazy load accepts missing material");
+			} catch (std::runtime_error &e) {
+			}
+		}
+		cout << "Testcase OK" << endl;
 	}
 
 	void Graphics()
@@ -275,9 +1209,100 @@ namespace Testcases {
 
 	}
 
+	void Arena()
+	{
+		cout << "*** Arena testcase ***" << endl;
+		General::Arena A(64), B(64);
+
+		/* Aligned, disjoint and growing past the first block */
+		std::vector<char *> Items;
+		for (Int i = 1; i <= 100; i++) {
+			char *P = (char *)A.Allocate(i);
+			if (((size_t)P & 15) != 0)
+				Fail("Arena allocation not aligned");
+			std::memset(P, i, i);
+			Items.push_back(P);
+		}
+		for (Int i = 1; i <= 100; i++)
+			if (Items[i - 1][i - 1] != char(i))
+				Fail("Arena allocations overlap");
+		Int Local = 0;
+		if (!A.Owns(Items.front()) || !A.Owns(Items.back()) ||
+		    A.Owns(&Local) || B.Owns(Items.front()))
+			Fail("Arena ownership");
+
+		/* Reserved space is handed out contiguously */
+		A.Reserve(10 * 32);
+		char *First = (char *)A.Allocate(32);
+		for (Int i = 1; i < 10; i++)
+			if ((char *)A.Allocate(32) != First + 32 * i)
+				Fail("Reserved arena space not contiguous");
+
+		/* Adopted items move; the owner keeps its last block */
+		char *Other = (char *)B.Allocate(16);
+		char *Before = (char *)A.Allocate(16);
+		A.Adopt(B);
+		if (!A.Owns(Other) || B.Owns(Other) ||
+		    (char *)A.Allocate(16) != Before + 16)
+			Fail("Arena adoption");
+		B.Allocate(16);
+
+		/* Scene frees heap items only */
+		World::Scene S;
+		S.AddObject(new (S.GetArena()) World::Sphere(
+				    Math::Vector(0.0, 0.0, 10.0), 1.0),
+			    World::Scene::ARENA);
+		S.AddObject(new World::Sphere(Math::Vector(0.0, 0.0, 5.0),
+					      1.0));
+		S.Purge();
+		cout << "Testcase OK" << endl;
+	}
+
+	void Profile()
+	{
+		cout << "*** Profile testcase ***" << endl;
+		General::Profile::Start();
+		General::Profile::Count(General::Profile::PRIMARY_RAYS, 3);
+		General::Profile::Count(General::Profile::SHADOW_RAYS, 2);
+		General::Profile::Count(General::Profile::TEXTURE_LOOKUPS, 7);
+		General::Profile::Count(General::Profile::REGION_LOADS, 4);
+		{
+			General::Profile::Scope S(General::Profile::SHADING);
+		}
+		General::Profile::Stop();
+
+		/* Counted after Stop(); must not show up */
+		General::Profile::Count(General::Profile::PRIMARY_RAYS, 100);
+
+		std::stringstream Out;
+		General::Profile::Report(Out);
+		const std::string R = Out.str();
+		const char *Fields[] = {
+			"\"seconds\": ", "\"threads\": ",
+			"\"rays\": { \"primary\": 3, \"secondary\": 0,"
+			" \"shadow\": 2, \"total\": 5 },",
+			"\"rays_per_second\": ", "\"texture_lookups\": 7,",
+			"\"regions\": { \"loads\": 4, \"evictions\": 0 },",
+			"\"phases_ms\": { \"other\": ", "\"parse\": ",
+			"\"build\": ", "\"primary\": ", "\"secondary\": ",
+			"\"shadow\": ", "\"shading\": ", "\"texture\": ",
+			"\"output\": ", "\"peak_rss_kb\": "
+		};
+		for (UInt i = 0; i < sizeof(Fields) / sizeof(Fields[0]); i++)
+			if (R.find(Fields[i]) == std::string::npos)
+				Fail(std::string("Profile report lacks ") +
+				     Fields[i]);
+		if (R[0] != '{' || R.find("}\n", R.size() - 2) ==
+		    std::string::npos)
+			Fail("Profile report is not one JSON object");
+		cout << "Profile report has all fields" << endl;
+	}
+
 	void All()
 	{
 		Math();
+		Profile();
+		Arena();
 		Render();
 		Scene();
 		Explicit();
@@ -20,8 +20,13 @@ namespace Testcases {
 	/**@{ Modules testcases. One per namespace */
 	void Scene();
 	void Render();
+	void PhotonGrid();
+	void IrradianceCache();
+	void HDRImage();
 	void Graphics();
 	void Math();
+	void Profile();
+	void Arena();
 	void Explicit();
 	void All();
 	/*@}*/
@@ -0,0 +1,152 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include "General/Thread.hh"
+
+namespace General {
+	void *Thread::Entry(void *Data)
+	{
+		static_cast<Thread *>(Data)->Run();
+		return NULL;
+	}
+
+	Thread::~Thread()
+	{
+		if (Running)
+			Join();
+	}
+
+	void Thread::Start()
+	{
+		if (Running)
+			throw std::logic_error("Thread already started");
+		if (pthread_create(&Handle, NULL, &Thread::Entry, this) != 0)
+			throw std::runtime_error("Unable to create thread");
+		Running = true;
+	}
+
+	void Thread::Join()
+	{
+		if (!Running)
+			return;
+		pthread_join(Handle, NULL);
+		Running = false;
+	}
+
+	namespace Parallel {
+		/** Worker count set by user; 0 means "all CPUs" */
+		static Int UserWorkers = 0;
+
+		/** \brief Thread executing one range of a Job */
+		class RangeThread : public Thread {
+		public:
+			Job *J;
+			Int Worker, From, To;
+			/** Set if the range threw */
+			Bool Failed;
+			/** Message of the exception */
+			std::string Error;
+
+			RangeThread() : Failed(false) {}
+
+			virtual void Run() {
+				try {
+					J->Run(Worker, From, To);
+				} catch (std::exception &e) {
+					Failed = true;
+					Error = e.what();
+				} catch (...) {
+					Failed = true;
+					Error = "Unknown error in worker";
+				}
+			}
+		};
+
+		Int CPUCount()
+		{
+			long Count = sysconf(_SC_NPROCESSORS_ONLN);
+			if (Count < 1)
+				return 1;
+			return Int(Count);
+		}
+
+		Int Workers()
+		{
+			if (UserWorkers > 0)
+				return UserWorkers;
+			return CPUCount();
+		}
+
+		void SetWorkers(Int Count)
+		{
+			UserWorkers = Count;
+		}
+
+		void For(Job &J, Int Count, Int Workers)
+		{
+			if (Count <= 0)
+				return;
+			if (Workers <= 0)
+				Workers = Parallel::Workers();
+			if (Workers > Count)
+				Workers = Count;
+
+			if (Workers == 1) {
+				J.Run(0, 0, Count);
+				return;
+			}
+
+			/* Slot 0 is the calling thread, never started */
+			RangeThread *Threads = new RangeThread[Workers];
+			const Int Chunk = Count / Workers;
+			const Int Rest = Count % Workers;
+			Int From = 0;
+			for (Int i = 0; i < Workers; i++) {
+				const Int To = From + Chunk + (i < Rest ? 1 : 0);
+				if (i > 0) {
+					RangeThread &T = Threads[i];
+					T.J = &J;
+					T.Worker = i;
+					T.From = From;
+					T.To = To;
+					T.Start();
+				}
+				From = To;
+			}
+
+			/* Calling thread does the first range */
+			RangeThread &Own = Threads[0];
+			Own.J = &J;
+			Own.Worker = 0;
+			Own.From = 0;
+			Own.To = Chunk + (Rest > 0 ? 1 : 0);
+			Own.Run();
+
+			std::string Error;
+			Bool Failed = false;
+			for (Int i = 0; i < Workers; i++) {
+				Threads[i].Join();
+				if (Threads[i].Failed && !Failed) {
+					Failed = true;
+					Error = Threads[i].Error;
+				}
+			}
+			delete[] Threads;
+			if (Failed)
+				throw std::runtime_error(Error);
+		}
+	}
+}
@@ -0,0 +1,163 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+#include <pthread.h>
+#include "General/Types.hh"
+
+/**
+ * \brief
+ *	Program-wide helpers not bound to any rendering concept
+ *	(threads, allocators, instrumentation).
+ */
+namespace General {
+
+	/** \brief Thin wrapper around a POSIX thread */
+	class Thread {
+	private:
+		/** Thread handle */
+		pthread_t Handle;
+
+		/** Was the thread started and not yet joined? */
+		Bool Running;
+
+		/** pthread entry point; calls Run() */
+		static void *Entry(void *Data);
+
+		/** Private copy-constructor */
+		Thread(const Thread &T);
+
+		/** Private operator= */
+		void operator=(const Thread &T) const;
+	public:
+		/** Construct stopped thread */
+		Thread() : Running(false) {}
+
+		/** Joins thread if it's still running */
+		virtual ~Thread();
+
+		/** Thread body */
+		virtual void Run() = 0;
+
+		/** Spawn the thread */
+		void Start();
+
+		/** Wait until Run() returns */
+		void Join();
+	};
+
+	/** \brief Non-recursive mutex */
+	class Mutex {
+	private:
+		pthread_mutex_t M;
+
+		/** Private copy-constructor */
+		Mutex(const Mutex &M);
+
+		/** Private operator= */
+		void operator=(const Mutex &M) const;
+	public:
+		Mutex() { pthread_mutex_init(&M, NULL); }
+		~Mutex() { pthread_mutex_destroy(&M); }
+
+		inline void Lock() { pthread_mutex_lock(&M); }
+		inline void Unlock() { pthread_mutex_unlock(&M); }
+
+		friend class Condition;
+	};
+
+	/** \brief Scoped mutex lock */
+	class Lock {
+	private:
+		Mutex &M;
+	public:
+		Lock(Mutex &M) : M(M) { M.Lock(); }
+		~Lock() { M.Unlock(); }
+	};
+
+	/** \brief Lock shared by readers, exclusive for a writer */
+	class RWLock {
+	private:
+		pthread_rwlock_t L;
+
+		/** Private copy-constructor */
+		RWLock(const RWLock &L);
+
+		/** Private operator= */
+		void operator=(const RWLock &L) const;
+	public:
+		RWLock() { pthread_rwlock_init(&L, NULL); }
+		~RWLock() { pthread_rwlock_destroy(&L); }
+
+		inline void ReadLock() { pthread_rwlock_rdlock(&L); }
+		inline void WriteLock() { pthread_rwlock_wrlock(&L); }
+		/** \return true if write lock was taken without waiting */
+		inline bool TryWriteLock() {
+			return pthread_rwlock_trywrlock(&L) == 0;
+		}
+		inline void Unlock() { pthread_rwlock_unlock(&L); }
+	};
+
+	/** \brief Condition variable bound to a Mutex */
+	class Condition {
+	private:
+		pthread_cond_t C;
+	public:
+		Condition() { pthread_cond_init(&C, NULL); }
+		~Condition() { pthread_cond_destroy(&C); }
+
+		/** Wait for signal; mutex must be locked */
+		inline void Wait(Mutex &M) { pthread_cond_wait(&C, &M.M); }
+		inline void Signal() { pthread_cond_signal(&C); }
+		inline void Broadcast() { pthread_cond_broadcast(&C); }
+	};
+
+	/**
+	 * \brief
+	 *	Range of work split between threads.
+	 *
+	 * Parallel::For calls Run() with disjoint [From, To)
+	 * subranges of [0, Count), each from a different worker.
+	 */
+	class Job {
+	public:
+		virtual ~Job() {}
+
+		/** Process items [From, To) as worker number Worker */
+		virtual void Run(Int Worker, Int From, Int To) = 0;
+	};
+
+	namespace Parallel {
+		/** Number of online processors (at least 1) */
+		Int CPUCount();
+
+		/** Default number of workers; CPUCount() unless
+		 * changed with SetWorkers() */
+		Int Workers();
+
+		/** Override number of workers (0 restores CPUCount) */
+		void SetWorkers(Int Count);
+
+		/**
+		 * Split [0, Count) into Workers contiguous ranges and
+		 * process them concurrently. Returns when all are done.
+		 * Worker 0 runs in the calling thread.
+		 * \throw std::runtime_error with the message of the
+		 *	first range that threw, after all have finished
+		 */
+		void For(Job &J, Int Count, Int Workers = 0);
+	}
+};
+
+#endif
@@ -0,0 +1,81 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "Graphics/CostMap.hh"
+
+namespace Graphics {
+	CostMap::CostMap(Int Width, Int Height)
+		: Costs(Width, Height)
+	{
+	}
+
+	/** Blue - cyan - green - yellow - red ramp for V in [0, 1] */
+	static void Ramp(float V, unsigned char *RGB)
+	{
+		const float Stops[5][3] = {
+			{ 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 },
+			{ 1, 1, 0 }, { 1, 0, 0 }
+		};
+		V = std::min(1.0f, std::max(0.0f, V)) * 4.0f;
+		const Int i = std::min(3, int(V));
+		const float f = V - i;
+		for (Int c = 0; c < 3; c++)
+			RGB[c] = (unsigned char)(255.0f *
+				(Stops[i][c] * (1.0f - f) + Stops[i + 1][c] * f)
+				+ 0.5f);
+	}
+
+	void CostMap::Save(const std::string &Base) const
+	{
+		Costs.Save(Base + ".cost.pfm");
+
+		const Int Width = Costs.GetWidth();
+		const Int Height = Costs.GetHeight();
+		const size_t Count = size_t(Width) * Height;
+
+		/* Scale to the 99th percentile, so a few very
+		 * expensive pixels don't make the rest one colour */
+		const float *Data = Costs.GetRGB(0, 0);
+		std::vector<float> Cycles(Count);
+		for (size_t i = 0; i < Count; i++)
+			Cycles[i] = Data[3 * i + 2];
+		float Max = 0.0f;
+		if (Count > 0) {
+			std::vector<float> Sorted(Cycles);
+			/* Nearest rank: ceil(0.99 Count) - 1 */
+			const size_t Idx = (Count * 99 + 99) / 100 - 1;
+			std::nth_element(Sorted.begin(), Sorted.begin() + Idx,
+					 Sorted.end());
+			Max = Sorted[Idx];
+		}
+
+		std::vector<unsigned char> RGB(3 * Count);
+		for (size_t i = 0; i < Count; i++)
+			Ramp(Max > 0.0f ? Cycles[i] / Max : 0.0f, &RGB[3 * i]);
+
+		const std::string File = Base + ".cost.ppm";
+		FILE *F = fopen(File.c_str(), "wb");
+		if (F == NULL)
+			throw std::runtime_error("Unable to open " + File);
+		Bool Ok = fprintf(F, "P6\n%d %d\n255\n",
+				  int(Width), int(Height)) > 0 &&
+			(Count == 0 || fwrite(&RGB[0], RGB.size(), 1, F) == 1);
+		if (fclose(F) != 0 || !Ok)
+			throw std::runtime_error("Unable to write " + File);
+	}
+}
@@ -0,0 +1,55 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _COSTMAP_H_
+#define _COSTMAP_H_
+
+#include <string>
+
+#include "General/Types.hh"
+#include "Graphics/HDRImage.hh"
+
+namespace Graphics {
+
+	/**
+	 * \brief
+	 *	Per-pixel render cost.
+	 *
+	 * Holds rays traced, object intersection tests and processor
+	 * cycles spent on each pixel. Saved as a PFM with the three
+	 * counts as channels (exact values for tools) and a false
+	 * colour PPM of cycles (blue - cheap, red - expensive) for
+	 * a quick look.
+	 */
+	class CostMap {
+	private:
+		/** R - rays, G - tests, B - cycles */
+		HDRImage Costs;
+
+	public:
+		CostMap(Int Width, Int Height);
+
+		/** Record cost of a pixel */
+		inline void Put(Int x, Int y, float Rays, float Tests,
+				float Cycles) {
+			const float C[3] = { Rays, Tests, Cycles };
+			Costs.PutRGB(x, y, C);
+		}
+
+		/** Write Base.cost.pfm and Base.cost.ppm
+		 * \throw std::runtime_error on I/O error */
+		void Save(const std::string &Base) const;
+	};
+};
+
+#endif
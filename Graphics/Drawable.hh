@@ -14,6 +14,7 @@
 #define _DRAWABLE_H_
 
 #include <string.h>
+#include <vector>
 #include "General/Types.hh"
 #include "World/Color.hh"
 
@@ -47,6 +48,53 @@ namespace Graphics {
 		/** Puts pixel of specified color at specified location */
 		virtual void PutPixel(Int x, Int y, const World::Color &C) = 0;
 
+		/** Puts unclamped light at specified location; drawables
+		 * which can't store it get it clamped */
+		virtual void PutRadiance(Int x, Int y, const World::Spectrum &S) {
+			PutPixel(x, y, S.Clamp());
+		}
+
+		/**
+		 * Puts a rectangle of pixels at once.
+		 * \param C	W * H colors, row by row
+		 *
+		 * Finished tiles should go through here; drawables
+		 * convert and refresh the whole tile in one go.
+		 */
+		virtual void PutTile(Int x, Int y, Int W, Int H,
+				     const World::Color *C) {
+			for (Int j = 0; j < H; j++)
+				for (Int i = 0; i < W; i++)
+					PutPixel(x + i, y + j, *C++);
+		}
+
+		/**
+		 * Puts a rectangle of unclamped light at once.
+		 * \param S	W * H values, row by row
+		 *
+		 * Drawables which can't store light above 1.0 get the
+		 * tile clamped through PutTile().
+		 */
+		virtual void PutRadianceTile(Int x, Int y, Int W, Int H,
+					     const World::Spectrum *S) {
+			std::vector<World::Color> C(W * H);
+			for (Int i = 0; i < W * H; i++)
+				C[i] = S[i].Clamp();
+			if (W * H > 0)
+				PutTile(x, y, W, H, &C[0]);
+		}
+
+		/** Record that the rectangle holds final pixels, which
+		 * a resumed render may keep; previews must not call it */
+		virtual void MarkFinished(Int x, Int y, Int W, Int H) {
+		}
+
+		/** Does the rectangle hold pixels finished by an
+		 * earlier (interrupted) render? Renderers skip it then. */
+		virtual Bool IsFinished(Int x, Int y, Int W, Int H) const {
+			return false;
+		}
+
 		/** Refreshes drawable (stores for images */
 		virtual void Refresh() = 0;
 
@@ -0,0 +1,213 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include <sstream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Graphics/Image.hh"
+#include "Graphics/HDRImage.hh"
+
+namespace Graphics {
+	/** \brief Linear [0,1] -> 8-bit sRGB lookup table */
+	class SRGBTable {
+	public:
+		/** Table entries; fine enough for 8-bit output */
+		enum { SIZE = 4096 };
+		unsigned char T[SIZE];
+
+		SRGBTable() {
+			for (Int i = 0; i < SIZE; i++) {
+				const double L = double(i) / (SIZE - 1);
+				const double S = L <= 0.0031308
+					? 12.92 * L
+					: 1.055 * std::pow(L, 1.0 / 2.4) - 0.055;
+				T[i] = (unsigned char)(S * 255.0 + 0.5);
+			}
+		}
+	};
+
+	/** Built before main(), read-only afterwards */
+	static const SRGBTable SRGB;
+
+	ToneMap ToneMap::Parse(const std::string &Desc)
+	{
+		std::stringstream s(Desc);
+		std::string Name;
+		std::getline(s, Name, ',');
+
+		ToneMap T;
+		if (Name == "clamp")
+			T.Op = CLAMP;
+		else if (Name == "reinhard")
+			T.Op = REINHARD;
+		else
+			throw std::invalid_argument(
+				"Unknown tone mapping: " + Name);
+		if (!s.eof() && !(s >> T.Exposure))
+			throw std::invalid_argument(
+				"Wrong exposure in: " + Desc);
+		return T;
+	}
+
+	HDRImage::HDRImage(Int Width, Int Height, Bool Accumulate)
+		: Drawable(Width, Height),
+		  Data(3 * Width * Height, 0.0f),
+		  Accumulate(Accumulate),
+		  Pixels(Data.empty() ? NULL : &Data[0])
+	{
+	}
+
+	HDRImage::HDRImage(Int Width, Int Height, float *Pixels)
+		: Drawable(Width, Height),
+		  Accumulate(false),
+		  Pixels(Pixels)
+	{
+	}
+
+	void HDRImage::PutPixel(Int x, Int y, const World::Color &C)
+	{
+		const float RGB[3] = { float(C[0]), float(C[1]), float(C[2]) };
+		PutRGB(x, y, RGB);
+	}
+
+	void HDRImage::PutRadiance(Int x, Int y, const World::Spectrum &S)
+	{
+		const float RGB[3] = { float(S[0]), float(S[1]), float(S[2]) };
+		PutRGB(x, y, RGB);
+	}
+
+	void HDRImage::PutTile(Int x, Int y, Int W, Int H,
+			       const World::Color *C)
+	{
+		for (Int j = 0; j < H; j++)
+			for (Int i = 0; i < W; i++, C++) {
+				const float RGB[3] = {
+					float((*C)[0]), float((*C)[1]),
+					float((*C)[2])
+				};
+				PutRGB(x + i, y + j, RGB);
+			}
+	}
+
+	void HDRImage::PutRadianceTile(Int x, Int y, Int W, Int H,
+				       const World::Spectrum *S)
+	{
+		for (Int j = 0; j < H; j++)
+			for (Int i = 0; i < W; i++, S++) {
+				const float RGB[3] = {
+					float((*S)[0]), float((*S)[1]),
+					float((*S)[2])
+				};
+				PutRGB(x + i, y + j, RGB);
+			}
+	}
+
+	void HDRImage::Clear()
+	{
+		std::fill(Pixels, Pixels + 3 * size_t(Width) * Height, 0.0f);
+	}
+
+	void HDRImage::Refresh()
+	{
+	}
+
+	void HDRImage::Quantize(const ToneMap &T, unsigned char *Out,
+				Bool Swap) const
+	{
+		QuantizeRows(T, 0, Height, Out, Swap);
+	}
+
+	void HDRImage::QuantizeRows(const ToneMap &T, Int Y, Int Rows,
+				    unsigned char *Out, Bool Swap) const
+	{
+		/* All operators work per channel, so the rows are
+		 * processed as one flat float array */
+		const size_t Count = 3 * size_t(Width) * Rows;
+		const float *In = Count > 0 ? GetRGB(0, Y) : NULL;
+		const float Scale = SRGBTable::SIZE - 1;
+		const Bool Reinhard = T.Op == ToneMap::REINHARD;
+		size_t i = 0;
+
+#ifdef __SSE2__
+		const __m128 Exposure = _mm_set1_ps(T.Exposure);
+		const __m128 One = _mm_set1_ps(1.0f);
+		const __m128 Zero = _mm_setzero_ps();
+		const __m128 Steps = _mm_set1_ps(Scale);
+		const __m128 Half = _mm_set1_ps(0.5f);
+		for (; i + 4 <= Count; i += 4) {
+			__m128 V = _mm_mul_ps(_mm_loadu_ps(&In[i]), Exposure);
+			if (Reinhard)
+				V = _mm_div_ps(V, _mm_add_ps(One, V));
+			V = _mm_min_ps(_mm_max_ps(V, Zero), One);
+			/* NaNs became 0 by max() above */
+			int Idx[4];
+			_mm_storeu_si128((__m128i *)Idx, _mm_cvttps_epi32(
+				_mm_add_ps(_mm_mul_ps(V, Steps), Half)));
+			Out[i] = SRGB.T[Idx[0]];
+			Out[i + 1] = SRGB.T[Idx[1]];
+			Out[i + 2] = SRGB.T[Idx[2]];
+			Out[i + 3] = SRGB.T[Idx[3]];
+		}
+#endif
+		for (; i < Count; i++) {
+			float V = In[i] * T.Exposure;
+			if (Reinhard)
+				V = V / (1.0f + V);
+			if (!(V > 0.0f))
+				V = 0.0f;
+			if (V > 1.0f)
+				V = 1.0f;
+			Out[i] = SRGB.T[Int(int(V * Scale + 0.5f))];
+		}
+
+		if (Swap)
+			for (size_t p = 0; p < Count; p += 3) {
+				const unsigned char R = Out[p];
+				Out[p] = Out[p + 2];
+				Out[p + 2] = R;
+			}
+	}
+
+	void HDRImage::Save(const std::string Filename) const
+	{
+		const std::string::size_type Dot = Filename.rfind('.');
+		if (Dot == std::string::npos ||
+		    Filename.substr(Dot) != ".pfm") {
+			std::vector<unsigned char> BGR(3 * size_t(Width) * Height);
+			Quantize(Mapping, BGR.empty() ? NULL : &BGR[0], true);
+			SaveBMP(Filename, Width, Height,
+				BGR.empty() ? NULL : &BGR[0]);
+			return;
+		}
+
+		/* Portable float map; negative scale means little
+		 * endian, rows go bottom-up */
+		FILE *F = fopen(Filename.c_str(), "wb");
+		if (F == NULL)
+			throw std::runtime_error("Unable to open " + Filename);
+		const union { unsigned int I; unsigned char C; } Endian = { 1 };
+		Bool Ok = fprintf(F, "PF\n%d %d\n%s\n", int(Width), int(Height),
+				  Endian.C ? "-1.0" : "1.0") > 0;
+		for (Int y = Height - 1; Ok && y >= 0; y--)
+			Ok = fwrite(GetRGB(0, y), sizeof(float) * 3,
+				    Width, F) == size_t(Width);
+		if (fclose(F) != 0 || !Ok)
+			throw std::runtime_error("Unable to write " + Filename);
+	}
+}
@@ -0,0 +1,143 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _HDRIMAGE_H_
+#define _HDRIMAGE_H_
+
+#include <string>
+#include <vector>
+
+#include "General/Types.hh"
+#include "Graphics/Drawable.hh"
+#include "World/Color.hh"
+
+namespace Graphics {
+
+	/** \brief Mapping of HDR values onto the displayable range */
+	struct ToneMap {
+		enum Operator {
+			CLAMP,		/**< Cut values above 1 */
+			REINHARD	/**< x / (1 + x) per channel */
+		};
+
+		Operator Op;
+
+		/** Multiplier applied before the operator */
+		float Exposure;
+
+		ToneMap(Operator Op = CLAMP, float Exposure = 1.0f)
+			: Op(Op), Exposure(Exposure) {}
+
+		/** Parse "clamp|reinhard[,exposure]"; throws
+		 * std::invalid_argument */
+		static ToneMap Parse(const std::string &Desc);
+	};
+
+	/**
+	 * \brief
+	 *	Framebuffer of unclamped float RGB pixels.
+	 *
+	 * Half the size of Image and keeps light above 1.0, so it can
+	 * be saved as HDR (PFM) or tone mapped and quantized to sRGB
+	 * in one pass when saved as BMP. In accumulation mode pixels
+	 * are summed instead of replaced, e.g. over progressive passes;
+	 * the sum is scaled at output by the ToneMap exposure.
+	 */
+	class HDRImage : public Drawable {
+	private:
+		/** RGB triples, row by row (unless stored elsewhere) */
+		std::vector<float> Data;
+
+		/** Add instead of overwriting? */
+		Bool Accumulate;
+
+		/** Private copy-constructor */
+		HDRImage(const HDRImage &G);
+
+		/** Private operator= */
+		void operator=(const HDRImage &G) const;
+
+	protected:
+		/** First pixel; Data or external storage */
+		float *Pixels;
+
+		/** Construct image over external storage set later
+		 * into Pixels (3 * Width * Height floats) */
+		HDRImage(Int Width, Int Height, float *Pixels);
+
+		/** Used by Save() for LDR formats */
+		ToneMap Mapping;
+
+		/** Quantize Rows rows starting at row Y; \see Quantize */
+		void QuantizeRows(const ToneMap &T, Int Y, Int Rows,
+				  unsigned char *Out, Bool Swap) const;
+
+	public:
+		/** Construct black image */
+		HDRImage(Int Width, Int Height, Bool Accumulate = false);
+
+		virtual void PutPixel(Int x, Int y, const World::Color &C);
+		virtual void PutRadiance(Int x, Int y, const World::Spectrum &S);
+		virtual void PutTile(Int x, Int y, Int W, Int H,
+				     const World::Color *C);
+		virtual void PutRadianceTile(Int x, Int y, Int W, Int H,
+					     const World::Spectrum *S);
+
+		/** Store float triple directly */
+		inline void PutRGB(Int x, Int y, const float *RGB) {
+			float *P = Pixels + 3 * (size_t(y) * Width + x);
+			if (Accumulate) {
+				P[0] += RGB[0];
+				P[1] += RGB[1];
+				P[2] += RGB[2];
+			} else {
+				P[0] = RGB[0];
+				P[1] = RGB[1];
+				P[2] = RGB[2];
+			}
+		}
+
+		/** Raw pixel access (RGB floats) */
+		inline const float *GetRGB(Int x, Int y) const {
+			return Pixels + 3 * (size_t(y) * Width + x);
+		}
+
+		/** Reset all pixels to black */
+		void Clear();
+
+		/** Switch accumulation mode */
+		inline void SetAccumulate(Bool Accumulate) {
+			this->Accumulate = Accumulate;
+		}
+
+		/** Set tone mapping used when saving LDR formats */
+		inline void SetToneMap(const ToneMap &T) {
+			Mapping = T;
+		}
+
+		/**
+		 * Tone map and quantize whole image to 8-bit sRGB.
+		 * \param Out	3 * Width * Height bytes, RGB order
+		 *		(BGR if Swap is set), rows top-down
+		 */
+		void Quantize(const ToneMap &T, unsigned char *Out,
+			      Bool Swap = false) const;
+
+		virtual void Refresh();
+
+		/** Save as PFM (.pfm, unmapped) or BMP (tone mapped) */
+		virtual void Save(const std::string Filename) const;
+	};
+};
+
+#endif
@@ -10,6 +10,10 @@
  * See Docs/LICENSE
  *********************/
 
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include "World/Color.hh"
 #include "Graphics/Image.hh"
@@ -26,12 +30,67 @@ namespace Graphics {
 		delete[] Data;
 	}
 
+	void Image::PutTile(Int x, Int y, Int W, Int H, const World::Color *C)
+	{
+		for (Int j = 0; j < H; j++, C += W)
+			std::copy(C, C + W, Data + (y + j) * Width + x);
+	}
+
 	void Image::Refresh()
 	{
 	}
 
+	/** Store little-endian 16/32 bit value */
+	static inline void PutLE(unsigned char *Buf, unsigned int Value,
+				 Int Bytes)
+	{
+		for (Int i = 0; i < Bytes; i++)
+			Buf[i] = (Value >> (8 * i)) & 0xFF;
+	}
+
+	void SaveBMP(const std::string &Filename, Int Width, Int Height,
+		     const unsigned char *BGR)
+	{
+		/* Rows are padded to 4 bytes and stored bottom-up */
+		const Int Row = (Width * 3 + 3) & ~3;
+		const unsigned int Size = Row * Height;
+
+		unsigned char Header[54] = { 'B', 'M' };
+		PutLE(Header + 2, 54 + Size, 4);	/* File size */
+		PutLE(Header + 10, 54, 4);		/* Pixel data offset */
+		PutLE(Header + 14, 40, 4);		/* Info header size */
+		PutLE(Header + 18, Width, 4);
+		PutLE(Header + 22, Height, 4);
+		PutLE(Header + 26, 1, 2);		/* Planes */
+		PutLE(Header + 28, 24, 2);		/* Bits per pixel */
+		PutLE(Header + 34, Size, 4);
+
+		std::vector<unsigned char> Data(Size, 0);
+		for (Int y = 0; y < Height; y++)
+			memcpy(&Data[(Height - 1 - y) * Row],
+			       BGR + y * Width * 3, Width * 3);
+
+		FILE *F = fopen(Filename.c_str(), "wb");
+		if (F == NULL)
+			throw std::runtime_error("Unable to open " + Filename);
+		const Bool Ok =
+			fwrite(Header, sizeof(Header), 1, F) == 1 &&
+			(Size == 0 || fwrite(&Data[0], Size, 1, F) == 1);
+		if (fclose(F) != 0 || !Ok)
+			throw std::runtime_error("Unable to write " + Filename);
+	}
+
 	void Image::Save(const std::string Filename) const
 	{
-		
+		std::vector<unsigned char> BGR(3 * Width * Height);
+		unsigned char *Out = BGR.empty() ? NULL : &BGR[0];
+		for (Int y = 0; y < Height; y++)
+			for (Int x = 0; x < Width; x++) {
+				const World::Color &C = Get(x, y);
+				*Out++ = (unsigned char)(C[2] * 255.0);
+				*Out++ = (unsigned char)(C[1] * 255.0);
+				*Out++ = (unsigned char)(C[0] * 255.0);
+			}
+		SaveBMP(Filename, Width, Height, BGR.empty() ? NULL : &BGR[0]);
 	}
 }
@@ -20,6 +20,12 @@
 #include "World/Color.hh"
 
 namespace Graphics {
+	/** Write 24-bit BMP file
+	 * \param BGR	Pixels (3 bytes each), rows top-down
+	 */
+	void SaveBMP(const std::string &Filename, Int Width, Int Height,
+		     const unsigned char *BGR);
+
 	/**
 	 * \brief Holds image data with basic operations.
 	 */
@@ -55,6 +61,18 @@ namespace Graphics {
 			Data[Y * Width + X] = C;
 		}
 
+		/** Reads pixel at position X, Y */
+		inline const World::Color &GetPixel(Int X, Int Y) const
+		{
+			return Get(X, Y);
+		}
+
+		/** Copies W * H colors, row by row, into the rectangle
+		 * at x, y; the rectangle must lie inside the image */
+		virtual void PutTile(Int x, Int y, Int W, Int H,
+				     const World::Color *C);
+
+		/** Saves image as 24-bit BMP */
 		virtual void Save(const std::string Filename) const;
 		virtual void Refresh();
 	};
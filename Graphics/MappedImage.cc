@@ -0,0 +1,159 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Graphics/MappedImage.hh"
+
+namespace Graphics {
+	/** \brief Start of framebuffer file */
+	struct MappedHeader {
+		char Magic[8];
+		int Width, Height, TileSize;
+		/** Offset of pixel data */
+		int Pixels;
+	};
+
+	static const char MappedMagic[8] = { 'b', 'l', 'a', 'R', 'A', 'Y',
+					     'F', '1' };
+
+	/** Throw runtime_error with errno text */
+	static void Fail(const std::string &What, const std::string &Path)
+	{
+		throw std::runtime_error(What + " " + Path + ": "
+					 + strerror(errno));
+	}
+
+	MappedImage::MappedImage(const std::string &Path,
+				 Int Width, Int Height,
+				 Int TileSize, Bool Resume)
+		: HDRImage(Width, Height, (float *)NULL),
+		  Fd(-1), Map(NULL), Size(0),
+		  TileSize(TileSize),
+		  TilesX((Width + TileSize - 1) / TileSize),
+		  TileMap(NULL)
+	{
+		const Int Tiles = TilesX * ((Height + TileSize - 1) / TileSize);
+		const size_t Page = sysconf(_SC_PAGESIZE);
+		const size_t Offset = (sizeof(MappedHeader) + Tiles + Page - 1)
+			/ Page * Page;
+		Size = Offset + 3 * sizeof(float) * size_t(Width) * Height;
+
+		Fd = open(Path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (Fd < 0)
+			Fail("Unable to open", Path);
+
+		MappedHeader H;
+		memset(&H, 0, sizeof(H));
+		struct stat St;
+		Bool Keep = false;
+		if (Resume && fstat(Fd, &St) == 0 && St.st_size > 0) {
+			if (pread(Fd, &H, sizeof(H), 0) != ssize_t(sizeof(H)) ||
+			    memcmp(H.Magic, MappedMagic, sizeof(H.Magic)) != 0 ||
+			    H.Width != Width || H.Height != Height ||
+			    H.TileSize != TileSize ||
+			    size_t(St.st_size) != Size) {
+				close(Fd);
+				throw std::runtime_error(
+					Path + " is not a framebuffer of"
+					" this size; can't resume");
+			}
+			Keep = true;
+		}
+
+		/* New file is sparse: black and nothing finished */
+		if (!Keep && (ftruncate(Fd, 0) != 0 ||
+			      ftruncate(Fd, Size) != 0)) {
+			close(Fd);
+			Fail("Unable to resize", Path);
+		}
+
+		void *M = mmap(NULL, Size, PROT_READ | PROT_WRITE,
+			       MAP_SHARED, Fd, 0);
+		if (M == MAP_FAILED) {
+			close(Fd);
+			Fail("Unable to map", Path);
+		}
+		Map = (unsigned char *)M;
+		TileMap = Map + sizeof(MappedHeader);
+		Pixels = (float *)(Map + Offset);
+
+		if (!Keep) {
+			memcpy(H.Magic, MappedMagic, sizeof(H.Magic));
+			H.Width = Width;
+			H.Height = Height;
+			H.TileSize = TileSize;
+			H.Pixels = int(Offset);
+			memcpy(Map, &H, sizeof(H));
+		}
+	}
+
+	MappedImage::~MappedImage()
+	{
+		msync(Map, Size, MS_SYNC);
+		munmap(Map, Size);
+		close(Fd);
+	}
+
+	void MappedImage::MarkFinished(Int x, Int y, Int W, Int H)
+	{
+		/* Mark tiles covered whole by the rectangle */
+		const Int TX0 = (x + TileSize - 1) / TileSize;
+		const Int TY0 = (y + TileSize - 1) / TileSize;
+		for (Int ty = TY0; ty * TileSize < y + H; ty++) {
+			const Int Y1 = std::min(Height, (ty + 1) * TileSize);
+			if (Y1 > y + H)
+				break;
+			for (Int tx = TX0; tx * TileSize < x + W; tx++) {
+				const Int X1 = std::min(Width,
+							(tx + 1) * TileSize);
+				if (X1 > x + W)
+					break;
+				TileMap[ty * TilesX + tx] = 1;
+			}
+		}
+	}
+
+	Bool MappedImage::IsFinished(Int x, Int y, Int W, Int H) const
+	{
+		/* Rectangle must lie inside finished tiles */
+		for (Int ty = y / TileSize; ty * TileSize < y + H; ty++)
+			for (Int tx = x / TileSize; tx * TileSize < x + W; tx++)
+				if (!TileMap[ty * TilesX + tx])
+					return false;
+		return W > 0 && H > 0;
+	}
+
+	Int MappedImage::FinishedTiles() const
+	{
+		const Int Tiles = TilesX * ((Height + TileSize - 1) / TileSize);
+		Int Count = 0;
+		for (Int i = 0; i < Tiles; i++)
+			if (TileMap[i])
+				Count++;
+		return Count;
+	}
+
+	void MappedImage::Refresh()
+	{
+		msync(Map, Size, MS_ASYNC);
+	}
+}
@@ -0,0 +1,86 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _MAPPEDIMAGE_H_
+#define _MAPPEDIMAGE_H_
+
+#include <string>
+
+#include "General/Types.hh"
+#include "Graphics/HDRImage.hh"
+
+namespace Graphics {
+
+	/**
+	 * \brief
+	 *	HDR framebuffer kept in a memory-mapped file.
+	 *
+	 * File starts with a header (size, tile size), then one byte
+	 * per tile telling whether it was finished, then float RGB
+	 * pixels at a page boundary. Pixels are written straight into
+	 * the mapping, so images larger than memory are paged by the
+	 * kernel, and a render killed in the middle can be resumed:
+	 * finished tiles are reported by IsFinished() and skipped.
+	 *
+	 * A tile is marked finished once MarkFinished() covers it
+	 * whole; renderers call it after the final pixels of a tile
+	 * are put, so previews are never mistaken for results.
+	 */
+	class MappedImage : public HDRImage {
+	private:
+		/** File descriptor of the mapping */
+		int Fd;
+
+		/** Mapped file and its size */
+		unsigned char *Map;
+		size_t Size;
+
+		/** Edge of tiles in the completion map */
+		const Int TileSize;
+
+		/** Tiles in a row */
+		const Int TilesX;
+
+		/** One byte per tile, row by row; nonzero if finished */
+		unsigned char *TileMap;
+
+		/** Private copy-constructor */
+		MappedImage(const MappedImage &G);
+
+		/** Private operator= */
+		void operator=(const MappedImage &G) const;
+
+	public:
+		/** Open or create framebuffer file
+		 * \param Resume	Keep pixels and finished tiles of an
+		 *			existing file (which must have the
+		 *			same size); otherwise start black
+		 * \throw std::runtime_error on I/O errors or mismatch
+		 */
+		MappedImage(const std::string &Path, Int Width, Int Height,
+			    Int TileSize = 32, Bool Resume = false);
+
+		~MappedImage();
+
+		virtual void MarkFinished(Int x, Int y, Int W, Int H);
+		virtual Bool IsFinished(Int x, Int y, Int W, Int H) const;
+
+		/** Number of tiles marked finished */
+		Int FinishedTiles() const;
+
+		/** Schedule write back of dirty pages */
+		virtual void Refresh();
+	};
+};
+
+#endif
@@ -16,8 +16,13 @@
 #include "Graphics/Screen.hh"
 
 namespace Graphics {
+	/** Above this many rectangles whole screen is updated */
+	static const UInt MaxRects = 64;
+
 	Screen::Screen(const Int Width, const Int Height)
-		: Drawable(Width, Height)
+		: Drawable(Width, Height),
+		  MinX(Width), MinY(Height), MaxX(-1), MaxY(-1),
+		  AllDirty(false), Quit(false)
 	{
 		if (VALGRIND) return;
 
@@ -33,13 +38,14 @@ namespace Graphics {
 		}
 
 		/* Create refresh thread */
-		SDL.RefreshThread = SDL_CreateThread(&Screen::Thread, &this->SDL);
+		SDL.RefreshThread = SDL_CreateThread(&Screen::Thread, this);
 	}
 
 	Screen::~Screen()
 	{
 		if (VALGRIND) return;
-		SDL_KillThread(SDL.RefreshThread);
+		Quit = true;
+		SDL_WaitThread(SDL.RefreshThread, NULL);
 		SDL_FreeSurface(this->SDL.S);
 		SDL_Quit();
 	}
@@ -57,23 +63,97 @@ namespace Graphics {
 
 		Uint32 *Bits = ((Uint32 *)SDL.S->pixels) + y*Width + x;
 		*(Uint32*)Bits = Pixel;
-		if (x % 15 == 0 && y == 0) {
-  			Refresh();
+
+		General::Lock L(DirtyLock);
+		if (x < MinX) MinX = x;
+		if (x > MaxX) MaxX = x;
+		if (y < MinY) MinY = y;
+		if (y > MaxY) MaxY = y;
+	}
+
+	void Screen::MarkDirty(Int x, Int y, Int W, Int H)
+	{
+		SDL_Rect R;
+		R.x = Sint16(x);
+		R.y = Sint16(y);
+		R.w = Uint16(W);
+		R.h = Uint16(H);
+
+		General::Lock L(DirtyLock);
+		if (AllDirty)
+			return;
+		if (Dirty.size() >= MaxRects)
+			AllDirty = true;
+		else
+			Dirty.push_back(R);
+	}
+
+	void Screen::Update()
+	{
+		std::vector<SDL_Rect> Rects;
+		Bool All;
+		{
+			General::Lock L(DirtyLock);
+			Rects.swap(Dirty);
+			All = AllDirty;
+			AllDirty = false;
+			if (MaxX >= MinX) {
+				SDL_Rect R;
+				R.x = Sint16(MinX);
+				R.y = Sint16(MinY);
+				R.w = Uint16(MaxX - MinX + 1);
+				R.h = Uint16(MaxY - MinY + 1);
+				Rects.push_back(R);
+				MinX = Width;
+				MinY = Height;
+				MaxX = MaxY = -1;
+			}
 		}
 
+		if (All)
+			SDL_UpdateRect(SDL.S, 0, 0, 0, 0);
+		else if (!Rects.empty())
+			SDL_UpdateRects(SDL.S, Int(Rects.size()), &Rects[0]);
 	}
 
-	int Screen::Thread(void *Data)
+	void Screen::PutTile(Int x, Int y, Int W, Int H, const World::Color *C)
 	{
-		struct SDL *SDL = static_cast<struct SDL*>(Data);
-		SDL_Event E;
-		for (;;) {
-			SDL_WaitEvent(NULL);
-			while (SDL_PollEvent(&E)) {
-				if (E.type == SDL_USEREVENT)
-					break;
+		if (VALGRIND) return;
+
+		/* Pack colors by hand; no SDL_MapRGB per pixel */
+		const SDL_PixelFormat &F = *SDL.S->format;
+		for (Int j = 0; j < H; j++) {
+			Uint32 *Bits = ((Uint32 *)SDL.S->pixels) +
+				(y + j) * Width + x;
+			for (Int i = 0; i < W; i++, C++) {
+				const Uint32 R = Uint32((*C)[0] * 255);
+				const Uint32 G = Uint32((*C)[1] * 255);
+				const Uint32 B = Uint32((*C)[2] * 255);
+				*Bits++ =
+					((R >> F.Rloss) << F.Rshift) |
+					((G >> F.Gloss) << F.Gshift) |
+					((B >> F.Bloss) << F.Bshift);
 			}
-			SDL_UpdateRect(SDL->S, 0, 0, 0, 0);
+		}
+
+		/* Refresh only the tile */
+		MarkDirty(x, y, W, H);
+	}
+
+	int Screen::Thread(void *Data)
+	{
+		Screen *S = static_cast<Screen *>(Data);
+		const Uint32 Period = 1000 / RefreshRate;
+		Uint32 Next = SDL_GetTicks();
+		while (!S->Quit) {
+			S->Update();
+			/* Fixed rate, without drifting */
+			Next += Period;
+			const Uint32 Now = SDL_GetTicks();
+			if (Int(Next - Now) > 0)
+				SDL_Delay(Next - Now);
+			else
+				Next = Now;
 		}
 		return 0;
 	}
@@ -81,8 +161,8 @@ namespace Graphics {
 	void Screen::Refresh()
 	{
 		if (VALGRIND) return;
-		static SDL_Event A = { SDL_USEREVENT };
-		SDL_PushEvent(&A);
+		General::Lock L(DirtyLock);
+		AllDirty = true;
 	}
 
 
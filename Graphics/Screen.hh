@@ -18,6 +18,8 @@
  * Don't place it in namespace
  */
 #include <SDL/SDL.h>
+#include <vector>
+#include "General/Thread.hh"
 #include "Graphics/Drawable.hh"
 #include "World/Color.hh"
 
@@ -48,22 +50,48 @@ namespace Graphics {
 		};
 		SDL SDL; /**< SDL Information */
 
-		/** Internal screen thread for refreshing screen
-		 * \param Data	struct SDL 
+		/**@{ Dirty regions, guarded by DirtyLock */
+		General::Mutex DirtyLock;
+		/** Rectangles changed by PutTile() */
+		std::vector<SDL_Rect> Dirty;
+		/** Bounding box of pixels changed by PutPixel() */
+		Int MinX, MinY, MaxX, MaxY;
+		/** Refresh() asked for whole screen */
+		Bool AllDirty;
+		/*@}*/
+
+		/** Tells refresh thread to finish */
+		volatile Bool Quit;
+
+		/** Mark rectangle for next refresh */
+		void MarkDirty(Int x, Int y, Int W, Int H);
+
+		/** Internal screen thread for refreshing screen;
+		 * updates dirty regions at most RefreshRate times
+		 * per second
+		 * \param Data	Screen
 		 */
 		static int Thread(void *Data);
 
+		/** Blit regions changed since the last call */
+		void Update();
+
 		/** Private copy-constructor */
 		Screen(const Screen &G);
 
 		/** Private operator= */
 		void operator=(const Screen &G) const;
 	public:
+		/** Refreshes per second */
+		static const Int RefreshRate = 30;
+
 		/** Construct screen */
 		Screen(const Int Width, const Int Height);
 
 		virtual ~Screen();
 		virtual void PutPixel(Int x, Int y, const World::Color &C);
+		virtual void PutTile(Int x, Int y, Int W, Int H,
+				     const World::Color *C);
 		virtual void Refresh();
 		virtual void Save(const std::string Filename) const;
 		void EventWait() const;
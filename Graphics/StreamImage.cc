@@ -0,0 +1,119 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "Graphics/StreamImage.hh"
+
+namespace Graphics {
+	StreamImage::StreamImage(Int Width, Int Height, int Fd, Format Type)
+		: HDRImage(Width, Height),
+		  Fd(Fd),
+		  Type(Type),
+		  Done(Width * Height, false),
+		  RowDone(Height, 0),
+		  NextRow(0)
+	{
+	}
+
+	void StreamImage::PutPixel(Int x, Int y, const World::Color &C)
+	{
+		HDRImage::PutPixel(x, y, C);
+		if (Mark(x, y) && y == NextRow)
+			Flush();
+	}
+
+	void StreamImage::PutRadiance(Int x, Int y, const World::Spectrum &S)
+	{
+		HDRImage::PutRadiance(x, y, S);
+		if (Mark(x, y) && y == NextRow)
+			Flush();
+	}
+
+	void StreamImage::PutTile(Int x, Int y, Int W, Int H,
+				  const World::Color *C)
+	{
+		HDRImage::PutTile(x, y, W, H, C);
+		for (Int j = 0; j < H; j++)
+			for (Int i = 0; i < W; i++)
+				Mark(x + i, y + j);
+		if (y <= NextRow && NextRow < y + H)
+			Flush();
+	}
+
+	void StreamImage::PutRadianceTile(Int x, Int y, Int W, Int H,
+					  const World::Spectrum *S)
+	{
+		HDRImage::PutRadianceTile(x, y, W, H, S);
+		for (Int j = 0; j < H; j++)
+			for (Int i = 0; i < W; i++)
+				Mark(x + i, y + j);
+		if (y <= NextRow && NextRow < y + H)
+			Flush();
+	}
+
+	void StreamImage::Write(const unsigned char *Data, Int Size)
+	{
+		while (Size > 0) {
+			const ssize_t Ret = write(Fd, Data, Size);
+			if (Ret < 0) {
+				if (errno == EINTR)
+					continue;
+				throw std::runtime_error(
+					std::string("Stream write failed: ")
+					+ strerror(errno));
+			}
+			Data += Ret;
+			Size -= Int(Ret);
+		}
+	}
+
+	void StreamImage::Flush()
+	{
+		Int Last = NextRow;
+		while (Last < Height && RowDone[Last] == Width)
+			Last++;
+		if (Last == NextRow)
+			return;
+
+		if (NextRow == 0 && Type == PPM) {
+			char Header[64];
+			const int Len = snprintf(Header, sizeof(Header),
+						 "P6\n%d %d\n255\n",
+						 int(Width), int(Height));
+			Write((const unsigned char *)Header, Len);
+		}
+
+		/* One write for all rows finished by this call */
+		const Int Rows = Last - NextRow;
+		Buffer.resize(3 * Width * Rows);
+		QuantizeRows(Mapping, NextRow, Rows, &Buffer[0], false);
+		Write(&Buffer[0], Int(Buffer.size()));
+		NextRow = Last;
+	}
+
+	void StreamImage::NextFrame()
+	{
+		if (NextRow != Height)
+			throw std::logic_error(
+				"Frame not finished before the next one");
+		Done.assign(Done.size(), false);
+		RowDone.assign(RowDone.size(), 0);
+		NextRow = 0;
+		Clear();
+	}
+}
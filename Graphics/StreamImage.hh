@@ -0,0 +1,103 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _STREAMIMAGE_H_
+#define _STREAMIMAGE_H_
+
+#include <vector>
+
+#include "General/Types.hh"
+#include "Graphics/HDRImage.hh"
+
+namespace Graphics {
+
+	/**
+	 * \brief
+	 *	Frames streamed row by row to a file descriptor.
+	 *
+	 * Rows are tone mapped and written in order as soon as all
+	 * their pixels were put, whatever order tiles finish in, so
+	 * a consumer (e.g. a video encoder reading a pipe) works on
+	 * the top of the frame while the bottom is still rendered.
+	 * Frames follow each other on the same stream; each one is
+	 * either a binary PPM (P6) or headerless RGB.
+	 *
+	 * Every pixel is expected to be put once per frame with its
+	 * final value; previews drawn over the frame would be sent.
+	 */
+	class StreamImage : public HDRImage {
+	public:
+		/** Frame encoding */
+		enum Format {
+			PPM,	/**< P6 header and 8-bit RGB */
+			RAW	/**< 8-bit RGB only */
+		};
+
+	private:
+		/** Stream written to (not closed) */
+		const int Fd;
+
+		const Format Type;
+
+		/** Pixels of current frame already put */
+		std::vector<bool> Done;
+
+		/** Count of Done pixels in each row */
+		std::vector<Int> RowDone;
+
+		/** First row not yet written */
+		Int NextRow;
+
+		/** Quantized rows waiting for write */
+		std::vector<unsigned char> Buffer;
+
+		/** Mark pixel put; false if it was put already */
+		inline Bool Mark(Int x, Int y) {
+			const Int Idx = y * Width + x;
+			if (Done[Idx])
+				return false;
+			Done[Idx] = true;
+			RowDone[y]++;
+			return true;
+		}
+
+		/** Write all complete rows following NextRow */
+		void Flush();
+
+		/** Write whole buffer; throws std::runtime_error */
+		void Write(const unsigned char *Data, Int Size);
+
+	public:
+		/** Stream frames of given size into Fd */
+		StreamImage(Int Width, Int Height, int Fd,
+			    Format Type = PPM);
+
+		virtual void PutPixel(Int x, Int y, const World::Color &C);
+		virtual void PutRadiance(Int x, Int y, const World::Spectrum &S);
+		virtual void PutTile(Int x, Int y, Int W, Int H,
+				     const World::Color *C);
+		virtual void PutRadianceTile(Int x, Int y, Int W, Int H,
+					     const World::Spectrum *S);
+
+		/** Rows sent of the current frame */
+		inline Int GetRowsSent() const {
+			return NextRow;
+		}
+
+		/** Start next frame; the current one must be complete
+		 * (throws std::logic_error otherwise) */
+		void NextFrame();
+	};
+};
+
+#endif
@@ -0,0 +1,63 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include "General/Types.hh"
+
+namespace Math {
+	/**
+	 * \brief
+	 *	Ray prepared for slab tests against axis aligned
+	 *	boxes.
+	 *
+	 * Inverse direction and the corner each axis enters at are
+	 * computed once per ray. Clip() has no branches: rays pass
+	 * hierarchy boxes at random, so the only one taken is the
+	 * caller's hit/miss. Selects of the form a > b ? a : b map
+	 * to min/max instructions, which also ignore the NaN given
+	 * by a ray lying in a slab plane.
+	 */
+	template<typename T>
+	class Slab {
+		T O[3], Inv[3];
+		Int Side[3];
+	public:
+		/** Prepare ray of origin O and direction D */
+		Slab(const T Origin[3], const T Direction[3]) {
+			for (Int a = 0; a < 3; a++) {
+				O[a] = Origin[a];
+				Inv[a] = T(1) / Direction[a];
+				Side[a] = Inv[a] < T(0);
+			}
+		}
+
+		/**
+		 * Clip ray interval to the box.
+		 * \param Box	Min and max corner
+		 * \param Near, Far	Interval; narrowed to the box
+		 * \return false if the interval misses the box
+		 */
+		inline Bool Clip(const T Box[2][3], T &Near, T &Far) const {
+			for (Int a = 0; a < 3; a++) {
+				const T T0 = (Box[Side[a]][a] - O[a]) * Inv[a];
+				const T T1 = (Box[1 - Side[a]][a] - O[a]) * Inv[a];
+				Near = T0 > Near ? T0 : Near;
+				Far = T1 < Far ? T1 : Far;
+			}
+			return Near <= Far;
+		}
+	};
+}
+
+#endif
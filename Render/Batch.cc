@@ -0,0 +1,87 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <iostream>
+#include <algorithm>
+
+#include "General/Thread.hh"
+#include "Render/Raytracer.hh"
+#include "Render/Batch.hh"
+
+namespace Render {
+	/** \brief Worker taking tiles from the combined queue */
+	class BatchJob : public General::Job {
+		Batch &B;
+	public:
+		BatchJob(Batch &B) : B(B) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			Raytracer R(B.Scene, B.Antialiasing);
+			const Int Count = Int(B.Tiles.size());
+			for (;;) {
+				const Int Idx = __sync_fetch_and_add(&B.Next, 1);
+				if (Idx >= Count)
+					break;
+				const Batch::Tile &T = B.Tiles[Idx];
+				Batch::View &V = B.Views[T.View];
+				R.SetCamera(V.Camera);
+				R.RenderTile(*V.Img, T.X, T.Y, T.W, T.H);
+			}
+		}
+	};
+
+	Batch::Batch(const World::Scene &Scene, Bool Antialiasing,
+		     Int TileSize)
+		: Scene(Scene),
+		  Antialiasing(Antialiasing),
+		  TileSize(TileSize),
+		  Next(0)
+	{
+	}
+
+	void Batch::AddView(const World::Camera &C, Graphics::Drawable &Img)
+	{
+		const View V = { C, &Img };
+		Views.push_back(V);
+	}
+
+	void Batch::Render()
+	{
+		std::cout << "*** Batch of " << Views.size()
+			  << " views ***" << std::endl;
+
+		Tiles.clear();
+		for (UInt v = 0; v < Views.size(); v++) {
+			const Graphics::Drawable &Img = *Views[v].Img;
+			const Int Width = Img.GetWidth();
+			const Int Height = Img.GetHeight();
+			for (Int y = 0; y < Height; y += TileSize)
+				for (Int x = 0; x < Width; x += TileSize) {
+					const Tile T = {
+						Int(v), x, y,
+						std::min(TileSize, Width - x),
+						std::min(TileSize, Height - y)
+					};
+					if (!Img.IsFinished(T.X, T.Y, T.W, T.H))
+						Tiles.push_back(T);
+				}
+		}
+
+		/* One worker per CPU; each runs until the queue is empty */
+		Next = 0;
+		BatchJob Job(*this);
+		General::Parallel::For(Job, General::Parallel::Workers());
+
+		std::cout << "*** Batch: tiles=" << Tiles.size() << std::endl;
+	}
+}
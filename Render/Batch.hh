@@ -0,0 +1,78 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <vector>
+
+#include "General/Types.hh"
+#include "World/Scene.hh"
+#include "World/Camera.hh"
+#include "Graphics/Drawable.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Renders one scene from several cameras at once.
+	 *
+	 * Tiles of all views go into one queue which worker threads
+	 * take from until it's empty, so no core idles at the end
+	 * of a view while others still work on it. Each worker has
+	 * its own Raytracer switched to the camera of the tile.
+	 */
+	class Batch {
+	private:
+		/** \brief Camera and the image it renders into */
+		struct View {
+			World::Camera Camera;
+			Graphics::Drawable *Img;
+		};
+
+		/** \brief Part of one view */
+		struct Tile {
+			Int View, X, Y, W, H;
+		};
+
+		/** Scene shared by all views */
+		const World::Scene &Scene;
+
+		const Bool Antialiasing;
+
+		/** Tile edge */
+		const Int TileSize;
+
+		std::vector<View> Views;
+
+		/** Combined queue of all views */
+		std::vector<Tile> Tiles;
+
+		/** Next tile to take from the queue */
+		volatile Int Next;
+
+		friend class BatchJob;
+
+	public:
+		Batch(const World::Scene &Scene, Bool Antialiasing,
+		      Int TileSize = 32);
+
+		/** Add view; Img must outlive Render() */
+		void AddView(const World::Camera &C, Graphics::Drawable &Img);
+
+		/** Render all views using all workers */
+		void Render();
+	};
+};
+
+#endif
@@ -0,0 +1,204 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cmath>
+
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+#include "General/Thread.hh"
+#include "Graphics/HDRImage.hh"
+#include "World/Camera.hh"
+#include "Render/Raytracer.hh"
+#include "Render/Daemon.hh"
+
+namespace Render {
+	/** \brief Serves jobs of one client */
+	class Connection : public General::Thread {
+		Daemon &D;
+		General::Socket *S;
+	public:
+		/** Set when the client is gone */
+		volatile Bool Finished;
+
+		Connection(Daemon &D, General::Socket *S)
+			: D(D), S(S), Finished(false) {}
+
+		~Connection() {
+			Join();
+			delete S;
+		}
+
+		/** Make pending reads fail */
+		void Disconnect() {
+			shutdown(S->GetFd(), SHUT_RDWR);
+		}
+
+		virtual void Run() {
+			try {
+				for (;;) {
+					UInt Type;
+					std::string Payload;
+					S->Receive(Type, Payload);
+					if (Type == Daemon::MSG_STOP) {
+						D.Stopping = true;
+						S->Send(Daemon::MSG_REPLY, "OK\n");
+						continue;
+					}
+					if (Type != Daemon::MSG_JOB)
+						throw std::runtime_error(
+							"Unexpected message");
+					S->Send(Daemon::MSG_REPLY,
+						D.Execute(Payload));
+				}
+			} catch (std::runtime_error &e) {
+				/* Client disconnected */
+			}
+			Finished = true;
+		}
+	};
+
+	Daemon::Daemon(const std::string &Address, Int CacheSize)
+		: Address(Address), Cache(CacheSize), Stopping(false)
+	{
+	}
+
+	std::string Daemon::Execute(const std::string &Job)
+	{
+		std::string SceneFile, Output;
+		Int Width = 640, Height = 480;
+		Bool Antialiasing = false;
+		Bool Override = false;
+		World::Camera Camera;
+		Graphics::ToneMap Mapping;
+
+		std::stringstream In(Job);
+		std::string Line;
+		while (std::getline(In, Line)) {
+			const std::string::size_type Eq = Line.find('=');
+			if (Eq == std::string::npos)
+				continue;
+			const std::string Key = Line.substr(0, Eq);
+			std::stringstream Value(Line.substr(Eq + 1));
+			if (Key == "scene")
+				std::getline(Value, SceneFile);
+			else if (Key == "output")
+				std::getline(Value, Output);
+			else if (Key == "width")
+				Value >> Width;
+			else if (Key == "height")
+				Value >> Height;
+			else if (Key == "antialiasing")
+				Value >> Antialiasing;
+			else if (Key == "tonemap") {
+				try {
+					Mapping = Graphics::ToneMap::Parse(
+						Value.str());
+				} catch (std::invalid_argument &e) {
+					return std::string("ERROR ") +
+						e.what() + "\n";
+				}
+			}
+			else if (Key == "camera") {
+				try {
+					Camera = World::Camera::Parse(
+						Value.str());
+				} catch (std::invalid_argument &e) {
+					return "ERROR Wrong camera\n";
+				}
+				Override = true;
+			} else
+				return "ERROR Unknown key " + Key + "\n";
+		}
+
+		if (SceneFile == "" || Output == "")
+			return "ERROR scene and output are required\n";
+		if (Width <= 0 || Height <= 0)
+			return "ERROR Wrong resolution\n";
+
+		World::SceneCache::Handle H;
+		if (!Cache.Acquire(SceneFile, H))
+			return "ERROR Unable to load " + SceneFile + "\n";
+
+		struct timeval A, B;
+		gettimeofday(&A, NULL);
+		std::string Reply;
+		try {
+			Graphics::HDRImage Img(Width, Height);
+			Img.SetToneMap(Mapping);
+			Raytracer R(*H, Antialiasing);
+			if (Override)
+				R.SetCamera(Camera);
+			R.RenderTile(Img, 0, 0, Width, Height);
+			Img.Save(Output);
+
+			gettimeofday(&B, NULL);
+			std::stringstream s;
+			s << "OK " << (B.tv_sec - A.tv_sec) +
+				0.000001 * (B.tv_usec - A.tv_usec) << "\n";
+			Reply = s.str();
+		} catch (std::exception &e) {
+			Reply = std::string("ERROR ") + e.what() + "\n";
+		}
+		Cache.Release(H);
+		return Reply;
+	}
+
+	void Daemon::Run()
+	{
+		/* libxml2 must be initialized before threads parse */
+		xmlInitParser();
+
+		General::Socket *Listen = General::Socket::Listen(Address);
+		std::list<Connection *> Connections;
+
+		std::cout << "*** Daemon listening on " << Address << std::endl;
+		while (!Stopping) {
+			struct pollfd P;
+			P.fd = Listen->GetFd();
+			P.events = POLLIN;
+			if (poll(&P, 1, 250) > 0 && (P.revents & POLLIN)) {
+				Connection *C =
+					new Connection(*this, Listen->Accept());
+				C->Start();
+				Connections.push_back(C);
+			}
+
+			/* Reap threads of gone clients */
+			std::list<Connection *>::iterator i =
+				Connections.begin();
+			while (i != Connections.end())
+				if ((*i)->Finished) {
+					delete *i;
+					i = Connections.erase(i);
+				} else
+					i++;
+		}
+		delete Listen;
+
+		/* Clients still connected are cut off after their job */
+		while (!Connections.empty()) {
+			Connections.front()->Disconnect();
+			delete Connections.front();
+			Connections.pop_front();
+		}
+
+		std::cout << "*** Daemon finished; scenes parsed="
+			  << Cache.GetMisses() << " reused="
+			  << Cache.GetHits() << std::endl;
+	}
+}
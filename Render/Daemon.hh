@@ -0,0 +1,80 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _DAEMON_H_
+#define _DAEMON_H_
+
+#include <string>
+#include <list>
+
+#include "General/Types.hh"
+#include "General/Socket.hh"
+#include "World/SceneCache.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Render server keeping parsed scenes between jobs.
+	 *
+	 * Listens on a socket; every connection is served by its own
+	 * thread, so jobs of different clients render concurrently.
+	 * A job is a message of "key=value" lines:
+	 *
+	 *   scene=<path>		Scene file (required)
+	 *   output=<path>		Output BMP file (required)
+	 *   width=<n>, height=<n>	Image size (default 640x480)
+	 *   antialiasing=<0|1>
+	 *   camera=<x,y,z,dx,dy,dz[,fov]>	Camera override (fov in degrees)
+	 *   tonemap=<clamp|reinhard>[,exposure]	For BMP output
+	 *
+	 * and is answered with "OK <seconds>" or "ERROR <reason>".
+	 * A STOP message makes the daemon finish once running jobs end.
+	 */
+	class Daemon {
+	public:
+		/** Message types */
+		enum {
+			MSG_JOB = 1,	/**< Job description */
+			MSG_REPLY,	/**< Result of the job */
+			MSG_STOP	/**< Shut daemon down */
+		};
+
+	private:
+		/** Address to listen on */
+		const std::string Address;
+
+		/** Parsed scenes */
+		World::SceneCache Cache;
+
+		/** Set by a STOP message */
+		volatile Bool Stopping;
+
+		friend class Connection;
+
+		/** Render one job; \return reply text */
+		std::string Execute(const std::string &Job);
+
+	public:
+		/** Create daemon
+		 * \param Address	\see General::Socket
+		 * \param CacheSize	Number of scenes kept parsed
+		 */
+		Daemon(const std::string &Address, Int CacheSize = 8);
+
+		/** Serve until stopped */
+		void Run();
+	};
+};
+
+#endif
@@ -0,0 +1,490 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <iostream>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "General/Socket.hh"
+#include "World/Scene.hh"
+#include "Render/Raytracer.hh"
+#include "Render/Distributed.hh"
+
+namespace Render {
+	/** Message types */
+	enum {
+		MSG_SCENE = 1,	/**< Frame settings + scene XML */
+		MSG_TILE,	/**< Tile to render */
+		MSG_RESULT,	/**< Tile header + RGB floats, as the
+				   worker got them from PutRadianceTile();
+				   nothing is clamped on the way */
+		MSG_QUIT,	/**< No more work */
+		MSG_HELLO	/**< Worker's pid, sent on connect */
+	};
+
+	/** Tiles assigned to one worker at a time */
+	static const UInt InFlight = 2;
+
+	/** \brief Frame settings sent before the scene */
+	struct FrameHeader {
+		int Width, Height, Antialiasing;
+	};
+
+	/** \brief Tile assignment; prefixes results as well */
+	struct TileHeader {
+		int Id, X, Y, W, H;
+	};
+
+	/**
+	 * \brief
+	 *	Drawable of the frame size holding a single tile.
+	 *
+	 * Raytracer places pixels in frame coordinates; only those
+	 * of the tile being rendered are kept, as float RGB rows
+	 * ready to be sent, so a worker needs memory for one tile
+	 * whatever the frame size.
+	 */
+	class TileTarget : public Graphics::Drawable {
+	private:
+		/** Tile origin in the frame */
+		Int X, Y;
+
+		/** Tile width */
+		Int W;
+
+		/** Private copy-constructor */
+		TileTarget(const TileTarget &T);
+
+		/** Private operator= */
+		void operator=(const TileTarget &T) const;
+	public:
+		/** RGB triples of the tile, row by row */
+		std::vector<float> Pixels;
+
+		TileTarget(Int Width, Int Height)
+			: Drawable(Width, Height), X(0), Y(0), W(0) {}
+
+		/** Start collecting the given tile */
+		void Place(Int X, Int Y, Int W, Int H) {
+			this->X = X;
+			this->Y = Y;
+			this->W = W;
+			Pixels.assign(3 * W * H, 0.0f);
+		}
+
+		virtual void PutPixel(Int x, Int y, const World::Color &C) {
+			PutRadiance(x, y, World::Spectrum(C));
+		}
+
+		virtual void PutRadiance(Int x, Int y, const World::Spectrum &S) {
+			float *P = &Pixels[3 * ((y - Y) * W + x - X)];
+			P[0] = float(S[0]);
+			P[1] = float(S[1]);
+			P[2] = float(S[2]);
+		}
+
+		virtual void PutRadianceTile(Int x, Int y, Int W, Int H,
+					     const World::Spectrum *S) {
+			for (Int j = 0; j < H; j++)
+				for (Int i = 0; i < W; i++)
+					PutRadiance(x + i, y + j, *S++);
+		}
+
+		virtual void Refresh() {
+		}
+
+		virtual void Save(const std::string Filename) const {
+			throw std::runtime_error("Tiles can't be saved");
+		}
+	};
+
+	/** \brief Connected worker */
+	struct Peer {
+		General::Socket *S;
+		/** Ids of tiles being rendered */
+		std::deque<Int> Tiles;
+		/** Process id it reported; 0 if unknown */
+		pid_t Pid;
+		/** When the oldest of Tiles is due */
+		time_t Deadline;
+	};
+
+	/** Seconds of a clock which doesn't jump */
+	static time_t Now()
+	{
+		struct timespec T;
+		clock_gettime(CLOCK_MONOTONIC, &T);
+		return T.tv_sec;
+	}
+
+	Coordinator::Coordinator(const std::string &SceneXML,
+				 Int Width, Int Height,
+				 Bool Antialiasing, Int TileSize,
+				 Int Timeout)
+		: SceneXML(SceneXML), Width(Width), Height(Height),
+		  Antialiasing(Antialiasing), Timeout(Timeout)
+	{
+		if (TileSize <= 0)
+			throw std::invalid_argument("Tile size must be positive");
+		if (Timeout <= 0)
+			throw std::invalid_argument("Timeout must be positive");
+		for (Int y = 0; y < Height; y += TileSize)
+			for (Int x = 0; x < Width; x += TileSize) {
+				Tile T;
+				T.X = x;
+				T.Y = y;
+				T.W = std::min(TileSize, Width - x);
+				T.H = std::min(TileSize, Height - y);
+				Tiles.push_back(T);
+			}
+	}
+
+	/** Send tiles until worker has InFlight of them; an idle
+	 * worker gets Timeout seconds for the first one */
+	static void Assign(Peer &P, std::deque<Int> &Pending,
+			   const std::vector<Tile> &Tiles, Int Timeout)
+	{
+		if (P.Tiles.empty())
+			P.Deadline = Now() + Timeout;
+		while (P.Tiles.size() < InFlight && !Pending.empty()) {
+			const Int Id = Pending.front();
+			const TileHeader H = {
+				Id, Tiles[Id].X, Tiles[Id].Y,
+				Tiles[Id].W, Tiles[Id].H
+			};
+			P.S->Send(MSG_TILE,
+				  std::string((const char *)&H, sizeof(H)));
+			Pending.pop_front();
+			P.Tiles.push_back(Id);
+		}
+	}
+
+	/** Drop worker i, handing its tiles back to Pending; local
+	 * workers are killed, as they might be stuck */
+	static void Drop(std::vector<Peer> &Peers, Int i,
+			 std::deque<Int> &Pending, Int &Retried,
+			 const std::vector<pid_t> &Children,
+			 const std::string &Reason)
+	{
+		Peer &P = Peers[i];
+		std::cout << "*** Dropping worker: "
+			  << Reason << "; retrying "
+			  << P.Tiles.size() << " tiles"
+			  << std::endl;
+		Retried += P.Tiles.size();
+		Pending.insert(Pending.begin(), P.Tiles.begin(), P.Tiles.end());
+		if (P.Pid > 0 &&
+		    std::find(Children.begin(), Children.end(), P.Pid)
+		    != Children.end())
+			kill(P.Pid, SIGKILL);
+		delete P.S;
+		Peers.erase(Peers.begin() + i);
+	}
+
+	/**
+	 * \brief
+	 *	Closes coordinator's sockets and reaps local workers
+	 *	however Run() exits.
+	 *
+	 * Unless the frame was finished, workers get no MSG_QUIT and
+	 * local ones are killed, as they might be stuck.
+	 */
+	class Shutdown {
+	private:
+		General::Socket *&Listen;
+		std::vector<Peer> &Peers;
+		const std::vector<pid_t> &Children;
+
+		/** Private copy-constructor */
+		Shutdown(const Shutdown &S);
+
+		/** Private operator= */
+		void operator=(const Shutdown &S) const;
+	public:
+		/** Were all tiles rendered? */
+		Bool Finished;
+
+		Shutdown(General::Socket *&Listen, std::vector<Peer> &Peers,
+			 const std::vector<pid_t> &Children)
+			: Listen(Listen), Peers(Peers), Children(Children),
+			  Finished(false) {}
+
+		~Shutdown() {
+			for (UInt i = 0; i < Peers.size(); i++) {
+				if (Finished)
+					try {
+						Peers[i].S->Send(MSG_QUIT,
+								 std::string());
+					} catch (std::runtime_error &e) {
+					}
+				delete Peers[i].S;
+			}
+			delete Listen;
+
+			for (UInt i = 0; i < Children.size(); i++) {
+				if (!Finished)
+					kill(Children[i], SIGKILL);
+				waitpid(Children[i], NULL, 0);
+			}
+		}
+	};
+
+	void Coordinator::Run(const std::string &Address, Int Spawn,
+			      Graphics::Drawable &Img)
+	{
+		General::Socket *Listen = General::Socket::Listen(Address);
+		std::vector<pid_t> Children;
+		std::vector<Peer> Peers;
+		Shutdown Guard(Listen, Peers, Children);
+
+		/* Local workers; they get a copy of the listening
+		 * socket which they close right away */
+		for (Int i = 0; i < Spawn; i++) {
+			const pid_t Pid = fork();
+			if (Pid == -1)
+				throw std::runtime_error("Unable to fork worker");
+			if (Pid == 0) {
+				delete Listen;
+				int Status = 0;
+				try {
+					Worker(Address).Run();
+				} catch (std::exception &e) {
+					std::cout << "*** Worker error: "
+						  << e.what() << std::endl;
+					Status = 1;
+				} catch (...) {
+					Status = 1;
+				}
+				/* Never unwinds into the guard's copy,
+				 * which would kill the siblings */
+				_exit(Status);
+			}
+			Children.push_back(Pid);
+		}
+
+		std::string Frame;
+		{
+			const FrameHeader H = { Width, Height, Antialiasing };
+			Frame.assign((const char *)&H, sizeof(H));
+			Frame += SceneXML;
+		}
+
+		std::deque<Int> Pending;
+		for (UInt i = 0; i < Tiles.size(); i++)
+			Pending.push_back(i);
+		std::vector<Bool> Finished(Tiles.size(), false);
+		UInt Done = 0;
+		Int Retried = 0;
+
+		std::vector<struct pollfd> Fds;
+		std::string Payload;
+		/* Received tile, widened for the drawable */
+		std::vector<World::Spectrum> Light;
+		while (Done < Tiles.size()) {
+			Fds.resize(Peers.size() + 1);
+			Fds[0].fd = Listen->GetFd();
+			Fds[0].events = POLLIN;
+			for (UInt i = 0; i < Peers.size(); i++) {
+				Fds[i + 1].fd = Peers[i].S->GetFd();
+				Fds[i + 1].events = POLLIN;
+			}
+
+			if (poll(&Fds[0], Fds.size(), 1000) < 0)
+				continue;
+
+			/* Give up if all local workers are gone and
+			 * no remote one is connected */
+			if (Spawn > 0 && Peers.empty()) {
+				while (!Children.empty() &&
+				       waitpid(Children.back(), NULL, WNOHANG)
+				       == Children.back())
+					Children.pop_back();
+				if (Children.empty())
+					throw std::runtime_error(
+						"All workers died");
+			}
+
+			/* Check workers backwards, so dropping one
+			 * doesn't disturb the others' indices */
+			for (Int i = Int(Peers.size()) - 1; i >= 0; i--) {
+				if (Fds[i + 1].revents == 0)
+					continue;
+				Peer &P = Peers[i];
+				try {
+					UInt Type;
+					P.S->Receive(Type, Payload);
+					if (Type == MSG_HELLO &&
+					    Payload.size() == sizeof(int)) {
+						int Pid;
+						memcpy(&Pid, Payload.data(),
+						       sizeof(Pid));
+						P.Pid = Pid;
+						continue;
+					}
+					TileHeader H;
+					if (Type != MSG_RESULT ||
+					    Payload.size() < sizeof(H))
+						throw std::runtime_error(
+							"Unexpected message");
+					memcpy(&H, Payload.data(), sizeof(H));
+
+					std::deque<Int>::iterator It =
+						std::find(P.Tiles.begin(),
+							  P.Tiles.end(), Int(H.Id));
+					if (It == P.Tiles.end())
+						throw std::runtime_error(
+							"Unassigned tile");
+					const Tile &T = Tiles[H.Id];
+					if (Payload.size() != sizeof(H) +
+					    sizeof(float) * 3 * T.W * T.H)
+						throw std::runtime_error(
+							"Wrong tile size");
+					P.Tiles.erase(It);
+					P.Deadline = Now() + Timeout;
+
+					const float *Pix = (const float *)
+						(Payload.data() + sizeof(H));
+					Light.resize(T.W * T.H);
+					for (Int p = 0; p < T.W * T.H; p++, Pix += 3)
+						Light[p] = World::Spectrum(
+							Pix[0], Pix[1], Pix[2]);
+					if (!Light.empty())
+						Img.PutRadianceTile(T.X, T.Y,
+								    T.W, T.H,
+								    &Light[0]);
+					if (!Finished[H.Id]) {
+						Finished[H.Id] = true;
+						Done++;
+					}
+					Assign(P, Pending, Tiles, Timeout);
+				} catch (std::runtime_error &e) {
+					Drop(Peers, i, Pending, Retried,
+					     Children, e.what());
+				}
+			}
+
+			/* Workers which hang without exiting */
+			const time_t T = Now();
+			for (Int i = Int(Peers.size()) - 1; i >= 0; i--)
+				if (!Peers[i].Tiles.empty() &&
+				    T > Peers[i].Deadline)
+					Drop(Peers, i, Pending, Retried,
+					     Children, "no tile in time");
+
+			/* New worker */
+			if (Fds[0].revents & POLLIN) {
+				Peer P;
+				P.S = NULL;
+				P.Pid = 0;
+				P.Deadline = 0;
+				try {
+					P.S = Listen->Accept();
+					/* Blocking reads after poll() must
+					 * not outlive a stuck worker */
+					P.S->SetTimeout(Timeout);
+					P.S->Send(MSG_SCENE, Frame);
+					Peers.push_back(P);
+				} catch (std::runtime_error &e) {
+					delete P.S;
+				}
+			}
+
+			/* New workers and those which lost their tiles
+			 * to dead ones get work */
+			for (UInt i = 0; i < Peers.size(); i++)
+				try {
+					Assign(Peers[i], Pending, Tiles, Timeout);
+				} catch (std::runtime_error &e) {
+					/* Will be noticed by poll() */
+				}
+		}
+
+		std::cout << "*** Distributed: tiles=" << Tiles.size()
+			  << " workers=" << Peers.size()
+			  << " retried=" << Retried << std::endl;
+		Guard.Finished = true;
+	}
+
+	void Worker::Run()
+	{
+		General::Socket *S = General::Socket::Connect(Address);
+		World::Scene *Scene = NULL;
+		Raytracer *R = NULL;
+		TileTarget *Img = NULL;
+
+		try {
+			UInt Type;
+			std::string Payload;
+			FrameHeader F;
+
+			/* Lets the coordinator kill us if we get stuck */
+			const int Pid = getpid();
+			S->Send(MSG_HELLO, std::string((const char *)&Pid,
+						       sizeof(Pid)));
+
+			S->Receive(Type, Payload);
+			if (Type != MSG_SCENE || Payload.size() < sizeof(F))
+				throw std::runtime_error("Scene expected");
+			memcpy(&F, Payload.data(), sizeof(F));
+
+			Scene = new World::Scene;
+			if (!Scene->ParseMemory(Payload.substr(sizeof(F))))
+				throw std::runtime_error("Unable to parse scene");
+			R = new Raytracer(*Scene, F.Antialiasing != 0);
+			Img = new TileTarget(F.Width, F.Height);
+
+			std::string Result;
+			for (;;) {
+				S->Receive(Type, Payload);
+				if (Type == MSG_QUIT)
+					break;
+				TileHeader H;
+				if (Type != MSG_TILE || Payload.size() != sizeof(H))
+					throw std::runtime_error("Tile expected");
+				memcpy(&H, Payload.data(), sizeof(H));
+				if (H.X < 0 || H.Y < 0 || H.W < 0 || H.H < 0 ||
+				    H.X + H.W > F.Width || H.Y + H.H > F.Height)
+					throw std::runtime_error("Tile out of frame");
+
+				Img->Place(H.X, H.Y, H.W, H.H);
+				R->RenderTile(*Img, H.X, H.Y, H.W, H.H);
+
+				Result.assign((const char *)&H, sizeof(H));
+				if (!Img->Pixels.empty())
+					Result.append((const char *)&Img->Pixels[0],
+						      sizeof(float)
+						      * Img->Pixels.size());
+				S->Send(MSG_RESULT, Result);
+			}
+		} catch (...) {
+			delete Img;
+			delete R;
+			delete Scene;
+			delete S;
+			throw;
+		}
+		delete Img;
+		delete R;
+		delete Scene;
+		delete S;
+	}
+}
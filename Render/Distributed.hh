@@ -0,0 +1,97 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _DISTRIBUTED_H_
+#define _DISTRIBUTED_H_
+
+#include <string>
+#include <vector>
+
+#include "General/Types.hh"
+#include "Graphics/Drawable.hh"
+
+namespace Render {
+
+	/** \brief Rectangular part of the image */
+	struct Tile {
+		Int X, Y, W, H;
+	};
+
+	/**
+	 * \brief
+	 *	Splits a frame into tiles rendered by worker processes.
+	 *
+	 * Workers connect to the coordinator's socket (local ones may
+	 * be forked by the coordinator itself), receive the scene
+	 * description and then get tiles to raytrace, two at a time so
+	 * they don't wait for the network. A worker which disconnects,
+	 * sends garbage or returns no tile within Timeout seconds is
+	 * dropped (local ones are killed) and its unfinished tiles are
+	 * handed to the others.
+	 */
+	class Coordinator {
+	private:
+		/** Scene description shipped to workers (XML) */
+		const std::string SceneXML;
+
+		/** Image size */
+		const Int Width, Height;
+
+		/** Antialiasing of workers' raytracers */
+		const Bool Antialiasing;
+
+		/** All tiles of the frame */
+		std::vector<Tile> Tiles;
+
+		/** Seconds a worker may spend on its oldest tile */
+		const Int Timeout;
+
+	public:
+		/** Split frame into tiles
+		 * \param SceneXML	Scene description
+		 * \param TileSize	Edge of a (square) tile
+		 * \param Timeout	Seconds to wait for a tile
+		 */
+		Coordinator(const std::string &SceneXML,
+			    Int Width, Int Height,
+			    Bool Antialiasing, Int TileSize = 32,
+			    Int Timeout = 600);
+
+		/** Render the frame
+		 * \param Address	Address to listen on
+		 *			\see General::Socket
+		 * \param Spawn		Number of local workers to fork
+		 * \param Img		Drawable of the frame size
+		 */
+		void Run(const std::string &Address, Int Spawn,
+			 Graphics::Drawable &Img);
+	};
+
+	/**
+	 * \brief
+	 *	Renders tiles for a Coordinator until told to quit.
+	 */
+	class Worker {
+	private:
+		/** Coordinator address */
+		const std::string Address;
+
+	public:
+		Worker(const std::string &Address) : Address(Address) {}
+
+		/** Serve the coordinator; throws on connection errors */
+		void Run();
+	};
+};
+
+#endif
@@ -0,0 +1,194 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <cmath>
+
+#include "Math/Abs.hh"
+#include "Render/IrradianceCache.hh"
+
+namespace Render {
+	/** Nodes are not split below this depth */
+	static const Int MaxDepth = 32;
+
+	IrradianceCache::Node::Node() : Head(NULL), Reach(0)
+	{
+		for (Int i = 0; i < 8; i++)
+			Child[i] = NULL;
+	}
+
+	void IrradianceCache::Node::Extend(Double R)
+	{
+		/* Rounded up, so the float never hides a record */
+		union { float F; unsigned int I; } New;
+		New.F = float(R) * 1.0001f;
+		unsigned int Old;
+		do {
+			Old = Reach;
+			if (Old >= New.I)
+				return;
+		} while (!__sync_bool_compare_and_swap(&Reach, Old, New.I));
+	}
+
+	Double IrradianceCache::Node::GetReach() const
+	{
+		union { float F; unsigned int I; } R;
+		R.I = Reach;
+		return R.F;
+	}
+
+	IrradianceCache::Node::~Node()
+	{
+		for (Int i = 0; i < 8; i++)
+			delete Child[i];
+		while (Head) {
+			Record *R = Head;
+			Head = R->Next;
+			delete R;
+		}
+	}
+
+	IrradianceCache::IrradianceCache(const Math::Vector &Center,
+					 Double Half, Double Accuracy)
+		: Center(Center), Half(Half), Accuracy(Accuracy), Count(0)
+	{
+	}
+
+	Bool IrradianceCache::Inside(const Math::Vector &Point) const
+	{
+		for (Int a = 0; a < 3; a++)
+			if (Math::Abs(Point[a] - Center[a]) > Half)
+				return false;
+		return true;
+	}
+
+	void IrradianceCache::Lookup(const Node &N, const Math::Vector &C,
+				     Double H,
+				     const Math::Vector &Point,
+				     const Math::Vector &Normal,
+				     World::Spectrum &Sum, Double &Weight) const
+	{
+		/* Records of the subtree lie inside the node and
+		 * reach at most N.Reach outside of it */
+		const Double Reach = N.GetReach();
+		for (Int a = 0; a < 3; a++)
+			if (Math::Abs(Point[a] - C[a]) > H + Reach)
+				return;
+
+		for (const Record *R = N.Head; R; R = R->Next) {
+			const Math::Vector D = Point - R->Position;
+
+			/* Skip records in front of the point */
+			if (D.Dot(Normal + R->Normal) < -0.1 * R->R)
+				continue;
+
+			/* Ward's error; used only below Accuracy */
+			const Double Cos = Normal.Dot(R->Normal);
+			const Double Err = D.Length() / R->R +
+				std::sqrt(Cos < 1.0 ? 1.0 - Cos : 0.0);
+			if (Err >= Accuracy)
+				continue;
+			const Double W = Err > 1e-10 ? 1.0 / Err : 1e10;
+
+			/* First order extrapolation */
+			const Math::Vector Rot = R->Normal.Cross(Normal);
+			World::Spectrum E = R->E;
+			for (Int c = 0; c < 3; c++)
+				E[c] += Rot.Dot(R->RotGrad[c]) +
+					D.Dot(R->TransGrad[c]);
+			Sum += E * W;
+			Weight += W;
+		}
+
+		const Double ChildH = H * 0.5;
+		for (Int i = 0; i < 8; i++) {
+			const Node *Child = N.Child[i];
+			if (Child == NULL)
+				continue;
+			const Math::Vector ChildC(
+				C[0] + (i & 1 ? ChildH : -ChildH),
+				C[1] + (i & 2 ? ChildH : -ChildH),
+				C[2] + (i & 4 ? ChildH : -ChildH));
+			Lookup(*Child, ChildC, ChildH,
+			       Point, Normal, Sum, Weight);
+		}
+	}
+
+	Bool IrradianceCache::Lookup(const Math::Vector &Point,
+				     const Math::Vector &Normal,
+				     World::Spectrum &E) const
+	{
+		World::Spectrum Sum;
+		Double Weight = 0.0;
+		Lookup(Root, Center, Half, Point, Normal, Sum, Weight);
+		if (Weight <= 0.0)
+			return false;
+
+		E = Sum / Weight;
+		/* Extrapolation must not create negative light */
+		for (Int c = 0; c < 3; c++)
+			if (E[c] < 0.0)
+				E[c] = 0.0;
+		return true;
+	}
+
+	void IrradianceCache::Insert(const Record &R)
+	{
+		Record *New = new Record(R);
+
+		/* Descend while children still cover the whole area
+		 * where the record is used */
+		const Double Reach = Accuracy * R.R;
+		Node *N = &Root;
+		Math::Vector C = Center;
+		Double H = Half;
+		/* Reach of every node on the path covers the record
+		 * before it is published */
+		N->Extend(Reach);
+		for (Int Depth = 0; Depth < MaxDepth && H * 0.5 >= Reach;
+		     Depth++) {
+			H *= 0.5;
+			Int i = 0;
+			for (Int a = 0; a < 3; a++) {
+				if (R.Position[a] >= C[a]) {
+					i |= 1 << a;
+					C[a] += H;
+				} else
+					C[a] -= H;
+			}
+
+			Node *Child = N->Child[i];
+			if (Child == NULL) {
+				/* Another thread may create it meanwhile */
+				Node *Created = new Node;
+				if (__sync_bool_compare_and_swap(
+					    &N->Child[i], (Node *)NULL, Created))
+					Child = Created;
+				else {
+					delete Created;
+					Child = N->Child[i];
+				}
+			}
+			N = Child;
+			N->Extend(Reach);
+		}
+
+		/* Publish; CAS is a full barrier so the record is
+		 * complete before readers can reach it */
+		Record *Old;
+		do {
+			Old = N->Head;
+			New->Next = Old;
+		} while (!__sync_bool_compare_and_swap(&N->Head, Old, New));
+		__sync_fetch_and_add(&Count, 1);
+	}
+}
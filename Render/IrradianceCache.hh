@@ -0,0 +1,139 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _IRRADIANCECACHE_H_
+#define _IRRADIANCECACHE_H_
+
+#include "General/Types.hh"
+#include "Math/Vector.hh"
+#include "World/Color.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Irradiance cache (Ward et al. 1988, Ward & Heckbert 1992).
+	 *
+	 * Records of indirect irradiance are kept in an octree; each one
+	 * lands in the deepest node still as large as its area of
+	 * influence. Irradiance at a new point is interpolated from the
+	 * records whose error estimate
+	 * e = |P - Pi| / Ri + sqrt(1 - N.Ni) is below Accuracy, weighted
+	 * by 1/e and extrapolated with their rotational and
+	 * translational gradients; if there are none the caller
+	 * computes a new record and inserts it. A record can't be used
+	 * farther than Accuracy * Ri away (its reach); every node keeps
+	 * the largest reach found in its subtree, so lookups only
+	 * descend into nodes whose records might apply.
+	 *
+	 * Readers take no locks. Inserting links new nodes and records
+	 * with compare-and-swap, and records never change after they
+	 * are published, so any number of threads may look up and insert
+	 * at the same time.
+	 */
+	class IrradianceCache {
+	public:
+		/** \brief Cached irradiance sample */
+		struct Record {
+			Math::Vector Position;
+			Math::Vector Normal;
+			/** Irradiance */
+			World::Spectrum E;
+			/** Harmonic mean distance to visible surfaces */
+			Double R;
+			/** Rotational gradient of each color component */
+			Math::Vector RotGrad[3];
+			/** Translational gradient of each color component */
+			Math::Vector TransGrad[3];
+
+			/** Next record of the same node */
+			Record *Next;
+		};
+
+	private:
+		/** \brief Octree node */
+		struct Node {
+			Record *volatile Head;
+			Node *volatile Child[8];
+
+			/** Largest reach of records in the subtree, as
+			 * float bits: non-negative floats order like
+			 * their bits, so it grows by integer CAS */
+			volatile unsigned int Reach;
+
+			/** Raise Reach to at least R */
+			void Extend(Double R);
+
+			/** Reach as a number */
+			Double GetReach() const;
+
+			Node();
+			~Node();
+		};
+
+		/** Root node and the cube it spans */
+		Node Root;
+		const Math::Vector Center;
+		const Double Half;
+
+		/** Max allowed error (Ward's a); records are used
+		 * where their error is smaller */
+		const Double Accuracy;
+
+		/** Number of records */
+		volatile int Count;
+
+		/** Recursive search of records around Point */
+		void Lookup(const Node &N, const Math::Vector &C, Double H,
+			    const Math::Vector &Point,
+			    const Math::Vector &Normal,
+			    World::Spectrum &Sum, Double &Weight) const;
+
+		/** Private copy-constructor */
+		IrradianceCache(const IrradianceCache &C);
+
+		/** Private operator= */
+		void operator=(const IrradianceCache &C) const;
+
+	public:
+		/** Create empty cache
+		 * \param Center	Center of cached space (a cube)
+		 * \param Half		Half of the cube's edge
+		 * \param Accuracy	Max allowed error; smaller values
+		 *			create more records
+		 */
+		IrradianceCache(const Math::Vector &Center, Double Half,
+				Double Accuracy = 0.2);
+
+		/** Is the point inside of cached space? */
+		Bool Inside(const Math::Vector &Point) const;
+
+		/**
+		 * Interpolate irradiance at a point.
+		 * \return false if no record is close enough
+		 */
+		Bool Lookup(const Math::Vector &Point,
+			    const Math::Vector &Normal,
+			    World::Spectrum &E) const;
+
+		/** Add a copy of the record; point must be Inside() */
+		void Insert(const Record &R);
+
+		/** Number of records */
+		inline Int Size() const {
+			return Int(Count);
+		}
+	};
+};
+
+#endif
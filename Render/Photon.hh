@@ -22,11 +22,11 @@ namespace Render {
 	 * \brief
 	 * 	Photon Class
 	 *
-	 * Class abstracts a photon illuminating some 
+	 * Class abstracts a photon illuminating some
 	 * part of the scene. It's created in a process
-	 * of tracing rays shot from a light source 
-	 * and stored in a structure suitable for 
-	 * Nearest Neighboor algorithm (kd-tree).
+	 * of tracing rays shot from a light source
+	 * and stored in a structure suitable for
+	 * Nearest Neighboor algorithm (kd-tree or hash grid).
 	 *
 	 */
 	class Photon {
@@ -34,33 +34,35 @@ namespace Render {
 		/** Photon position */
 		Math::Vector Position;
 
-		/** Photon color; wonder if it will be used */
-		World::Color Color;
+		/** Direction photon was travelling when stored */
+		Math::Vector Direction;
 
-		/** Needed for luminance calculations */
-		Double Intensity;
+		/** Photon power (flux); not cropped */
+		World::Spectrum Power;
 	public:
 		/** Initialize photon */
-		Photon(const Math::Vector &Position, const World::Color &Color)
-			: Position(Position), Color(Color) {}
-
+		Photon(const Math::Vector &Position,
+		       const Math::Vector &Direction,
+		       const World::Spectrum &Power)
+			: Position(Position), Direction(Direction),
+			  Power(Power) {}
 
 		/** Photon position accessor */
-		inline const Math::Vector &GetPosition()
+		inline const Math::Vector &GetPosition() const
 		{
 			return Position;
 		}
 
-		/** Photon color accessor */
-		inline const World::Color &GetColor()
+		/** Incoming direction accessor */
+		inline const Math::Vector &GetDirection() const
 		{
-			return Color;
+			return Direction;
 		}
 
-		/** Photon intensity accessor */
-		inline Double GetIntensity()
+		/** Photon power accessor */
+		inline const World::Spectrum &GetPower() const
 		{
-			return Intensity;
+			return Power;
 		}
 	};
 }
@@ -0,0 +1,150 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#include <stdexcept>
+
+#include "General/Thread.hh"
+#include "Render/PhotonGrid.hh"
+
+namespace Render {
+	/** \brief Build step 1: bucket of each photon + histogram
+	 * of the worker's range */
+	class GridCount : public General::Job {
+		PhotonGrid &G;
+	public:
+		GridCount(PhotonGrid &G) : G(G) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			const std::vector<Photon> &P = *G.Photons;
+			unsigned int *Hist = &G.Counts[size_t(Worker) * (G.Mask + 1)];
+			for (Int i = From; i < To; i++) {
+				const Math::Vector &Pos = P[i].GetPosition();
+				const unsigned int B = G.Hash(
+					G.Cell(Pos[0]),
+					G.Cell(Pos[1]),
+					G.Cell(Pos[2]));
+				G.Bucket[i] = B;
+				Hist[B]++;
+			}
+		}
+	};
+
+	/**
+	 * \brief Build step 2: blocked prefix sum over buckets
+	 *
+	 * First run sums each block of buckets over all histograms,
+	 * second run scans blocks using offsets computed sequentially
+	 * in between. It stores bucket starts and replaces each
+	 * histogram entry by the offset its worker scatters to.
+	 */
+	class GridScan : public General::Job {
+		PhotonGrid &G;
+	public:
+		/** Second run? */
+		Bool Apply;
+
+		GridScan(PhotonGrid &G) : G(G), Apply(false) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			const size_t Size = G.Mask + 1;
+			if (!Apply) {
+				unsigned int Sum = 0;
+				for (Int w = 0; w < G.Workers; w++)
+					for (Int b = From; b < To; b++)
+						Sum += G.Counts[w * Size + b];
+				G.BlockSum[Worker] = Sum;
+				return;
+			}
+			unsigned int Sum = G.BlockSum[Worker];
+			for (Int b = From; b < To; b++) {
+				G.Start[b] = Sum;
+				for (Int w = 0; w < G.Workers; w++) {
+					unsigned int &C = G.Counts[w * Size + b];
+					const unsigned int N = C;
+					C = Sum;
+					Sum += N;
+				}
+			}
+		}
+	};
+
+	/** \brief Build step 3: scatter photon indices into buckets,
+	 * each worker into its own slots */
+	class GridScatter : public General::Job {
+		PhotonGrid &G;
+	public:
+		GridScatter(PhotonGrid &G) : G(G) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			unsigned int *Cursor =
+				&G.Counts[size_t(Worker) * (G.Mask + 1)];
+			for (Int i = From; i < To; i++)
+				G.Index[Cursor[G.Bucket[i]]++] = i;
+		}
+	};
+
+	PhotonGrid::PhotonGrid(Int Workers)
+		: Photons(NULL), CellSize(1.0), InvCellSize(1.0), Mask(0),
+		  Workers(Workers > 0 ? Workers : General::Parallel::Workers())
+	{
+	}
+
+	void PhotonGrid::Build(const std::vector<Photon> &Photons,
+			       Double Radius)
+	{
+		if (Radius <= 0.0)
+			throw std::invalid_argument(
+				"Photon grid radius must be positive");
+
+		this->Photons = &Photons;
+		this->CellSize = 2.0 * Radius;
+		this->InvCellSize = 1.0 / CellSize;
+
+		const Int Count = Int(Photons.size());
+
+		/* Bucket table: power of two not smaller than photon count */
+		UInt Size = 1;
+		while (Size < UInt(Count))
+			Size <<= 1;
+		Mask = Size - 1;
+
+		/* assign() reuses capacity; nothing is freed between passes */
+		Start.assign(Size + 1, 0U);
+		Bucket.resize(Count);
+		Index.resize(Count);
+		Counts.assign(size_t(Workers) * Size, 0U);
+		BlockSum.assign(Workers + 1, 0U);
+
+		if (Count == 0)
+			return;
+
+		/* Counting and scattering split photons the same way,
+		 * so worker w scatters exactly what it counted */
+		GridCount Counter(*this);
+		General::Parallel::For(Counter, Count, Workers);
+
+		GridScan Scan(*this);
+		General::Parallel::For(Scan, Size, Workers);
+		unsigned int Offset = 0;
+		for (Int w = 0; w < Workers; w++) {
+			const unsigned int Sum = BlockSum[w];
+			BlockSum[w] = Offset;
+			Offset += Sum;
+		}
+		Scan.Apply = true;
+		General::Parallel::For(Scan, Size, Workers);
+		Start[Size] = Count;
+
+		GridScatter Scatter(*this);
+		General::Parallel::For(Scatter, Count, Workers);
+	}
+}
@@ -0,0 +1,164 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _PHOTONGRID_H_
+#define _PHOTONGRID_H_
+
+#include <vector>
+#include <cmath>
+
+#include "General/Types.hh"
+#include "Math/Vector.hh"
+#include "Render/Photon.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Spatial hash grid over a photon array.
+	 *
+	 * Space is divided into cubic cells twice as wide as the
+	 * search radius, so a sphere of that radius touches at most
+	 * 2x2x2 cells. Cells are hashed into a power-of-two bucket table
+	 * sized after the photon count; the table is a counting sort of
+	 * photon indices (bucket start offsets + index array), built in
+	 * parallel: each worker counts its own range of photons into a
+	 * histogram of its own, a blocked prefix sum gives every
+	 * (bucket, worker) pair its offset, and each worker scatters
+	 * its range there. Workers own disjoint ranges of the output,
+	 * so no atomics are needed and every bucket lists photons in
+	 * index order, whatever the worker count.
+	 *
+	 * Rebuilding is meant to be done once per progressive pass;
+	 * buffers are kept between builds so memory depends only on
+	 * the largest photon count ever passed (histograms take one
+	 * word per bucket and worker).
+	 */
+	class PhotonGrid {
+	private:
+		/** Photons the grid was built over (not owned) */
+		const std::vector<Photon> *Photons;
+
+		/** Cell width and its inverse */
+		Double CellSize, InvCellSize;
+
+		/** Bucket count - 1 (count is a power of two) */
+		UInt Mask;
+
+		/** Bucket start offsets into Index; Mask + 2 entries */
+		std::vector<unsigned int> Start;
+
+		/** Photon indices sorted by bucket */
+		std::vector<unsigned int> Index;
+
+		/** Bucket of each photon (build scratch) */
+		std::vector<unsigned int> Bucket;
+
+		/** Per-worker bucket histograms, worker after worker;
+		 * turned into scatter cursors (build scratch) */
+		std::vector<unsigned int> Counts;
+
+		/** Per-worker block sums of the prefix scan */
+		std::vector<unsigned int> BlockSum;
+
+		/** Worker count used while building */
+		const Int Workers;
+
+		/** Quantize coordinate into cell number */
+		inline Int Cell(Double Coord) const {
+			return Int((int)std::floor(Coord * InvCellSize));
+		}
+
+		/** Hash cell coordinates into bucket */
+		inline UInt Hash(Int x, Int y, Int z) const {
+			/* Teschner et al. large primes */
+			return ((UInt)((unsigned)x * 73856093U) ^
+				(UInt)((unsigned)y * 19349663U) ^
+				(UInt)((unsigned)z * 83492791U)) & Mask;
+		}
+
+		friend class GridCount;
+		friend class GridScan;
+		friend class GridScatter;
+
+		/** Private copy-constructor */
+		PhotonGrid(const PhotonGrid &G);
+
+		/** Private operator= */
+		void operator=(const PhotonGrid &G) const;
+	public:
+		/** Create empty grid
+		 * \param Workers	Threads used for building (0 - all CPUs)
+		 */
+		PhotonGrid(Int Workers = 0);
+
+		/** (Re)build grid over photons for given search radius */
+		void Build(const std::vector<Photon> &Photons, Double Radius);
+
+		/** Cell width the grid was built with */
+		inline Double GetCellSize() const {
+			return CellSize;
+		}
+
+		/**
+		 * Visit every photon within Radius of Point.
+		 *
+		 * Radius must not exceed the one given to Build().
+		 * Visitor is called as V(const Photon &, Double SquareDist)
+		 * and nothing is allocated on the way.
+		 */
+		template<typename Visitor>
+		void Query(const Math::Vector &Point, Double Radius,
+			   Visitor &V) const
+		{
+			if (Index.empty())
+				return;
+
+			const Double R2 = Radius * Radius;
+			/* Lower cell of the 2x2x2 block covering the sphere */
+			const Int x0 = Cell(Point[0] - Radius);
+			const Int y0 = Cell(Point[1] - Radius);
+			const Int z0 = Cell(Point[2] - Radius);
+
+			/* Different cells may share a bucket; visit each once */
+			UInt Seen[8];
+			Int SeenCnt = 0;
+
+			for (Int dx = 0; dx < 2; dx++)
+			for (Int dy = 0; dy < 2; dy++)
+			for (Int dz = 0; dz < 2; dz++) {
+				const UInt B = Hash(x0 + dx, y0 + dy, z0 + dz);
+				Bool Dup = false;
+				for (Int i = 0; i < SeenCnt; i++)
+					if (Seen[i] == B) {
+						Dup = true;
+						break;
+					}
+				if (Dup)
+					continue;
+				Seen[SeenCnt++] = B;
+
+				for (unsigned int i = Start[B];
+				     i < Start[B + 1]; i++) {
+					const Photon &P = (*Photons)[Index[i]];
+					const Double D2 =
+						(P.GetPosition() - Point)
+						.SquareLength();
+					if (D2 <= R2)
+						V(P, D2);
+				}
+			}
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,169 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "Math/Constants.hh"
+#include "Render/PhotonMap.hh"
+
+namespace Render {
+	/** \brief Orders photons along one axis */
+	class PhotonLess {
+		const Int Axis;
+	public:
+		PhotonLess(Int Axis) : Axis(Axis) {}
+
+		inline bool operator()(const Photon &A, const Photon &B) const {
+			return A.GetPosition()[Axis] < B.GetPosition()[Axis];
+		}
+	};
+
+	/** \brief Orders neighbours so the farthest is on heap top */
+	static inline bool NeighbourLess(const PhotonMap::Neighbour &A,
+					 const PhotonMap::Neighbour &B)
+	{
+		return A.SquareDist < B.SquareDist;
+	}
+
+	PhotonMap::PhotonMap() : Scale(0.0)
+	{
+	}
+
+	void PhotonMap::Build(std::vector<Photon> &Photons, Double Emitted)
+	{
+		this->Photons.clear();
+		this->Photons.swap(Photons);
+		Axis.assign(this->Photons.size(), 0);
+		Scale = Emitted > 0.0 ? 1.0 / Emitted : 0.0;
+		Balance(0, Size());
+	}
+
+	void PhotonMap::Balance(Int From, Int To)
+	{
+		if (To - From < 2)
+			return;
+
+		/* Split along the widest extent of the range */
+		Math::Vector Min = Photons[From].GetPosition();
+		Math::Vector Max = Min;
+		for (Int i = From + 1; i < To; i++) {
+			const Math::Vector &P = Photons[i].GetPosition();
+			for (Int a = 0; a < 3; a++) {
+				if (P[a] < Min[a]) Min[a] = P[a];
+				if (P[a] > Max[a]) Max[a] = P[a];
+			}
+		}
+		const Math::Vector Extent = Max - Min;
+		Int Split = 0;
+		if (Extent[1] > Extent[Split]) Split = 1;
+		if (Extent[2] > Extent[Split]) Split = 2;
+
+		const Int Mid = (From + To) / 2;
+		std::nth_element(Photons.begin() + From,
+				 Photons.begin() + Mid,
+				 Photons.begin() + To,
+				 PhotonLess(Split));
+		Axis[Mid] = (unsigned char)Split;
+
+		Balance(From, Mid);
+		Balance(Mid + 1, To);
+	}
+
+	void PhotonMap::Locate(Int From, Int To, const Math::Vector &Point,
+			       Int K, Double &MaxDist2,
+			       std::vector<Neighbour> &Heap) const
+	{
+		if (From >= To)
+			return;
+
+		const Int Mid = (From + To) / 2;
+		const Photon &P = Photons[Mid];
+		const Int A = Axis[Mid];
+		const Double Delta = Point[A] - P.GetPosition()[A];
+
+		/* Near side first; far side only if the split plane
+		 * is closer than the current farthest neighbour */
+		if (Delta < 0.0)
+			Locate(From, Mid, Point, K, MaxDist2, Heap);
+		else
+			Locate(Mid + 1, To, Point, K, MaxDist2, Heap);
+
+		if (Delta * Delta < MaxDist2) {
+			if (Delta < 0.0)
+				Locate(Mid + 1, To, Point, K, MaxDist2, Heap);
+			else
+				Locate(From, Mid, Point, K, MaxDist2, Heap);
+		}
+
+		const Double D2 = (P.GetPosition() - Point).SquareLength();
+		if (D2 >= MaxDist2)
+			return;
+
+		Neighbour N;
+		N.SquareDist = D2;
+		N.Index = Mid;
+		if (Int(Heap.size()) < K) {
+			Heap.push_back(N);
+			std::push_heap(Heap.begin(), Heap.end(), NeighbourLess);
+			if (Int(Heap.size()) == K)
+				MaxDist2 = Heap.front().SquareDist;
+		} else {
+			std::pop_heap(Heap.begin(), Heap.end(), NeighbourLess);
+			Heap.back() = N;
+			std::push_heap(Heap.begin(), Heap.end(), NeighbourLess);
+			MaxDist2 = Heap.front().SquareDist;
+		}
+	}
+
+	Double PhotonMap::Nearest(const Math::Vector &Point, Int K,
+				  Double MaxDist,
+				  std::vector<Neighbour> &Heap) const
+	{
+		Heap.clear();
+		Double MaxDist2 = MaxDist * MaxDist;
+		Locate(0, Size(), Point, K, MaxDist2, Heap);
+		return Heap.empty() ? 0.0 : (Double)Heap.front().SquareDist;
+	}
+
+	World::Spectrum PhotonMap::Irradiance(const Math::Vector &Point,
+					      const Math::Vector &Normal,
+					      Int K, Double MaxDist, Bool Cone,
+					      std::vector<Neighbour> &Heap) const
+	{
+		World::Spectrum Flux;
+		const Double R2 = Nearest(Point, K, MaxDist, Heap);
+		/* Too few photons make just noise */
+		if (Heap.size() < 2 || R2 <= 0.0)
+			return Flux;
+
+		const Double R = std::sqrt(R2);
+		for (UInt i = 0; i < Heap.size(); i++) {
+			const Photon &P = Photons[Heap[i].Index];
+			if (P.GetDirection().Dot(Normal) >= 0.0)
+				continue;
+			if (Cone)
+				/* Cone filter, k = 1 */
+				Flux += P.GetPower() *
+					(1.0 - std::sqrt(Heap[i].SquareDist) / R);
+			else
+				Flux += P.GetPower();
+		}
+
+		Double Area = Math::PI * R2;
+		if (Cone)
+			/* Normalization of the cone filter: 1 - 2/(3k) */
+			Area /= 3.0;
+		return Flux * (Scale / Area);
+	}
+}
@@ -0,0 +1,109 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _PHOTONMAP_H_
+#define _PHOTONMAP_H_
+
+#include <vector>
+
+#include "General/Types.hh"
+#include "Math/Vector.hh"
+#include "World/Color.hh"
+#include "Render/Photon.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Classic photon map: balanced kd-tree over stored photons.
+	 *
+	 * Photons are reordered in place so that the median of every
+	 * range [From, To) lies at its middle and splits the range
+	 * along the axis of largest extent; no pointers are stored,
+	 * only one split axis per photon. Radiance is estimated from
+	 * the K nearest photons within a maximal distance (Jensen).
+	 */
+	class PhotonMap {
+	public:
+		/** \brief Photon found by a k-NN search */
+		struct Neighbour {
+			Double SquareDist;
+			Int Index;
+		};
+
+	private:
+		/** Photons in kd-tree order */
+		std::vector<Photon> Photons;
+
+		/** Split axis of the node at the same index */
+		std::vector<unsigned char> Axis;
+
+		/** Power multiplier (1 / emitted photons) */
+		Double Scale;
+
+		/** Balance photons in range [From, To) */
+		void Balance(Int From, Int To);
+
+		/** Recursive k-NN search in range [From, To) */
+		void Locate(Int From, Int To, const Math::Vector &Point,
+			    Int K, Double &MaxDist2,
+			    std::vector<Neighbour> &Heap) const;
+
+	public:
+		/** Create empty map */
+		PhotonMap();
+
+		/**
+		 * Build map taking over the photons.
+		 * \param Photons	Stored photons; vector is swapped
+		 *			into the map and left empty
+		 * \param Emitted	Photons emitted to get them
+		 */
+		void Build(std::vector<Photon> &Photons, Double Emitted);
+
+		/** Number of stored photons */
+		inline Int Size() const {
+			return Int(Photons.size());
+		}
+
+		/** Photon accessor (kd-tree order) */
+		inline const Photon &operator[](Int Idx) const {
+			return Photons[Idx];
+		}
+
+		/**
+		 * Find up to K nearest photons within MaxDist of Point.
+		 * \param Heap	Result (max-heap on distance); reused
+		 *		between calls to avoid allocations
+		 * \return Square distance of the farthest photon found
+		 */
+		Double Nearest(const Math::Vector &Point, Int K, Double MaxDist,
+			       std::vector<Neighbour> &Heap) const;
+
+		/**
+		 * Estimate flux density arriving at a surface point.
+		 *
+		 * Only photons hitting the front side of Normal are
+		 * counted. With Cone set they are weighted with the cone
+		 * filter, which keeps sharp caustic edges.
+		 *
+		 * \param Heap	Scratch buffer \see Nearest
+		 */
+		World::Spectrum Irradiance(const Math::Vector &Point,
+					   const Math::Vector &Normal,
+					   Int K, Double MaxDist, Bool Cone,
+					   std::vector<Neighbour> &Heap) const;
+	};
+};
+
+#endif
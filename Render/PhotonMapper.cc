@@ -0,0 +1,405 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <iostream>
+#include <cmath>
+#include <limits>
+
+#include "General/Profile.hh"
+#include "General/Thread.hh"
+#include "Math/Abs.hh"
+#include "Math/Constants.hh"
+#include "Render/PhotonMapper.hh"
+
+namespace Render {
+	/** Resolution of caustic projection maps */
+	static const Int ProjectionRes = 64;
+
+	/** \brief Raytracer of one worker; gathers with its own
+	 * context from the maps and cache of the mapper */
+	class MapperTracer : public Raytracer {
+		const PhotonMapper &M;
+		PhotonMapper::GatherContext Ctx;
+
+	protected:
+		virtual void Gather(const Ray &R,
+				    const Math::Vector &ColPoint,
+				    const Math::Vector &Normal,
+				    World::Color &Diffuse) {
+			M.Indirect(R, ColPoint, Normal, Diffuse, Ctx);
+		}
+
+	public:
+		MapperTracer(const PhotonMapper &M, UInt Seed)
+			: Raytracer(M.Scene, M.Antialiasing, M.MaxDepth),
+			  M(M), Ctx(Seed) {
+			SetCamera(*M.Camera);
+		}
+
+		/** Add statistics of this worker to the mapper's */
+		void Merge(PhotonMapper &Into) const {
+			__sync_fetch_and_add(&Into.ShadowRays, ShadowRays);
+			__sync_fetch_and_add(&Into.ReflectedRays, ReflectedRays);
+			__sync_fetch_and_add(&Into.RefractedRays, RefractedRays);
+			__sync_fetch_and_add(&Into.Gathers, Ctx.Gathers);
+			__sync_fetch_and_add(&Into.CacheHits, Ctx.CacheHits);
+		}
+	};
+
+	/** \brief Worker taking tiles from the common queue */
+	class MapperJob : public General::Job {
+		PhotonMapper &M;
+		Graphics::Drawable &Img;
+	public:
+		/** \brief Part of the image */
+		struct Tile {
+			Int X, Y, W, H;
+		};
+
+		std::vector<Tile> Tiles;
+
+		/** Next tile to take from the queue */
+		volatile Int Next;
+
+		MapperJob(PhotonMapper &M, Graphics::Drawable &Img)
+			: M(M), Img(Img), Next(0) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			MapperTracer T(M, UInt(Worker + 1));
+			const Int Count = Int(Tiles.size());
+			for (;;) {
+				const Int Idx = __sync_fetch_and_add(&Next, 1);
+				if (Idx >= Count)
+					break;
+				const Tile &P = Tiles[Idx];
+				T.RenderTile(Img, P.X, P.Y, P.W, P.H);
+			}
+			T.Merge(M);
+		}
+	};
+
+	PhotonMapper::GatherContext::GatherContext(UInt Seed)
+		: Rnd(Seed), Gathers(0), CacheHits(0)
+	{
+	}
+
+	PhotonMapper::PhotonMapper(const World::Scene &Scene,
+				   const Bool Antialiasing,
+				   const MapConfig &Global,
+				   const MapConfig &Caustic,
+				   const GatherConfig &Gather,
+				   Double Power,
+				   const Int MaxDepth)
+		: Raytracer(Scene, Antialiasing, MaxDepth),
+		  GlobalCfg(Global), CausticCfg(Caustic), GatherCfg(Gather),
+		  Power(Power), Cache(NULL), Own(1), Gathers(0), CacheHits(0)
+	{
+	}
+
+	PhotonMapper::~PhotonMapper()
+	{
+		delete Cache;
+	}
+
+	void PhotonMapper::BuildMap(PhotonMap &Map, const MapConfig &Cfg,
+				    Int Store, Int Aim, UInt Seed)
+	{
+		General::Profile::Scope S(General::Profile::BUILD);
+		std::vector<Photon> Photons;
+		if (Cfg.Photons <= 0) {
+			Map.Build(Photons, 0.0);
+			return;
+		}
+
+		const PhotonTracer Tracer(this->Scene, Power, Store,
+					  MaxDepth, Aim);
+		if (!Tracer.HasLights()) {
+			Map.Build(Photons, 0.0);
+			return;
+		}
+
+		std::vector<std::vector<Photon> > Buffers;
+		Tracer.Shoot(Cfg.Photons, Seed, Buffers, Photons);
+		Map.Build(Photons, Cfg.Photons);
+	}
+
+	void PhotonMapper::CreateCache()
+	{
+		/* Unbounded objects (planes) reach outside of bounded ones;
+		 * the cube is made much larger, as the octree depth grows
+		 * only with its logarithm. Points outside of it are
+		 * gathered each time without caching */
+		const Math::Vector &Center = this->Camera->GetPosition();
+		Double Half = GatherCfg.MaxRadius;
+		World::Scene::ObjectIterator Iter(this->Scene);
+		while (const World::Object *O = Iter.Next()) {
+			Math::Vector C;
+			Double R;
+			if (!O->Bounds(C, R))
+				continue;
+			for (Int a = 0; a < 3; a++) {
+				const Double Reach = Math::Abs(C[a] - Center[a]) + R;
+				if (Reach > Half)
+					Half = Reach;
+			}
+		}
+		World::Scene::AggregateIterator AIter(this->Scene);
+		while (const World::Aggregate *A = AIter.Next()) {
+			Math::Vector C;
+			Double R;
+			A->Bounds(C, R);
+			for (Int a = 0; a < 3; a++) {
+				const Double Reach = Math::Abs(C[a] - Center[a]) + R;
+				if (Reach > Half)
+					Half = Reach;
+			}
+		}
+		delete Cache;
+		Cache = new IrradianceCache(Center, 64.0 * Half,
+					    GatherCfg.Accuracy);
+	}
+
+	void PhotonMapper::FinalGather(const Math::Vector &Point,
+				       const Math::Vector &Normal,
+				       IrradianceCache::Record &Rec,
+				       GatherContext &Ctx) const
+	{
+		const Int M = GatherCfg.Samples;
+		const Int N = Int(int(Math::PI * M + 0.5));
+		const Double Samples = M * N;
+		const Double Far = std::numeric_limits<double>::max();
+
+		Math::Vector U, V;
+		PhotonTracer::Basis(Normal, U, V);
+
+		std::vector<World::Spectrum> &GatherL = Ctx.GatherL;
+		std::vector<Double> &GatherD = Ctx.GatherD;
+		GatherL.resize(M * N);
+		GatherD.resize(M * N);
+
+		/* Stratified, cosine-weighted gather rays; radiance
+		 * (times PI) seen along each from the global map */
+		World::Spectrum Sum;
+		Double InvDist = 0.0;
+		for (Int j = 0; j < M; j++)
+		for (Int k = 0; k < N; k++) {
+			const Double Sin2 = (j + Ctx.Rnd.Next()) / M;
+			const Double SinT = std::sqrt(Sin2);
+			const Double CosT = std::sqrt(1.0 - Sin2);
+			const Double Phi = 2.0 * Math::PI * (k + Ctx.Rnd.Next()) / N;
+			const Math::Vector Dir =
+				U * (SinT * std::cos(Phi)) +
+				V * (SinT * std::sin(Phi)) +
+				Normal * CosT;
+
+			World::Spectrum &L = GatherL[j * N + k];
+			L = World::Spectrum();
+			GatherD[j * N + k] = Far;
+
+			const Ray R(Point, Dir);
+			const World::Object *Obj;
+			World::HitStorage Storage;
+			Double Dist;
+			if (!this->Scene.Collide(R, Dist, Obj, Storage))
+				continue;
+			GatherD[j * N + k] = Dist;
+			InvDist += 1.0 / Dist;
+
+			const Math::Vector Hit = R.GetPoint(Dist);
+			const World::Spectrum Rho =
+				Obj->ColorAt(Hit, World::Material::DIFFUSE);
+			if (Rho.Average() <= 0.0)
+				continue;
+			Math::Vector HitNormal = Obj->NormalAt(Hit);
+			if (HitNormal.Dot(Dir) > 0.0)
+				HitNormal = -HitNormal;
+			L = Rho * Global.Irradiance(Hit, HitNormal,
+						    GlobalCfg.K,
+						    GlobalCfg.MaxDist,
+						    false, Ctx.Heap);
+			Sum += L;
+		}
+		Ctx.Gathers++;
+
+		Rec.Position = Point;
+		Rec.Normal = Normal;
+		Rec.E = Sum / Samples;
+		Rec.R = InvDist > 0.0 ? Samples / InvDist : GatherCfg.MaxRadius;
+		if (Rec.R < GatherCfg.MinRadius)
+			Rec.R = GatherCfg.MinRadius;
+		if (Rec.R > GatherCfg.MaxRadius)
+			Rec.R = GatherCfg.MaxRadius;
+
+		/* Gradients (Ward & Heckbert 1992); L is PI times
+		 * radiance, which cancels PI in the rotational one */
+		for (Int c = 0; c < 3; c++)
+			Rec.RotGrad[c] = Rec.TransGrad[c] = Math::Vector();
+
+		for (Int k = 0; k < N; k++) {
+			const Int Prev = (k + N - 1) % N;
+			const Double PhiK = 2.0 * Math::PI * (k + 0.5) / N;
+			const Double PhiEdge = 2.0 * Math::PI * k / N;
+			const Math::Vector Uk =
+				U * std::cos(PhiK) + V * std::sin(PhiK);
+			const Math::Vector Vk =
+				U * (-std::sin(PhiK)) + V * std::cos(PhiK);
+			const Math::Vector VEdge =
+				U * (-std::sin(PhiEdge)) + V * std::cos(PhiEdge);
+
+			World::Spectrum Rot, AlongTheta, AlongPhi;
+			for (Int j = 0; j < M; j++) {
+				const World::Spectrum &L = GatherL[j * N + k];
+				const Double Sin2 = (j + 0.5) / M;
+				Rot -= L * std::sqrt(Sin2 / (1.0 - Sin2));
+
+				/* Change between strata along phi */
+				const Double DPhi = std::min(GatherD[j * N + k],
+							     GatherD[j * N + Prev]);
+				AlongPhi += (L - GatherL[j * N + Prev]) *
+					((std::sqrt((j + 1.0) / M) -
+					  std::sqrt(Double(j) / M)) / DPhi);
+
+				/* Change between strata along theta */
+				if (j == 0)
+					continue;
+				const Double DTheta =
+					std::min(GatherD[j * N + k],
+						 GatherD[(j - 1) * N + k]);
+				const Double Edge = Double(j) / M;
+				AlongTheta += (L - GatherL[(j - 1) * N + k]) *
+					(std::sqrt(Edge) * (1.0 - Edge) / DTheta);
+			}
+
+			for (Int c = 0; c < 3; c++) {
+				Rec.RotGrad[c] += Vk * (Rot[c] / Samples);
+				Rec.TransGrad[c] +=
+					(Uk * (AlongTheta[c] * 2.0 * Math::PI / N) +
+					 VEdge * AlongPhi[c]) / Math::PI;
+			}
+		}
+	}
+
+	void PhotonMapper::Gather(const Ray &R,
+				  const Math::Vector &ColPoint,
+				  const Math::Vector &Normal,
+				  World::Color &Diffuse)
+	{
+		Indirect(R, ColPoint, Normal, Diffuse, Own);
+	}
+
+	void PhotonMapper::Indirect(const Ray &R,
+				    const Math::Vector &ColPoint,
+				    const Math::Vector &Normal,
+				    World::Color &Diffuse,
+				    GatherContext &Ctx) const
+	{
+		/* Gather on the side we look at */
+		Math::Vector Side = Normal;
+		if (Normal.Dot(R.Direction()) > 0.0)
+			Side = -Normal;
+
+		World::Spectrum Light(Diffuse);
+		if (Cache) {
+			World::Spectrum E;
+			const Bool Cached = Cache->Inside(ColPoint);
+			if (Cached && Cache->Lookup(ColPoint, Side, E))
+				Ctx.CacheHits++;
+			else {
+				IrradianceCache::Record Rec;
+				FinalGather(ColPoint, Side, Rec, Ctx);
+				E = Rec.E;
+				if (Cached)
+					Cache->Insert(Rec);
+			}
+			Light += E;
+		} else if (Global.Size() > 0)
+			Light += Global.Irradiance(ColPoint, Side,
+						   GlobalCfg.K,
+						   GlobalCfg.MaxDist,
+						   false, Ctx.Heap);
+		if (Caustic.Size() > 0)
+			Light += Caustic.Irradiance(ColPoint, Side,
+						    CausticCfg.K,
+						    CausticCfg.MaxDist,
+						    true, Ctx.Heap);
+		Diffuse = Light.Clamp();
+	}
+
+	void PhotonMapper::RenderTiles(Graphics::Drawable &Img)
+	{
+		ShadowRays = ReflectedRays = RefractedRays = 0;
+
+		std::cout << "*** Raytracing renderer ***" << std::endl;
+
+		const Int Width = Img.GetWidth();
+		const Int Height = Img.GetHeight();
+		MapperJob Job(*this, Img);
+		Int Skipped = 0;
+		for (Int y = 0; y < Height; y += TileSize)
+			for (Int x = 0; x < Width; x += TileSize) {
+				const MapperJob::Tile T = {
+					x, y,
+					std::min(TileSize, Width - x),
+					std::min(TileSize, Height - y)
+				};
+				if (Img.IsFinished(T.X, T.Y, T.W, T.H))
+					Skipped++;
+				else
+					Job.Tiles.push_back(T);
+			}
+
+		/* One worker per CPU; each runs until the queue is empty */
+		General::Parallel::For(Job, General::Parallel::Workers());
+
+		if (Skipped > 0)
+			std::cout << "*** Tiles finished before: "
+				  << Skipped << std::endl;
+		PrintStats();
+	}
+
+	void PhotonMapper::Render(Graphics::Drawable &Img)
+	{
+		std::cout << "*** Photon mapper ***" << std::endl;
+
+		/* Gather rays see direct light and caustics as well */
+		const Bool Gathering = GatherCfg.Samples > 0;
+		BuildMap(Global, GlobalCfg,
+			 Gathering ? (PhotonTracer::DIRECT |
+				      PhotonTracer::CAUSTIC |
+				      PhotonTracer::INDIRECT)
+			 : PhotonTracer::INDIRECT, 0, 1);
+		BuildMap(Caustic, CausticCfg, PhotonTracer::CAUSTIC,
+			 ProjectionRes, 2);
+		std::cout << "*** Photons stored: global=" << Global.Size()
+			  << " caustic=" << Caustic.Size() << std::endl;
+
+		Own.Gathers = Own.CacheHits = 0;
+		Gathers = CacheHits = 0;
+		delete Cache;
+		Cache = NULL;
+		if (Gathering && Global.Size() > 0)
+			CreateCache();
+
+		if (Progressive || Costs) {
+			Raytracer::Render(Img);
+			Gathers = Own.Gathers;
+			CacheHits = Own.CacheHits;
+		} else
+			RenderTiles(Img);
+
+		if (Cache)
+			std::cout << "*** Final gathers=" << Gathers
+				  << " cache hits=" << CacheHits
+				  << " records=" << Cache->Size() << std::endl;
+	}
+}
@@ -0,0 +1,177 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _PHOTONMAPPER_H_
+#define _PHOTONMAPPER_H_
+
+#include <vector>
+
+#include "General/Types.hh"
+#include "Render/Raytracer.hh"
+#include "Render/PhotonMap.hh"
+#include "Render/PhotonTracer.hh"
+#include "Render/IrradianceCache.hh"
+#include "General/Random.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Raytracer extended with global and caustic photon maps.
+	 *
+	 * Direct light and specular paths are traced as in Raytracer;
+	 * at diffuse surfaces light which came over a diffuse bounce
+	 * is estimated from the global map and light focused by
+	 * specular objects from the caustic map. Caustic photons are
+	 * aimed at specular objects with projection maps, so all
+	 * of their budget ends up in caustics.
+	 *
+	 * With final gathering enabled the global map holds all photons
+	 * and is looked at only from the ends of gather rays; indirect
+	 * irradiance computed this way is kept in an IrradianceCache
+	 * and interpolated, so only a small fraction of diffuse hits
+	 * (including antialiasing subsamples) has to gather.
+	 *
+	 * Render() splits the image into tiles which worker threads
+	 * take from a common queue. Each worker traces with its own
+	 * GatherContext while the maps and the cache are shared, so
+	 * a record gathered by one thread is reused by all of them.
+	 * The coarse preview and cost maps keep the single-threaded
+	 * path of Raytracer::Render().
+	 */
+	class PhotonMapper : public Raytracer {
+	public:
+		/** \brief Budget and estimate parameters of one map */
+		struct MapConfig {
+			Int Photons;	/**< Photons emitted (0 - no map) */
+			Int K;		/**< Photons used in estimate */
+			Double MaxDist;	/**< Max distance of used photons */
+		};
+
+		/** \brief Final gather settings */
+		struct GatherConfig {
+			Int Samples;	/**< Hemisphere strata along theta;
+					   about PI times more along phi
+					   (0 - no final gather) */
+			Double Accuracy;	/**< Irradiance cache error */
+			Double MinRadius;	/**< Record radius limits */
+			Double MaxRadius;
+		};
+
+	private:
+		/**@{ Map settings */
+		const MapConfig GlobalCfg, CausticCfg;
+		const GatherConfig GatherCfg;
+		/*@}*/
+
+		/** Flux of white light \see PhotonTracer */
+		const Double Power;
+
+		/** Indirect (L D (S|D)* D) photons */
+		PhotonMap Global;
+
+		/** Caustic (L S+ D) photons */
+		PhotonMap Caustic;
+
+		/** Cache of final gather results; NULL if not gathering */
+		IrradianceCache *Cache;
+
+		/** \brief Scratch state of one rendering thread */
+		struct GatherContext {
+			/** Gather ray jittering */
+			General::Random Rnd;
+
+			/**@{ Statistics */
+			Int Gathers;
+			Int CacheHits;
+			/*@}*/
+
+			/** k-NN scratch buffer */
+			std::vector<PhotonMap::Neighbour> Heap;
+
+			/**@{ Final gather scratch buffers */
+			std::vector<World::Spectrum> GatherL;
+			std::vector<Double> GatherD;
+			/*@}*/
+
+			GatherContext(UInt Seed);
+		};
+
+		/** Context of Gather() called on the mapper itself */
+		GatherContext Own;
+
+		/**@{ Statistics of the whole render */
+		Int Gathers;
+		Int CacheHits;
+		/*@}*/
+
+		friend class MapperTracer;
+		friend class MapperJob;
+
+		/** Emit photons for one map */
+		void BuildMap(PhotonMap &Map, const MapConfig &Cfg,
+			      Int Store, Int Aim, UInt Seed);
+
+		/** Compute indirect irradiance record by final gathering */
+		void FinalGather(const Math::Vector &Point,
+				 const Math::Vector &Normal,
+				 IrradianceCache::Record &Rec,
+				 GatherContext &Ctx) const;
+
+		/** Add photon map estimates to diffuse light; safe to
+		 * call from many threads with distinct contexts */
+		void Indirect(const Ray &R,
+			      const Math::Vector &ColPoint,
+			      const Math::Vector &Normal,
+			      World::Color &Diffuse,
+			      GatherContext &Ctx) const;
+
+		/** Create cache spanning the camera and bounded objects */
+		void CreateCache();
+
+		/** Render tiles of the image with all workers */
+		void RenderTiles(Graphics::Drawable &Img);
+
+		/** Indirect() with the mapper's own context */
+		virtual void Gather(const Ray &R,
+				    const Math::Vector &ColPoint,
+				    const Math::Vector &Normal,
+				    World::Color &Diffuse);
+
+	public:
+		/** Initialize renderer
+		 * \param Scene		Scene to be rendered
+		 * \param Antialiasing	Is antialiasing enabled?
+		 * \param Global	Global map settings
+		 * \param Caustic	Caustic map settings
+		 * \param Gather	Final gather settings
+		 * \param Power		Flux of white light
+		 * \param MaxDepth	Max ray and photon path length
+		 */
+		PhotonMapper(const World::Scene &Scene,
+			     const Bool Antialiasing,
+			     const MapConfig &Global,
+			     const MapConfig &Caustic,
+			     const GatherConfig &Gather,
+			     Double Power = 1000.0,
+			     const Int MaxDepth = 5);
+
+		/** Release cache */
+		~PhotonMapper();
+
+		/** Shoot photons, then raytrace using them */
+		void Render(Graphics::Drawable &Img);
+	};
+};
+
+#endif
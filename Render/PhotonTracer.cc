@@ -0,0 +1,249 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#include <cmath>
+
+#include "General/Thread.hh"
+#include "Math/Abs.hh"
+#include "Math/Constants.hh"
+#include "Render/PhotonTracer.hh"
+
+namespace Render {
+	PhotonTracer::PhotonTracer(const World::Scene &Scene,
+				   Double Power,
+				   Int Store,
+				   Int MaxDepth,
+				   Int Aim)
+		: Scene(Scene), MaxDepth(MaxDepth),
+		  Power(Power), Store(Store)
+	{
+		/* Brighter lights get more photons; when aiming,
+		 * lights which see no specular object get none */
+		Double Sum = 0.0;
+		World::Scene::LightIterator Iter(Scene);
+		while (const World::Light *l = Iter.Next()) {
+			const World::PointLight *P =
+				dynamic_cast<const World::PointLight *>(l);
+			if (P == NULL)
+				continue;
+			Double W = World::Spectrum(P->GetColor()).Average();
+			if (W <= 0.0)
+				continue;
+			if (Aim > 0) {
+				ProjectionMap Map(Scene, P->GetPosition(), Aim);
+				W *= Map.Coverage();
+				if (W <= 0.0)
+					continue;
+				Projections.push_back(Map);
+			}
+			Sum += W;
+			Lights.push_back(P);
+			LightCDF.push_back(Sum);
+		}
+		for (UInt i = 0; i < LightCDF.size(); i++)
+			LightCDF[i] /= Sum;
+	}
+
+	Math::Vector PhotonTracer::SphereDirection(General::Random &Rnd)
+	{
+		const Double z = 1.0 - 2.0 * Rnd.Next();
+		const Double r = std::sqrt(1.0 - z * z);
+		const Double Phi = 2.0 * Math::PI * Rnd.Next();
+		return Math::Vector(r * std::cos(Phi), r * std::sin(Phi), z);
+	}
+
+	void PhotonTracer::Basis(const Math::Vector &Normal,
+				 Math::Vector &U, Math::Vector &V)
+	{
+		const Math::Vector Helper =
+			Math::Abs(Normal[0]) > 0.9
+			? Math::Vector(0.0, 1.0, 0.0)
+			: Math::Vector(1.0, 0.0, 0.0);
+		U = Helper.Cross(Normal).Normalize();
+		V = Normal.Cross(U);
+	}
+
+	Math::Vector PhotonTracer::HemisphereDirection(
+		const Math::Vector &Normal, General::Random &Rnd)
+	{
+		Math::Vector U, V;
+		Basis(Normal, U, V);
+
+		const Double r = std::sqrt(Rnd.Next());
+		const Double Phi = 2.0 * Math::PI * Rnd.Next();
+		const Double z = std::sqrt(1.0 - r * r);
+		return U * (r * std::cos(Phi)) +
+			V * (r * std::sin(Phi)) +
+			Normal * z;
+	}
+
+	void PhotonTracer::Emit(Int Count, General::Random &Rnd,
+				std::vector<Photon> &Out) const
+	{
+		if (Lights.empty())
+			return;
+
+		for (Int i = 0; i < Count; i++) {
+			/* Pick a light */
+			const Double Xi = Rnd.Next();
+			UInt L = 0;
+			while (L + 1 < Lights.size() && LightCDF[L] < Xi)
+				L++;
+			const Double Prob =
+				LightCDF[L] - (L > 0 ? LightCDF[L - 1] : 0.0);
+
+			World::Spectrum Flux =
+				World::Spectrum(Lights[L]->GetColor())
+				* (Power / Prob);
+
+			Math::Vector Dir;
+			if (Projections.empty())
+				Dir = SphereDirection(Rnd);
+			else {
+				/* Only a part of the light's flux
+				 * leaves through marked cells */
+				Dir = Projections[L].Sample(Rnd);
+				Flux *= Projections[L].Coverage();
+			}
+
+			Trace(Ray(Lights[L]->GetPosition(), Dir),
+			      Flux, Rnd, Out);
+		}
+	}
+
+	/** \brief Emission split between workers */
+	class ShootJob : public General::Job {
+		const PhotonTracer &T;
+		const UInt Seed;
+		std::vector<std::vector<Photon> > &Buffers;
+	public:
+		ShootJob(const PhotonTracer &T, UInt Seed,
+			 std::vector<std::vector<Photon> > &Buffers)
+			: T(T), Seed(Seed), Buffers(Buffers) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			/* Seed depends on the range, not on timing */
+			General::Random Rnd(Seed * 7919U + UInt(From));
+			T.Emit(To - From, Rnd, Buffers[Worker]);
+		}
+	};
+
+	void PhotonTracer::Shoot(Int Count, UInt Seed,
+				 std::vector<std::vector<Photon> > &Buffers,
+				 std::vector<Photon> &Out) const
+	{
+		const Int Workers = General::Parallel::Workers();
+		Buffers.resize(Workers);
+		for (Int w = 0; w < Workers; w++)
+			Buffers[w].clear();
+
+		ShootJob Job(*this, Seed, Buffers);
+		General::Parallel::For(Job, Count, Workers);
+
+		for (Int w = 0; w < Workers; w++)
+			Out.insert(Out.end(),
+				   Buffers[w].begin(), Buffers[w].end());
+	}
+
+	void PhotonTracer::Trace(Ray R, World::Spectrum Flux,
+				 General::Random &Rnd,
+				 std::vector<Photon> &Out) const
+	{
+		Double CurIdx = Scene.GetAtmosphere();
+
+		/* Did the photon bounce off a diffuse surface yet? */
+		Bool Diffused = false;
+
+		for (Int Depth = 0; Depth < MaxDepth; Depth++) {
+			const World::Object *Obj = NULL;
+			World::HitStorage Hit;
+			Double ColPos = 0.0;
+			if (Scene.Collide(R, ColPos, Obj, Hit) == false)
+				return;
+
+			const Math::Vector ColPoint = R.GetPoint(ColPos);
+			const Math::Vector Normal = Obj->NormalAt(ColPoint);
+
+			const World::Spectrum Diff =
+				Obj->ColorAt(ColPoint, World::Material::DIFFUSE);
+			const World::Spectrum Refl =
+				Obj->ColorAt(ColPoint, World::Material::REFLECT);
+			const World::Spectrum Refr =
+				Obj->ColorAt(ColPoint, World::Material::REFRACT);
+
+			Double Pd = Diff.Average();
+			Double Pr = Refl.Average();
+			Double Pt = Refr.Average();
+
+			if (Pd > 0.0) {
+				const Int Kind = Depth == 0 ? DIRECT :
+					(Diffused ? INDIRECT : CAUSTIC);
+				if (Store & Kind)
+					Out.push_back(Photon(ColPoint,
+							     R.Direction(),
+							     Flux));
+			}
+
+			/* Russian roulette; scale if material
+			 * reflects more than it gets */
+			const Double Sum = Pd + Pr + Pt;
+			if (Sum > 1.0) {
+				Pd /= Sum;
+				Pr /= Sum;
+				Pt /= Sum;
+			}
+
+			const Double Xi = Rnd.Next();
+			if (Xi < Pd) {
+				/* Nothing more to store for caustic maps */
+				if (Store == CAUSTIC)
+					return;
+				Diffused = true;
+
+				/* Diffuse bounce off the visible side */
+				Math::Vector Side = Normal;
+				if (Normal.Dot(R.Direction()) > 0.0)
+					Side = -Normal;
+				R = Ray(ColPoint,
+					HemisphereDirection(Side, Rnd));
+				Flux = Flux * Diff / Pd;
+			} else if (Xi < Pd + Pr) {
+				R = R.Reflect(Normal, ColPoint);
+				Flux = Flux * Refl / Pr;
+			} else if (Xi < Pd + Pr + Pt) {
+				/* Same index convention as Raytracer */
+				const Double NewIdx =
+					Obj->GetProperty(World::Material::INDEX);
+				Double IntoIdx = NewIdx;
+				Math::Vector RealNormal = Normal;
+				if (NewIdx == CurIdx) {
+					IntoIdx = Scene.GetAtmosphere();
+					RealNormal = -Normal;
+				}
+
+				/* Total internal reflection? */
+				const Double n = CurIdx / IntoIdx;
+				const Double c1 =
+					- RealNormal.Dot(R.Direction());
+				if (1.0 - n * n * (1.0 - c1 * c1) < 0.0) {
+					R = R.Reflect(RealNormal, ColPoint);
+				} else {
+					R = R.Refract(RealNormal, ColPoint,
+						      CurIdx, IntoIdx);
+					CurIdx = IntoIdx;
+				}
+				Flux = Flux * Refr / Pt;
+			} else
+				return; /* Absorbed */
+		}
+	}
+}
@@ -0,0 +1,135 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _PHOTONTRACER_H_
+#define _PHOTONTRACER_H_
+
+#include <vector>
+
+#include "General/Types.hh"
+#include "General/Random.hh"
+#include "Math/Vector.hh"
+#include "World/Scene.hh"
+#include "Render/Photon.hh"
+#include "Render/Ray.hh"
+#include "Render/ProjectionMap.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Shoots photons from scene point lights and traces
+	 *	them through the scene.
+	 *
+	 * At every hit the photon is stored if the surface has a
+	 * diffuse component and the path so far is of a selected kind,
+	 * then it's diffusely reflected, specularly reflected,
+	 * refracted or absorbed by Russian roulette driven by the
+	 * material colors.
+	 *
+	 * Tracer is stateless after construction; several threads
+	 * may call Emit() concurrently with their own generators.
+	 */
+	class PhotonTracer {
+	public:
+		/** Kinds of light paths ending at a diffuse surface */
+		enum Path {
+			DIRECT = 1,	/**< Light - Diffuse */
+			CAUSTIC = 2,	/**< Light - Specular+ - Diffuse */
+			INDIRECT = 4	/**< Any path with a diffuse bounce */
+		};
+
+	private:
+		/** Scene to shoot photons into */
+		const World::Scene &Scene;
+
+		/** Max bounces of one photon */
+		const Int MaxDepth;
+
+		/** Flux of light of color (1,1,1) */
+		const Double Power;
+
+		/** Path kinds to be stored; Path bits */
+		const Int Store;
+
+		/** Point lights photons are emitted from */
+		std::vector<const World::PointLight *> Lights;
+
+		/** Projection map of each light; empty if not aiming */
+		std::vector<ProjectionMap> Projections;
+
+		/** Cumulative light selection probabilities */
+		std::vector<Double> LightCDF;
+
+		/** Trace one photon starting with ray R */
+		void Trace(Ray R, World::Spectrum Power,
+			   General::Random &Rnd,
+			   std::vector<Photon> &Out) const;
+
+	public:
+		/** Create tracer
+		 * \param Scene		Scene to trace photons in
+		 * \param Power		Flux of a white light; raytracer
+		 *			lights have no falloff, so this sets
+		 *			how bright indirect light is.
+		 * \param Store	Path kinds to store (Path bits)
+		 * \param MaxDepth	Max photon bounces
+		 * \param Aim		Shoot only towards specular objects
+		 *			using projection maps of given
+		 *			resolution (0 - shoot everywhere)
+		 */
+		PhotonTracer(const World::Scene &Scene,
+			     Double Power,
+			     Int Store = CAUSTIC | INDIRECT,
+			     Int MaxDepth = 5,
+			     Int Aim = 0);
+
+		/** Does the scene have any light to emit from? */
+		inline Bool HasLights() const {
+			return !Lights.empty();
+		}
+
+		/**
+		 * Emit Count photons and append stored ones to Out.
+		 *
+		 * Stored power is not divided by the number of
+		 * emitted photons; estimators divide by their total.
+		 */
+		void Emit(Int Count, General::Random &Rnd,
+			  std::vector<Photon> &Out) const;
+
+		/**
+		 * Emit Count photons using all workers.
+		 *
+		 * Each worker fills its own buffer from Buffers (resized
+		 * to the worker count; capacity is reused between calls)
+		 * and the buffers are appended to Out in worker order,
+		 * so the result depends only on Seed and worker count.
+		 */
+		void Shoot(Int Count, UInt Seed,
+			   std::vector<std::vector<Photon> > &Buffers,
+			   std::vector<Photon> &Out) const;
+
+		/** \return Random direction on unit sphere */
+		static Math::Vector SphereDirection(General::Random &Rnd);
+
+		/** Orthonormal basis (U, V, Normal) around unit Normal */
+		static void Basis(const Math::Vector &Normal,
+				  Math::Vector &U, Math::Vector &V);
+
+		/** \return Cosine-distributed direction around Normal */
+		static Math::Vector HemisphereDirection(
+			const Math::Vector &Normal, General::Random &Rnd);
+	};
+};
+
+#endif
@@ -0,0 +1,310 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#include <iostream>
+#include <cmath>
+
+#include "General/Thread.hh"
+#include "Math/Constants.hh"
+#include "Render/ProgressiveMapper.hh"
+
+namespace Render {
+	/** \brief Eye pass over a range of image rows */
+	class EyeJob : public General::Job {
+		ProgressiveMapper &M;
+		const World::Camera::View &V;
+		const Int Width;
+	public:
+		/** Hit points found by each worker */
+		std::vector<std::vector<ProgressiveMapper::HitPoint> > Out;
+
+		EyeJob(ProgressiveMapper &M, const World::Camera::View &V,
+		       Int Width, Int Workers)
+			: M(M), V(V), Width(Width), Out(Workers) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			const World::Spectrum One(1.0, 1.0, 1.0);
+			for (Int y = From; y < To; y++)
+				for (Int x = 0; x < Width; x++) {
+					/* Refraction needs unit directions */
+					const Ray R = V.At(x, y);
+					Math::Vector Dir = R.Direction();
+					Dir.Normalize();
+					M.TraceEye(Ray(R.Start(), Dir), One, 0,
+						   M.Scene.GetAtmosphere(),
+						   y * Width + x, Out[Worker]);
+				}
+		}
+	};
+
+	/** \brief Sums photons around one hit point */
+	class GatherVisitor {
+	public:
+		const Math::Vector &Normal;
+		Int Count;
+		World::Spectrum Flux;
+
+		GatherVisitor(const Math::Vector &Normal)
+			: Normal(Normal), Count(0) {}
+
+		inline void operator()(const Photon &P, Double SquareDist) {
+			/* Skip photons coming from behind the surface */
+			if (P.GetDirection().Dot(Normal) >= 0.0)
+				return;
+			Count++;
+			Flux += P.GetPower();
+		}
+	};
+
+	/** \brief Radius/flux update of a range of hit points */
+	class GatherJob : public General::Job {
+		ProgressiveMapper &M;
+	public:
+		GatherJob(ProgressiveMapper &M) : M(M) {}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			for (Int i = From; i < To; i++) {
+				ProgressiveMapper::HitPoint &H = M.HitPoints[i];
+				GatherVisitor V(H.Normal);
+				M.Grid.Query(H.Position, std::sqrt(H.Radius2), V);
+				if (V.Count == 0)
+					continue;
+
+				/* Keep Alpha of new photons, shrink radius
+				 * so the density stays the same */
+				const Double NewN = H.N + M.Alpha * V.Count;
+				const Double Ratio = NewN / (H.N + V.Count);
+				H.N = NewN;
+				H.Radius2 *= Ratio;
+				H.Flux = (H.Flux + V.Flux) * Ratio;
+			}
+		}
+	};
+
+	ProgressiveMapper::ProgressiveMapper(const World::Scene &Scene,
+					     Int Passes,
+					     Int PhotonsPerPass,
+					     Double Radius,
+					     Double Power,
+					     Double Alpha,
+					     Int MaxDepth)
+		: Scene(Scene),
+		  Passes(Passes),
+		  PhotonsPerPass(PhotonsPerPass),
+		  InitialRadius(Radius),
+		  Alpha(Alpha),
+		  MaxDepth(MaxDepth),
+		  Tracer(Scene, Power,
+			 PhotonTracer::CAUSTIC | PhotonTracer::INDIRECT,
+			 MaxDepth),
+		  Emitted(0.0)
+	{
+	}
+
+	World::Color ProgressiveMapper::Shade(const Math::Vector &ColPoint,
+					      const Math::Vector &Normal,
+					      const Ray &Reflect,
+					      const World::Object &Obj) const
+	{
+		World::Color
+			Diffuse = World::ColLib::Black(),
+			Specular = World::ColLib::Black();
+
+		World::Scene::LightIterator Iter(this->Scene);
+		while (const World::Light *l = Iter.Next()) {
+			const World::AmbientLight *A =
+				dynamic_cast<const World::AmbientLight *>(l);
+			if (A != NULL) {
+				Diffuse += A->GetColor();
+				continue;
+			}
+
+			const World::PointLight *P =
+				dynamic_cast<const World::PointLight *>(l);
+			if (P == NULL)
+				continue;
+
+			const Ray ToLight = Ray::RayFromPoints(ColPoint,
+							       P->GetPosition());
+			const World::Object *tmp;
+			World::HitStorage tmpHit;
+			Double ColPos;
+			if (this->Scene.Collide(ToLight, ColPos, tmp,
+						tmpHit) == true)
+				continue;
+
+			const Math::Vector &LightDir = ToLight.Direction();
+			Double CoeffSpecular = Reflect.Direction().Dot(LightDir);
+			if (CoeffSpecular < 0.0)
+				CoeffSpecular = 0.0;
+			Diffuse += P->GetColor() * Normal.Dot(LightDir);
+			Specular += P->GetColor() * CoeffSpecular;
+		}
+
+		return Diffuse * Obj.ColorAt(ColPoint, World::Material::DIFFUSE) +
+			(Specular *
+			 Obj.ColorAt(ColPoint, World::Material::SPECULAR))
+			.Pow(Obj.GetProperty(World::Material::SHININESS));
+	}
+
+	void ProgressiveMapper::TraceEye(const Ray &R,
+					 const World::Spectrum &Weight,
+					 Int Depth, Double CurIdx, Int Pixel,
+					 std::vector<HitPoint> &Out)
+	{
+		const World::Object *Obj = NULL;
+		World::HitStorage Hit;
+		Double ColPos = 0.0;
+		if (this->Scene.Collide(R, ColPos, Obj, Hit) == false) {
+			/* Only primary rays show the background,
+			 * as in Raytracer */
+			if (Depth == 0)
+				Direct[Pixel] = Scene.GetBackground();
+			return;
+		}
+
+		const Math::Vector ColPoint = R.GetPoint(ColPos);
+		const Math::Vector Normal = Obj->NormalAt(ColPoint);
+		const Ray ReflectRay = R.Reflect(Normal, ColPoint);
+
+		const World::Spectrum ObjDiff =
+			Obj->ColorAt(ColPoint, World::Material::DIFFUSE);
+		const World::Spectrum ObjRefl =
+			Obj->ColorAt(ColPoint, World::Material::REFLECT);
+		const World::Spectrum ObjRefr =
+			Obj->ColorAt(ColPoint, World::Material::REFRACT);
+
+		Direct[Pixel] += Weight *
+			World::Spectrum(Shade(ColPoint, Normal, ReflectRay, *Obj));
+
+		if (ObjDiff.Average() > 0.0) {
+			HitPoint H;
+			H.Position = ColPoint;
+			H.Normal = Normal;
+			/* Photons may arrive on either side of a plane;
+			 * gather on the side we look at */
+			if (Normal.Dot(R.Direction()) > 0.0)
+				H.Normal = -Normal;
+			H.Weight = Weight * ObjDiff;
+			H.Pixel = Pixel;
+			H.Radius2 = InitialRadius * InitialRadius;
+			H.N = 0.0;
+			Out.push_back(H);
+		}
+
+		if (Depth >= MaxDepth)
+			return;
+
+		if (ObjRefl.Average() > 0.0)
+			TraceEye(ReflectRay, Weight * ObjRefl,
+				 Depth + 1, CurIdx, Pixel, Out);
+
+		if (ObjRefr.Average() > 0.0) {
+			const Double NewIdx =
+				Obj->GetProperty(World::Material::INDEX);
+			Double IntoIdx = NewIdx;
+			Math::Vector RealNormal = Normal;
+			if (NewIdx == CurIdx) {
+				IntoIdx = this->Scene.GetAtmosphere();
+				RealNormal = - Normal;
+			}
+			/* Skip total internal reflection */
+			const Double n = CurIdx / IntoIdx;
+			const Double c1 = - RealNormal.Dot(R.Direction());
+			if (1.0 - n * n * (1.0 - c1 * c1) < 0.0)
+				return;
+
+			const Ray RefractRay =
+				R.Refract(RealNormal, ColPoint, CurIdx, IntoIdx);
+			TraceEye(RefractRay, Weight * ObjRefr,
+				 Depth + 1, IntoIdx, Pixel, Out);
+		}
+	}
+
+	void ProgressiveMapper::Pass(Int Number)
+	{
+		/* Capacity of all buffers is kept between passes */
+		Photons.clear();
+		Tracer.Shoot(PhotonsPerPass, UInt(Number), WorkerPhotons, Photons);
+		Emitted += PhotonsPerPass;
+
+		/* Grid cells follow the largest current radius */
+		Double MaxRadius2 = 0.0;
+		for (UInt i = 0; i < HitPoints.size(); i++)
+			if (HitPoints[i].Radius2 > MaxRadius2)
+				MaxRadius2 = HitPoints[i].Radius2;
+		if (MaxRadius2 <= 0.0)
+			return;
+		Grid.Build(Photons, std::sqrt(MaxRadius2));
+
+		GatherJob Gather(*this);
+		General::Parallel::For(Gather, Int(HitPoints.size()));
+	}
+
+	void ProgressiveMapper::Output(Graphics::Drawable &Img) const
+	{
+		const Int Width = Img.GetWidth();
+		const Int Height = Img.GetHeight();
+
+		std::vector<World::Spectrum> Pixels(Direct);
+		if (Emitted > 0.0)
+			for (UInt i = 0; i < HitPoints.size(); i++) {
+				const HitPoint &H = HitPoints[i];
+				const Double Area = Math::PI * H.Radius2;
+				Pixels[H.Pixel] += H.Weight * H.Flux
+					/ (Area * Emitted);
+			}
+
+		if (!Pixels.empty())
+			Img.PutRadianceTile(0, 0, Width, Height, &Pixels[0]);
+		Img.Refresh();
+	}
+
+	void ProgressiveMapper::Render(Graphics::Drawable &Img)
+	{
+		const Int Width = Img.GetWidth();
+		const Int Height = Img.GetHeight();
+		const World::Camera::View V =
+			this->Scene.GetCamera().CreateView(Width, Height);
+
+		std::cout << "*** Progressive photon mapper ***" << std::endl;
+
+		/* Eye pass */
+		Direct.assign(Width * Height, World::Spectrum());
+		HitPoints.clear();
+		Emitted = 0.0;
+		{
+			EyeJob Eye(*this, V, Width,
+				   General::Parallel::Workers());
+			General::Parallel::For(Eye, Height);
+			for (UInt w = 0; w < Eye.Out.size(); w++)
+				HitPoints.insert(HitPoints.end(),
+						 Eye.Out[w].begin(),
+						 Eye.Out[w].end());
+		}
+		std::cout << "*** Hit points: " << HitPoints.size() << std::endl;
+
+		if (!Tracer.HasLights()) {
+			Output(Img);
+			return;
+		}
+
+		/* Photon passes */
+		for (Int p = 0; p < Passes; p++) {
+			Pass(p);
+			Output(Img);
+			std::cout << "*** Pass " << p + 1 << "/" << Passes
+				  << " photons stored=" << Photons.size()
+				  << std::endl;
+		}
+	}
+}
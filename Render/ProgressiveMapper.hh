@@ -0,0 +1,139 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _PROGRESSIVEMAPPER_H_
+#define _PROGRESSIVEMAPPER_H_
+
+#include <vector>
+
+#include "General/Types.hh"
+#include "Render/Renderer.hh"
+#include "Render/Photon.hh"
+#include "Render/PhotonGrid.hh"
+#include "Render/PhotonTracer.hh"
+#include "World/Scene.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Progressive photon mapper.
+	 *
+	 * Eye pass follows specular paths from the camera (like
+	 * Raytracer does) and records a hit point at every diffuse
+	 * surface; direct light is computed there as well. Then
+	 * each photon pass shoots a fixed number of photons, hashes
+	 * them into a PhotonGrid built for the current largest
+	 * hit point radius and lets every hit point gather photons
+	 * within its own radius. Radii shrink by the Alpha rule
+	 * (Hachisuka et al. 2008) so the estimate converges while
+	 * photon, hit point and grid memory stay constant whatever
+	 * the number of passes.
+	 */
+	class ProgressiveMapper : public Renderer {
+	public:
+		/** \brief Diffuse surface seen from a pixel */
+		struct HitPoint {
+			Math::Vector Position;
+			Math::Vector Normal;
+			/** Camera path throughput times diffuse color */
+			World::Spectrum Weight;
+			/** Pixel index (y * Width + x) */
+			Int Pixel;
+			/** Current square search radius */
+			Double Radius2;
+			/** Accumulated photon count */
+			Double N;
+			/** Accumulated (radius corrected) flux */
+			World::Spectrum Flux;
+		};
+
+	private:
+		/** Scene to be rendered */
+		const World::Scene &Scene;
+
+		/**@{ Progressive parameters */
+		const Int Passes;
+		const Int PhotonsPerPass;
+		const Double InitialRadius;
+		const Double Alpha;
+		/*@}*/
+
+		/** Max depth of eye and photon paths */
+		const Int MaxDepth;
+
+		/** Photon tracer */
+		PhotonTracer Tracer;
+
+		/** Hit points of all pixels */
+		std::vector<HitPoint> HitPoints;
+
+		/** Direct light of each pixel */
+		std::vector<World::Spectrum> Direct;
+
+		/** Photons of current pass; one buffer per worker */
+		std::vector<std::vector<Photon> > WorkerPhotons;
+
+		/** Photons of current pass, merged */
+		std::vector<Photon> Photons;
+
+		/** Grid over Photons */
+		PhotonGrid Grid;
+
+		/** Photons emitted in all passes so far */
+		Double Emitted;
+
+		friend class EyeJob;
+		friend class GatherJob;
+
+		/** Direct light at a surface point (Raytracer's model) */
+		World::Color Shade(const Math::Vector &ColPoint,
+				   const Math::Vector &Normal,
+				   const Ray &Reflect,
+				   const World::Object &Obj) const;
+
+		/** Follow eye ray; store hit points and direct light */
+		void TraceEye(const Ray &R, const World::Spectrum &Weight,
+			      Int Depth, Double CurIdx, Int Pixel,
+			      std::vector<HitPoint> &Out);
+
+		/** Run one photon pass */
+		void Pass(Int Number);
+
+		/** Write current estimate into Img */
+		void Output(Graphics::Drawable &Img) const;
+
+	public:
+		/** Initialize renderer
+		 * \param Scene		Scene to be rendered
+		 * \param Passes	Number of photon passes
+		 * \param PhotonsPerPass Photons shot in each pass
+		 * \param Radius	Initial gather radius
+		 * \param Power		Flux of white light
+		 *			\see PhotonTracer
+		 * \param Alpha		Fraction of new photons kept
+		 * \param MaxDepth	Max eye and photon path length
+		 */
+		ProgressiveMapper(const World::Scene &Scene,
+				  Int Passes = 16,
+				  Int PhotonsPerPass = 100000,
+				  Double Radius = 0.25,
+				  Double Power = 1000.0,
+				  Double Alpha = 0.7,
+				  Int MaxDepth = 5);
+
+		/** Render scene; image is updated after every pass */
+		void Render(Graphics::Drawable &Img);
+	};
+};
+
+#endif
@@ -0,0 +1,134 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#include <cmath>
+#include <algorithm>
+
+#include "Math/Constants.hh"
+#include "Render/ProjectionMap.hh"
+
+namespace Render {
+	ProjectionMap::ProjectionMap(const World::Scene &Scene,
+				     const Math::Vector &Position,
+				     Int Resolution)
+		: ZRes(Resolution), PhiRes(2 * Resolution)
+	{
+		/* Bounding cones of specular objects */
+		std::vector<Math::Vector> Axis;
+		std::vector<Double> CosAngle;
+		Bool Everything = false;
+
+		/* Bounding spheres of specular objects and aggregates */
+		std::vector<Math::Vector> Centers;
+		std::vector<Double> Radii;
+		World::Scene::ObjectIterator Iter(Scene);
+		while (const World::Object *O = Iter.Next()) {
+			if (!O->GetMaterial().IsSpecular())
+				continue;
+
+			Math::Vector Center;
+			Double Radius;
+			if (!O->Bounds(Center, Radius)) {
+				/* Unbounded mirror; may be anywhere */
+				Everything = true;
+				break;
+			}
+			Centers.push_back(Center);
+			Radii.push_back(Radius);
+		}
+		World::Scene::AggregateIterator AIter(Scene);
+		while (const World::Aggregate *A = AIter.Next()) {
+			if (!A->IsSpecular())
+				continue;
+			Math::Vector Center;
+			Double Radius;
+			A->Bounds(Center, Radius);
+			Centers.push_back(Center);
+			Radii.push_back(Radius);
+		}
+
+		for (size_t i = 0; !Everything && i < Centers.size(); i++) {
+			const Double Radius = Radii[i];
+			Math::Vector ToCenter = Centers[i] - Position;
+			const Double Dist = ToCenter.Length();
+			if (Dist <= Radius) {
+				/* Light inside the object */
+				Everything = true;
+				break;
+			}
+			Axis.push_back(ToCenter / Dist);
+			CosAngle.push_back(std::sqrt(1.0 - (Radius * Radius)
+						     / (Dist * Dist)));
+		}
+
+		/* Angular radius of cells in each row; cells of one row
+		 * differ only by rotation around the z axis */
+		std::vector<Double> RowAngle(ZRes);
+		for (Int z = 0; z < ZRes; z++) {
+			const Math::Vector C = CellCenter(z * PhiRes);
+			Double Max = 0.0;
+			for (Int Corner = 0; Corner < 4; Corner++) {
+				const Math::Vector K = Direction(
+					z + (Corner & 1), Corner >> 1);
+				const Double A = std::acos(
+					std::min(1.0, (double)C.Dot(K)));
+				if (A > Max)
+					Max = A;
+			}
+			RowAngle[z] = Max;
+		}
+
+		for (Int c = 0; c < ZRes * PhiRes; c++) {
+			if (Everything) {
+				Marked.push_back(c);
+				continue;
+			}
+			const Math::Vector Dir = CellCenter(c);
+			for (UInt o = 0; o < Axis.size(); o++) {
+				/* Angle between cell and object cones */
+				const Double Cos = Dir.Dot(Axis[o]);
+				const Double Angle =
+					std::acos(std::min(1.0, (double)Cos))
+					- std::acos((double)CosAngle[o]);
+				if (Angle <= RowAngle[c / PhiRes]) {
+					Marked.push_back(c);
+					break;
+				}
+			}
+		}
+	}
+
+	Math::Vector ProjectionMap::Direction(Double z, Double p) const
+	{
+		const Double Z = z / ZRes * 2.0 - 1.0;
+		const Double Phi = p / PhiRes * 2.0 * Math::PI;
+		const Double r = std::sqrt(std::max(0.0, 1.0 - Z * Z));
+		return Math::Vector(r * std::cos(Phi), r * std::sin(Phi), Z);
+	}
+
+	Math::Vector ProjectionMap::CellCenter(Int Cell) const
+	{
+		return Direction((Cell / PhiRes) + 0.5, (Cell % PhiRes) + 0.5);
+	}
+
+	Math::Vector ProjectionMap::Sample(General::Random &Rnd) const
+	{
+		/* Cells have equal area: pick one, then a point in it */
+		Int Idx = Int(int(Rnd.Next() * Marked.size()));
+		if (Idx >= Int(Marked.size()))
+			Idx = Int(Marked.size()) - 1;
+		const Int Cell = Marked[Idx];
+
+		return Direction((Cell / PhiRes) + Rnd.Next(),
+				 (Cell % PhiRes) + Rnd.Next());
+	}
+}
@@ -0,0 +1,70 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _PROJECTIONMAP_H_
+#define _PROJECTIONMAP_H_
+
+#include <vector>
+
+#include "General/Types.hh"
+#include "General/Random.hh"
+#include "Math/Vector.hh"
+#include "World/Scene.hh"
+
+namespace Render {
+
+	/**
+	 * \brief
+	 *	Directions from a point light towards specular objects.
+	 *
+	 * The sphere of directions around the light is divided into
+	 * equal-area cells (uniform in cos(theta) and phi). A cell is
+	 * marked when its cone may hit the bounding sphere of an object
+	 * with specular material. Caustic photons are then shot only
+	 * through marked cells and their power is scaled by the
+	 * covered fraction of the sphere.
+	 */
+	class ProjectionMap {
+	private:
+		/** Cells along cos(theta) and along phi */
+		const Int ZRes, PhiRes;
+
+		/** Indices of marked cells */
+		std::vector<Int> Marked;
+
+		/** Unit direction at fractional cell coordinates
+		 * (row along cos(theta), column along phi) */
+		Math::Vector Direction(Double z, Double p) const;
+
+		/** Unit direction through the center of a cell */
+		Math::Vector CellCenter(Int Cell) const;
+
+	public:
+		/** Build map for a light at Position
+		 * \param Resolution	Cells along cos(theta); twice
+		 *			as many are used along phi
+		 */
+		ProjectionMap(const World::Scene &Scene,
+			      const Math::Vector &Position,
+			      Int Resolution = 64);
+
+		/** \return Marked fraction of the sphere of directions */
+		inline Double Coverage() const {
+			return Double(Marked.size()) / Double(ZRes * PhiRes);
+		}
+
+		/** \return Direction uniformly distributed over marked cells */
+		Math::Vector Sample(General::Random &Rnd) const;
+	};
+};
+
+#endif
@@ -13,8 +13,10 @@
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <algorithm>
 
 #include "General/Types.hh"
+#include "General/Profile.hh"
 #include "Render/Raytracer.hh"
 
 namespace Render {
@@ -22,12 +24,22 @@ namespace Render {
 	 * calculating a single pixel on the screen */
 	const Int Raytracer::AASize = 2;
 
+	/** Edge of tiles the image is rendered in */
+	const Int Raytracer::TileSize = 32;
+
+	/** Preview block edge; 1/16 of rays in the first pass */
+	const Int Raytracer::CoarseStep = 4;
+
 	Raytracer::Raytracer(const World::Scene &Scene,
 			     const Bool Antialiasing,
 			     const Int MaxDepth)
 
 		: Scene(Scene),
+		  Camera(&Scene.GetCamera()),
 		  Antialiasing(Antialiasing),
+		  Progressive(false),
+		  CoarseWidth(0),
+		  Costs(NULL),
 		  MaxDepth(MaxDepth),
 		  ShadowRays(0),
 		  ReflectedRays(0),
@@ -69,10 +81,18 @@ namespace Render {
 
 			/* Check if we are shadowed from this light */
 			this->ShadowRays++;
+			General::Profile::Count(General::Profile::SHADOW_RAYS);
 			Ray ToLight = Ray::RayFromPoints(ColPoint,
 							 P->GetPosition());
 			const World::Object *tmp;
-			if (this->Scene.Collide(ToLight, ColPos, tmp) == true)
+			World::HitStorage tmpHit;
+			Bool Shadowed;
+			{
+				General::Profile::Scope S(General::Profile::SHADOW);
+				Shadowed = this->Scene.Collide(ToLight, ColPos, tmp,
+							       tmpHit);
+			}
+			if (Shadowed == true)
 				continue;
 
 			/* Unshadowed light */
@@ -97,12 +117,16 @@ namespace Render {
 			      const Double CurIdx)
 	{
 		const World::Object *Obj = NULL;
+		World::HitStorage Hit;
 
 		/* Check collision with scene objects */
 		Double ColPos = 0.0;
-		if (this->Scene.Collide(R, ColPos, Obj) == false) {
+		General::Profile::Scope S(Depth > 0
+					  ? General::Profile::SECONDARY
+					  : General::Profile::PRIMARY);
+		if (this->Scene.Collide(R, ColPos, Obj, Hit) == false)
 			return false;
-		}
+		S.Change(General::Profile::SHADING);
 		const Math::Vector ColPoint = R.GetPoint(ColPos);
 		const Math::Vector Normal = Obj->NormalAt(ColPoint);
 		const Ray ReflectRay = R.Reflect(Normal, ColPoint);
@@ -117,6 +141,7 @@ namespace Render {
 			Reflect = World::ColLib::Black(),
 			Refract = World::ColLib::Black();
 
+		S.Change(General::Profile::TEXTURE);
 		const World::Color &ObjDiff =
 			Obj->ColorAt(ColPoint, World::Material::DIFFUSE);
 		const World::Color &ObjSpec =
@@ -125,6 +150,7 @@ namespace Render {
 			Obj->ColorAt(ColPoint, World::Material::REFLECT);
 		const World::Color &ObjRefr =
 			Obj->ColorAt(ColPoint, World::Material::REFRACT);
+		S.Change(General::Profile::SHADING);
 		const Double Shininess =
 			Obj->GetProperty(World::Material::SHININESS);
 		const Double NewIdx =
@@ -133,6 +159,10 @@ namespace Render {
 		TraceLights(ColPoint, Normal,
 			    ReflectRay,
 			    Diffuse, Specular);
+		if (ObjDiff[0] != 0.0 ||
+		    ObjDiff[1] != 0.0 ||
+		    ObjDiff[2] != 0.0)
+			Gather(R, ColPoint, Normal, Diffuse);
 
 		if (Depth < MaxDepth) {
 			/* Reflection tracing */
@@ -141,6 +171,8 @@ namespace Render {
 			    ObjRefl[2] != 0.0)
 			{
 				this->ReflectedRays++;
+				General::Profile::Count(
+					General::Profile::SECONDARY_RAYS);
 				if (!Trace(ReflectRay, Reflect,
 					   Depth + 1, CurIdx))
 					Reflect = World::ColLib::Black();
@@ -166,6 +198,8 @@ namespace Render {
 					R.Refract(RealNormal, ColPoint,
 						  CurIdx, IntoIdx);
 				this->RefractedRays++;
+				General::Profile::Count(
+					General::Profile::SECONDARY_RAYS);
 				if (!Trace(RefractRay,
 					   Refract,
 					   Depth + 1,
@@ -180,81 +214,177 @@ namespace Render {
 		return true;
 	}
 
-	void Raytracer::Render(Graphics::Drawable &Img)
+	World::Color Raytracer::Pixel(const World::Camera::View &V,
+				      Int x, Int y)
+	{
+		const World::Color &Background = Scene.GetBackground();
+		World::Color C;
+		General::Profile::Count(General::Profile::PRIMARY_RAYS,
+					Antialiasing ? AASize * AASize : 1);
+
+		if (!this->Antialiasing) {
+			Ray R = V.At(x, y);
+			if (this->Trace(R, C, 0, Scene.GetAtmosphere()) == true)
+				return C;
+			return Background;
+		}
+
+		Double R = 0.0, G = 0.0, B = 0.0;
+		for (Int aa_x = 0;
+		     aa_x < AASize;
+		     aa_x++)
+		for (Int aa_y = 0;
+		     aa_y < AASize;
+		     aa_y++) {
+			Ray TracedRay = V.At(
+				x * AASize + aa_x,
+				y * AASize + aa_y);
+			if (this->Trace(
+				    TracedRay, C, 0,
+				    Scene.GetAtmosphere())
+			    == true) {
+				R += C[0];
+				G += C[1];
+				B += C[2];
+			} else {
+				R += Background[0];
+				G += Background[1];
+				B += Background[2];
+			}
+		}
+		return World::Color(R/AASize/AASize,
+				    G/AASize/AASize,
+				    B/AASize/AASize);
+	}
+
+	void Raytracer::RenderTile(Graphics::Drawable &Img,
+				   Int X, Int Y, Int W, Int H)
 	{
 		Int Width = Img.GetWidth();
 		Int Height = Img.GetHeight();
-		const World::Color &Background = Scene.GetBackground();
 		const World::Camera::View V =
-			this->Scene.GetCamera().CreateView(
+			this->Camera->CreateView(
 				Antialiasing ? Int(Width * AASize) : Width,
 				Antialiasing ? Int(Height * AASize) : Height);
 
+		/* Iterate over rays created from camera. */
+		TileBuffer.resize(W * H);
+		for (Int y = 0; y < H; y++)
+			for (Int x = 0; x < W; x++) {
+				const Int PX = X + x, PY = Y + y;
+				if (!Coarse.empty() &&
+				    PX % CoarseStep == 0 &&
+				    PY % CoarseStep == 0)
+					/* Traced already by the preview */
+					TileBuffer[y * W + x] = Coarse[
+						(PY / CoarseStep) * CoarseWidth
+						+ PX / CoarseStep];
+				else
+					TileBuffer[y * W + x] =
+						CostedPixel(V, PX, PY);
+			}
+		General::Profile::Scope S(General::Profile::OUTPUT);
+		if (W * H > 0) {
+			Img.PutRadianceTile(X, Y, W, H, &TileBuffer[0]);
+			Img.MarkFinished(X, Y, W, H);
+		}
+	}
+
+	World::Color Raytracer::CostedPixel(const World::Camera::View &V,
+					    Int x, Int y)
+	{
+		if (!Costs)
+			return Pixel(V, x, y);
+
+		const Int Rays = ShadowRays + ReflectedRays + RefractedRays;
+		const unsigned long long Tests = World::Scene::Tests;
+		const unsigned long long Start = General::Profile::Now();
+		const World::Color C = Pixel(V, x, y);
+		const unsigned long long Cycles =
+			General::Profile::Now() - Start;
+
+		const Int Primary = Antialiasing ? AASize * AASize : 1;
+		Costs->Put(x, y,
+			   float(Primary + ShadowRays + ReflectedRays
+				 + RefractedRays - Rays),
+			   float(World::Scene::Tests - Tests),
+			   float(Cycles));
+		return C;
+	}
+
+	void Raytracer::CoarseTile(Graphics::Drawable &Img,
+				   const World::Camera::View &V,
+				   Int X, Int Y, Int W, Int H)
+	{
+		TileBuffer.resize(W * H);
+		for (Int by = 0; by < H; by += CoarseStep)
+			for (Int bx = 0; bx < W; bx += CoarseStep) {
+				const Int PX = X + bx, PY = Y + by;
+				const World::Color C = CostedPixel(V, PX, PY);
+				Coarse[(PY / CoarseStep) * CoarseWidth
+				       + PX / CoarseStep] = C;
+
+				const Int BW = std::min(CoarseStep, W - bx);
+				const Int BH = std::min(CoarseStep, H - by);
+				for (Int y = 0; y < BH; y++)
+					for (Int x = 0; x < BW; x++)
+						TileBuffer[(by + y) * W
+							   + bx + x] = C;
+			}
+		if (W * H > 0)
+			Img.PutRadianceTile(X, Y, W, H, &TileBuffer[0]);
+	}
 
+	void Raytracer::Render(Graphics::Drawable &Img)
+	{
 		ShadowRays = ReflectedRays = RefractedRays = 0;
 
 		std::cout << "*** Raytracing renderer ***" << std::endl;
 
-		World::Color C;
-
-		/* Debug part */
-/*		Ray RR = V.At(327,263);
-		this->Trace(RR, C, 0, AtmosphereIdx);
-		return; */
-		/* End of debug part */
-
-		/* Iterate over rays created from camera. */
-		if (!this->Antialiasing)
-			for (Int x = 0; x < Width; x++) {
-				for (Int y = 0; y < Height; y++) {
-					Ray R = V.At(x, y);
-					if (this->Trace(
-						    R, C,
-						    0, Scene.GetAtmosphere())
-					    == true) {
-						Img.PutPixel(x, y, C);
-					} else {
-						Img.PutPixel(x, y, Background);
-					}
-				}
-			}
-		else {
-			Double R, G, B;
-			for (Int x = 0; x < Width; x++)
-			for (Int y = 0; y < Height; y++) {
-				R = G = B = 0.0;
-
-				for (Int aa_x = 0;
-				     aa_x < AASize;
-				     aa_x++)
-				for (Int aa_y = 0;
-				     aa_y < AASize;
-				     aa_y++) {
-					Ray TracedRay = V.At(
-						x * AASize + aa_x,
-						y * AASize + aa_y);
-					if (this->Trace(
-						    TracedRay, C, 0,
-						    Scene.GetAtmosphere())
-					    == true) {
-						R += C[0];
-						G += C[1];
-						B += C[2];
-					} else {
-						R += Background[0];
-						G += Background[1];
-						B += Background[2];
-					}
+		const Int Width = Img.GetWidth();
+		const Int Height = Img.GetHeight();
+
+		/* Tiles start at multiples of CoarseStep, so each
+		 * preview pixel is one the full pass would trace */
+		Coarse.clear();
+		if (Progressive) {
+			const World::Camera::View V =
+				this->Camera->CreateView(
+					Antialiasing ? Int(Width * AASize) : Width,
+					Antialiasing ? Int(Height * AASize) : Height);
+			CoarseWidth = (Width + CoarseStep - 1) / CoarseStep;
+			Coarse.resize(CoarseWidth *
+				      ((Height + CoarseStep - 1) / CoarseStep));
+			for (Int y = 0; y < Height; y += TileSize)
+				for (Int x = 0; x < Width; x += TileSize) {
+					const Int W = std::min(TileSize, Width - x);
+					const Int H = std::min(TileSize, Height - y);
+					if (!Img.IsFinished(x, y, W, H))
+						CoarseTile(Img, V, x, y, W, H);
 				}
-				C = World::Color(R/AASize/AASize,
-						 G/AASize/AASize,
-						 B/AASize/AASize);
-//				C = World::ColLib::Red();
-				Img.PutPixel(x, y, C);
-			}
+			Img.Refresh();
 		}
 
+		Int Skipped = 0;
+		for (Int y = 0; y < Height; y += TileSize)
+			for (Int x = 0; x < Width; x += TileSize) {
+				const Int W = std::min(TileSize, Width - x);
+				const Int H = std::min(TileSize, Height - y);
+				if (Img.IsFinished(x, y, W, H))
+					Skipped++;
+				else
+					RenderTile(Img, x, y, W, H);
+			}
+		Coarse.clear();
+		if (Skipped > 0)
+			std::cout << "*** Tiles finished before: "
+				  << Skipped << std::endl;
 
+		PrintStats();
+	}
+
+	void Raytracer::PrintStats() const
+	{
 		std::cout << "*** Raytracing Stats ***" << std::endl;
 		std::cout << "*** Rays: Reflected="
 			  << ReflectedRays
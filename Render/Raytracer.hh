@@ -27,6 +27,7 @@
 
 #include "Graphics/Image.hh"
 #include "Graphics/Screen.hh"
+#include "Graphics/CostMap.hh"
 
 /**
  * \brief
@@ -46,9 +47,13 @@ namespace Render {
 	 *
 	 */
 	class Raytracer : public Renderer {
+	protected:
 		/** Scene to be rendered */
 		const World::Scene &Scene;
 
+		/** Camera to render from (scene's one by default) */
+		const World::Camera *Camera;
+
 		/** Anti-aliasing */
 		const Bool Antialiasing;
 
@@ -56,6 +61,28 @@ namespace Render {
 		 *  number of pixels creating one picture-pixel */
 		static const Int AASize;
 
+		/** Image is rendered and submitted in square tiles */
+		static const Int TileSize;
+
+		/** Pixels of the tile being rendered */
+		std::vector<World::Spectrum> TileBuffer;
+
+		/** Edge of blocks shown by the coarse preview pass */
+		static const Int CoarseStep;
+
+		/** Render coarse preview before the full image */
+		Bool Progressive;
+
+		/** Pixels traced by the preview pass, one per
+		 * CoarseStep block; reused by the full pass */
+		std::vector<World::Color> Coarse;
+
+		/** Blocks in one row of Coarse */
+		Int CoarseWidth;
+
+		/** Per-pixel costs are recorded here if set */
+		Graphics::CostMap *Costs;
+
 		/** Max depth to recur during rendering */
 		const Int MaxDepth;
 
@@ -89,6 +116,21 @@ namespace Render {
 			World::Color &Specular);
 
 
+		/**
+		 * Add light not computed by TraceLights (e.g. indirect
+		 * light from photon maps) to the diffuse coefficient.
+		 * Raytracer itself adds nothing.
+		 *
+		 * \param R		Ray which hit the surface
+		 * \param ColPoint	Collision point
+		 * \param Normal	Normal at collision point
+		 * \param Diffuse	Diffuse coefficient to add to
+		 */
+		virtual void Gather(const Ray &R,
+				    const Math::Vector &ColPoint,
+				    const Math::Vector &Normal,
+				    World::Color &Diffuse) {}
+
 		/**
 		 * Trace a ray. Check collisions, create recursively
 		 * shadow rays, reflected rays and refracted rays.
@@ -105,6 +147,25 @@ namespace Render {
 			   const Int Depth,
 			   const Double CurIdx);
 
+		/** Trace all (antialiasing) rays of one pixel
+		 * \return Pixel color (background if nothing was hit)
+		 */
+		World::Color Pixel(const World::Camera::View &V,
+				   Int x, Int y);
+
+		/** Pixel() recording its cost if a cost map is set */
+		World::Color CostedPixel(const World::Camera::View &V,
+					 Int x, Int y);
+
+		/** Trace one pixel per CoarseStep block of a tile
+		 * and fill whole blocks with it */
+		void CoarseTile(Graphics::Drawable &Img,
+				const World::Camera::View &V,
+				Int X, Int Y, Int W, Int H);
+
+		/** Print ray statistics of the last render */
+		void PrintStats() const;
+
 	public:
 		/** Initialize renderer
 		 * \param Scene   scene to be rendered
@@ -115,11 +176,38 @@ namespace Render {
 			  const Bool Antialiasing = true,
 			  const Int MaxDepth = 5);
 
+		/** Render from another camera than the scene's one;
+		 * camera must outlive the renderer */
+		inline void SetCamera(const World::Camera &C) {
+			Camera = &C;
+		}
+
+		/** Show a coarse (1/CoarseStep^2 of rays) preview
+		 * first, then refine it tile by tile */
+		inline void SetProgressive(Bool Enable) {
+			Progressive = Enable;
+		}
+
+		/** Record cost of each rendered pixel into M
+		 * (NULL disables); M must be of the image size */
+		inline void SetCostMap(Graphics::CostMap *M) {
+			Costs = M;
+		}
+
 		/** Renders scene into Image buffer
 		 * \param Img	Drawable object (Screen or Image)
 		 */
 		void Render(Graphics::Drawable &Img);
 
+		/** Renders a part of the image only
+		 * \param Img	Drawable of the whole image size
+		 * \param X	Left column of the part
+		 * \param Y	Top row of the part
+		 * \param W	Width of the part
+		 * \param H	Height of the part
+		 */
+		void RenderTile(Graphics::Drawable &Img,
+				Int X, Int Y, Int W, Int H);
 	};
 };
 
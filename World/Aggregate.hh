@@ -0,0 +1,86 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _AGGREGATE_H_
+#define _AGGREGATE_H_
+
+#include "General/Types.hh"
+#include "Math/Vector.hh"
+#include "Render/Ray.hh"
+#include "World/Object.hh"
+
+namespace World {
+	/**
+	 * \brief
+	 *	Room for an object made up by an aggregate for a hit.
+	 *
+	 * Objects hit inside an aggregate may not exist on their own
+	 * (a triangle of a mesh) or may go away while being shaded
+	 * (a sphere of a dropped region), so the aggregate builds one
+	 * here. The storage belongs to whoever asked for the hit,
+	 * usually on its stack, so the object lives exactly as long
+	 * as the caller keeps it.
+	 */
+	class HitStorage {
+	private:
+		/** Largest object an aggregate may build */
+		enum { SIZE = 64 };
+
+		char Data[SIZE] __attribute__((aligned(16)));
+
+	public:
+		/** Memory for an object of type T */
+		template <typename T> inline void *Get() {
+			/* Fails to compile if T doesn't fit */
+			typedef char Fits[sizeof(T) <= SIZE ? 1 : -1];
+			(void)sizeof(Fits);
+			return Data;
+		}
+	};
+
+	/**
+	 * \brief
+	 *	Group of objects which the scene tests as a whole.
+	 *
+	 * Scene asks aggregates for the nearest hit after its own
+	 * objects; an aggregate finds which of its objects was hit,
+	 * so it may keep them in any structure or even out of memory.
+	 */
+	class Aggregate {
+	public:
+		virtual ~Aggregate() {}
+
+		/**
+		 * Find nearest collision with a contained object.
+		 * \param RayPos	Nearest collision found so far;
+		 *			updated when a nearer one is found
+		 * \param Hit		Where the returned object may be
+		 *			built; left alone if none is hit
+		 * \return Object hit before RayPos or NULL
+		 */
+		virtual const Object *Collide(const Render::Ray &R,
+					      Double &RayPos,
+					      HitStorage &Hit) const = 0;
+
+		/** Get sphere enclosing all contained objects */
+		virtual void Bounds(Math::Vector &Center,
+				    Double &Radius) const = 0;
+
+		/** Could any contained object be specular? */
+		virtual Bool IsSpecular() const {
+			return true;
+		}
+	};
+};
+
+#endif
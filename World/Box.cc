@@ -0,0 +1,129 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#include <string>
+#include <sstream>
+#include <limits>
+#include <cmath>
+
+#include "Math/Abs.hh"
+#include "Math/Slab.hh"
+#include "World/Scene.hh"
+#include "World/Box.hh"
+
+namespace World {
+	Box::Box(const Math::Vector &Center, const Math::Vector &Size,
+		 const Material &M, Bool Visible)
+		: Object(M, Visible), Center(Center), Aligned(true)
+	{
+		for (Int a = 0; a < 3; a++) {
+			Axis[a] = Math::Vector(a == 0, a == 1, a == 2);
+			Corners[1][a] = Math::Abs(Size[a]) / 2.0;
+			Corners[0][a] = -Corners[1][a];
+		}
+	}
+
+	Box::Box(const Math::Vector &Center, const Math::Vector &Size,
+		 const Math::Vector &Dir, const Math::Vector &Top,
+		 const Material &M, Bool Visible)
+		: Object(M, Visible), Center(Center), Aligned(false)
+	{
+		Axis[2] = Math::Vector(Dir).Normalize();
+		Axis[0] = Top.Cross(Axis[2]).Normalize();
+		Axis[1] = Axis[2].Cross(Axis[0]);
+		for (Int a = 0; a < 3; a++) {
+			Corners[1][a] = Math::Abs(Size[a]) / 2.0;
+			Corners[0][a] = -Corners[1][a];
+		}
+	}
+
+	Math::Vector Box::Local(const Math::Vector &Point) const
+	{
+		const Math::Vector P = Point - Center;
+		if (Aligned)
+			return P;
+		return Math::Vector(P.Dot(Axis[0]), P.Dot(Axis[1]),
+				    P.Dot(Axis[2]));
+	}
+
+	Int Box::Face(const Math::Vector &P) const
+	{
+		/* Face the point is relatively nearest to */
+		Int Nearest = 0;
+		Double Best = -1.0;
+		for (Int a = 0; a < 3; a++) {
+			const Double Rel = Corners[1][a] > 0.0
+				? Math::Abs(P[a]) / Corners[1][a] : 1.0;
+			if (Rel > Best) {
+				Best = Rel;
+				Nearest = a;
+			}
+		}
+		return Nearest;
+	}
+
+	Bool Box::Collide(const Render::Ray &R, Double &RayPos) const
+	{
+		const Math::Vector S = Local(R.Start());
+		double O[3], D[3];
+		for (Int a = 0; a < 3; a++) {
+			O[a] = S[a];
+			D[a] = Aligned ? R.Direction()[a]
+				: R.Direction().Dot(Axis[a]);
+		}
+
+		double Near = -std::numeric_limits<double>::max();
+		double Far = std::numeric_limits<double>::max();
+		if (!Math::Slab<double>(O, D).Clip(Corners, Near, Far))
+			return false;
+
+		/* Exit point for rays starting inside */
+		if (Near > NearestCollision)
+			RayPos = Near;
+		else if (Far > NearestCollision)
+			RayPos = Far;
+		else
+			return false;
+		return true;
+	}
+
+	Math::Vector Box::NormalAt(const Math::Vector &Point) const
+	{
+		const Math::Vector P = Local(Point);
+		const Int F = Face(P);
+		if (P[F] < 0.0)
+			return Axis[F] * -1.0;
+		return Axis[F];
+	}
+
+	Math::Point Box::UVAt(const Math::Vector &Point) const
+	{
+		const Math::Vector P = Local(Point);
+		const Int F = Face(P);
+		const Int U = (F + 1) % 3, V = (F + 2) % 3;
+		return Math::Point(P[U] - Corners[0][U], P[V] - Corners[0][V]);
+	}
+
+	std::string Box::Dump() const
+	{
+		std::stringstream s;
+		s << "[Box Center="
+		  << this->Center
+		  << " Size="
+		  << Math::Vector(2.0 * Corners[1][0], 2.0 * Corners[1][1],
+				  2.0 * Corners[1][2])
+		  << " Mat="
+		  << M
+		  << "]";
+		return s.str();
+	}
+};
@@ -0,0 +1,89 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _BOX_H_
+#define _BOX_H_
+
+#include <iostream>
+#include <string>
+#include <cmath>
+
+#include "Math/Vector.hh"
+#include "Render/Ray.hh"
+#include "World/Object.hh"
+
+namespace World {
+	/**
+	 * \brief
+	 *	Box, axis aligned or oriented by three axes.
+	 *
+	 * Rays are moved into box coordinates, where the box
+	 * spans -Half to Half, and clipped by Math::Slab, like
+	 * boxes of acceleration structures. UV coordinates run
+	 * in scene units across each face, as on planes.
+	 */
+	class Box : public Object {
+	protected:
+		/** Box center */
+		Math::Vector Center;
+
+		/** Unit vectors along box edges */
+		Math::Vector Axis[3];
+
+		/** Are Axis the x, y and z axes? */
+		Bool Aligned;
+
+		/** Min and max corner in box coordinates */
+		double Corners[2][3];
+
+		virtual std::string Dump() const;
+
+		/** Point in box coordinates */
+		Math::Vector Local(const Math::Vector &Point) const;
+
+		/** Axis of the face nearest to a point in box
+		 * coordinates */
+		Int Face(const Math::Vector &P) const;
+	public:
+		/** Construct axis aligned box of edge lengths Size */
+		Box(const Math::Vector &Center,
+		    const Math::Vector &Size,
+		    const Material &M = MatLib::Red(),
+		    Bool Visible = true);
+
+		/**
+		 * Construct oriented box; z edge follows Dir, y edge
+		 * lies in the plane of Dir and Top, as on a camera.
+		 * Size gives edge lengths along x, y and z.
+		 */
+		Box(const Math::Vector &Center,
+		    const Math::Vector &Size,
+		    const Math::Vector &Dir,
+		    const Math::Vector &Top,
+		    const Material &M = MatLib::Red(),
+		    Bool Visible = true);
+
+		virtual Bool Collide(const Render::Ray &R, Double &RayPos) const;
+		virtual Math::Vector NormalAt(const Math::Vector &Point) const;
+		virtual Math::Point UVAt(const Math::Vector &Point) const;
+
+		virtual Bool Bounds(Math::Vector &Center, Double &Radius) const {
+			Center = this->Center;
+			Radius = std::sqrt(Corners[1][0] * Corners[1][0]
+					   + Corners[1][1] * Corners[1][1]
+					   + Corners[1][2] * Corners[1][2]);
+			return true;
+		}
+	};
+};
+
+#endif
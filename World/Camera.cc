@@ -11,6 +11,8 @@
  *********************/
 
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <cmath>
 
 #include "General/Types.hh"
@@ -88,6 +90,26 @@ namespace World {
 		return Render::Ray(Pos, Base + Dir);
 	}
 
+	Camera Camera::Parse(const std::string &Desc)
+	{
+		std::stringstream s(Desc);
+		char Comma;
+		Double V[7];
+		V[6] = 45.0;
+		for (Int i = 0; i < 6; i++)
+			if ((i > 0 && !(s >> Comma && Comma == ',')) ||
+			    !(s >> V[i]))
+				throw std::invalid_argument(
+					"Wrong camera: " + Desc);
+		if (s >> Comma && (Comma != ',' || !(s >> V[6]) ||
+				   s >> Comma))
+			throw std::invalid_argument("Wrong camera: " + Desc);
+
+		return Camera(Math::Vector(V[0], V[1], V[2]),
+			      Math::Vector(V[3], V[4], V[5]),
+			      DegreeToFOV(V[6]));
+	}
+
 	std::ostream &operator<<(std::ostream &os, const Camera &C)
 	{
 		os << "[Camera FOV=" << C.FOV << std::endl
@@ -14,6 +14,7 @@
 #define _CAMERA_H_
 
 #include <cmath>
+#include <string>
 
 #include "General/Types.hh"
 #include "Math/Vector.hh"
@@ -105,6 +106,21 @@ namespace World {
 		       Bool AutoTop = true,
 		       const Math::Vector &Top = Math::Vector(0.0, 1.0, 0.0));
 
+		/** Parse "x,y,z,dx,dy,dz[,fov]" (fov in degrees)
+		 * \throw std::invalid_argument on wrong description */
+		static Camera Parse(const std::string &Desc);
+
+		/** Camera position accessor */
+		inline const Math::Vector &GetPosition() const {
+			return Pos;
+		}
+
+		/**@{ Camera accessors */
+		inline const Math::Vector &GetDirection() const { return Dir; }
+		inline const Math::Vector &GetTop() const { return Top; }
+		inline Double GetFOV() const { return FOV; }
+		/*@}*/
+
 		/** Performs few vector calculations and returns object
 		 * which is then used to create rays */
 		View CreateView(Int XRes, Int YRes) const;
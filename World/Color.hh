@@ -54,6 +54,60 @@ namespace World {
 						const Color &C);
 	};
 
+	/**
+	 * \brief
+	 *	Unclamped RGB triple.
+	 *
+	 * Color crops itself into 0.0 - 1.0 after every operation;
+	 * light transport sums (photon power, radiance estimates)
+	 * must not, so they are kept in this type until the
+	 * result is displayed.
+	 */
+	class Spectrum : public Math::Tuple<Double, false, 3> {
+	public:
+		/** Creates zero spectrum */
+		Spectrum() : Math::Tuple<Double, false, 3>()
+		{
+		}
+
+		/** Spectrum of any Double values */
+		Spectrum(Double r, Double g, Double b) {
+			D[0] = r;
+			D[1] = g;
+			D[2] = b;
+		}
+
+		/** Widen color into spectrum */
+		Spectrum(const Color &C) {
+			D[0] = C[0];
+			D[1] = C[1];
+			D[2] = C[2];
+		}
+
+		/** Create spectrum back from Tuple after calculations */
+		Spectrum(const Math::Tuple<Double, false, 3> &T) {
+			D[0] = T[0];
+			D[1] = T[1];
+			D[2] = T[2];
+		}
+
+		/** \return Mean of the three components */
+		inline Double Average() const {
+			return (D[0] + D[1] + D[2]) / 3.0;
+		}
+
+		/** \return Spectrum cropped into a displayable color */
+		inline Color Clamp() const {
+			Double V[3];
+			for (Int i = 0; i < 3; i++) {
+				V[i] = D[i];
+				if (V[i] > 1.0) V[i] = 1.0;
+				if (V[i] < 0.0) V[i] = 0.0;
+			}
+			return Color(V[0], V[1], V[2]);
+		}
+	};
+
 	/**
 	 * \brief
 	 *	Color library
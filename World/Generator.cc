@@ -0,0 +1,425 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+
+#include "General/Random.hh"
+#include "Math/Constants.hh"
+#include "World/Generator.hh"
+#include "World/Texture.hh"
+#include "World/Material.hh"
+#include "World/Sphere.hh"
+#include "World/Plane.hh"
+#include "World/Light.hh"
+
+namespace World {
+	/** Concentric shells of one NESTED group */
+	static const Int ShellCount = 4;
+
+	/** Round to 4 decimal places; printed with std::fixed and
+	 * parsed back such values stay bit-identical */
+	static inline double Round(double V)
+	{
+		return std::floor(V * 10000.0 + 0.5) / 10000.0;
+	}
+
+	/** Normally distributed number (Box-Muller) */
+	static double Gauss(General::Random &Rnd)
+	{
+		const double U = 1.0 - Rnd.Next();
+		const double V = Rnd.Next();
+		return std::sqrt(-2.0 * std::log(U)) * std::cos(2.0 * Math::PI * V);
+	}
+
+	/** Uniformly chosen index below Count */
+	static Int Pick(General::Random &Rnd, Int Count)
+	{
+		const Int I = Int(int(Rnd.Next() * Count));
+		return I < Count ? I : Int(Count - 1);
+	}
+
+	static inline void Set(Double *Out, double X, double Y, double Z)
+	{
+		Out[0] = Round(X);
+		Out[1] = Round(Y);
+		Out[2] = Round(Z);
+	}
+
+	Generator::Config Generator::Defaults()
+	{
+		const Config C = { 1000, 1, 2, 8, 16, UNIFORM, 1, 10.0 };
+		return C;
+	}
+
+	Generator::Config Generator::Parse(const std::string &Spec)
+	{
+		Config C = Defaults();
+		std::istringstream In(Spec);
+		std::string Item;
+		while (std::getline(In, Item, ',')) {
+			const std::string::size_type Eq = Item.find('=');
+			if (Eq == std::string::npos)
+				throw std::invalid_argument(
+					"Generator option without value: " + Item);
+			const std::string Key = Item.substr(0, Eq);
+			std::istringstream Value(Item.substr(Eq + 1));
+
+			if (Key == "layout") {
+				const std::string L = Value.str();
+				if (L == "uniform") C.Distribution = UNIFORM;
+				else if (L == "clustered") C.Distribution = CLUSTERED;
+				else if (L == "nested") C.Distribution = NESTED;
+				else throw std::invalid_argument(
+					"Unknown generator layout: " + L);
+				continue;
+			}
+
+			if (Key == "spheres") Value >> C.Spheres;
+			else if (Key == "planes") Value >> C.Planes;
+			else if (Key == "lights") Value >> C.Lights;
+			else if (Key == "textures") Value >> C.Textures;
+			else if (Key == "materials") Value >> C.Materials;
+			else if (Key == "seed") Value >> C.Seed;
+			else if (Key == "size") Value >> C.Size;
+			else throw std::invalid_argument(
+				"Unknown generator option: " + Key);
+
+			if (Value.fail() || !Value.eof())
+				throw std::invalid_argument(
+					"Wrong generator value: " + Item);
+		}
+		return C;
+	}
+
+	Generator::Generator(const Config &C)
+		: Cfg(C)
+	{
+		if (C.Spheres < 0 || C.Planes < 0 || C.Lights < 0)
+			throw std::invalid_argument(
+				"Generator object counts can't be negative");
+		if (C.Textures < 1 || C.Materials < 1)
+			throw std::invalid_argument(
+				"Generator needs a texture and a material");
+		if (C.Distribution == NESTED && C.Materials < 3)
+			throw std::invalid_argument(
+				"Nested layout needs 3 materials for glass");
+		if (C.Size <= 0.0)
+			throw std::invalid_argument(
+				"Generator scene size must be positive");
+
+		General::Random Rnd(C.Seed);
+		const double S = C.Size;
+
+		/* Checked and plain textures in turn; the floor
+		 * gets the first, checked one */
+		for (Int i = 0; i < C.Textures; i++) {
+			TextureSpec T;
+			T.Checked = (i % 2 == 0);
+			Set(T.A, Rnd.Next(), Rnd.Next(), Rnd.Next());
+			Set(T.B, Rnd.Next(), Rnd.Next(), Rnd.Next());
+			T.Size = Round(0.5 + 1.5 * Rnd.Next());
+			Textures.push_back(T);
+		}
+
+		/* Diffuse, mirror and glass materials in turn; glass
+		 * alternates refractive index so nested shells refract
+		 * at every boundary */
+		for (Int i = 0; i < C.Materials; i++) {
+			MaterialSpec M;
+			M.Type = Kind(int(i % 3));
+			M.Texture = i % C.Textures;
+			M.Shininess = Round(5.0 + 25.0 * Rnd.Next());
+			M.Index = 1.0;
+			if (M.Type == GLASS) {
+				M.Index = Glass.size() % 2 ? MatLib::IdxWater
+					: MatLib::IdxGlass;
+				Glass.push_back(i);
+			}
+			Materials.push_back(M);
+		}
+
+		/* Spheres of the same volume fraction whatever count */
+		const double Radius =
+			S * 0.5 / std::pow(std::max(1.0, double(C.Spheres)),
+					   1.0 / 3.0);
+		const Int Clusters = Int(std::max(1, int(std::pow(
+			double(C.Spheres), 1.0 / 3.0))));
+		std::vector<Math::Vector> Centers;
+		if (C.Distribution == CLUSTERED)
+			for (Int i = 0; i < Clusters; i++)
+				Centers.push_back(Math::Vector(
+					(Rnd.Next() - 0.5) * 2.0 * S,
+					Rnd.Next() * S,
+					Rnd.Next() * 2.0 * S));
+
+		for (Int i = 0; i < C.Spheres; i++) {
+			ObjectSpec O;
+			O.Material = Pick(Rnd, C.Materials);
+			switch (C.Distribution) {
+			case UNIFORM:
+				O.Scalar = Round(Radius * (0.5 + 0.5 * Rnd.Next()));
+				Set(O.V, (Rnd.Next() - 0.5) * 2.0 * S,
+				    O.Scalar + Rnd.Next() * S,
+				    Rnd.Next() * 2.0 * S);
+				break;
+
+			case CLUSTERED: {
+				const Math::Vector &Ctr = Centers[i % Clusters];
+				const double Spread = S * 0.1;
+				O.Scalar = Round(Radius * 0.25
+						 * (0.5 + 0.5 * Rnd.Next()));
+				const double X = Ctr[0] + Gauss(Rnd) * Spread;
+				const double Y = Ctr[1] + Gauss(Rnd) * Spread;
+				const double Z = Ctr[2] + Gauss(Rnd) * Spread;
+				Set(O.V, X, std::max(Y, double(O.Scalar)), Z);
+				break;
+			}
+
+			case NESTED: {
+				/* Group of shells shares the center and
+				 * the outer radius of the first shell */
+				const Int Shell = i % ShellCount;
+				if (Shell == 0) {
+					O.Scalar = Round(Radius * ShellCount * 0.5);
+					Set(O.V, (Rnd.Next() - 0.5) * 2.0 * S,
+					    O.Scalar + Rnd.Next() * S,
+					    Rnd.Next() * 2.0 * S);
+				} else {
+					const ObjectSpec &Outer =
+						Spheres[i - Shell];
+					O.V[0] = Outer.V[0];
+					O.V[1] = Outer.V[1];
+					O.V[2] = Outer.V[2];
+					O.Scalar = Round(Outer.Scalar
+							 * (ShellCount - Shell)
+							 / ShellCount);
+				}
+				/* Innermost sphere keeps its random
+				 * material */
+				if (Shell < ShellCount - 1)
+					O.Material = Glass[Shell % Glass.size()];
+				break;
+			}
+			}
+			Spheres.push_back(O);
+		}
+
+		/* Floor, then tilted floors facing the scene center at
+		 * a distance which keeps the camera and lights inside;
+		 * shadow rays don't stop at lights, so no plane may
+		 * hang above the scene */
+		const Math::Vector Center(0.0, S * 0.5, S);
+		for (Int i = 0; i < C.Planes; i++) {
+			ObjectSpec O;
+			O.Material = 0;
+			if (i == 0) {
+				Set(O.V, 0.0, 1.0, 0.0);
+				O.Scalar = 0.0;
+			} else {
+				Math::Vector N(Gauss(Rnd),
+					       1.0 + std::fabs(Gauss(Rnd)),
+					       Gauss(Rnd));
+				N.Normalize();
+				Set(O.V, N[0], N[1], N[2]);
+				const Math::Vector Normal(O.V[0], O.V[1], O.V[2]);
+				O.Scalar = Round(Normal.Dot(Center) - 4.0 * S);
+				/* Walls get diffuse materials only; glass
+				 * ones would hide the whole scene */
+				O.Material = 3 * Pick(Rnd, (C.Materials + 2) / 3);
+			}
+			Planes.push_back(O);
+		}
+
+		/* Lights above the scene; many lights are dimmer */
+		const double Power = std::min(1.0, 1.5 / std::max(1, int(C.Lights)));
+		for (Int i = 0; i < C.Lights; i++) {
+			LightSpec L;
+			Set(L.Position, (Rnd.Next() - 0.5) * 2.0 * S,
+			    (2.0 + Rnd.Next()) * S,
+			    (Rnd.Next() * 3.0 - 1.0) * S);
+			Set(L.C, Power * (0.7 + 0.3 * Rnd.Next()),
+			    Power * (0.7 + 0.3 * Rnd.Next()),
+			    Power * (0.7 + 0.3 * Rnd.Next()));
+			Lights.push_back(L);
+		}
+	}
+
+	Camera Generator::GetCamera() const
+	{
+		const double S = Cfg.Size;
+		return Camera(Math::Vector(0.0, Round(S), Round(-1.8 * S)),
+			      Math::Vector(0.0, -0.4, 1.0));
+	}
+
+	void Generator::Build(Scene &S) const
+	{
+		std::vector<const Texture *> Tex;
+		for (UInt i = 0; i < Textures.size(); i++) {
+			const TextureSpec &T = Textures[i];
+			const Color A(T.A[0], T.A[1], T.A[2]);
+			Texture *New;
+			if (T.Checked)
+				New = new (S.GetArena()) TexLib::Checked(
+					A, Color(T.B[0], T.B[1], T.B[2]),
+					T.Size, T.Size);
+			else
+				New = new (S.GetArena()) TexLib::Plain(A);
+			S.AddTexture(New, Scene::ARENA);
+			Tex.push_back(New);
+		}
+
+		std::vector<const Material *> Mat;
+		for (UInt i = 0; i < Materials.size(); i++) {
+			const MaterialSpec &M = Materials[i];
+			const Texture &Diffuse = M.Type == GLASS
+				? TexLib::Black() : *Tex[M.Texture];
+			const Texture &Reflect = M.Type == MIRROR
+				? TexLib::Gray() : TexLib::Black();
+			const Texture &Refract = M.Type == GLASS
+				? TexLib::White() : TexLib::Black();
+			/* Same arguments as materials read from XML */
+			Material *New = new (S.GetArena()) Material(
+				Diffuse, TexLib::White(), Refract, Reflect,
+				0.0, 0.0, 0.0, M.Shininess, M.Index);
+			S.AddMaterial(New, Scene::ARENA);
+			Mat.push_back(New);
+		}
+
+		for (UInt i = 0; i < Spheres.size(); i++) {
+			const ObjectSpec &O = Spheres[i];
+			S.AddObject(new (S.GetArena()) Sphere(
+				Math::Vector(O.V[0], O.V[1], O.V[2]),
+				O.Scalar, *Mat[O.Material]), Scene::ARENA);
+		}
+
+		for (UInt i = 0; i < Planes.size(); i++) {
+			const ObjectSpec &O = Planes[i];
+			S.AddObject(new (S.GetArena()) Plane(
+				Math::Vector(O.V[0], O.V[1], O.V[2]),
+				O.Scalar, *Mat[O.Material]), Scene::ARENA);
+		}
+
+		for (UInt i = 0; i < Lights.size(); i++) {
+			const LightSpec &L = Lights[i];
+			S.AddLight(new (S.GetArena()) PointLight(
+				Math::Vector(L.Position[0], L.Position[1],
+					     L.Position[2]),
+				Color(L.C[0], L.C[1], L.C[2])), Scene::ARENA);
+		}
+		S.AddLight(new (S.GetArena()) AmbientLight(Color(0.1, 0.1, 0.1)),
+			   Scene::ARENA);
+	}
+
+	/** Attributes of vector or color tag */
+	static void Attrs(std::ostream &Out, const char *Names,
+			  const Double *V)
+	{
+		for (Int i = 0; i < 3; i++)
+			Out << " " << Names[i] << "=\"" << V[i] << "\"";
+	}
+
+	void Generator::WriteXML(std::ostream &Out) const
+	{
+		static const char *KindNames[] = { "diffuse", "mirror", "glass" };
+		const std::ios::fmtflags Flags = Out.flags();
+		const std::streamsize Precision = Out.precision();
+		Out << std::fixed << std::setprecision(4);
+
+		const Camera C = GetCamera();
+		const Double Pos[3] = { 0.0, C.GetPosition()[1],
+					C.GetPosition()[2] };
+		const Double Dir[3] = { 0.0, -0.4, 1.0 };
+
+		Out << "<?xml version=\"1.0\"?>" << std::endl
+		    << "<!-- Generated scene: " << Spheres.size() << " spheres, "
+		    << Planes.size() << " planes, " << Lights.size()
+		    << " lights, seed " << Cfg.Seed << " -->" << std::endl
+		    << "<Scene>" << std::endl
+		    << "  <Camera FOV=\"45\">" << std::endl
+		    << "    <Pos"; Attrs(Out, "xyz", Pos); Out << " />" << std::endl
+		    << "    <Dir"; Attrs(Out, "xyz", Dir); Out << " />" << std::endl
+		    << "  </Camera>" << std::endl;
+
+		for (UInt i = 0; i < Textures.size(); i++) {
+			const TextureSpec &T = Textures[i];
+			Out << "  <Texture id=\"Tex" << i << "\"";
+			if (T.Checked)
+				Out << " type=\"Checked\" width=\"" << T.Size
+				    << "\" height=\"" << T.Size << "\">";
+			else
+				Out << " type=\"Plain\">";
+			Out << std::endl << "    <Color";
+			Attrs(Out, "rgb", T.A);
+			Out << " />" << std::endl;
+			if (T.Checked) {
+				Out << "    <Color";
+				Attrs(Out, "rgb", T.B);
+				Out << " />" << std::endl;
+			}
+			Out << "  </Texture>" << std::endl;
+		}
+
+		for (UInt i = 0; i < Materials.size(); i++) {
+			const MaterialSpec &M = Materials[i];
+			Out << "  <!-- " << KindNames[M.Type] << " -->" << std::endl
+			    << "  <Material id=\"Mat" << i << "\" diffuse=\"";
+			if (M.Type == GLASS)
+				Out << "Black";
+			else
+				Out << "Tex" << M.Texture;
+			Out << "\" specular=\"White\" reflect=\""
+			    << (M.Type == MIRROR ? "Gray" : "Black")
+			    << "\" refract=\""
+			    << (M.Type == GLASS ? "White" : "Black")
+			    << "\" shininess=\"" << M.Shininess
+			    << "\" idx=\"" << M.Index << "\" />" << std::endl;
+		}
+
+		for (UInt i = 0; i < Spheres.size(); i++) {
+			const ObjectSpec &O = Spheres[i];
+			Out << "  <Sphere radius=\"" << O.Scalar << "\">"
+			    << "<Position"; Attrs(Out, "xyz", O.V);
+			Out << " /><Material id=\"Mat" << O.Material << "\" />"
+			    << "</Sphere>" << std::endl;
+		}
+
+		for (UInt i = 0; i < Planes.size(); i++) {
+			const ObjectSpec &O = Planes[i];
+			Out << "  <Plane distance=\"" << O.Scalar << "\">"
+			    << "<Material id=\"Mat" << O.Material << "\" />"
+			    << "<Normal"; Attrs(Out, "xyz", O.V);
+			Out << " /></Plane>" << std::endl;
+		}
+
+		for (UInt i = 0; i < Lights.size(); i++) {
+			const LightSpec &L = Lights[i];
+			Out << "  <Light type=\"Point\">" << std::endl
+			    << "    <Position"; Attrs(Out, "xyz", L.Position);
+			Out << " />" << std::endl << "    <Color";
+			Attrs(Out, "rgb", L.C);
+			Out << " />" << std::endl << "  </Light>" << std::endl;
+		}
+
+		Out << "  <Light type=\"Ambient\">" << std::endl
+		    << "    <Color r=\"0.1\" g=\"0.1\" b=\"0.1\" />" << std::endl
+		    << "  </Light>" << std::endl
+		    << "</Scene>" << std::endl;
+
+		Out.flags(Flags);
+		Out.precision(Precision);
+	}
+};
@@ -0,0 +1,131 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _GENERATOR_H_
+#define _GENERATOR_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "General/Types.hh"
+#include "Math/Vector.hh"
+#include "World/Color.hh"
+#include "World/Camera.hh"
+#include "World/Scene.hh"
+
+namespace World {
+
+	/**
+	 * \brief
+	 *	Procedural scenes of any size for scaling tests.
+	 *
+	 * Whole scene is drawn from a seeded generator in the
+	 * constructor, so the same Config always gives the same scene.
+	 * It can then be built directly into a Scene or written as
+	 * XML; both give identical scenes since all generated numbers
+	 * are rounded to values XML keeps exactly.
+	 */
+	class Generator {
+	public:
+		/** How spheres are placed */
+		enum Layout {
+			UNIFORM,	/**< Spread evenly over the scene box */
+			CLUSTERED,	/**< Dense gaussian clusters */
+			NESTED		/**< Concentric glass shells */
+		};
+
+		/** \brief Generated scene description */
+		struct Config {
+			Int Spheres;
+			Int Planes;
+			Int Lights;	/**< Point lights; ambient is always added */
+			Int Textures;
+			Int Materials;
+			Layout Distribution;
+			UInt Seed;
+			Double Size;	/**< Half width of the scene box */
+		};
+
+		/** \return Default configuration */
+		static Config Defaults();
+
+		/**
+		 * Parse "key=value,..." description; keys are spheres,
+		 * planes, lights, textures, materials, layout
+		 * (uniform|clustered|nested), seed and size. Missing
+		 * keys keep default values.
+		 * \throw std::invalid_argument on wrong description
+		 */
+		static Config Parse(const std::string &Spec);
+
+		/** Generate scene
+		 * \throw std::invalid_argument on wrong counts */
+		Generator(const Config &C);
+
+		/** \return Camera looking at the whole scene */
+		Camera GetCamera() const;
+
+		/** Add generated textures, materials, objects and
+		 * lights to S */
+		void Build(Scene &S) const;
+
+		/** Write generated scene as XML document */
+		void WriteXML(std::ostream &Out) const;
+
+	private:
+		/** \brief Plain or checked texture */
+		struct TextureSpec {
+			Bool Checked;
+			Double A[3], B[3];
+			Double Size;
+		};
+
+		/** \brief Material kinds */
+		enum Kind { DIFFUSE, MIRROR, GLASS };
+
+		/** \brief Material; diffuse color comes from a texture */
+		struct MaterialSpec {
+			Kind Type;
+			Int Texture;
+			Double Shininess;
+			Double Index;
+		};
+
+		/** \brief Sphere or plane with a material index */
+		struct ObjectSpec {
+			Double V[3];	/**< Center or normal */
+			Double Scalar;	/**< Radius or distance */
+			Int Material;
+		};
+
+		/** \brief Point light */
+		struct LightSpec {
+			Double Position[3];
+			Double C[3];
+		};
+
+		const Config Cfg;
+
+		std::vector<TextureSpec> Textures;
+		std::vector<MaterialSpec> Materials;
+		std::vector<ObjectSpec> Spheres;
+		std::vector<ObjectSpec> Planes;
+		std::vector<LightSpec> Lights;
+
+		/** Indices of glass materials */
+		std::vector<Int> Glass;
+	};
+};
+
+#endif
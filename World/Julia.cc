@@ -0,0 +1,288 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#include <string>
+#include <sstream>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Math/Constants.hh"
+#include "World/Scene.hh"
+#include "World/Julia.hh"
+
+namespace World {
+	QuaternionJulia::Config::Config()
+		: Slice(0.0), Iterations(10), Epsilon(0.0001),
+		  Bailout(20.0), MaxSteps(256)
+	{
+		C[0] = -1.0;
+		C[1] = -0.2;
+		C[2] = C[3] = 0.0;
+	}
+
+	QuaternionJulia::QuaternionJulia(const Math::Vector &Center,
+					 Double Scale, const Config &Cfg,
+					 const Material &M, Bool Visible)
+		: Object(M, Visible), Center(Center), Scale(Scale), Cfg(Cfg)
+	{
+		/* |z|^2 - |z| > |c| makes |z^2 + c| > |z|, so orbits
+		 * starting beyond the root of it escape */
+		const Double C = std::sqrt(Cfg.C[0] * Cfg.C[0]
+					   + Cfg.C[1] * Cfg.C[1]
+					   + Cfg.C[2] * Cfg.C[2]
+					   + Cfg.C[3] * Cfg.C[3]);
+		Radius = (1.0 + std::sqrt(1.0 + 4.0 * C)) / 2.0;
+	}
+
+	Double QuaternionJulia::Distance(const double P[3]) const
+	{
+		/* z and its derivative z' = 2 z z', z'_0 = 1 */
+		double Len2, DLen2;
+#ifdef __SSE2__
+		/* Quaternions as (x, y) and (z, w) pairs; the lower
+		 * lane carries the sign flips of the products */
+		const __m128d Lo = _mm_set_sd(-0.0);
+		const __m128d Hi = _mm_set_pd(-0.0, 0.0);
+		const __m128d Both = _mm_set1_pd(-0.0);
+		const __m128d CXY = _mm_set_pd(Cfg.C[1], Cfg.C[0]);
+		const __m128d CZW = _mm_set_pd(Cfg.C[3], Cfg.C[2]);
+		__m128d XY = _mm_set_pd(P[1], P[0]);
+		__m128d ZW = _mm_set_pd(Cfg.Slice, P[2]);
+		__m128d DXY = _mm_set_sd(1.0);
+		__m128d DZW = _mm_setzero_pd();
+		__m128d L = _mm_add_pd(_mm_mul_pd(XY, XY), _mm_mul_pd(ZW, ZW));
+		L = _mm_add_sd(L, _mm_unpackhi_pd(L, L));
+		for (Int i = 0; i < Cfg.Iterations
+			     && _mm_cvtsd_f64(L) <= Cfg.Bailout; i++) {
+			const __m128d X = _mm_unpacklo_pd(XY, XY);
+			const __m128d Y = _mm_unpackhi_pd(XY, XY);
+			const __m128d Z = _mm_unpacklo_pd(ZW, ZW);
+			const __m128d W = _mm_unpackhi_pd(ZW, ZW);
+			const __m128d SXY = _mm_shuffle_pd(DXY, DXY, 1);
+			const __m128d SZW = _mm_shuffle_pd(DZW, DZW, 1);
+
+			/* (x dx - y dy - z dz - w dw,
+			 *  x dy + y dx + z dw - w dz) */
+			__m128d N = _mm_mul_pd(X, DXY);
+			N = _mm_add_pd(N, _mm_mul_pd(Y, _mm_xor_pd(SXY, Lo)));
+			N = _mm_add_pd(N, _mm_mul_pd(Z, _mm_xor_pd(DZW, Lo)));
+			N = _mm_add_pd(N, _mm_mul_pd(W, _mm_xor_pd(SZW, Both)));
+			/* (x dz - y dw + z dx + w dy,
+			 *  x dw + y dz - z dy + w dx) */
+			__m128d M = _mm_mul_pd(X, DZW);
+			M = _mm_add_pd(M, _mm_mul_pd(Y, _mm_xor_pd(SZW, Lo)));
+			M = _mm_add_pd(M, _mm_mul_pd(Z, _mm_xor_pd(DXY, Hi)));
+			M = _mm_add_pd(M, _mm_mul_pd(W, SXY));
+			DXY = _mm_add_pd(N, N);
+			DZW = _mm_add_pd(M, M);
+
+			/* x^2 - y^2 - z^2 - w^2 = 2 x^2 - |z|^2 */
+			const __m128d X2 = _mm_add_pd(X, X);
+			XY = _mm_add_pd(_mm_sub_sd(_mm_mul_pd(X2, XY), L), CXY);
+			ZW = _mm_add_pd(_mm_mul_pd(X2, ZW), CZW);
+			L = _mm_add_pd(_mm_mul_pd(XY, XY), _mm_mul_pd(ZW, ZW));
+			L = _mm_add_sd(L, _mm_unpackhi_pd(L, L));
+		}
+		__m128d DL = _mm_add_pd(_mm_mul_pd(DXY, DXY),
+					_mm_mul_pd(DZW, DZW));
+		DL = _mm_add_sd(DL, _mm_unpackhi_pd(DL, DL));
+		Len2 = _mm_cvtsd_f64(L);
+		DLen2 = _mm_cvtsd_f64(DL);
+#else
+		double X = P[0], Y = P[1], Z = P[2], W = Cfg.Slice;
+		double DX = 1.0, DY = 0.0, DZ = 0.0, DW = 0.0;
+		Len2 = X * X + Y * Y + Z * Z + W * W;
+		for (Int i = 0; i < Cfg.Iterations && Len2 <= Cfg.Bailout; i++) {
+			const double NDX = 2.0 * (X * DX - Y * DY - Z * DZ - W * DW);
+			const double NDY = 2.0 * (X * DY + Y * DX + Z * DW - W * DZ);
+			const double NDZ = 2.0 * (X * DZ - Y * DW + Z * DX + W * DY);
+			const double NDW = 2.0 * (X * DW + Y * DZ - Z * DY + W * DX);
+			DX = NDX; DY = NDY; DZ = NDZ; DW = NDW;
+
+			const double NX = X * X - Y * Y - Z * Z - W * W + Cfg.C[0];
+			Y = 2.0 * X * Y + Cfg.C[1];
+			Z = 2.0 * X * Z + Cfg.C[2];
+			W = 2.0 * X * W + Cfg.C[3];
+			X = NX;
+			Len2 = X * X + Y * Y + Z * Z + W * W;
+		}
+		DLen2 = DX * DX + DY * DY + DZ * DZ + DW * DW;
+#endif
+
+		const double Len = std::sqrt(Len2);
+		const double DLen = std::sqrt(DLen2);
+		if (Len <= 0.0 || DLen <= 0.0)
+			return 0.0;
+		return 0.5 * Len * std::log(Len) / DLen;
+	}
+
+	void QuaternionJulia::Potentials(const double P[][3], Int Count,
+					 double *G) const
+	{
+		Int k = 0;
+#ifdef __SSE2__
+		/* Two orbits per register; escaped lanes stop changing */
+		const __m128d Two = _mm_set1_pd(2.0);
+		const __m128d Half = _mm_set1_pd(0.5);
+		const __m128d Bail = _mm_set1_pd(Cfg.Bailout);
+		const __m128d CX = _mm_set1_pd(Cfg.C[0]);
+		const __m128d CY = _mm_set1_pd(Cfg.C[1]);
+		const __m128d CZ = _mm_set1_pd(Cfg.C[2]);
+		const __m128d CW = _mm_set1_pd(Cfg.C[3]);
+		for (; k + 2 <= Count; k += 2) {
+			__m128d X = _mm_set_pd(P[k + 1][0], P[k][0]);
+			__m128d Y = _mm_set_pd(P[k + 1][1], P[k][1]);
+			__m128d Z = _mm_set_pd(P[k + 1][2], P[k][2]);
+			__m128d W = _mm_set1_pd(Cfg.Slice);
+			__m128d Weight = _mm_set1_pd(1.0);
+			for (Int i = 0; i < Cfg.Iterations; i++) {
+				const __m128d Len2 = _mm_add_pd(
+					_mm_add_pd(_mm_mul_pd(X, X), _mm_mul_pd(Y, Y)),
+					_mm_add_pd(_mm_mul_pd(Z, Z), _mm_mul_pd(W, W)));
+				const __m128d Active = _mm_cmple_pd(Len2, Bail);
+				if (_mm_movemask_pd(Active) == 0)
+					break;
+
+				const __m128d X2 = _mm_mul_pd(Two, X);
+				const __m128d NX = _mm_add_pd(_mm_sub_pd(
+					_mm_mul_pd(X, X), _mm_add_pd(
+						_mm_mul_pd(Y, Y), _mm_add_pd(
+							_mm_mul_pd(Z, Z),
+							_mm_mul_pd(W, W)))), CX);
+				const __m128d NY = _mm_add_pd(_mm_mul_pd(X2, Y), CY);
+				const __m128d NZ = _mm_add_pd(_mm_mul_pd(X2, Z), CZ);
+				const __m128d NW = _mm_add_pd(_mm_mul_pd(X2, W), CW);
+				X = _mm_or_pd(_mm_and_pd(Active, NX),
+					      _mm_andnot_pd(Active, X));
+				Y = _mm_or_pd(_mm_and_pd(Active, NY),
+					      _mm_andnot_pd(Active, Y));
+				Z = _mm_or_pd(_mm_and_pd(Active, NZ),
+					      _mm_andnot_pd(Active, Z));
+				W = _mm_or_pd(_mm_and_pd(Active, NW),
+					      _mm_andnot_pd(Active, W));
+				Weight = _mm_or_pd(
+					_mm_and_pd(Active, _mm_mul_pd(Weight, Half)),
+					_mm_andnot_pd(Active, Weight));
+			}
+
+			double Len2[2], Wt[2];
+			_mm_storeu_pd(Len2, _mm_add_pd(
+				_mm_add_pd(_mm_mul_pd(X, X), _mm_mul_pd(Y, Y)),
+				_mm_add_pd(_mm_mul_pd(Z, Z), _mm_mul_pd(W, W))));
+			_mm_storeu_pd(Wt, Weight);
+			for (Int l = 0; l < 2; l++)
+				G[k + l] = 0.5 * Wt[l] * std::log(Len2[l]);
+		}
+#endif
+		for (; k < Count; k++) {
+			double X = P[k][0], Y = P[k][1], Z = P[k][2];
+			double W = Cfg.Slice, Weight = 1.0;
+			double Len2 = X * X + Y * Y + Z * Z + W * W;
+			for (Int i = 0; i < Cfg.Iterations && Len2 <= Cfg.Bailout;
+			     i++) {
+				const double NX = X * X - Y * Y - Z * Z - W * W
+					+ Cfg.C[0];
+				Y = 2.0 * X * Y + Cfg.C[1];
+				Z = 2.0 * X * Z + Cfg.C[2];
+				W = 2.0 * X * W + Cfg.C[3];
+				X = NX;
+				Weight *= 0.5;
+				Len2 = X * X + Y * Y + Z * Z + W * W;
+			}
+			G[k] = 0.5 * Weight * std::log(Len2);
+		}
+	}
+
+	Bool QuaternionJulia::Collide(const Render::Ray &R,
+				      Double &RayPos) const
+	{
+		/* Ray in set coordinates keeps its parameter */
+		const Math::Vector O = (R.Start() - Center) / Scale;
+		const Math::Vector D = R.Direction() / Scale;
+
+		/* Part of the ray inside the bounding sphere */
+		const Double A = D.Dot(D);
+		const Double B = O.Dot(D);
+		const Double Disc = B * B - A * (O.Dot(O) - Radius * Radius);
+		if (Disc <= 0.0)
+			return false;
+		const Double Root = std::sqrt(Disc);
+		const Double Exit = (-B + Root) / A;
+		if (Exit <= NearestCollision)
+			return false;
+		Double T = (-B - Root) / A;
+		if (T < NearestCollision)
+			T = NearestCollision;
+
+		const Double Step = 1.0 / std::sqrt(A);
+		for (Int s = 0; s < Cfg.MaxSteps && T < Exit; s++) {
+			const double P[3] = {
+				O[0] + T * D[0], O[1] + T * D[1], O[2] + T * D[2]
+			};
+			const Double Dist = Distance(P);
+			if (Dist < Cfg.Epsilon) {
+				RayPos = T;
+				return true;
+			}
+			T += Dist * Step;
+		}
+		return false;
+	}
+
+	Math::Vector QuaternionJulia::NormalAt(const Math::Vector &Point) const
+	{
+		const Math::Vector P = (Point - Center) / Scale;
+		const Double Delta = Cfg.Epsilon;
+		double Samples[6][3];
+		for (Int s = 0; s < 6; s++) {
+			for (Int a = 0; a < 3; a++)
+				Samples[s][a] = P[a];
+			Samples[s][s / 2] += s % 2 ? -Delta : Delta;
+		}
+
+		double G[6];
+		Potentials(Samples, 6, G);
+		Math::Vector N(G[0] - G[1], G[2] - G[3], G[4] - G[5]);
+		if (N.SquareLength() == 0.0)
+			return (Point - Center).Normalize();
+		return N.Normalize();
+	}
+
+	Math::Point QuaternionJulia::UVAt(const Math::Vector &Point) const
+	{
+		/* Spherical coordinates around the center */
+		const Math::Vector P = Point - Center;
+		const Double Len = P.Length();
+		if (Len == 0.0)
+			return Math::Point(0.0, 0.0);
+		const Double U = std::atan2(P[2], P[0]) / (2.0 * Math::PI) + 0.5;
+		const Double V = std::acos(P[1] / Len) / Math::PI;
+		return Math::Point(U, V);
+	}
+
+	std::string QuaternionJulia::Dump() const
+	{
+		std::stringstream s;
+		s << "[QuaternionJulia Center="
+		  << this->Center
+		  << " Scale=" << Scale
+		  << " C=(" << Cfg.C[0] << ", " << Cfg.C[1] << ", "
+		  << Cfg.C[2] << ", " << Cfg.C[3] << ")"
+		  << " Mat="
+		  << M
+		  << "]";
+		return s.str();
+	}
+};
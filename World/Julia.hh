@@ -0,0 +1,100 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _JULIA_H_
+#define _JULIA_H_
+
+#include <iostream>
+#include <string>
+
+#include "Math/Vector.hh"
+#include "Render/Ray.hh"
+#include "World/Object.hh"
+
+namespace World {
+	/**
+	 * \brief
+	 *	Three dimensional slice of a quaternion Julia set,
+	 *	z -> z^2 + c; port of Tiny4D's Julia module.
+	 *
+	 * Surface is found by sphere tracing: each step moves the
+	 * ray by the distance estimate 0.5 |z| log|z| / |z'|, until
+	 * it is below Epsilon or the ray leaves the sphere all
+	 * escaping orbits start outside of. Normals are gradients of
+	 * the potential log|z_n| / 2^n; their six samples iterate
+	 * together, two per SSE2 register.
+	 *
+	 * Coordinates of the set are scaled by Scale and moved to
+	 * Center; Epsilon is measured before scaling.
+	 */
+	class QuaternionJulia : public Object {
+	public:
+		/** \brief Set and tracing parameters */
+		struct Config {
+			/** Constant c: real part and i, j, k */
+			Double C[4];
+			/** k coordinate of the rendered slice */
+			Double Slice;
+			/** Iterations per distance estimate */
+			Int Iterations;
+			/** Distance considered a hit */
+			Double Epsilon;
+			/** Orbit escapes when |z|^2 exceeds it */
+			Double Bailout;
+			/** Tracing steps before giving up on a ray */
+			Int MaxSteps;
+
+			/** Defaults of Tiny4D, with more iterations */
+			Config();
+		};
+
+	protected:
+		/** Set center in the scene */
+		Math::Vector Center;
+
+		/** Scene units per set unit */
+		Double Scale;
+
+		const Config Cfg;
+
+		/** Radius no orbit returns from; bounds the set */
+		Double Radius;
+
+		virtual std::string Dump() const;
+
+		/** Distance estimate from point in set coordinates */
+		Double Distance(const double P[3]) const;
+
+		/** Potential log|z_n| / 2^n of Count points; pairs are
+		 * iterated in lockstep */
+		void Potentials(const double P[][3], Int Count,
+				double *G) const;
+	public:
+		QuaternionJulia(const Math::Vector &Center,
+				Double Scale,
+				const Config &Cfg = Config(),
+				const Material &M = MatLib::Red(),
+				Bool Visible = true);
+
+		virtual Bool Collide(const Render::Ray &R, Double &RayPos) const;
+		virtual Math::Vector NormalAt(const Math::Vector &Point) const;
+		virtual Math::Point UVAt(const Math::Vector &Point) const;
+
+		virtual Bool Bounds(Math::Vector &Center, Double &Radius) const {
+			Center = this->Center;
+			Radius = this->Radius * Scale;
+			return true;
+		}
+	};
+};
+
+#endif
@@ -97,6 +97,13 @@ namespace World {
 			}
 		}
 
+		/** Does material reflect or refract light specularly?
+		 * Such materials focus photons into caustics. */
+		inline Bool IsSpecular() const
+		{
+			return !Reflect.IsBlack() || !Refract.IsBlack();
+		}
+
 		/** Get color of one material at given point */
 		inline Color GetColor(Filter f, const Math::Point &UV) const
 		{
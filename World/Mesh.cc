@@ -0,0 +1,658 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "General/Interner.hh"
+#include "General/MappedFile.hh"
+#include "Math/Slab.hh"
+#include "World/Scene.hh"
+#include "World/Mesh.hh"
+
+namespace World {
+	/** Vertex of triangle as a vector */
+	static inline Math::Vector Vertex(const std::vector<float> &P,
+					  uint32_t V)
+	{
+		return Math::Vector(P[3 * V], P[3 * V + 1], P[3 * V + 2]);
+	}
+
+	Triangle::Triangle(const TriangleMesh &Mesh, uint32_t Index)
+		: Object(Mesh.M), Mesh(Mesh), Index(Index)
+	{
+	}
+
+	Bool Triangle::Collide(const Render::Ray &R, Double &RayPos) const
+	{
+		/* Moller-Trumbore; Mesh.Leaf() does the same in floats */
+		const uint32_t *I = &Mesh.Indices[3 * Index];
+		const Math::Vector V0 = Vertex(Mesh.Positions, I[0]);
+		const Math::Vector E1 = Vertex(Mesh.Positions, I[1]) - V0;
+		const Math::Vector E2 = Vertex(Mesh.Positions, I[2]) - V0;
+		const Math::Vector P = R.Direction().Cross(E2);
+		const Double Det = E1.Dot(P);
+		if (Det == 0.0)
+			return false;
+		const Double Inv = 1.0 / Det;
+		const Math::Vector S = R.Start() - V0;
+		const Double U = S.Dot(P) * Inv;
+		if (U < 0.0 || U > 1.0)
+			return false;
+		const Math::Vector Q = S.Cross(E1);
+		const Double V = R.Direction().Dot(Q) * Inv;
+		if (V < 0.0 || U + V > 1.0)
+			return false;
+		const Double T = E2.Dot(Q) * Inv;
+		if (T <= NearestCollision)
+			return false;
+		RayPos = T;
+		return true;
+	}
+
+	void Triangle::Barycentric(const Math::Vector &Point,
+				   Double &B1, Double &B2) const
+	{
+		const uint32_t *I = &Mesh.Indices[3 * Index];
+		const Math::Vector V0 = Vertex(Mesh.Positions, I[0]);
+		const Math::Vector E1 = Vertex(Mesh.Positions, I[1]) - V0;
+		const Math::Vector E2 = Vertex(Mesh.Positions, I[2]) - V0;
+		const Math::Vector P = Point - V0;
+		const Double D00 = E1.Dot(E1), D01 = E1.Dot(E2), D11 = E2.Dot(E2);
+		const Double D20 = P.Dot(E1), D21 = P.Dot(E2);
+		const Double Den = D00 * D11 - D01 * D01;
+		if (Den == 0.0) {
+			B1 = B2 = 0.0;
+			return;
+		}
+		B1 = (D11 * D20 - D01 * D21) / Den;
+		B2 = (D00 * D21 - D01 * D20) / Den;
+	}
+
+	Math::Vector Triangle::NormalAt(const Math::Vector &Point) const
+	{
+		const uint32_t *I = &Mesh.Indices[3 * Index];
+		if (Mesh.Normals.empty()) {
+			const Math::Vector V0 = Vertex(Mesh.Positions, I[0]);
+			const Math::Vector E1 = Vertex(Mesh.Positions, I[1]) - V0;
+			const Math::Vector E2 = Vertex(Mesh.Positions, I[2]) - V0;
+			return E1.Cross(E2).Normalize();
+		}
+
+		Double B1, B2;
+		Barycentric(Point, B1, B2);
+		const Math::Vector N =
+			Vertex(Mesh.Normals, I[0]) * (1.0 - B1 - B2)
+			+ Vertex(Mesh.Normals, I[1]) * B1
+			+ Vertex(Mesh.Normals, I[2]) * B2;
+		return Math::Vector(N).Normalize();
+	}
+
+	Math::Point Triangle::UVAt(const Math::Vector &Point) const
+	{
+		Double B1, B2;
+		Barycentric(Point, B1, B2);
+		if (Mesh.UVs.empty())
+			return Math::Point(B1, B2);
+
+		const uint32_t *I = &Mesh.Indices[3 * Index];
+		const float *T0 = &Mesh.UVs[2 * I[0]];
+		const float *T1 = &Mesh.UVs[2 * I[1]];
+		const float *T2 = &Mesh.UVs[2 * I[2]];
+		const Double B0 = 1.0 - B1 - B2;
+		return Math::Point(B0 * T0[0] + B1 * T1[0] + B2 * T2[0],
+				   B0 * T0[1] + B1 * T1[1] + B2 * T2[1]);
+	}
+
+	Bool Triangle::Bounds(Math::Vector &Center, Double &Radius) const
+	{
+		const uint32_t *I = &Mesh.Indices[3 * Index];
+		Center = (Vertex(Mesh.Positions, I[0])
+			  + Vertex(Mesh.Positions, I[1])
+			  + Vertex(Mesh.Positions, I[2])) / 3.0;
+		Radius = 0.0;
+		for (Int c = 0; c < 3; c++)
+			Radius = std::max(Radius, (Double)(
+				Vertex(Mesh.Positions, I[c]) - Center).Length());
+		return true;
+	}
+
+	std::string Triangle::Dump() const
+	{
+		std::stringstream s;
+		s << "[Triangle Index=" << Index
+		  << " Mat=" << M
+		  << "]";
+		return s.str();
+	}
+
+	/** \brief Orders triangles by centroid along an axis */
+	struct ByCentroid {
+		const std::vector<float> &C;
+		const Int Axis;
+		ByCentroid(const std::vector<float> &C, Int Axis)
+			: C(C), Axis(Axis) {}
+		inline bool operator()(uint32_t A, uint32_t B) const {
+			return C[3 * A + Axis] < C[3 * B + Axis];
+		}
+	};
+
+	TriangleMesh::TriangleMesh(Buffers &B, const Material &M)
+		: M(M), Radius(0.0)
+	{
+		Positions.swap(B.Positions);
+		Normals.swap(B.Normals);
+		UVs.swap(B.UVs);
+		Indices.swap(B.Indices);
+
+		const size_t Vertices = Positions.size() / 3;
+		if (Normals.size() != 3 * Vertices)
+			Normals.clear();
+		if (UVs.size() != 2 * Vertices)
+			UVs.clear();
+		Indices.resize(Indices.size() - Indices.size() % 3);
+		for (size_t i = 0; i < Indices.size(); i++)
+			if (Indices[i] >= Vertices)
+				throw std::runtime_error(
+					"Mesh vertex index out of range");
+
+		const uint32_t Count = Indices.size() / 3;
+		if (Count == 0)
+			return;
+
+		std::vector<uint32_t> Order(Count);
+		std::vector<float> Centroids(3 * Count);
+		for (uint32_t t = 0; t < Count; t++) {
+			Order[t] = t;
+			for (Int a = 0; a < 3; a++)
+				Centroids[3 * t + a] =
+					(Positions[3 * Indices[3 * t] + a]
+					 + Positions[3 * Indices[3 * t + 1] + a]
+					 + Positions[3 * Indices[3 * t + 2] + a])
+					/ 3.0f;
+		}
+
+		Nodes.reserve(2 * (Count / LEAF + 1));
+		Build(Order, Centroids, 0, Count);
+
+		/* Store triangles in leaf order */
+		std::vector<uint32_t> Sorted(Indices.size());
+		for (uint32_t t = 0; t < Count; t++)
+			for (Int c = 0; c < 3; c++)
+				Sorted[3 * t + c] = Indices[3 * Order[t] + c];
+		Indices.swap(Sorted);
+
+		const Node &Root = Nodes[0];
+		const Math::Vector Min(Root.Box[0][0], Root.Box[0][1], Root.Box[0][2]);
+		const Math::Vector Max(Root.Box[1][0], Root.Box[1][1], Root.Box[1][2]);
+		Center = (Min + Max) * 0.5;
+		Radius = (Max - Min).Length() * 0.5;
+	}
+
+	uint32_t TriangleMesh::Build(std::vector<uint32_t> &Order,
+				     const std::vector<float> &Centroids,
+				     uint32_t From, uint32_t To)
+	{
+		const uint32_t Number = Nodes.size();
+		Nodes.push_back(Node());
+
+		Node N;
+		if (To - From <= LEAF) {
+			for (Int a = 0; a < 3; a++) {
+				N.Box[0][a] = 1e30f;
+				N.Box[1][a] = -1e30f;
+			}
+			for (uint32_t i = From; i < To; i++)
+				for (Int c = 0; c < 3; c++) {
+					const float *P = &Positions[
+						3 * Indices[3 * Order[i] + c]];
+					for (Int a = 0; a < 3; a++) {
+						N.Box[0][a] = std::min(N.Box[0][a], P[a]);
+						N.Box[1][a] = std::max(N.Box[1][a], P[a]);
+					}
+				}
+			N.Offset = From;
+			N.Count = To - From;
+			Nodes[Number] = N;
+			return Number;
+		}
+
+		/* Inner boxes are unions of their children, only
+		 * centroids are scanned on each level */
+		float CMin[3], CMax[3];
+		for (Int a = 0; a < 3; a++) {
+			CMin[a] = 1e30f;
+			CMax[a] = -1e30f;
+		}
+		for (uint32_t i = From; i < To; i++) {
+			const float *C = &Centroids[3 * Order[i]];
+			for (Int a = 0; a < 3; a++) {
+				CMin[a] = std::min(CMin[a], C[a]);
+				CMax[a] = std::max(CMax[a], C[a]);
+			}
+		}
+
+		Int Axis = 0;
+		for (Int a = 1; a < 3; a++)
+			if (CMax[a] - CMin[a] > CMax[Axis] - CMin[Axis])
+				Axis = a;
+		/* Split near the median at a multiple of LEAF, so all
+		 * leaves but the last one are full */
+		const uint32_t Blocks = (To - From + LEAF - 1) / LEAF;
+		const uint32_t Mid = From + LEAF * (Blocks / 2);
+		std::nth_element(Order.begin() + From, Order.begin() + Mid,
+				 Order.begin() + To,
+				 ByCentroid(Centroids, Axis));
+
+		Build(Order, Centroids, From, Mid);
+		N.Offset = Build(Order, Centroids, Mid, To);
+		N.Count = 0;
+		const Node &L = Nodes[Number + 1], &R = Nodes[N.Offset];
+		for (Int a = 0; a < 3; a++) {
+			N.Box[0][a] = std::min(L.Box[0][a], R.Box[0][a]);
+			N.Box[1][a] = std::max(L.Box[1][a], R.Box[1][a]);
+		}
+		Nodes[Number] = N;
+		return Number;
+	}
+
+	void TriangleMesh::Leaf(const Node &N, const float O[3],
+				const float D[3], float &Limit,
+				uint32_t &Hit) const
+	{
+		const float Nearest = NearestCollision;
+		uint32_t i = 0;
+#ifdef __SSE__
+		/* Four triangles at a time; a short group repeats
+		 * its last triangle */
+		const __m128 Zero = _mm_setzero_ps();
+		const __m128 One = _mm_set1_ps(1.0f);
+		const __m128 Near = _mm_set1_ps(Nearest);
+		const __m128 Dx = _mm_set1_ps(D[0]);
+		const __m128 Dy = _mm_set1_ps(D[1]);
+		const __m128 Dz = _mm_set1_ps(D[2]);
+		for (; i < N.Count; i += 4) {
+			float V0[3][4], E1[3][4], E2[3][4]
+				__attribute__((aligned(16)));
+			for (Int l = 0; l < 4; l++) {
+				const uint32_t t = N.Offset
+					+ std::min(i + l, N.Count - 1);
+				const float *P0 = &Positions[3 * Indices[3 * t]];
+				const float *P1 = &Positions[3 * Indices[3 * t + 1]];
+				const float *P2 = &Positions[3 * Indices[3 * t + 2]];
+				for (Int a = 0; a < 3; a++) {
+					V0[a][l] = P0[a];
+					E1[a][l] = P1[a] - P0[a];
+					E2[a][l] = P2[a] - P0[a];
+				}
+			}
+			const __m128 E1x = _mm_load_ps(E1[0]);
+			const __m128 E1y = _mm_load_ps(E1[1]);
+			const __m128 E1z = _mm_load_ps(E1[2]);
+			const __m128 E2x = _mm_load_ps(E2[0]);
+			const __m128 E2y = _mm_load_ps(E2[1]);
+			const __m128 E2z = _mm_load_ps(E2[2]);
+
+			/* P = D x E2, Det = E1 . P */
+			const __m128 Px = _mm_sub_ps(_mm_mul_ps(Dy, E2z),
+						     _mm_mul_ps(Dz, E2y));
+			const __m128 Py = _mm_sub_ps(_mm_mul_ps(Dz, E2x),
+						     _mm_mul_ps(Dx, E2z));
+			const __m128 Pz = _mm_sub_ps(_mm_mul_ps(Dx, E2y),
+						     _mm_mul_ps(Dy, E2x));
+			const __m128 Det = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(E1x, Px),
+					   _mm_mul_ps(E1y, Py)),
+				_mm_mul_ps(E1z, Pz));
+			/* Det of 0 makes infinities and NaNs which fail
+			 * the tests below */
+			const __m128 Inv = _mm_div_ps(One, Det);
+
+			const __m128 Sx = _mm_sub_ps(_mm_set1_ps(O[0]),
+						     _mm_load_ps(V0[0]));
+			const __m128 Sy = _mm_sub_ps(_mm_set1_ps(O[1]),
+						     _mm_load_ps(V0[1]));
+			const __m128 Sz = _mm_sub_ps(_mm_set1_ps(O[2]),
+						     _mm_load_ps(V0[2]));
+			const __m128 U = _mm_mul_ps(_mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(Sx, Px),
+					   _mm_mul_ps(Sy, Py)),
+				_mm_mul_ps(Sz, Pz)), Inv);
+
+			/* Q = S x E1 */
+			const __m128 Qx = _mm_sub_ps(_mm_mul_ps(Sy, E1z),
+						     _mm_mul_ps(Sz, E1y));
+			const __m128 Qy = _mm_sub_ps(_mm_mul_ps(Sz, E1x),
+						     _mm_mul_ps(Sx, E1z));
+			const __m128 Qz = _mm_sub_ps(_mm_mul_ps(Sx, E1y),
+						     _mm_mul_ps(Sy, E1x));
+			const __m128 V = _mm_mul_ps(_mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(Dx, Qx),
+					   _mm_mul_ps(Dy, Qy)),
+				_mm_mul_ps(Dz, Qz)), Inv);
+			const __m128 T = _mm_mul_ps(_mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(E2x, Qx),
+					   _mm_mul_ps(E2y, Qy)),
+				_mm_mul_ps(E2z, Qz)), Inv);
+
+			__m128 Mask = _mm_and_ps(_mm_cmpge_ps(U, Zero),
+						 _mm_cmpge_ps(V, Zero));
+			Mask = _mm_and_ps(Mask, _mm_cmple_ps(_mm_add_ps(U, V),
+							     One));
+			Mask = _mm_and_ps(Mask, _mm_cmpgt_ps(T, Near));
+			Mask = _mm_and_ps(Mask, _mm_cmplt_ps(
+						  T, _mm_set1_ps(Limit)));
+			const int Bits = _mm_movemask_ps(Mask);
+			if (!Bits)
+				continue;
+
+			float Ts[4] __attribute__((aligned(16)));
+			_mm_store_ps(Ts, T);
+			for (Int l = 0; l < 4; l++)
+				if ((Bits & (1 << l)) && Ts[l] < Limit) {
+					Limit = Ts[l];
+					Hit = N.Offset
+						+ std::min(i + l, N.Count - 1);
+				}
+		}
+#endif
+		for (; i < N.Count; i++) {
+			const uint32_t t = N.Offset + i;
+			const float *P0 = &Positions[3 * Indices[3 * t]];
+			const float *P1 = &Positions[3 * Indices[3 * t + 1]];
+			const float *P2 = &Positions[3 * Indices[3 * t + 2]];
+			float E1[3], E2[3], S[3];
+			for (Int a = 0; a < 3; a++) {
+				E1[a] = P1[a] - P0[a];
+				E2[a] = P2[a] - P0[a];
+				S[a] = O[a] - P0[a];
+			}
+			const float P[3] = {
+				D[1] * E2[2] - D[2] * E2[1],
+				D[2] * E2[0] - D[0] * E2[2],
+				D[0] * E2[1] - D[1] * E2[0]
+			};
+			const float Inv = 1.0f /
+				(E1[0] * P[0] + E1[1] * P[1] + E1[2] * P[2]);
+			const float U = (S[0] * P[0] + S[1] * P[1]
+					 + S[2] * P[2]) * Inv;
+			const float Q[3] = {
+				S[1] * E1[2] - S[2] * E1[1],
+				S[2] * E1[0] - S[0] * E1[2],
+				S[0] * E1[1] - S[1] * E1[0]
+			};
+			const float V = (D[0] * Q[0] + D[1] * Q[1]
+					 + D[2] * Q[2]) * Inv;
+			const float T = (E2[0] * Q[0] + E2[1] * Q[1]
+					 + E2[2] * Q[2]) * Inv;
+			if (U >= 0.0f && V >= 0.0f && U + V <= 1.0f &&
+			    T > Nearest && T < Limit) {
+				Limit = T;
+				Hit = t;
+			}
+		}
+	}
+
+	const Object *TriangleMesh::Collide(const Render::Ray &R,
+					    Double &RayPos,
+					    HitStorage &Storage) const
+	{
+		if (Nodes.empty())
+			return NULL;
+
+		float O[3], D[3];
+		for (Int a = 0; a < 3; a++) {
+			O[a] = R.Start()[a];
+			D[a] = R.Direction()[a];
+		}
+		const Math::Slab<float> S(O, D);
+		const Double Max = std::numeric_limits<float>::max();
+		float Limit = RayPos < Max ? float(RayPos) : float(Max);
+		uint32_t Hit = 0xFFFFFFFFU;
+
+		/* Nearer child first; farther ones wait with the
+		 * distance their box is entered at */
+		struct { uint32_t Node; float Near; } Stack[64];
+		Int Top = 0;
+		float Near = 0.0f, Far = Limit;
+		uint32_t Cur = 0;
+		if (!S.Clip(Nodes[0].Box, Near, Far))
+			return NULL;
+		for (;;) {
+			const Node &N = Nodes[Cur];
+			if (N.Count) {
+				Scene::Tests += N.Count;
+				Leaf(N, O, D, Limit, Hit);
+			} else {
+				float NearL = 0.0f, FarL = Limit;
+				float NearR = 0.0f, FarR = Limit;
+				const Bool HitL = S.Clip(Nodes[Cur + 1].Box,
+							 NearL, FarL);
+				const Bool HitR = S.Clip(Nodes[N.Offset].Box,
+							 NearR, FarR);
+				if (HitL && HitR) {
+					const Bool LeftFirst = NearL <= NearR;
+					Stack[Top].Node = LeftFirst
+						? N.Offset : Cur + 1;
+					Stack[Top].Near = LeftFirst
+						? NearR : NearL;
+					Top++;
+					Cur = LeftFirst ? Cur + 1 : N.Offset;
+					continue;
+				}
+				if (HitL || HitR) {
+					Cur = HitL ? Cur + 1 : N.Offset;
+					continue;
+				}
+			}
+
+			/* Next waiting node not behind the nearest hit */
+			while (Top > 0 && Stack[Top - 1].Near >= Limit)
+				Top--;
+			if (Top == 0)
+				break;
+			Cur = Stack[--Top].Node;
+		}
+
+		if (Hit == 0xFFFFFFFFU)
+			return NULL;
+		RayPos = Limit;
+		return new (Storage.Get<Triangle>()) Triangle(*this, Hit);
+	}
+
+	size_t TriangleMesh::GetBytes() const
+	{
+		return sizeof(float) * (Positions.size() + Normals.size()
+					+ UVs.size())
+			+ sizeof(uint32_t) * Indices.size()
+			+ sizeof(Node) * Nodes.size();
+	}
+
+	/** \brief Reads statement fields of one OBJ line */
+	class OBJLine {
+		const char *Cur;
+		const std::string &Name;
+		const long Number;
+	public:
+		OBJLine(const char *Text, const std::string &Name, long Number)
+			: Cur(Text), Name(Name), Number(Number) {}
+
+		/** Error at this line */
+		std::runtime_error Error(const std::string &What) const {
+			std::ostringstream s;
+			s << Name << ":" << Number << ": " << What;
+			return std::runtime_error(s.str());
+		}
+
+		/** Skip spaces; \return false at end of line */
+		Bool More() {
+			while (*Cur == ' ' || *Cur == '\t' || *Cur == '\r')
+				Cur++;
+			return *Cur != '\0';
+		}
+
+		/** Read a number */
+		float Value() {
+			char *End;
+			const float V = strtof(Cur, &End);
+			if (End == Cur)
+				throw Error("Expected a number");
+			Cur = End;
+			return V;
+		}
+
+		/** Read an index given relative to Count items read;
+		 * \return Item number or NONE if the field is empty */
+		uint32_t Index(size_t Count) {
+			if (*Cur == '/' || *Cur == ' ' || *Cur == '\t' ||
+			    *Cur == '\r' || *Cur == '\0')
+				return General::Interner::NONE;
+			char *End;
+			const long I = strtol(Cur, &End, 10);
+			if (End == Cur)
+				throw Error("Expected an index");
+			Cur = End;
+			const long Abs = I < 0 ? long(Count) + I : I - 1;
+			if (I == 0 || Abs < 0 || Abs >= long(Count))
+				throw Error("Index out of range");
+			return uint32_t(Abs);
+		}
+
+		/** Skip a '/' between indices; \return false if
+		 * there is none */
+		Bool Slash() {
+			if (*Cur != '/')
+				return false;
+			Cur++;
+			return true;
+		}
+
+		/** Statement keyword */
+		std::string Keyword() {
+			const char *Begin = Cur;
+			while (*Cur && *Cur != ' ' && *Cur != '\t' && *Cur != '\r')
+				Cur++;
+			return std::string(Begin, Cur);
+		}
+	};
+
+	void TriangleMesh::ReadOBJ(const char *Data, size_t Size,
+				   const std::string &Name, Buffers &Out)
+	{
+		Out = Buffers();
+		std::vector<float> P, N, T;
+
+		/* Distinct position/uv/normal triples become vertices */
+		General::Interner Corners;
+		Bool MissingNormal = false, MissingUV = false;
+
+		std::vector<char> Text;
+		std::vector<uint32_t> Face;
+		long Number = 0;
+		for (size_t Pos = 0; Pos < Size;) {
+			const char *Begin = Data + Pos;
+			const char *End = (const char *)memchr(Begin, '\n',
+							       Size - Pos);
+			if (!End)
+				End = Data + Size;
+			Pos = End - Data + 1;
+			Number++;
+
+			Text.assign(Begin, End);
+			Text.push_back('\0');
+			OBJLine L(&Text[0], Name, Number);
+			if (!L.More())
+				continue;
+			const std::string Key = L.Keyword();
+
+			if (Key == "v" || Key == "vn") {
+				std::vector<float> &To = Key == "v" ? P : N;
+				for (Int a = 0; a < 3; a++) {
+					L.More();
+					To.push_back(L.Value());
+				}
+				continue;
+			}
+			if (Key == "vt") {
+				for (Int a = 0; a < 2; a++) {
+					L.More();
+					T.push_back(L.Value());
+				}
+				continue;
+			}
+			if (Key != "f")
+				continue;
+
+			Face.clear();
+			while (L.More()) {
+				uint32_t C[3];
+				C[0] = L.Index(P.size() / 3);
+				C[1] = C[2] = General::Interner::NONE;
+				if (C[0] == General::Interner::NONE)
+					throw L.Error("Face vertex without"
+						      " position");
+				if (L.Slash()) {
+					C[1] = L.Index(T.size() / 2);
+					if (L.Slash())
+						C[2] = L.Index(N.size() / 3);
+				}
+
+				const UInt ID = Corners.Intern(
+					(const char *)C, sizeof(C));
+				if (ID == Out.Positions.size() / 3) {
+					for (Int a = 0; a < 3; a++)
+						Out.Positions.push_back(
+							P[3 * C[0] + a]);
+					for (Int a = 0; a < 2; a++)
+						Out.UVs.push_back(
+							C[1] == General::Interner::NONE
+							? 0.0f : T[2 * C[1] + a]);
+					for (Int a = 0; a < 3; a++)
+						Out.Normals.push_back(
+							C[2] == General::Interner::NONE
+							? 0.0f : N[3 * C[2] + a]);
+					MissingUV |= C[1] == General::Interner::NONE;
+					MissingNormal |= C[2] == General::Interner::NONE;
+				}
+				Face.push_back(ID);
+			}
+			if (Face.size() < 3)
+				throw L.Error("Face has less than 3 vertices");
+			for (size_t i = 2; i < Face.size(); i++) {
+				Out.Indices.push_back(Face[0]);
+				Out.Indices.push_back(Face[i - 1]);
+				Out.Indices.push_back(Face[i]);
+			}
+		}
+
+		/* Attributes given for only some vertices are dropped */
+		if (MissingUV)
+			std::vector<float>().swap(Out.UVs);
+		if (MissingNormal)
+			std::vector<float>().swap(Out.Normals);
+	}
+
+	void TriangleMesh::LoadOBJ(const std::string &File, Buffers &Out)
+	{
+		const General::MappedFile Map(File);
+		ReadOBJ(Map.GetData(), Map.GetSize(), File, Out);
+	}
+}
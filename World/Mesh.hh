@@ -0,0 +1,172 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+#ifndef _MESH_H_
+#define _MESH_H_
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "General/Types.hh"
+#include "World/Aggregate.hh"
+#include "World/Material.hh"
+#include "World/Object.hh"
+
+namespace World {
+	class TriangleMesh;
+
+	/**
+	 * \brief
+	 *	One triangle of a mesh, as returned by
+	 *	TriangleMesh::Collide()
+	 *
+	 * Holds only the mesh and triangle number; vertices,
+	 * normals and UV coordinates are read from mesh buffers.
+	 */
+	class Triangle : public Object {
+	protected:
+		const TriangleMesh &Mesh;
+		const uint32_t Index;
+
+		virtual std::string Dump() const;
+
+		/** Barycentric coordinates of point at v1 and v2 */
+		void Barycentric(const Math::Vector &Point,
+				 Double &B1, Double &B2) const;
+	public:
+		Triangle(const TriangleMesh &Mesh, uint32_t Index);
+
+		virtual Bool Collide(const Render::Ray &R, Double &RayPos) const;
+		virtual Math::Vector NormalAt(const Math::Vector &Point) const;
+		virtual Math::Point UVAt(const Math::Vector &Point) const;
+		virtual Bool Bounds(Math::Vector &Center, Double &Radius) const;
+	};
+
+	/**
+	 * \brief
+	 *	Triangles sharing indexed vertex buffers and one
+	 *	material.
+	 *
+	 * Vertices are stored once as floats; each triangle is
+	 * three indices into them. A bounding volume hierarchy of
+	 * boxes, built at construction, holds up to LEAF triangles
+	 * in a leaf; leaf triangles are tested four at a time.
+	 * Together this takes about 30-40 bytes per triangle.
+	 *
+	 * Triangles exist only as indices, so Collide() builds the
+	 * hit one in the caller's HitStorage.
+	 */
+	class TriangleMesh : public Aggregate {
+	public:
+		/** Triangles tested at most in a leaf */
+		enum { LEAF = 8 };
+
+		/** \brief Mesh data before the hierarchy is built */
+		struct Buffers {
+			/** x, y, z of each vertex */
+			std::vector<float> Positions;
+			/** x, y, z of each vertex; empty for flat shading */
+			std::vector<float> Normals;
+			/** u, v of each vertex; may be empty */
+			std::vector<float> UVs;
+			/** Three vertex numbers per triangle */
+			std::vector<uint32_t> Indices;
+		};
+
+	private:
+		/** \brief Hierarchy node; children of an inner node
+		 * are the next node and node number Offset */
+		struct Node {
+			/** Min and max corner of the box */
+			float Box[2][3];
+			/** First triangle of a leaf or right child */
+			uint32_t Offset;
+			/** Triangles of a leaf; 0 for inner nodes */
+			uint32_t Count;
+		};
+
+		std::vector<float> Positions, Normals, UVs;
+		std::vector<uint32_t> Indices;
+		std::vector<Node> Nodes;
+
+		const Material &M;
+
+		/** Sphere enclosing the mesh */
+		Math::Vector Center;
+		Double Radius;
+
+		/** Private copy-constructor */
+		TriangleMesh(const TriangleMesh &T);
+
+		/** Private operator= */
+		void operator=(const TriangleMesh &T) const;
+
+		/** Build hierarchy of triangles Order[From, To);
+		 * \return Number of the created node */
+		uint32_t Build(std::vector<uint32_t> &Order,
+			       const std::vector<float> &Centroids,
+			       uint32_t From, uint32_t To);
+
+		/** Test triangles of a leaf; nearer hit updates
+		 * Limit and Hit */
+		void Leaf(const Node &N, const float O[3], const float D[3],
+			  float &Limit, uint32_t &Hit) const;
+
+		friend class Triangle;
+	public:
+		/**
+		 * Take over buffers (they are left empty) and build
+		 * the hierarchy.
+		 * \throw std::runtime_error if an index is out of range
+		 */
+		TriangleMesh(Buffers &B, const Material &M);
+
+		/**
+		 * Read Wavefront OBJ text into buffers. Vertices,
+		 * normals, texture coordinates and faces are read;
+		 * polygons are split into triangle fans, other
+		 * statements are ignored. Out is replaced.
+		 * \param Name	File name for error messages
+		 * \throw std::runtime_error on malformed input
+		 */
+		static void ReadOBJ(const char *Data, size_t Size,
+				    const std::string &Name, Buffers &Out);
+
+		/** Read Wavefront OBJ file; see ReadOBJ() */
+		static void LoadOBJ(const std::string &File, Buffers &Out);
+
+		virtual const Object *Collide(const Render::Ray &R,
+					      Double &RayPos,
+					      HitStorage &Hit) const;
+
+		virtual void Bounds(Math::Vector &Center, Double &Radius) const {
+			Center = this->Center;
+			Radius = this->Radius;
+		}
+
+		virtual Bool IsSpecular() const {
+			return M.IsSpecular();
+		}
+
+		/** \return Number of triangles */
+		inline UInt GetTriangles() const {
+			return UInt(Indices.size() / 3);
+		}
+
+		/** \return Bytes of buffers and hierarchy */
+		size_t GetBytes() const;
+	};
+};
+
+#endif
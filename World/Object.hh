@@ -16,6 +16,7 @@
 #include <iostream>
 #include <string>
 
+#include "General/Profile.hh"
 #include "Math/Matrix.hh"
 #include "Math/Vector.hh"
 #include "Render/Ray.hh"
@@ -76,6 +77,7 @@ namespace World {
 		/** Get color of specified material filter at given object point */
 		inline const Color ColorAt(const Math::Vector &Point,
 					   const Material::Filter F) const {
+			General::Profile::Count(General::Profile::TEXTURE_LOOKUPS);
 			return this->M.GetColor(F, UVAt(Point));
 		}
 
@@ -83,6 +85,19 @@ namespace World {
 		inline Double GetProperty(Material::Property P) const {
 			return this->M.GetProperty(P);
 		}
+
+		/** Object material accessor */
+		inline const Material &GetMaterial() const {
+			return this->M;
+		}
+
+		/**
+		 * Get sphere enclosing the object.
+		 * \return false if object is unbounded (eg. plane)
+		 */
+		virtual Bool Bounds(Math::Vector &Center, Double &Radius) const {
+			return false;
+		}
 	};
 };
 
@@ -53,6 +53,11 @@ namespace World {
 		virtual Bool Collide(const Render::Ray &R, Double &RayPos) const;
 		virtual Math::Vector NormalAt(const Math::Vector &Point) const;
 
+		/**@{ Plane equation accessors */
+		inline const Math::Vector &GetNormal() const { return Normal; }
+		inline Double GetDistance() const { return Distance; }
+		/*@}*/
+
 		/** \bug Current implementation will only work for 
 		 * horizontal plane */
 		virtual Math::Point UVAt(const Math::Vector &Point) const;
@@ -13,22 +13,17 @@
 #ifndef _PRIMITIVES_H_
 #define _PRIMITIVES_H_
 
-#error "Not finished. Do not include"
-namespace World {
+/**
+ * \file
+ *	All object types a scene may hold: unbounded planes,
+ *	spheres, boxes, quaternion Julia sets and triangle
+ *	meshes (an Aggregate).
+ */
 
-#if 0
-
-	class Box {
-	public:
-		/* Perpendicular plane vector and two points
-		 * gives two parallel planes */
-		struct {
-			Math::Vector Norm;
-			Math::Vector P[2];
-		} V, H;
-
-	};
-#endif
-};
+#include "World/Plane.hh"
+#include "World/Sphere.hh"
+#include "World/Box.hh"
+#include "World/Julia.hh"
+#include "World/Mesh.hh"
 
 #endif
@@ -0,0 +1,337 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "General/Profile.hh"
+#include "Math/Slab.hh"
+#include "World/Scene.hh"
+#include "World/SceneBinary.hh"
+#include "World/Region.hh"
+
+namespace World {
+	/** \brief Orders regions by box center along an axis */
+	struct ByCenter {
+		const std::vector<double> &C;
+		const Int Axis;
+		ByCenter(const std::vector<double> &C, Int Axis)
+			: C(C), Axis(Axis) {}
+		inline bool operator()(uint32_t A, uint32_t B) const {
+			return C[3 * A + Axis] < C[3 * B + Axis];
+		}
+	};
+
+	RegionSet::RegionSet(const std::string &File,
+			     const std::vector<const Material *> &Materials,
+			     const BinaryRegion *Records, UInt Count,
+			     uint64_t SphereOffset, size_t Budget)
+		: File(File),
+		  Fd(open(File.c_str(), O_RDONLY)),
+		  Materials(Materials),
+		  Regions(NULL),
+		  Count(Count),
+		  Budget(Budget),
+		  Used(0),
+		  Clock(0),
+		  Radius(0.0),
+		  Specular(false)
+	{
+		if (Fd < 0)
+			throw std::runtime_error("Unable to open " + File + ": "
+						 + strerror(errno));
+
+		Math::Vector Min, Max;
+		Regions = new Region[Count];
+		for (UInt i = 0; i < Count; i++) {
+			Region &R = Regions[i];
+			const BinaryRegion &B = Records[i];
+			for (Int a = 0; a < 3; a++) {
+				R.Box[0][a] = B.Min[a];
+				R.Box[1][a] = B.Max[a];
+			}
+			R.Offset = SphereOffset
+				+ uint64_t(B.First) * sizeof(BinaryPrimitive);
+			R.Count = B.Count;
+			for (Int a = 0; a < 3; a++) {
+				if (i == 0 || R.Box[0][a] < Min[a])
+					Min[a] = R.Box[0][a];
+				if (i == 0 || R.Box[1][a] > Max[a])
+					Max[a] = R.Box[1][a];
+			}
+		}
+		Center = (Min + Max) * 0.5;
+		Radius = (Max - Min).Length() * 0.5;
+
+		if (Count > 0) {
+			std::vector<uint32_t> Order(Count);
+			std::vector<double> Centers(3 * Count);
+			for (UInt i = 0; i < Count; i++) {
+				Order[i] = i;
+				for (Int a = 0; a < 3; a++)
+					Centers[3 * i + a] = (Regions[i].Box[0][a]
+							      + Regions[i].Box[1][a])
+						* 0.5;
+			}
+			Nodes.reserve(2 * Count);
+			Build(Order, Centers, 0, Count);
+		}
+
+		for (UInt i = 0; i < Materials.size(); i++)
+			if (Materials[i]->IsSpecular())
+				Specular = true;
+	}
+
+	RegionSet::~RegionSet()
+	{
+		delete[] Regions;
+		close(Fd);
+	}
+
+	uint32_t RegionSet::Build(std::vector<uint32_t> &Order,
+				  const std::vector<double> &Centers,
+				  uint32_t From, uint32_t To)
+	{
+		const uint32_t Number = Nodes.size();
+		Nodes.push_back(Node());
+
+		Node N;
+		if (To - From == 1) {
+			const Region &Reg = Regions[Order[From]];
+			for (Int c = 0; c < 2; c++)
+				for (Int a = 0; a < 3; a++)
+					N.Box[c][a] = Reg.Box[c][a];
+			N.Offset = Order[From];
+			N.Count = 1;
+			Nodes[Number] = N;
+			return Number;
+		}
+
+		/* Split at the median center along the widest axis */
+		double CMin[3], CMax[3];
+		for (Int a = 0; a < 3; a++) {
+			CMin[a] = 1e300;
+			CMax[a] = -1e300;
+		}
+		for (uint32_t i = From; i < To; i++) {
+			const double *C = &Centers[3 * Order[i]];
+			for (Int a = 0; a < 3; a++) {
+				CMin[a] = std::min(CMin[a], C[a]);
+				CMax[a] = std::max(CMax[a], C[a]);
+			}
+		}
+		Int Axis = 0;
+		for (Int a = 1; a < 3; a++)
+			if (CMax[a] - CMin[a] > CMax[Axis] - CMin[Axis])
+				Axis = a;
+		const uint32_t Mid = From + (To - From) / 2;
+		std::nth_element(Order.begin() + From, Order.begin() + Mid,
+				 Order.begin() + To, ByCenter(Centers, Axis));
+
+		Build(Order, Centers, From, Mid);
+		N.Offset = Build(Order, Centers, Mid, To);
+		N.Count = 0;
+		const Node &L = Nodes[Number + 1], &R = Nodes[N.Offset];
+		for (Int a = 0; a < 3; a++) {
+			N.Box[0][a] = std::min(L.Box[0][a], R.Box[0][a]);
+			N.Box[1][a] = std::max(L.Box[1][a], R.Box[1][a]);
+		}
+		Nodes[Number] = N;
+		return Number;
+	}
+
+	void RegionSet::Load(Region &Reg) const
+	{
+		General::Profile::Scope S(General::Profile::BUILD);
+		size_t Bytes = 0;
+
+		Reg.Lock.WriteLock();
+		if (!Reg.Loaded) {
+			std::vector<BinaryPrimitive> Buffer(Reg.Count);
+			const size_t Size = Reg.Count * sizeof(BinaryPrimitive);
+			size_t Done = 0;
+			while (Done < Size) {
+				const ssize_t Got = pread(
+					Fd, (char *)&Buffer[0] + Done,
+					Size - Done, Reg.Offset + Done);
+				if (Got <= 0)
+					break;
+				Done += Got;
+			}
+
+			UInt Valid = Reg.Count;
+			if (Done < Size) {
+				/* Can't stop rendering from here */
+				std::cout << "*** Unable to read region of "
+					  << File << "; it stays empty"
+					  << std::endl;
+				Valid = 0;
+			}
+
+			/* Same check as the eagerly read file */
+			for (UInt i = 0; i < Valid; i++) {
+				if (Buffer[i].Material < Materials.size())
+					continue;
+				Reg.Lock.Unlock();
+				throw std::runtime_error(
+					"Binary scene refers to a "
+					"missing record");
+			}
+
+			/* One allocation keeps the spheres contiguous */
+			Bytes = Valid * sizeof(Sphere);
+			Sphere *Spheres = (Sphere *)Reg.Memory.Allocate(
+				Bytes ? Bytes : 1);
+			for (UInt i = 0; i < Valid; i++) {
+				const BinaryPrimitive &B = Buffer[i];
+				new (Spheres + i) Sphere(
+					Math::Vector(B.V[0], B.V[1], B.V[2]),
+					B.Scalar, *Materials[B.Material]);
+			}
+			Reg.Spheres = Spheres;
+			Reg.Count = Valid;
+			Reg.Loaded = true;
+			General::Profile::Count(General::Profile::REGION_LOADS);
+		}
+		Reg.Lock.Unlock();
+
+		General::Lock L(Guard);
+		Reg.LastUse = ++Clock;
+		Used += Bytes;
+		Evict(Reg);
+	}
+
+	void RegionSet::Evict(const Region &Keep) const
+	{
+		if (Used <= Budget)
+			return;
+
+		/* Oldest first; regions in use are skipped */
+		std::vector<std::pair<unsigned long, UInt> > Order;
+		for (UInt i = 0; i < Count; i++) {
+			const Region &R = Regions[i];
+			if (R.Loaded && &R != &Keep && R.Count != 0)
+				Order.push_back(std::make_pair(R.LastUse, i));
+		}
+		std::sort(Order.begin(), Order.end());
+
+		for (UInt i = 0; i < Order.size() && Used > Budget; i++) {
+			Region &Oldest = Regions[Order[i].second];
+			if (!Oldest.Lock.TryWriteLock())
+				continue;
+			Used -= Oldest.Count * sizeof(Sphere);
+			Oldest.Loaded = false;
+			Oldest.Spheres = NULL;
+			Oldest.Memory.Release();
+			Oldest.Lock.Unlock();
+			General::Profile::Count(
+				General::Profile::REGION_EVICTIONS);
+		}
+	}
+
+	void RegionSet::Visit(Region &Reg, const Render::Ray &R,
+			      Double &RayPos, const Sphere *&Best,
+			      HitStorage &Storage) const
+	{
+		Reg.LastUse = Clock;
+
+		Reg.Lock.ReadLock();
+		while (!Reg.Loaded) {
+			Reg.Lock.Unlock();
+			Load(Reg);
+			Reg.Lock.ReadLock();
+		}
+
+		const Sphere *Hit = NULL;
+		Scene::Tests += Reg.Count;
+		for (UInt s = 0; s < Reg.Count; s++) {
+			Double t;
+			if (Reg.Spheres[s].Sphere::Collide(R, t) &&
+			    t < RayPos) {
+				RayPos = t;
+				Hit = Reg.Spheres + s;
+			}
+		}
+		/* Copy while the region can't be dropped */
+		if (Hit)
+			Best = new (Storage.Get<Sphere>()) Sphere(*Hit);
+		Reg.Lock.Unlock();
+	}
+
+	const Object *RegionSet::Collide(const Render::Ray &R,
+					 Double &RayPos,
+					 HitStorage &Hit) const
+	{
+		if (Nodes.empty())
+			return NULL;
+
+		double O[3], D[3];
+		for (Int a = 0; a < 3; a++) {
+			O[a] = R.Start()[a];
+			D[a] = R.Direction()[a];
+		}
+		const Math::Slab<double> S(O, D);
+
+		/* Nearer child first; farther ones wait with the
+		 * distance their box is entered at */
+		struct { uint32_t Node; double Near; } Stack[64];
+		Int Top = 0;
+		double Near = 0.0, Far = RayPos;
+		uint32_t Cur = 0;
+		const Sphere *Best = NULL;
+		if (!S.Clip(Nodes[0].Box, Near, Far))
+			return NULL;
+		for (;;) {
+			const Node &N = Nodes[Cur];
+			if (N.Count) {
+				Visit(Regions[N.Offset], R, RayPos, Best, Hit);
+			} else {
+				double NearL = 0.0, FarL = RayPos;
+				double NearR = 0.0, FarR = RayPos;
+				const Bool HitL = S.Clip(Nodes[Cur + 1].Box,
+							 NearL, FarL);
+				const Bool HitR = S.Clip(Nodes[N.Offset].Box,
+							 NearR, FarR);
+				if (HitL && HitR) {
+					const Bool LeftFirst = NearL <= NearR;
+					Stack[Top].Node = LeftFirst
+						? N.Offset : Cur + 1;
+					Stack[Top].Near = LeftFirst
+						? NearR : NearL;
+					Top++;
+					Cur = LeftFirst ? Cur + 1 : N.Offset;
+					continue;
+				}
+				if (HitL || HitR) {
+					Cur = HitL ? Cur + 1 : N.Offset;
+					continue;
+				}
+			}
+
+			/* Next waiting node not behind the nearest hit */
+			while (Top > 0 && Stack[Top - 1].Near >= RayPos)
+				Top--;
+			if (Top == 0)
+				break;
+			Cur = Stack[--Top].Node;
+		}
+		return Best;
+	}
+}
@@ -0,0 +1,176 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _REGION_H_
+#define _REGION_H_
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "General/Types.hh"
+#include "General/Arena.hh"
+#include "General/Thread.hh"
+#include "World/Aggregate.hh"
+#include "World/Material.hh"
+#include "World/Sphere.hh"
+
+namespace World {
+	struct BinaryRegion;
+
+	/**
+	 * \brief
+	 *	Spheres of a binary scene file read on demand, region
+	 *	by region.
+	 *
+	 * Each region is a box; its spheres are read from the file
+	 * the first time a ray enters the box. Boxes are kept in a
+	 * bounding volume hierarchy, one region per leaf, walked
+	 * nearer child first, so a ray only tests and loads regions
+	 * it crosses before its nearest hit. When resident spheres
+	 * take more than the budget, least recently used regions are
+	 * dropped and read again when needed.
+	 *
+	 * A region may be dropped while an object found in it is
+	 * being shaded, so Collide() copies the hit sphere into the
+	 * caller's HitStorage before the region is released.
+	 */
+	class RegionSet : public Aggregate {
+	private:
+		/** \brief Box of spheres, maybe resident */
+		struct Region {
+			/** Min and max corner */
+			double Box[2][3];
+
+			/** File offset of the first sphere record */
+			uint64_t Offset;
+			uint32_t Count;
+
+			/** Guards Loaded and Spheres; readers test rays */
+			General::RWLock Lock;
+			Bool Loaded;
+			const Sphere *Spheres;
+			General::Arena Memory;
+
+			/** Clock of the last ray which entered the box */
+			volatile unsigned long LastUse;
+
+			Region() : Offset(0), Count(0), Loaded(false),
+				   Spheres(NULL), LastUse(0) {}
+		};
+
+		/** \brief Hierarchy node; children of an inner node
+		 * are the next node and node number Offset */
+		struct Node {
+			/** Min and max corner of the box */
+			double Box[2][3];
+			/** Region of a leaf or right child */
+			uint32_t Offset;
+			/** 1 for leaves; 0 for inner nodes */
+			uint32_t Count;
+		};
+
+		/** Scene file */
+		const std::string File;
+		const int Fd;
+
+		/** Material table of the file */
+		const std::vector<const Material *> Materials;
+
+		Region *Regions;
+		const UInt Count;
+
+		/** Hierarchy over region boxes */
+		std::vector<Node> Nodes;
+
+		/** Bytes of resident spheres allowed and used */
+		const size_t Budget;
+		mutable size_t Used;
+
+		/** Guards Used and Clock */
+		mutable General::Mutex Guard;
+
+		/** Counts loads; orders region uses */
+		mutable volatile unsigned long Clock;
+
+		/** Sphere enclosing all regions */
+		Math::Vector Center;
+		Double Radius;
+
+		/** Is any material specular? */
+		Bool Specular;
+
+		/** Private copy-constructor */
+		RegionSet(const RegionSet &R);
+
+		/** Private operator= */
+		void operator=(const RegionSet &R) const;
+
+		/** Build hierarchy of regions Order[From, To);
+		 * \return Number of the created node */
+		uint32_t Build(std::vector<uint32_t> &Order,
+			       const std::vector<double> &Centers,
+			       uint32_t From, uint32_t To);
+
+		/** Test spheres of a region, loading it if needed;
+		 * nearer hit is copied to Hit and updates RayPos
+		 * and Best */
+		void Visit(Region &Reg, const Render::Ray &R, Double &RayPos,
+			   const Sphere *&Best, HitStorage &Hit) const;
+
+		/** Read spheres of a region and drop other regions
+		 * if over budget
+		 * \throw std::runtime_error on a missing material */
+		void Load(Region &Reg) const;
+
+		/** Drop least recently used regions (not Keep) until
+		 * resident spheres fit the budget; Guard is locked */
+		void Evict(const Region &Keep) const;
+
+	public:
+		/**
+		 * Open regions of a binary scene file.
+		 * \param Records	Region table, checked by caller
+		 * \param SphereOffset	File offset of sphere records
+		 * \param Budget	Bytes of resident spheres
+		 * \throw std::runtime_error if file can't be opened
+		 */
+		RegionSet(const std::string &File,
+			  const std::vector<const Material *> &Materials,
+			  const BinaryRegion *Records, UInt Count,
+			  uint64_t SphereOffset, size_t Budget);
+
+		~RegionSet();
+
+		virtual const Object *Collide(const Render::Ray &R,
+					      Double &RayPos,
+					      HitStorage &Hit) const;
+
+		virtual void Bounds(Math::Vector &Center, Double &Radius) const {
+			Center = this->Center;
+			Radius = this->Radius;
+		}
+
+		virtual Bool IsSpecular() const {
+			return Specular;
+		}
+
+		/** \return Number of regions */
+		inline UInt GetCount() const {
+			return Count;
+		}
+	};
+};
+
+#endif
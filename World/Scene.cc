@@ -17,6 +17,8 @@
 #include "World/Scene.hh"
 
 namespace World {
+	__thread unsigned long long Scene::Tests = 0;
+	size_t Scene::RegionBudget = 0;
 
 	Scene::~Scene()
 	{
@@ -25,32 +27,51 @@ namespace World {
 
 	void Scene::Purge()
 	{
-		for (std::vector<Object *>::iterator i = this->Objects.begin();
-		     i != this->Objects.end();
+		for (std::vector<Object *>::iterator i = this->HeapObjects.begin();
+		     i != this->HeapObjects.end();
+		     i++)
+			delete *i;
+
+		for (std::vector<Light *>::iterator i = this->HeapLights.begin();
+		     i != this->HeapLights.end();
 		     i++)
 			delete *i;
 
-		for (std::vector<Light *>::iterator i = this->Lights.begin();
-		     i != this->Lights.end();
+		for (std::vector<Material *>::iterator i = this->HeapMaterials.begin();
+		     i != this->HeapMaterials.end();
 		     i++)
 			delete *i;
 
-		for (std::vector<Material *>::iterator i = this->Materials.begin();
-		     i != this->Materials.end();
+		for (std::vector<Texture *>::iterator i = this->HeapTextures.begin();
+		     i != this->HeapTextures.end();
 		     i++)
 			delete *i;
 
-		for (std::vector<Texture *>::iterator i = this->Textures.begin();
-		     i != this->Textures.end();
+		for (std::vector<Aggregate *>::iterator i = this->Aggregates.begin();
+		     i != this->Aggregates.end();
 		     i++)
 			delete *i;
 
+		Aggregates.clear();
+		HeapObjects.clear();
+		HeapLights.clear();
+		HeapMaterials.clear();
+		HeapTextures.clear();
+		Objects.clear();
+		Lights.clear();
+		Materials.clear();
+		Textures.clear();
+
+		/* Items in the arena own no memory of their own */
+		Memory.Release();
 	}
 
-	Bool Scene::Collide(const Render::Ray &R, Double &RayPos, const Object* &O) const
+	Bool Scene::Collide(const Render::Ray &R, Double &RayPos, const Object* &O,
+			    HitStorage &Hit) const
 	{
 		Bool SceneCol = false;
 		RayPos = std::numeric_limits<double>::infinity();
+		Tests += Objects.size();
 		std::vector<Object *>::const_iterator i;
 		for (i = this->Objects.begin();
 		     i != this->Objects.end();
@@ -65,9 +86,21 @@ namespace World {
 				SceneCol = true;
 			}
 		}
+
+		for (UInt a = 0; a < Aggregates.size(); a++)
+			if (const Object *A = Aggregates[a]->Collide(R, RayPos,
+								     Hit)) {
+				O = A;
+				SceneCol = true;
+			}
 		return SceneCol;
 	}
 
+	void Scene::SetRegionBudget(size_t Bytes)
+	{
+		RegionBudget = Bytes;
+	}
+
 	/*@{Iterator specializations constructing 
 	 * iterator from different Scene members */
 	template<> Scene::Iterator<Light>::Iterator(const Scene &S)
@@ -78,5 +111,7 @@ namespace World {
 		: Cur(S.Textures.begin()), End(S.Textures.end()) {}
 	template<> Scene::Iterator<Material>::Iterator(const Scene &S)
 		: Cur(S.Materials.begin()), End(S.Materials.end()) {}
+	template<> Scene::Iterator<Aggregate>::Iterator(const Scene &S)
+		: Cur(S.Aggregates.begin()), End(S.Aggregates.end()) {}
 	/*@}*/
 };
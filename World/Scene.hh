@@ -14,13 +14,15 @@
 #define _SCENE_H_
 
 #include <vector>
-#include <map>
 #include <stdexcept>
 
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "General/Debug.hh"
+#include "General/Interner.hh"
+#include "General/Arena.hh"
 #include "Render/Ray.hh"
 
 #include "World/Color.hh"
@@ -28,8 +30,8 @@
 #include "World/Material.hh"
 
 #include "World/Object.hh"
-#include "World/Plane.hh"
-#include "World/Sphere.hh"
+#include "World/Aggregate.hh"
+#include "World/Primitives.hh"
 
 #include "World/Light.hh"
 #include "World/Camera.hh"
@@ -44,6 +46,9 @@
  *
  */
 namespace World {
+	struct Fragment;
+	class ContentKey;
+
 	/** Nearest taken in account Ray collision */
 	static const Double NearestCollision(0.001);
 
@@ -56,23 +61,45 @@ namespace World {
 	 * of scene lights. Scene frees in it's destructor memory
 	 * allocated for objects in the scene (they must be added
 	 * to the structure with Add* functions.
+	 *
+	 * Readers create items in the scene arena (see GetArena())
+	 * and add them as ARENA; the arena is freed at once. Items
+	 * allocated with plain new are added as HEAP (the default)
+	 * and deleted one by one.
 	 */
 	class Scene {
-		/** Scene materials to be freed */
+		/** Scene materials */
 		std::vector<Material *> Materials;
 
-		/** Scene textures to be freed */
+		/** Scene textures */
 		std::vector<Texture *> Textures;
 
-		/** Scene objects to be freed, we check
+		/** Scene objects, we check
 		 * collisions with this objects.
 		 * \bug rewrite implementation to use octree */
 		std::vector<Object *> Objects;
 
-		/** Lights we iterate during shadowpass.
-		 * Freed during scene destruction */
+		/** Lights we iterate during shadowpass */
 		std::vector<Light *> Lights;
 
+		/** Groups of objects tested after Objects; always
+		 * deleted by the scene */
+		std::vector<Aggregate *> Aggregates;
+
+		/** Bytes of spheres lazy regions may keep in memory;
+		 * 0 reads whole scenes */
+		static size_t RegionBudget;
+
+		/** Memory of items created by readers */
+		General::Arena Memory;
+
+		/**@{ Added items not created in Memory; freed by Purge() */
+		std::vector<Material *> HeapMaterials;
+		std::vector<Texture *> HeapTextures;
+		std::vector<Object *> HeapObjects;
+		std::vector<Light *> HeapLights;
+		/*@}*/
+
 		/** Scene background color */
 		Color Background;
 
@@ -82,6 +109,12 @@ namespace World {
 		/** Camera used to render the scene */
 		Camera C;
 
+		/** All cameras of the scene file (C is the first one) */
+		std::vector<Camera> Cameras;
+
+		/** Names of Cameras; empty if not given */
+		std::vector<std::string> CameraNames;
+
 		/*** Facilities for reading XML Files */
 		/*@{ XML Readers */
 
@@ -98,10 +131,18 @@ namespace World {
 		/** Parse named or given refractive index */
 		Double ParseIdx(xmlNodePtr Node);
 
-		/** Lookup material in library */
-		const Material *GetMaterial(const std::string &id);
-		/** Lookup texture in library */
-		const Texture *GetTexture(const std::string &id);
+		/** Lookup material in library; NULL if not defined */
+		const Material *GetMaterial(const char *id) const;
+		/** Lookup texture in library; NULL if not defined */
+		const Texture *GetTexture(const char *id) const;
+
+		/** Earlier texture with the same parameters or NULL;
+		 * counts read and shared textures */
+		const Texture *SharedTexture(const ContentKey &Key);
+		/** Make texture found by its parameters */
+		void ShareTexture(const ContentKey &Key, const Texture *T);
+		/** Print how many definitions were shared */
+		void ReportShared() const;
 
 		/** Texture parser */
 		void ParseTexture(xmlNodePtr Node);
@@ -113,22 +154,72 @@ namespace World {
 		/** Parse camera data */
 		void ParseCamera(xmlNodePtr Node);
 
-		/** Sphere parser */
-		void ParseSphere(xmlNodePtr Node);
-		/** Plane parser */
-		void ParsePlane(xmlNodePtr Node);
+		/** Sphere parser; returns new object created in A */
+		Object *ParseSphere(xmlNodePtr Node, General::Arena &A);
+		/** Plane parser; returns new object created in A */
+		Object *ParsePlane(xmlNodePtr Node, General::Arena &A);
+		/** Box parser; returns new object created in A */
+		Object *ParseBox(xmlNodePtr Node, General::Arena &A);
+		/** Quaternion Julia parser; returns new object created in A */
+		Object *ParseJulia(xmlNodePtr Node, General::Arena &A);
+		/** Mesh parser; reads the OBJ file it names */
+		Aggregate *ParseMesh(xmlNodePtr Node);
+
+		/** Directory of the scene file being read, with a
+		 * trailing slash; relative mesh files are found there */
+		std::string Directory;
+
+		/** Reset id library before reading a document */
+		void BeginDocument();
+
+		/** Read one child element of the Scene root */
+		void ParseElement(xmlNodePtr Node);
+
+		/**
+		 * Read scene element by element and free the reader.
+		 * Objects are created as their elements close, so
+		 * the document is never held in memory as a whole;
+		 * on error the scene keeps what was read so far.
+		 */
+		Bool ParseReader(xmlTextReaderPtr Reader);
+
+		/** Can the document be read by ParseChunked()? */
+		static Bool Chunkable(const char *Data, size_t Size);
+
+		/**
+		 * Read scene held in memory on all workers. Other
+		 * elements are read in order, while runs of objects
+		 * are split into chunks of text parsed and converted
+		 * in parallel, then added in document order.
+		 */
+		Bool ParseChunked(const char *Data, size_t Size);
+
+		/** Read one top level element from its text */
+		void ParseFragment(const Fragment &F);
+
+		/** Create and add objects of pending fragments */
+		void ParseObjects(std::vector<Fragment> &Pending);
+		friend class ObjectJob;
 		/*@}*/
 
-		/**@{ Loaded items + default items library */
-		std::map<std::string, Color> ColMap;
-		std::map<std::string, const Texture *> TexMap;
-		std::map<std::string, const Material *> MatMap;
-		std::map<std::string, const Double> IdxMap;
+		/**@{ Loaded items + default items library. Names
+		 * of colors, textures, materials and indices share
+		 * one set of IDs; each item kind maps IDs to values */
+		General::Interner Names;
+		General::IDMap<Color> ColMap;
+		General::IDMap<const Texture *> TexMap;
+		General::IDMap<const Material *> MatMap;
+		General::IDMap<Double> IdxMap;
+		/*@}*/
 
-		typedef std::map<std::string, Color>::iterator ColIter;
-		typedef std::map<std::string, const Texture *>::iterator TexIter;
-		typedef std::map<std::string, const Material *>::iterator MatIter;
-		typedef std::map<std::string, const Double>::iterator IdxIter;
+		/**@{ Textures and materials by their parameters
+		 * (see ContentKey); identical definitions under
+		 * other ids share the first instance */
+		General::Interner Contents;
+		General::IDMap<const Texture *> TexByContent;
+		General::IDMap<const Material *> MatByContent;
+		UInt TexturesRead, TexturesShared;
+		UInt MaterialsRead, MaterialsShared;
 		/*@}*/
 
 	public:
@@ -138,7 +229,9 @@ namespace World {
 		      const Double AtmosphereIdx = MatLib::IdxAir)
 			: Background(Background),
 			  AtmosphereIdx(AtmosphereIdx),
-			  C(C) {
+			  C(C),
+			  TexturesRead(0), TexturesShared(0),
+			  MaterialsRead(0), MaterialsShared(0) {
 			Materials.reserve(20);
 			Objects.reserve(20);
 			Lights.reserve(20);
@@ -151,51 +244,129 @@ namespace World {
 		/** Frees all added to scene objects */
 		void Purge();
 
+		/** Arena readers and generators create items in;
+		 * they are freed with the scene */
+		inline General::Arena &GetArena() {
+			return Memory;
+		}
+
+		/** How an added item was allocated */
+		enum Owner {
+			HEAP,	/**< Plain new; deleted by Purge() */
+			ARENA	/**< In GetArena(); freed with it */
+		};
+
 		/** Add object to scene. It will be freed by
 		 * scene destructor */
-		inline void AddObject(Object *O) {
+		inline void AddObject(Object *O, Owner From = HEAP) {
 			if (DEBUG && O == NULL)
 				throw std::invalid_argument
 					("Argument can't be a NULL pointer");
+			if (DEBUG && (From == ARENA) != Memory.Owns(O))
+				throw std::invalid_argument
+					("Item isn't where Owner says");
 			Objects.push_back(O);
+			if (From == HEAP)
+				HeapObjects.push_back(O);
 		}
 
 		/** Add light to the scene. It will be freed
 		 * by scene destructor */
-		inline void AddLight(Light *L) {
+		inline void AddLight(Light *L, Owner From = HEAP) {
 			if (DEBUG && L == NULL)
 				throw std::invalid_argument
 					("Argument can't be a NULL pointer");
+			if (DEBUG && (From == ARENA) != Memory.Owns(L))
+				throw std::invalid_argument
+					("Item isn't where Owner says");
 			Lights.push_back(L);
+			if (From == HEAP)
+				HeapLights.push_back(L);
 		}
 
 		/** Add material to the scene. It will be freed
 		 * by scene destructor */
-		inline void AddMaterial(Material *M) {
+		inline void AddMaterial(Material *M, Owner From = HEAP) {
 			if (DEBUG && M == NULL)
 				throw std::invalid_argument
 					("Argument can't be a NULL pointer");
+			if (DEBUG && (From == ARENA) != Memory.Owns(M))
+				throw std::invalid_argument
+					("Item isn't where Owner says");
 			Materials.push_back(M);
+			if (From == HEAP)
+				HeapMaterials.push_back(M);
 		}
 
 		/** Add texture to the scene. It will be freed
 		 * by scene destructor */
-		inline void AddTexture(Texture *T) {
+		inline void AddTexture(Texture *T, Owner From = HEAP) {
 			if (DEBUG && T == NULL)
 				throw std::invalid_argument
 					("Argument can't be a NULL pointer");
+			if (DEBUG && (From == ARENA) != Memory.Owns(T))
+				throw std::invalid_argument
+					("Item isn't where Owner says");
 			Textures.push_back(T);
+			if (From == HEAP)
+				HeapTextures.push_back(T);
 		}
 
+		/** Add group of objects to the scene. It will be
+		 * freed by scene destructor */
+		inline void AddAggregate(Aggregate *A) {
+			if (DEBUG && A == NULL)
+				throw std::invalid_argument
+					("Argument can't be a NULL pointer");
+			Aggregates.push_back(A);
+		}
+
+		/**
+		 * Read spheres of binary scenes with a region table
+		 * only when rays reach them, keeping at most Bytes of
+		 * them in memory (see RegionSet); 0 reads everything
+		 * at once. Applies to scenes loaded afterwards.
+		 */
+		static void SetRegionBudget(size_t Bytes);
+
+		/** Object intersection tests done by the calling
+		 * thread so far; for cost statistics */
+		static __thread unsigned long long Tests;
+
 		/**
 		 * Finds nearest collision of ray with scene object.
+		 * \param Hit	Storage for an object hit inside an
+		 *		aggregate; O may point into it, so it
+		 *		must be kept while O is used
 		 * \bug This should be implemented using an octree, not a vector.
 		 */
-		Bool Collide(const Render::Ray &R, Double &RayPos, const Object* &O) const;
+		Bool Collide(const Render::Ray &R, Double &RayPos, const Object* &O,
+			     HitStorage &Hit) const;
 
-		/** Reader */
+		/** Reader of XML or binary (see SaveBinary()) scene file */
 		Bool ParseFile(const std::string &File);
 
+		/**
+		 * Write scene in binary format. Objects are grouped
+		 * by type, so their order may change.
+		 * \param RegionSize	If not 0, spheres are grouped into
+		 *			regions of at most that many, which
+		 *			may be loaded lazily
+		 * \throw std::runtime_error if writing fails or scene
+		 * has objects/textures binary format doesn't know
+		 */
+		void SaveBinary(const std::string &File,
+				UInt RegionSize = 0) const;
+
+		/** Read scene written by SaveBinary() */
+		Bool LoadBinary(const std::string &File);
+
+		/** Does file start as a binary scene? */
+		static Bool IsBinary(const std::string &File);
+
+		/** Reader of a scene description held in memory */
+		Bool ParseMemory(const std::string &XML);
+
 		/** Scene background accessor */
 		inline const Color &GetBackground() const {
 			return this->Background;
@@ -211,6 +382,21 @@ namespace World {
 			return this->C;
 		}
 
+		/** Number of cameras defined (at least one) */
+		inline Int GetCameraCount() const {
+			return Cameras.empty() ? 1 : Int(Cameras.size());
+		}
+
+		/** Camera number Idx in file order */
+		inline const Camera &GetCamera(Int Idx) const {
+			return Cameras.empty() ? this->C : Cameras[Idx];
+		}
+
+		/** Name of camera number Idx ("" if not given) */
+		inline std::string GetCameraName(Int Idx) const {
+			return CameraNames.empty() ? "" : CameraNames[Idx];
+		}
+
 		/** \brief Template class for simplified scene iterators */
 		template<typename T>
 		class Iterator {
@@ -239,6 +425,7 @@ namespace World {
 		typedef Iterator<Object> ObjectIterator;
 		typedef Iterator<Texture> TextureIterator;
 		typedef Iterator<Material> MaterialIterator;
+		typedef Iterator<Aggregate> AggregateIterator;
 		/*@}*/
 	};
 
@@ -0,0 +1,523 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "General/MappedFile.hh"
+#include "General/Profile.hh"
+#include "World/Scene.hh"
+#include "World/SceneBinary.hh"
+#include "World/Region.hh"
+
+namespace World {
+	/** Size of each section record */
+	static const size_t RecordSize[SECTIONS] = {
+		1, sizeof(BinaryColor), sizeof(BinaryTexture),
+		sizeof(BinaryMaterial), sizeof(BinaryPrimitive),
+		sizeof(BinaryPrimitive), sizeof(BinaryLight),
+		sizeof(BinaryCamera), sizeof(BinaryRegion)
+	};
+
+	template<typename T>
+	static inline void Store(double *Out, const T &V)
+	{
+		Out[0] = V[0];
+		Out[1] = V[1];
+		Out[2] = V[2];
+	}
+
+	static inline Math::Vector Load(const double *In)
+	{
+		return Math::Vector(In[0], In[1], In[2]);
+	}
+
+	/** \brief Tables of a scene being written */
+	class BinaryWriter {
+	public:
+		std::string Strings;
+		std::vector<BinaryColor> Colors;
+		std::vector<BinaryTexture> Textures;
+		std::vector<BinaryMaterial> Materials;
+		std::vector<BinaryPrimitive> Spheres, Planes;
+		std::vector<BinaryLight> Lights;
+		std::vector<BinaryCamera> Cameras;
+
+		std::map<std::vector<double>, uint32_t> ColorIdx;
+		std::map<const Texture *, uint32_t> TextureIdx;
+		std::map<const Material *, uint32_t> MaterialIdx;
+
+		/** Each distinct string is stored once */
+		General::Interner StringIDs;
+		std::vector<uint32_t> StringOffsets;
+
+		uint32_t AddColor(const Color &C) {
+			std::vector<double> Key(3);
+			Key[0] = C[0];
+			Key[1] = C[1];
+			Key[2] = C[2];
+			std::map<std::vector<double>, uint32_t>::iterator i =
+				ColorIdx.find(Key);
+			if (i != ColorIdx.end())
+				return i->second;
+			BinaryColor B;
+			std::copy(Key.begin(), Key.end(), B.RGB);
+			Colors.push_back(B);
+			return ColorIdx[Key] = uint32_t(Colors.size() - 1);
+		}
+
+		uint32_t AddTexture(const Texture *T) {
+			std::map<const Texture *, uint32_t>::iterator i =
+				TextureIdx.find(T);
+			if (i != TextureIdx.end())
+				return i->second;
+
+			BinaryTexture B;
+			memset(&B, 0, sizeof(B));
+			B.Tiled = T->IsTiled();
+			B.SizeU = T->GetSizeU();
+			B.SizeV = T->GetSizeV();
+			const TexLib::Plain *P =
+				dynamic_cast<const TexLib::Plain *>(T);
+			const TexLib::Checked *C =
+				dynamic_cast<const TexLib::Checked *>(T);
+			if (P) {
+				B.Type = BinaryTexture::PLAIN;
+				B.A = B.B = AddColor(P->GetColor());
+			} else if (C) {
+				B.Type = BinaryTexture::CHECKED;
+				B.A = AddColor(C->GetColorA());
+				B.B = AddColor(C->GetColorB());
+			} else
+				throw std::runtime_error(
+					"Texture type not supported"
+					" by binary scene format");
+			Textures.push_back(B);
+			return TextureIdx[T] = uint32_t(Textures.size() - 1);
+		}
+
+		uint32_t AddMaterial(const Material *M) {
+			std::map<const Material *, uint32_t>::iterator i =
+				MaterialIdx.find(M);
+			if (i != MaterialIdx.end())
+				return i->second;
+
+			static const Material::Filter Filters[4] = {
+				Material::DIFFUSE, Material::SPECULAR,
+				Material::REFRACT, Material::REFLECT
+			};
+			BinaryMaterial B;
+			for (Int f = 0; f < 4; f++)
+				B.Textures[f] = AddTexture(
+					&M->GetTexture(Filters[f]));
+			B.Reflective = M->GetProperty(Material::REFLECTIVE);
+			B.Refractive = M->GetProperty(Material::REFRACTIVE);
+			B.Absorptive = M->GetProperty(Material::ABSORPTIVE);
+			B.Shininess = M->GetProperty(Material::SHININESS);
+			B.Index = M->GetProperty(Material::INDEX);
+			Materials.push_back(B);
+			return MaterialIdx[M] = uint32_t(Materials.size() - 1);
+		}
+
+		uint32_t AddString(const std::string &S) {
+			if (S == "")
+				return NoName;
+			const UInt ID = StringIDs.Intern(S);
+			if (ID < StringOffsets.size())
+				return StringOffsets[ID];
+			StringOffsets.push_back(uint32_t(Strings.size()));
+			Strings += S;
+			Strings += '\0';
+			return StringOffsets.back();
+		}
+	};
+
+	/** Write section data padded to 8 bytes */
+	template<typename T>
+	static void WriteSection(std::ofstream &Out, const std::vector<T> &V)
+	{
+		static const char Zero[8] = { 0 };
+		const size_t Size = V.size() * sizeof(T);
+		if (Size)
+			Out.write((const char *)&V[0], Size);
+		Out.write(Zero, (8 - Size % 8) % 8);
+	}
+
+	/** \brief Orders sphere records by center along an axis */
+	class ByAxis {
+		const Int Axis;
+	public:
+		ByAxis(Int Axis) : Axis(Axis) {}
+		inline bool operator()(const BinaryPrimitive &A,
+				       const BinaryPrimitive &B) const {
+			return A.V[Axis] < B.V[Axis];
+		}
+	};
+
+	/** Order spheres [From, To) into regions of at most Size
+	 * spheres by median splits along the longest axis */
+	static void Partition(std::vector<BinaryPrimitive> &S,
+			      uint32_t From, uint32_t To, uint32_t Size,
+			      std::vector<BinaryRegion> &Out)
+	{
+		double Min[3], Max[3];
+		for (Int a = 0; a < 3; a++) {
+			Min[a] = Max[a] = S[From].V[a];
+			for (uint32_t i = From; i < To; i++) {
+				Min[a] = std::min(Min[a], S[i].V[a]);
+				Max[a] = std::max(Max[a], S[i].V[a]);
+			}
+		}
+
+		if (To - From > Size) {
+			Int Axis = 0;
+			for (Int a = 1; a < 3; a++)
+				if (Max[a] - Min[a] > Max[Axis] - Min[Axis])
+					Axis = a;
+			const uint32_t Mid = From + (To - From) / 2;
+			std::nth_element(S.begin() + From, S.begin() + Mid,
+					 S.begin() + To, ByAxis(Axis));
+			Partition(S, From, Mid, Size, Out);
+			Partition(S, Mid, To, Size, Out);
+			return;
+		}
+
+		BinaryRegion R;
+		memset(&R, 0, sizeof(R));
+		for (Int a = 0; a < 3; a++) {
+			R.Min[a] = S[From].V[a] - S[From].Scalar;
+			R.Max[a] = S[From].V[a] + S[From].Scalar;
+			for (uint32_t i = From; i < To; i++) {
+				R.Min[a] = std::min(R.Min[a],
+						    S[i].V[a] - S[i].Scalar);
+				R.Max[a] = std::max(R.Max[a],
+						    S[i].V[a] + S[i].Scalar);
+			}
+		}
+		R.First = From;
+		R.Count = To - From;
+		Out.push_back(R);
+	}
+
+	void Scene::SaveBinary(const std::string &File, UInt RegionSize) const
+	{
+		if (!Aggregates.empty())
+			throw std::runtime_error(
+				"Scene with object groups can't be"
+				" written in binary format");
+		BinaryWriter W;
+
+		/* Own materials first, so their order is kept */
+		for (UInt i = 0; i < Materials.size(); i++)
+			W.AddMaterial(Materials[i]);
+
+		for (UInt i = 0; i < Objects.size(); i++) {
+			const Object *O = Objects[i];
+			BinaryPrimitive B;
+			memset(&B, 0, sizeof(B));
+			B.Material = W.AddMaterial(&O->GetMaterial());
+
+			const Plane *P = dynamic_cast<const Plane *>(O);
+			Math::Vector Center;
+			Double Radius;
+			if (P) {
+				Store(B.V, P->GetNormal());
+				B.Scalar = P->GetDistance();
+				W.Planes.push_back(B);
+			} else if (dynamic_cast<const Sphere *>(O) &&
+				   O->Bounds(Center, Radius)) {
+				Store(B.V, Center);
+				B.Scalar = Radius;
+				W.Spheres.push_back(B);
+			} else
+				throw std::runtime_error(
+					"Object type not supported"
+					" by binary scene format");
+		}
+
+		for (UInt i = 0; i < Lights.size(); i++) {
+			BinaryLight B;
+			memset(&B, 0, sizeof(B));
+			B.Color = W.AddColor(Lights[i]->GetColor());
+			const PointLight *P =
+				dynamic_cast<const PointLight *>(Lights[i]);
+			if (P) {
+				B.Type = BinaryLight::POINT;
+				Store(B.Position, P->GetPosition());
+			} else
+				B.Type = BinaryLight::AMBIENT;
+			W.Lights.push_back(B);
+		}
+
+		/* Scene built in memory has only the main camera */
+		for (Int i = 0; i < GetCameraCount(); i++) {
+			const Camera &C = GetCamera(i);
+			BinaryCamera B;
+			memset(&B, 0, sizeof(B));
+			Store(B.Pos, C.GetPosition());
+			Store(B.Dir, C.GetDirection());
+			Store(B.Top, C.GetTop());
+			B.FOV = C.GetFOV();
+			B.Name = W.AddString(GetCameraName(i));
+			W.Cameras.push_back(B);
+		}
+
+		std::vector<BinaryRegion> Regions;
+		if (RegionSize > 0 && !W.Spheres.empty())
+			Partition(W.Spheres, 0, W.Spheres.size(), RegionSize,
+				  Regions);
+
+		std::vector<char> Strings(W.Strings.begin(), W.Strings.end());
+		const size_t Counts[SECTIONS] = {
+			Strings.size(), W.Colors.size(), W.Textures.size(),
+			W.Materials.size(), W.Spheres.size(), W.Planes.size(),
+			W.Lights.size(), W.Cameras.size(), Regions.size()
+		};
+
+		BinaryHeader H;
+		memset(&H, 0, sizeof(H));
+		memcpy(H.Magic, BinaryMagic, sizeof(H.Magic));
+		H.Version = BinaryVersion;
+		H.Order = BinaryOrder;
+		H.Sections = SECTIONS;
+		Store(H.Background, Background);
+		H.Atmosphere = AtmosphereIdx;
+
+		BinarySection Table[SECTIONS];
+		uint64_t Offset = sizeof(H) + sizeof(Table);
+		for (Int s = 0; s < SECTIONS; s++) {
+			if (Counts[s] > 0xFFFFFFFFUL)
+				throw std::runtime_error(
+					"Scene too large for binary format");
+			Table[s].Type = s;
+			Table[s].Count = uint32_t(Counts[s]);
+			Table[s].Offset = Offset;
+			Offset += (Counts[s] * RecordSize[s] + 7) / 8 * 8;
+		}
+
+		std::ofstream Out(File.c_str(), std::ios::binary);
+		Out.write((const char *)&H, sizeof(H));
+		Out.write((const char *)Table, sizeof(Table));
+		WriteSection(Out, Strings);
+		WriteSection(Out, W.Colors);
+		WriteSection(Out, W.Textures);
+		WriteSection(Out, W.Materials);
+		WriteSection(Out, W.Spheres);
+		WriteSection(Out, W.Planes);
+		WriteSection(Out, W.Lights);
+		WriteSection(Out, W.Cameras);
+		WriteSection(Out, Regions);
+		Out.close();
+		if (!Out)
+			throw std::runtime_error("Unable to write " + File);
+	}
+
+	Bool Scene::IsBinary(const std::string &File)
+	{
+		char Magic[sizeof(BinaryMagic)];
+		std::ifstream In(File.c_str(), std::ios::binary);
+		In.read(Magic, sizeof(Magic));
+		return In && memcmp(Magic, BinaryMagic, sizeof(Magic)) == 0;
+	}
+
+	/** \return Records of section S, checked to lie in the file */
+	template<typename T>
+	static const T *Records(const General::MappedFile &Map,
+				const BinarySection *Table, Int S)
+	{
+		const BinarySection &Sec = Table[S];
+		const size_t Size = Map.GetSize();
+		if (Sec.Type != uint32_t(S) || Sec.Offset % 8 != 0 ||
+		    Sec.Offset > Size ||
+		    uint64_t(Sec.Count) * RecordSize[S] > Size - Sec.Offset)
+			throw std::runtime_error(
+				"Corrupted binary scene section");
+		return (const T *)(Map.GetData() + Sec.Offset);
+	}
+
+	/** Check index read from file */
+	static inline uint32_t Index(uint32_t I, uint32_t Count)
+	{
+		if (I >= Count)
+			throw std::runtime_error(
+				"Binary scene refers to a missing record");
+		return I;
+	}
+
+	Bool Scene::LoadBinary(const std::string &File)
+	{
+		General::Profile::Scope S(General::Profile::BUILD);
+		try {
+			const General::MappedFile Map(File);
+			if (Map.GetSize() < sizeof(BinaryHeader))
+				throw std::runtime_error("File is too short");
+			const BinaryHeader &H =
+				*(const BinaryHeader *)Map.GetData();
+			if (memcmp(H.Magic, BinaryMagic, sizeof(H.Magic)) != 0)
+				throw std::runtime_error(
+					"Not a binary scene file");
+			if (H.Order != BinaryOrder)
+				throw std::runtime_error(
+					"Binary scene of other byte order");
+			const uint32_t Sections =
+				H.Version == 1 ? SectionsV1 : SECTIONS;
+			if (H.Version < 1 || H.Version > BinaryVersion ||
+			    H.Sections != Sections || Map.GetSize() < sizeof(H) +
+			    Sections * sizeof(BinarySection))
+				throw std::runtime_error(
+					"Unsupported binary scene version");
+			const BinarySection *Table =
+				(const BinarySection *)(Map.GetData() + sizeof(H));
+
+			const char *Strings = Records<char>(Map, Table, STRINGS);
+			const BinaryColor *Col =
+				Records<BinaryColor>(Map, Table, COLORS);
+			const BinaryTexture *Tex =
+				Records<BinaryTexture>(Map, Table, TEXTURES);
+			const BinaryMaterial *Mat =
+				Records<BinaryMaterial>(Map, Table, MATERIALS);
+			const BinaryPrimitive *Sph =
+				Records<BinaryPrimitive>(Map, Table, SPHERES);
+			const BinaryPrimitive *Pla =
+				Records<BinaryPrimitive>(Map, Table, PLANES);
+			const BinaryLight *Lig =
+				Records<BinaryLight>(Map, Table, LIGHTS);
+			const BinaryCamera *Cam =
+				Records<BinaryCamera>(Map, Table, CAMERAS);
+			const uint32_t RegCount =
+				Sections > REGIONS ? Table[REGIONS].Count : 0;
+			const BinaryRegion *Reg = RegCount == 0 ? NULL
+				: Records<BinaryRegion>(Map, Table, REGIONS);
+			const uint32_t StrCount = Table[STRINGS].Count;
+			const uint32_t ColCount = Table[COLORS].Count;
+			if (StrCount > 0 && Strings[StrCount - 1] != '\0')
+				throw std::runtime_error(
+					"Corrupted binary scene strings");
+
+			BeginDocument();
+			Background = Color(H.Background[0], H.Background[1],
+					   H.Background[2]);
+			AtmosphereIdx = H.Atmosphere;
+
+			std::vector<const Texture *> TexTable;
+			TexTable.reserve(Table[TEXTURES].Count);
+			for (uint32_t i = 0; i < Table[TEXTURES].Count; i++) {
+				const BinaryTexture &B = Tex[i];
+				const double *A = Col[Index(B.A, ColCount)].RGB;
+				Texture *T;
+				if (B.Type == BinaryTexture::PLAIN)
+					T = new (Memory) TexLib::Plain(
+						Color(A[0], A[1], A[2]));
+				else if (B.Type == BinaryTexture::CHECKED) {
+					const double *C =
+						Col[Index(B.B, ColCount)].RGB;
+					T = new (Memory) TexLib::Checked(
+						Color(A[0], A[1], A[2]),
+						Color(C[0], C[1], C[2]),
+						B.SizeU, B.SizeV, B.Tiled != 0);
+				} else
+					throw std::runtime_error(
+						"Unknown texture type"
+						" in binary scene");
+				AddTexture(T, ARENA);
+				TexTable.push_back(T);
+			}
+
+			std::vector<const Material *> MatTable;
+			MatTable.reserve(Table[MATERIALS].Count);
+			const uint32_t TexCount = TexTable.size();
+			for (uint32_t i = 0; i < Table[MATERIALS].Count; i++) {
+				const BinaryMaterial &B = Mat[i];
+				Material *M = new (Memory) Material(
+					*TexTable[Index(B.Textures[0], TexCount)],
+					*TexTable[Index(B.Textures[1], TexCount)],
+					*TexTable[Index(B.Textures[2], TexCount)],
+					*TexTable[Index(B.Textures[3], TexCount)],
+					B.Reflective, B.Refractive,
+					B.Absorptive, B.Shininess, B.Index);
+				AddMaterial(M, ARENA);
+				MatTable.push_back(M);
+			}
+
+			const uint32_t MatCount = MatTable.size();
+
+			/* Spheres of regions are read when rays need them */
+			uint32_t SphCount = Table[SPHERES].Count;
+			if (RegCount > 0 && RegionBudget > 0) {
+				for (uint32_t i = 0; i < RegCount; i++)
+					if (Reg[i].First > SphCount ||
+					    Reg[i].Count > SphCount - Reg[i].First)
+						throw std::runtime_error(
+							"Corrupted binary scene"
+							" region");
+				RegionSet *Set = new RegionSet(
+					File, MatTable, Reg, RegCount,
+					Table[SPHERES].Offset, RegionBudget);
+				AddAggregate(Set);
+				std::cout << "*** Lazy regions: " << RegCount
+					  << " holding " << SphCount << " spheres"
+					  << std::endl;
+				SphCount = 0;
+			}
+
+			Objects.reserve(Objects.size() + SphCount
+					+ Table[PLANES].Count);
+			/* All primitives in one block, in file order */
+			Memory.Reserve(SphCount * sizeof(Sphere)
+				      + Table[PLANES].Count * sizeof(Plane)
+				      + 16 * (SphCount + Table[PLANES].Count));
+			for (uint32_t i = 0; i < SphCount; i++)
+				AddObject(new (Memory) Sphere(
+					Load(Sph[i].V), Sph[i].Scalar,
+					*MatTable[Index(Sph[i].Material,
+							 MatCount)]), ARENA);
+			for (uint32_t i = 0; i < Table[PLANES].Count; i++)
+				AddObject(new (Memory) Plane(
+					Load(Pla[i].V), Pla[i].Scalar,
+					*MatTable[Index(Pla[i].Material,
+							 MatCount)]), ARENA);
+
+			for (uint32_t i = 0; i < Table[LIGHTS].Count; i++) {
+				const BinaryLight &B = Lig[i];
+				const double *C = Col[Index(B.Color, ColCount)].RGB;
+				if (B.Type == BinaryLight::POINT)
+					AddLight(new (Memory) PointLight(
+						Load(B.Position),
+						Color(C[0], C[1], C[2])), ARENA);
+				else
+					AddLight(new (Memory) AmbientLight(
+						Color(C[0], C[1], C[2])), ARENA);
+			}
+
+			for (uint32_t i = 0; i < Table[CAMERAS].Count; i++) {
+				const BinaryCamera &B = Cam[i];
+				Cameras.push_back(Camera(Load(B.Pos), Load(B.Dir),
+							 B.FOV, false,
+							 Load(B.Top)));
+				CameraNames.push_back(B.Name == NoName ? ""
+					: Strings + Index(B.Name, StrCount));
+			}
+			if (!Cameras.empty())
+				this->C = Cameras.front();
+			return true;
+		} catch (std::exception &e) {
+			std::cout << "*** Error while reading binary scene:"
+				  << std::endl << e.what() << std::endl;
+			return false;
+		}
+	}
+};
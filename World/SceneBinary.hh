@@ -0,0 +1,118 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _SCENEBINARY_H_
+#define _SCENEBINARY_H_
+
+#include <stdint.h>
+
+/*
+ * Binary scene file, version 2. All numbers are stored in host
+ * byte order (checked on load) and every section starts at an
+ * 8 byte boundary so records may be read straight from the map:
+ *
+ *	BinaryHeader
+ *	BinarySection[Sections]	- Type, record count, offset
+ *	sections			- arrays of records below
+ *
+ * Textures point to the color table, materials to the texture
+ * table and primitives to the material table, all by index.
+ * Camera names are offsets into the string table.
+ *
+ * Version 2 adds the region table: spheres may be grouped by
+ * location, each region giving the bounding box and the range of
+ * its spheres, so they can be read only when needed (see
+ * RegionSet). Version 1 files have no region table.
+ */
+namespace World {
+	static const char BinaryMagic[8] = { 'b', 'l', 'a', 'R', 'A', 'Y',
+					     'S', 'C' };
+	static const uint32_t BinaryVersion = 2;
+	static const uint32_t BinaryOrder = 0x01020304;
+	static const uint32_t NoName = 0xFFFFFFFF;
+
+	/** \brief Start of binary scene file */
+	struct BinaryHeader {
+		char Magic[8];
+		uint32_t Version;
+		uint32_t Order;
+		uint32_t Sections;
+		uint32_t Reserved;
+		double Background[3];
+		double Atmosphere;
+	};
+
+	/** \brief Section table entry */
+	struct BinarySection {
+		uint32_t Type;
+		uint32_t Count;
+		uint64_t Offset;
+	};
+
+	/** Section types */
+	enum { STRINGS, COLORS, TEXTURES, MATERIALS, SPHERES, PLANES,
+	       LIGHTS, CAMERAS, REGIONS, SECTIONS };
+
+	/** Sections of version 1 files */
+	static const uint32_t SectionsV1 = REGIONS;
+
+	struct BinaryColor {
+		double RGB[3];
+	};
+
+	struct BinaryTexture {
+		enum { PLAIN, CHECKED };
+		uint32_t Type;
+		uint32_t Tiled;
+		uint32_t A, B;		/**< Colors; B unused by PLAIN */
+		double SizeU, SizeV;
+	};
+
+	struct BinaryMaterial {
+		/** Diffuse, specular, refract and reflect textures */
+		uint32_t Textures[4];
+		double Reflective, Refractive, Absorptive;
+		double Shininess, Index;
+	};
+
+	/** \brief Sphere (center, radius) or plane (normal, distance) */
+	struct BinaryPrimitive {
+		double V[3];
+		double Scalar;
+		uint32_t Material;
+		uint32_t Pad;
+	};
+
+	struct BinaryLight {
+		enum { AMBIENT, POINT };
+		uint32_t Type;
+		uint32_t Color;
+		double Position[3];
+	};
+
+	struct BinaryCamera {
+		double Pos[3], Dir[3], Top[3];
+		double FOV;
+		uint32_t Name;
+		uint32_t Pad;
+	};
+
+	/** \brief Spheres [First, First + Count) and their bounds */
+	struct BinaryRegion {
+		double Min[3], Max[3];
+		uint32_t First;
+		uint32_t Count;
+	};
+};
+
+#endif
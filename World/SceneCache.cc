@@ -0,0 +1,109 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "World/SceneCache.hh"
+
+namespace World {
+	SceneCache::SceneCache(UInt Capacity)
+		: Capacity(Capacity), Hits(0), Misses(0)
+	{
+	}
+
+	SceneCache::~SceneCache()
+	{
+		while (!Entries.empty()) {
+			Unref(Entries.front());
+			Entries.pop_front();
+		}
+	}
+
+	void SceneCache::Unref(Entry *E)
+	{
+		if (--E->Refs > 0)
+			return;
+		delete E->S;
+		delete E;
+	}
+
+	Bool SceneCache::Acquire(const std::string &Path, Handle &H)
+	{
+		struct stat St;
+		if (stat(Path.c_str(), &St) != 0)
+			return false;
+
+		{
+			General::Lock L(Guard);
+			std::list<Entry *>::iterator i;
+			for (i = Entries.begin(); i != Entries.end(); i++) {
+				Entry *E = *i;
+				if (E->Path != Path)
+					continue;
+				if (E->MTime != St.st_mtime) {
+					/* Stale; users keep their copy */
+					Entries.erase(i);
+					Unref(E);
+					break;
+				}
+				Entries.erase(i);
+				Entries.push_front(E);
+				E->Refs++;
+				Hits++;
+				H.E = E;
+				return true;
+			}
+		}
+
+		Scene *S = new Scene;
+		if (!S->ParseFile(Path)) {
+			delete S;
+			return false;
+		}
+
+		Entry *E = new Entry;
+		E->Path = Path;
+		E->MTime = St.st_mtime;
+		E->S = S;
+		E->Refs = 2;
+
+		General::Lock L(Guard);
+		/* Another thread may have parsed it meanwhile; both
+		 * copies are valid, the newer one is kept */
+		for (std::list<Entry *>::iterator i = Entries.begin();
+		     i != Entries.end(); i++)
+			if ((*i)->Path == Path) {
+				Unref(*i);
+				Entries.erase(i);
+				break;
+			}
+		Entries.push_front(E);
+		while (Entries.size() > Capacity) {
+			Unref(Entries.back());
+			Entries.pop_back();
+		}
+		Misses++;
+		H.E = E;
+		return true;
+	}
+
+	void SceneCache::Release(Handle &H)
+	{
+		if (H.E == NULL)
+			return;
+		General::Lock L(Guard);
+		Unref(H.E);
+		H.E = NULL;
+	}
+}
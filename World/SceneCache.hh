@@ -0,0 +1,113 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#ifndef _SCENECACHE_H_
+#define _SCENECACHE_H_
+
+#include <string>
+#include <list>
+#include <ctime>
+
+#include "General/Types.hh"
+#include "General/Thread.hh"
+#include "World/Scene.hh"
+
+namespace World {
+
+	/**
+	 * \brief
+	 *	Parsed scenes kept between renders, least recently
+	 *	used ones are dropped.
+	 *
+	 * Scenes are keyed by file path and checked against the file's
+	 * modification time on every Acquire(), so an edited file is
+	 * parsed again. Entries are reference counted: a scene evicted
+	 * or replaced while somebody still renders it is freed only
+	 * after its last Release(). Cache may be used from many threads;
+	 * parsing happens outside of the lock.
+	 */
+	class SceneCache {
+	private:
+		/** \brief Cached scene */
+		struct Entry {
+			std::string Path;
+			time_t MTime;
+			Scene *S;
+			/** Users + 1 while the entry is in the list */
+			Int Refs;
+		};
+
+		/** Max number of cached scenes */
+		const UInt Capacity;
+
+		/** Entries, most recently used first */
+		std::list<Entry *> Entries;
+
+		/** Guards Entries and reference counts */
+		General::Mutex Guard;
+
+		/**@{ Statistics */
+		Int Hits, Misses;
+		/*@}*/
+
+		/** Drop one reference; lock must be held */
+		static void Unref(Entry *E);
+
+		/** Private copy-constructor */
+		SceneCache(const SceneCache &C);
+
+		/** Private operator= */
+		void operator=(const SceneCache &C) const;
+
+	public:
+		/** \brief Scene in use; returned to the cache with Release() */
+		class Handle {
+			Entry *E;
+			friend class SceneCache;
+		public:
+			Handle() : E(NULL) {}
+
+			/** Scene accessor */
+			inline const Scene &operator*() const {
+				return *E->S;
+			}
+		};
+
+		/** Create empty cache */
+		SceneCache(UInt Capacity = 8);
+
+		/** Frees scenes (all handles must be released) */
+		~SceneCache();
+
+		/**
+		 * Get parsed scene of a file.
+		 * \return false if file doesn't exist or doesn't parse
+		 */
+		Bool Acquire(const std::string &Path, Handle &H);
+
+		/** Stop using a scene */
+		void Release(Handle &H);
+
+		/** Cache hits */
+		inline Int GetHits() const {
+			return Hits;
+		}
+
+		/** Scenes parsed */
+		inline Int GetMisses() const {
+			return Misses;
+		}
+	};
+};
+
+#endif
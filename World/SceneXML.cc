@@ -12,7 +12,14 @@
 
 #include <stdexcept>
 #include <iostream>
-
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+
+#include "General/Profile.hh"
+#include "General/Thread.hh"
+#include "General/MappedFile.hh"
 #include "World/Scene.hh"
 
 namespace World {
@@ -25,22 +32,28 @@ namespace World {
 	}
 
 	/** Convert string to double without checking syntax */
-	static Double ToDouble(const std::string &str)
+	static Double ToDouble(const char *str)
 	{
-		std::stringstream os(str);
-		Double a; /** \bug Nah, should I use sscanf?
-			      stringstream is not much predictable */
-		os >> a;
-		return a;
+		return strtod(str, NULL);
 	}
 
+	static inline Double ToDouble(const std::string &str)
+	{
+		return ToDouble(str.c_str());
+	}
+
+	/** Document line before the fragment being read; fragments
+	 * are parsed apart from the document by ParseChunked() */
+	static __thread long LineOffset = 0;
+
 	/** \brief Exception internal to XML reader */
 	class XMLError : public std::runtime_error {
 	public:
 		/** Create exception with file context */
 		XMLError(xmlNodePtr Node, const std::string &Desc)
 			: std::runtime_error(
-				"On line " + ToStr(xmlGetLineNo(Node)) +
+				"On line " +
+				ToStr(xmlGetLineNo(Node) + LineOffset) +
 				": " + Desc)
 		{
 		}
@@ -54,13 +67,13 @@ namespace World {
 
 	/** Check numerical value syntax
 	 * \bug Very c-ish code */
-	static Bool IsDouble(const std::string &str)
+	static Bool IsDouble(const char *str)
 	{
 		Bool WasDot = false;
-		if (str.length() == 0)
+		if (str[0] == '\0')
 			return false;
 		for (UInt i = 0U;
-		     i != str.length();
+		     str[i] != '\0';
 		     i++) {
 			if (str[i] == '-' && i == 0)
 				continue;
@@ -75,27 +88,81 @@ namespace World {
 		return true;
 	}
 
+	static inline Bool IsDouble(const std::string &str)
+	{
+		return IsDouble(str.c_str());
+	}
+
+	/**
+	 * \brief
+	 *	Property value; points into the document tree
+	 *	unless the value had to be assembled.
+	 */
+	class PropText {
+	private:
+		xmlChar *Copy;
+		const char *Text;
+
+		/** Private copy-constructor */
+		PropText(const PropText &P);
+
+		/** Private operator= */
+		void operator=(const PropText &P) const;
+	public:
+		PropText(xmlNodePtr Node, const char *id)
+			: Copy(NULL), Text("") {
+			xmlAttrPtr A = xmlHasProp(Node, (const xmlChar *)id);
+			if (A == NULL)
+				return;
+			xmlNodePtr C = A->children;
+			if (A->type == XML_ATTRIBUTE_NODE &&
+			    (C == NULL ||
+			     (C->type == XML_TEXT_NODE && C->next == NULL))) {
+				if (C && C->content)
+					Text = (const char *)C->content;
+				return;
+			}
+			/* Entity references or DTD default */
+			Copy = xmlGetProp(Node, (const xmlChar *)id);
+			if (Copy)
+				Text = (const char *)Copy;
+		}
+
+		~PropText() {
+			if (Copy)
+				xmlFree(Copy);
+		}
+
+		/** Value; empty if property not given */
+		inline const char *Get() const {
+			return Text;
+		}
+
+		inline size_t Length() const {
+			return strlen(Text);
+		}
+
+		inline Bool Empty() const {
+			return Text[0] == '\0';
+		}
+	};
+
 	/** Helper function retrieving property */
 	static std::string GetProp(xmlNodePtr Node, const char *id)
 	{
-		xmlChar *text = (xmlChar *)xmlGetProp(Node,(const xmlChar *)id);
-		if (text == NULL)
-			return std::string("");
-		std::string t((const char *)text);
-		xmlFree(text);
-		return t;
+		return PropText(Node, id).Get();
 	}
 
 	/** Read compulsory numerical property and convert to double */
 	static Double GetDoubleProp(xmlNodePtr Node, const char *str)
 	{
-		std::string Prop = GetProp(Node, str);
-		if (Prop == "")
+		const PropText Prop(Node, str);
+		if (Prop.Empty())
 			throw XMLError(Node,
 			"Unable to find numerical tag " + std::string(str));
-		if (!IsDouble(Prop))
+		if (!IsDouble(Prop.Get()))
 		    throw XMLError(Node, "Invalid numerical value");
-		Double Val = ToDouble(Prop);
+		Double Val = ToDouble(Prop.Get());
 		/* \bug Do some checking! And return exception */
 		return Val;
 	}
@@ -106,11 +173,11 @@ namespace World {
 				    const char *str,
 				    Double DefaultValue)
 	{
-		std::string Prop = GetProp(Node, str);
-		if (Prop == "")
+		const PropText Prop(Node, str);
+		if (Prop.Empty())
 			return DefaultValue;
 
-		Double Val = ToDouble(Prop);
+		Double Val = ToDouble(Prop.Get());
 		/* \bug Do some checking! And return exception */
 		return Val;
 	}
@@ -164,50 +231,45 @@ namespace World {
 	{
 		using namespace std;
 		cout << "--- Dumping colors: " << endl;
-		for (ColIter i = ColMap.begin();
-		     i != ColMap.end(); i++) {
-			cout << i->first << " == " << i->second << endl;
-		}
+		for (UInt i = 0; i < ColMap.Size(); i++)
+			if (const Color *C = ColMap.Find(i))
+				cout << Names.Name(i) << " == " << *C << endl;
 
 		cout << "--- Dumping textures: " << endl;
-		for (TexIter i = TexMap.begin();
-		     i != TexMap.end(); i++) {
-			cout << i->first << " == " << *i->second << endl;
-		}
+		for (UInt i = 0; i < TexMap.Size(); i++)
+			if (const Texture *const *T = TexMap.Find(i))
+				cout << Names.Name(i) << " == " << **T << endl;
 
 		cout << "--- Dumping materials: " << endl;
-		for (MatIter i = MatMap.begin();
-		     i != MatMap.end(); i++) {
-			cout << i->first << " == " << *i->second << endl;
-		}
+		for (UInt i = 0; i < MatMap.Size(); i++)
+			if (const Material *const *M = MatMap.Find(i))
+				cout << Names.Name(i) << " == " << **M << endl;
 	}
 
 	void Scene::CreateLibrary()
 	{
-		using namespace std;
-
-		ColMap.insert(make_pair(string("Black"), ColLib::Black()));
-		ColMap.insert(make_pair(string("White"), ColLib::White()));
-		ColMap.insert(make_pair(string("Red"), ColLib::Red()));
-		ColMap.insert(make_pair(string("Green"), ColLib::Green()));
-		ColMap.insert(make_pair(string("Blue"), ColLib::Blue()));
-		ColMap.insert(make_pair(string("Gray"), ColLib::Gray()));
-
-		TexMap.insert(make_pair(string("Black"), &TexLib::Black()));
-		TexMap.insert(make_pair(string("White"), &TexLib::White()));
-		TexMap.insert(make_pair(string("Red"), &TexLib::Red()));
-		TexMap.insert(make_pair(string("Green"), &TexLib::Green()));
-		TexMap.insert(make_pair(string("Blue"), &TexLib::Blue()));
-		TexMap.insert(make_pair(string("Gray"), &TexLib::Gray()));
-
-		IdxMap.insert(make_pair(string("Vacuum"), 1.0));
-		IdxMap.insert(make_pair(string("Air"), 1.0002926));
-		IdxMap.insert(make_pair(string("Water"), 1.333));
-		IdxMap.insert(make_pair(string("Diamond"), 2.419));
-		IdxMap.insert(make_pair(string("Amber"), 1.55));
-		IdxMap.insert(make_pair(string("Salt"), 1.544));
-		IdxMap.insert(make_pair(string("Ice"), 1.31));
-		IdxMap.insert(make_pair(string("Glass"), 1.60));
+		ColMap.Insert(Names.Intern("Black"), ColLib::Black());
+		ColMap.Insert(Names.Intern("White"), ColLib::White());
+		ColMap.Insert(Names.Intern("Red"), ColLib::Red());
+		ColMap.Insert(Names.Intern("Green"), ColLib::Green());
+		ColMap.Insert(Names.Intern("Blue"), ColLib::Blue());
+		ColMap.Insert(Names.Intern("Gray"), ColLib::Gray());
+
+		TexMap.Insert(Names.Intern("Black"), &TexLib::Black());
+		TexMap.Insert(Names.Intern("White"), &TexLib::White());
+		TexMap.Insert(Names.Intern("Red"), &TexLib::Red());
+		TexMap.Insert(Names.Intern("Green"), &TexLib::Green());
+		TexMap.Insert(Names.Intern("Blue"), &TexLib::Blue());
+		TexMap.Insert(Names.Intern("Gray"), &TexLib::Gray());
+
+		IdxMap.Insert(Names.Intern("Vacuum"), 1.0);
+		IdxMap.Insert(Names.Intern("Air"), 1.0002926);
+		IdxMap.Insert(Names.Intern("Water"), 1.333);
+		IdxMap.Insert(Names.Intern("Diamond"), 2.419);
+		IdxMap.Insert(Names.Intern("Amber"), 1.55);
+		IdxMap.Insert(Names.Intern("Salt"), 1.544);
+		IdxMap.Insert(Names.Intern("Ice"), 1.31);
+		IdxMap.Insert(Names.Intern("Glass"), 1.60);
 	}
 
 	Color Scene::ParseColor(xmlNodePtr Node)
@@ -233,9 +295,9 @@ namespace World {
 
 		if (id != "") {
 			/* Do we have this id in map? */
-			ColIter iter = ColMap.find(id);
-			if (iter != ColMap.end())
-				return iter->second;
+			const Color *Known = ColMap.Find(Names.Find(id));
+			if (Known)
+				return *Known;
 
 			if (r == "" || g == "" || b == "")
 				throw XMLError(Node,
@@ -254,42 +316,101 @@ namespace World {
 				"Illegal color attribute value. "
 				"R, G, B belongs between 0.0 and 1.0");
 		if (id != "")
-			ColMap.insert( make_pair(id, Color(R, G, B)) );
+			ColMap.Insert(Names.Intern(id), Color(R, G, B));
 		return Color(R, G, B);
 	}
 
 	Math::Vector Scene::ParseVector(xmlNodePtr Node)
 	{
-		std::string x = GetProp(Node, "x");
-		std::string y = GetProp(Node, "y");
-		std::string z = GetProp(Node, "z");
-		if (x == "" || y == "" || z == "")
+		const PropText x(Node, "x"), y(Node, "y"), z(Node, "z");
+		if (x.Empty() || y.Empty() || z.Empty())
 			throw XMLError(Node,
 				"Inappropriate vector declaration");
 
 		double X, Y, Z;
-		X = ToDouble(x);
-		Y = ToDouble(y);
-		Z = ToDouble(z);
+		X = ToDouble(x.Get());
+		Y = ToDouble(y.Get());
+		Z = ToDouble(z.Get());
 		return Math::Vector(X, Y, Z);
 	}
 
-	const Texture *Scene::GetTexture(const std::string &id)
+	const Texture *Scene::GetTexture(const char *id) const
+	{
+		const Texture *const *T = TexMap.Find(Names.Find(id, strlen(id)));
+		return T ? *T : NULL;
+	}
+
+	const Material *Scene::GetMaterial(const char *id) const
+	{
+		const Material *const *M =
+			MatMap.Find(Names.Find(id, strlen(id)));
+		return M ? *M : NULL;
+	}
+
+
+	/**
+	 * \brief
+	 *	Parameters of a texture or material as bytes; equal
+	 *	keys mean items which render the same.
+	 */
+	class ContentKey {
+	private:
+		std::string Key;
+	public:
+		/** Start key of an item kind */
+		ContentKey(char Kind) : Key(1, Kind) {}
+
+		inline ContentKey &operator<<(Double V) {
+			const double D = V;
+			Key.append((const char *)&D, sizeof(D));
+			return *this;
+		}
+
+		inline ContentKey &operator<<(const Color &C) {
+			return *this << C[0] << C[1] << C[2];
+		}
+
+		inline ContentKey &operator<<(Bool B) {
+			Key += B ? '1' : '0';
+			return *this;
+		}
+
+		inline ContentKey &operator<<(const void *P) {
+			Key.append((const char *)&P, sizeof(P));
+			return *this;
+		}
+
+		inline const std::string &Get() const {
+			return Key;
+		}
+	};
+
+	const Texture *Scene::SharedTexture(const ContentKey &Key)
 	{
-		TexIter iter = TexMap.find(id);
-		if (iter != TexMap.end())
-			return iter->second;
-		return NULL;
+		TexturesRead++;
+		const Texture *const *Known =
+			TexByContent.Find(Contents.Find(Key.Get()));
+		if (Known == NULL)
+			return NULL;
+		TexturesShared++;
+		return *Known;
 	}
 
-	const Material *Scene::GetMaterial(const std::string &id)
+	void Scene::ShareTexture(const ContentKey &Key, const Texture *T)
 	{
-		MatIter iter = MatMap.find(id);
-		if (iter != MatMap.end())
-			return iter->second;
-		return NULL;
+		TexByContent.Insert(Contents.Intern(Key.Get()), T);
 	}
 
+	void Scene::ReportShared() const
+	{
+		if (TexturesShared == 0 && MaterialsShared == 0)
+			return;
+		std::cout << "*** Shared identical definitions: "
+			  << TexturesShared << " of " << TexturesRead
+			  << " textures, "
+			  << MaterialsShared << " of " << MaterialsRead
+			  << " materials" << std::endl;
+	}
 
 	void Scene::ParseTexture(xmlNodePtr Node)
 	{
@@ -303,7 +424,7 @@ namespace World {
 			throw XMLError(Node,
 				       "No identified given for texture");
 
-		if (GetTexture(id) != NULL)
+		if (GetTexture(id.c_str()) != NULL)
 			throw XMLError(Node,
 				       "Texture with this ID already exists");
 
@@ -320,11 +441,20 @@ namespace World {
 					"Plane texture requires"
 					" one color parameter");
 
-			TexLib::Plain *Tex = new TexLib::Plain(C);
+			ContentKey Key('P');
+			Key << C;
+			const UInt ID = Names.Intern(id);
+			if (const Texture *Known = SharedTexture(Key)) {
+				TexMap.Insert(ID, Known);
+				return;
+			}
+
+			TexLib::Plain *Tex = new (Memory) TexLib::Plain(C);
 			/* Add texture to scene so it will be freed
 			   and to id list */
-			this->AddTexture(Tex);
-			TexMap.insert( make_pair(id, Tex) );
+			this->AddTexture(Tex, ARENA);
+			TexMap.Insert(ID, Tex);
+			ShareTexture(Key, Tex);
 
 		} else if (Type == "Checked") {
 			xmlNodePtr Child = Node->xmlChildrenNode;
@@ -361,11 +491,20 @@ namespace World {
 			if (Tile_ == "false" || Tile_ == "no")
 				Tile = false;
 
+			ContentKey Key('C');
+			Key << A << B << Width << Height << Tile;
+			const UInt ID = Names.Intern(id);
+			if (const Texture *Known = SharedTexture(Key)) {
+				TexMap.Insert(ID, Known);
+				return;
+			}
+
 			TexLib::Checked *Tex =
-				new TexLib::Checked(A, B, Width, Height, Tile);
-			this->AddTexture(Tex);
+				new (Memory) TexLib::Checked(A, B, Width, Height, Tile);
+			this->AddTexture(Tex, ARENA);
 
-			TexMap.insert( make_pair(id, Tex) );
+			TexMap.Insert(ID, Tex);
+			ShareTexture(Key, Tex);
 		} else
 			throw XMLError(Node,
 				"Invalid texture type specified");
@@ -379,12 +518,12 @@ namespace World {
 			return idx;
 		} else {
 			if (idx != "") {
-				IdxIter iter = IdxMap.find(idx);
-				if (iter == IdxMap.end())
+				const Double *Idx = IdxMap.Find(Names.Find(idx));
+				if (Idx == NULL)
 					throw XMLError(Node,
 						       "No refractive index"
 						       " with that name");
-				return iter->second;
+				return *Idx;
 			} else {
 				return MatLib::IdxGlass;
 			}
@@ -396,7 +535,7 @@ namespace World {
 		std::string id = GetProp(Node, "id");
 		if (id == "")
 			throw XMLError("Material identifier not specified");
-		if (GetMaterial(id) != NULL)
+		if (GetMaterial(id.c_str()) != NULL)
 			throw XMLError("Material already defined");
 
 		/* Material parameters with default values */
@@ -414,10 +553,10 @@ namespace World {
 		Double Idx = ParseIdx(Node);
 
 		/* Decode given non-default textures */
-		if (diffuse != "") Diffuse = GetTexture(diffuse);
-		if (specular != "") Specular = GetTexture(specular);
-		if (reflect != "") Reflect = GetTexture(reflect);
-		if (refract != "") Refract = GetTexture(refract);
+		if (diffuse != "") Diffuse = GetTexture(diffuse.c_str());
+		if (specular != "") Specular = GetTexture(specular.c_str());
+		if (reflect != "") Reflect = GetTexture(reflect.c_str());
+		if (refract != "") Refract = GetTexture(refract.c_str());
 
 		if (!Diffuse) throw XMLError(Node,
 					     "Undefined texture " + diffuse);
@@ -428,15 +567,29 @@ namespace World {
 		if (!Refract) throw XMLError(Node,
 					     "Undefined texture " + refract);
 
+		/* Textures are shared already, so equal materials
+		 * refer to the same ones */
+		ContentKey Key('M');
+		Key << Diffuse << Specular << Refract << Reflect
+		    << Shininess << Idx;
+		MaterialsRead++;
+		const UInt Content = Contents.Intern(Key.Get());
+		if (const Material *const *Known = MatByContent.Find(Content)) {
+			MatMap.Insert(Names.Intern(id), *Known);
+			MaterialsShared++;
+			return;
+		}
+
 		/* Everything read, insert to library */
-		Material *Mat = new Material(
+		Material *Mat = new (Memory) Material(
 			*Diffuse, *Specular,
 			*Refract, *Reflect,
 			0.0, 0.0, 0.0,
 			Shininess, Idx);
 
-		MatMap.insert( make_pair(id, Mat) );
-		this->AddMaterial(Mat);
+		MatMap.Insert(Names.Intern(id), Mat);
+		MatByContent.Insert(Content, Mat);
+		this->AddMaterial(Mat, ARENA);
 	}
 
 	void Scene::ParseLight(xmlNodePtr Node)
@@ -455,7 +608,7 @@ namespace World {
 				throw XMLError(Node,
 					"Garbage after color declaration");
 
-			this->AddLight(new AmbientLight(C));
+			this->AddLight(new (Memory) AmbientLight(C), ARENA);
 		} else if (Type == "Point") {
 			xmlNodePtr Cur = Node->xmlChildrenNode;
 			Bool GotColor = false;
@@ -482,7 +635,8 @@ namespace World {
 				throw XMLError(Node,
 					       "Point light requires color"
 					       " and position data");
-			this->AddLight(new PointLight(Pos, C));
+			this->AddLight(new (Memory) PointLight(Pos, C),
+				       ARENA);
 		}
 	}
 
@@ -519,16 +673,20 @@ namespace World {
 					" declaration");
 		}
 
-		/* Create camera from read data */
-		this->C = Camera(Pos,
-				 Dir,
-				 Camera::DegreeToFOV(FOV),
-				 !GotTop,
-				 Top);
+		/* Create camera from read data; further cameras
+		 * are additional views */
+		Cameras.push_back(Camera(Pos,
+					 Dir,
+					 Camera::DegreeToFOV(FOV),
+					 !GotTop,
+					 Top));
+		CameraNames.push_back(GetProp(Node, "name"));
+		if (Cameras.size() == 1)
+			this->C = Cameras.front();
 
 	}
 
-	void Scene::ParseSphere(xmlNodePtr Node)
+	Object *Scene::ParseSphere(xmlNodePtr Node, General::Arena &A)
 	{
 		xmlNodePtr Cur = Node->xmlChildrenNode;
 		Bool	GotPosition = false,
@@ -544,8 +702,8 @@ namespace World {
 				GotPosition = true;
 			} else
 			if (!GotMaterial && IsToken(Cur, "Material")) {
-				std::string id = GetProp(Cur, "id");
-				Material = GetMaterial(id);
+				Material = GetMaterial(
+					PropText(Cur, "id").Get());
 				if (!Material)
 					throw XMLError(Cur,
 						"Material doesn't exist");
@@ -556,16 +714,15 @@ namespace World {
 					" declaration");
 		}
 
-		/* Create camera from read data */
-		Sphere *S = new Sphere(Position, Radius, *Material);
+		/* Create sphere from read data */
+		Sphere *S = new (A) Sphere(Position, Radius, *Material);
 		if (DEBUG)
 			std::cout
 				<< "Adding sphere " << *S << std::endl;
-		this->AddObject(S);
-
+		return S;
 	}
 
-	void Scene::ParsePlane(xmlNodePtr Node)
+	Object *Scene::ParsePlane(xmlNodePtr Node, General::Arena &A)
 	{
 		xmlNodePtr Cur = Node->xmlChildrenNode;
 		Bool	GotNormal = false,
@@ -581,8 +738,8 @@ namespace World {
 				GotNormal = true;
 			} else
 			if (!GotMaterial && IsToken(Cur, "Material")) {
-				std::string id = GetProp(Cur, "id");
-				Material = GetMaterial(id);
+				Material = GetMaterial(
+					PropText(Cur, "id").Get());
 				if (!Material)
 					throw XMLError(Cur,
 						"Material doesn't exist");
@@ -593,103 +750,739 @@ namespace World {
 					" declaration");
 		}
 
-		/* Create camera from read data */
-		this->AddObject(
-			new Plane(Normal, Distance, *Material));
+		/* Create plane from read data */
+		return new (A) Plane(Normal, Distance, *Material);
 	}
 
-	Bool Scene::ParseFile(const std::string &File)
+	Object *Scene::ParseBox(xmlNodePtr Node, General::Arena &A)
 	{
-		xmlDocPtr doc = NULL;
-		xmlNodePtr cur;
-		xmlLineNumbersDefault(1);
-		xmlKeepBlanksDefault(0);
+		xmlNodePtr Cur = Node->xmlChildrenNode;
+		Bool	GotPosition = false,
+			GotSize = false,
+			GotDir = false,
+			GotTop = false,
+			GotMaterial = false;
+		const Material *Material = &MatLib::Gray();
+		Math::Vector
+			Position(0.0, 0.0, 0.0),
+			Size(1.0, 1.0, 1.0),
+			Dir(0.0, 0.0, 1.0),
+			Top(0.0, 1.0, 0.0);
+
+		OmitComments(Cur);
+		for (; Cur != NULL; Cur = Cur->next, OmitComments(Cur)) {
+			if (!GotPosition && IsToken(Cur, "Position")) {
+				Position = ParseVector(Cur);
+				GotPosition = true;
+			} else
+			if (!GotSize && IsToken(Cur, "Size")) {
+				Size = ParseVector(Cur);
+				GotSize = true;
+			} else
+			if (!GotDir && IsToken(Cur, "Dir")) {
+				Dir = ParseVector(Cur);
+				GotDir = true;
+			} else
+			if (!GotTop && IsToken(Cur, "Top")) {
+				Top = ParseVector(Cur);
+				GotTop = true;
+			} else
+			if (!GotMaterial && IsToken(Cur, "Material")) {
+				Material = GetMaterial(
+					PropText(Cur, "id").Get());
+				if (!Material)
+					throw XMLError(Cur,
+						"Material doesn't exist");
+				GotMaterial = true;
+			} else
+				throw XMLError(
+					"Garbage in Box"
+					" declaration");
+		}
+
+		/* Create box from read data; oriented only if asked */
+		if (GotDir || GotTop)
+			return new (A) Box(Position, Size, Dir, Top, *Material);
+		return new (A) Box(Position, Size, *Material);
+	}
+
+	Object *Scene::ParseJulia(xmlNodePtr Node, General::Arena &A)
+	{
+		xmlNodePtr Cur = Node->xmlChildrenNode;
+		Bool	GotPosition = false,
+			GotC = false,
+			GotMaterial = false;
+		const Material *Material = &MatLib::Gray();
+		Math::Vector Position(0.0, 0.0, 0.0);
+		QuaternionJulia::Config Cfg;
+		const Double Scale = GetDoubleProp(Node, "scale", 1.0);
+		Cfg.Slice = GetDoubleProp(Node, "slice", Cfg.Slice);
+		Cfg.Iterations = Int(GetDoubleProp(Node, "iterations",
+						   Cfg.Iterations));
+		Cfg.Epsilon = GetDoubleProp(Node, "epsilon", Cfg.Epsilon);
+		Cfg.Bailout = GetDoubleProp(Node, "bailout", Cfg.Bailout);
+		Cfg.MaxSteps = Int(GetDoubleProp(Node, "steps", Cfg.MaxSteps));
+		if (Scale <= 0.0 || Cfg.Iterations < 1 || Cfg.Epsilon <= 0.0
+		    || Cfg.Bailout <= 4.0 || Cfg.MaxSteps < 1)
+			throw XMLError(Node, "Invalid Julia parameters");
+
+		OmitComments(Cur);
+		for (; Cur != NULL; Cur = Cur->next, OmitComments(Cur)) {
+			if (!GotPosition && IsToken(Cur, "Position")) {
+				Position = ParseVector(Cur);
+				GotPosition = true;
+			} else
+			if (!GotC && IsToken(Cur, "C")) {
+				const Math::Vector C = ParseVector(Cur);
+				Cfg.C[0] = C[0];
+				Cfg.C[1] = C[1];
+				Cfg.C[2] = C[2];
+				Cfg.C[3] = GetDoubleProp(Cur, "w", 0.0);
+				GotC = true;
+			} else
+			if (!GotMaterial && IsToken(Cur, "Material")) {
+				Material = GetMaterial(
+					PropText(Cur, "id").Get());
+				if (!Material)
+					throw XMLError(Cur,
+						"Material doesn't exist");
+				GotMaterial = true;
+			} else
+				throw XMLError(
+					"Garbage in Julia"
+					" declaration");
+		}
+
+		return new (A) QuaternionJulia(Position, Scale, Cfg, *Material);
+	}
+
+	Aggregate *Scene::ParseMesh(xmlNodePtr Node)
+	{
+		xmlNodePtr Cur = Node->xmlChildrenNode;
+		Bool	GotPosition = false,
+			GotMaterial = false;
+		const Material *Material = &MatLib::Gray();
+		Math::Vector Position(0.0, 0.0, 0.0);
+		const Double Scale = GetDoubleProp(Node, "scale", 1.0);
+		std::string File = GetProp(Node, "file");
+		if (File.empty())
+			throw XMLError(Node, "Mesh requires a file");
+		if (File[0] != '/')
+			File = Directory + File;
+
+		OmitComments(Cur);
+		for (; Cur != NULL; Cur = Cur->next, OmitComments(Cur)) {
+			if (!GotPosition && IsToken(Cur, "Position")) {
+				Position = ParseVector(Cur);
+				GotPosition = true;
+			} else
+			if (!GotMaterial && IsToken(Cur, "Material")) {
+				Material = GetMaterial(
+					PropText(Cur, "id").Get());
+				if (!Material)
+					throw XMLError(Cur,
+						"Material doesn't exist");
+				GotMaterial = true;
+			} else
+				throw XMLError(
+					"Garbage in Mesh"
+					" declaration");
+		}
+
+		TriangleMesh::Buffers B;
 		try {
-			doc = xmlParseFile(File.c_str());
-			if (doc == NULL)
-				throw XMLError("Unable to initialize parsing");
+			TriangleMesh::LoadOBJ(File, B);
+		} catch (std::runtime_error &e) {
+			throw XMLError(Node, e.what());
+		}
 
-			cur = xmlDocGetRootElement(doc);
-			if (cur == NULL)
-				throw XMLError("Document is empty");
+		/* Place the mesh; normals keep their direction */
+		for (size_t i = 0; i < B.Positions.size(); i++)
+			B.Positions[i] = B.Positions[i] * Scale + Position[i % 3];
+
+		TriangleMesh *T = new TriangleMesh(B, *Material);
+		std::cout << "*** Mesh " << File << ": "
+			  << T->GetTriangles() << " triangles, "
+			  << (T->GetTriangles()
+			      ? T->GetBytes() / T->GetTriangles() : 0)
+			  << " bytes per triangle" << std::endl;
+		return T;
+	}
 
-			if (xmlStrcmp(cur->name, (const xmlChar *) "Scene"))
-				throw XMLError("Document has wrong type,"
-					       " root node != Scene");
+	/** \brief Top level element of a document held in memory */
+	struct Fragment {
+		const char *Begin, *End;
+		long Line;		/**< Line Begin lies on */
+		Bool Object;		/**< Sphere, Plane or Box element */
+	};
 
-			/* Initialize scene object */
-			ColMap.clear();
-			MatMap.clear();
-			TexMap.clear();
-			CreateLibrary();
-
-			cur = cur->xmlChildrenNode;
-			OmitComments(cur);
-			for (; cur != NULL;
-			     cur = cur->next, OmitComments(cur)) {
-				if (IsToken(cur, "Background")) {
-					this->Background = ParseColor(cur);
-					continue;
-				}
+	/**
+	 * \brief
+	 *	Finds top level elements of a scene document without
+	 *	parsing them.
+	 *
+	 * Only tags, comments, processing instructions, CDATA and
+	 * quoted attribute values are told apart; libxml checks the
+	 * elements when their fragments are parsed.
+	 */
+	class XMLScanner {
+		const char *Cur;
+		const char *const End;
+		long Line;
+
+		/** Syntax error at the current line */
+		XMLError Error() const {
+			return XMLError("On line " + ToStr(Line) +
+					": XML syntax error");
+		}
 
-				if (IsToken(cur, "Atmosphere")) {
-					this->AtmosphereIdx = ParseIdx(cur);
-					continue;
-				}
+		/** Does text at Cur start with S? */
+		inline Bool Starts(const char *S) const {
+			const size_t N = strlen(S);
+			return size_t(End - Cur) >= N && memcmp(Cur, S, N) == 0;
+		}
 
-				if (IsToken(cur, "Color")) {
-					ParseColor(cur);
-					continue;
-				}
+		/** Does tag name at Cur + Skip equal Name? */
+		Bool IsName(size_t Skip, const char *Name) const {
+			const size_t N = strlen(Name);
+			if (size_t(End - Cur) <= Skip + N ||
+			    memcmp(Cur + Skip, Name, N) != 0)
+				return false;
+			const char C = Cur[Skip + N];
+			return C == '>' || C == '/' || C == ' ' ||
+				C == '\t' || C == '\r' || C == '\n';
+		}
 
-				if (IsToken(cur, "Texture")) {
-					ParseTexture(cur);
-					continue;
+		/** Move just past Until */
+		void Skip(const char *Until) {
+			const size_t N = strlen(Until);
+			for (;; Cur++) {
+				if (size_t(End - Cur) < N)
+					throw Error();
+				if (memcmp(Cur, Until, N) == 0) {
+					Cur += N;
+					return;
 				}
+				if (*Cur == '\n')
+					Line++;
+			}
+		}
 
-				if (IsToken(cur, "Material")) {
-					ParseMaterial(cur);
-					continue;
-				}
+		/** Skip whitespace, comments and processing instructions */
+		void SkipMisc() {
+			while (Cur < End) {
+				if (*Cur == '\n') {
+					Line++;
+					Cur++;
+				} else if (*Cur == ' ' || *Cur == '\t' ||
+					   *Cur == '\r')
+					Cur++;
+				else if (Starts("<!--"))
+					Skip("-->");
+				else if (Starts("<?"))
+					Skip("?>");
+				else
+					return;
+			}
+		}
 
-				if (IsToken(cur, "Light")) {
-					ParseLight(cur);
-					continue;
+		/** Move past the tag at Cur
+		 * \return true for an empty element tag */
+		Bool Tag() {
+			char Quote = 0;
+			for (Cur++; Cur < End; Cur++) {
+				const char C = *Cur;
+				if (C == '\n')
+					Line++;
+				else if (Quote) {
+					if (C == Quote)
+						Quote = 0;
+				} else if (C == '"' || C == '\'')
+					Quote = C;
+				else if (C == '>') {
+					Cur++;
+					return Cur[-2] == '/';
 				}
+			}
+			throw Error();
+		}
 
-				if (IsToken(cur, "Camera")) {
-					ParseCamera(cur);
-					continue;
+	public:
+		XMLScanner(const char *Data, size_t Size)
+			: Cur(Data), End(Data + Size), Line(1) {}
+
+		/**
+		 * Move past the Scene start tag.
+		 * \return false if the document needs the full parser
+		 * (other encoding, DTD, empty scene or broken prolog)
+		 */
+		Bool Begin() {
+			try {
+				if (Starts("\xEF\xBB\xBF"))
+					Cur += 3;
+				if (Starts("<?xml")) {
+					const char *Decl = Cur;
+					Skip("?>");
+					std::string D(Decl, Cur);
+					for (UInt i = 0; i < D.size(); i++)
+						D[i] = tolower(D[i]);
+					const std::string::size_type E =
+						D.find("encoding");
+					if (E != std::string::npos &&
+					    D.find("utf-8", E) == std::string::npos)
+						return false;
 				}
+				SkipMisc();
+				if (Cur >= End || !IsName(1, "Scene"))
+					return false;
+				return !Tag();
+			} catch (XMLError &e) {
+				return false;
+			}
+		}
 
-				if (IsToken(cur, "Sphere")) {
-					ParseSphere(cur);
-					continue;
+		/** Find next top level element
+		 * \return false after the Scene end tag */
+		Bool Next(Fragment &F) {
+			SkipMisc();
+			if (Starts("</")) {
+				if (!IsName(2, "Scene"))
+					throw Error();
+				Tag();
+				SkipMisc();
+				if (Cur != End)
+					throw Error();
+				return false;
+			}
+			if (Cur >= End || *Cur != '<' || Starts("<!"))
+				throw Error();
+
+			F.Begin = Cur;
+			F.Line = Line;
+			F.Object = IsName(1, "Sphere") || IsName(1, "Plane")
+				|| IsName(1, "Box");
+			Int Depth = 0;
+			do {
+				if (Cur >= End)
+					throw Error();
+				if (*Cur != '<') {
+					/* Text up to the next tag */
+					const char *Lt = (const char *)
+						memchr(Cur, '<', End - Cur);
+					if (Lt == NULL)
+						throw Error();
+					Line += std::count(Cur, Lt, '\n');
+					Cur = Lt;
+				} else if (Starts("<!--"))
+					Skip("-->");
+				else if (Starts("<![CDATA["))
+					Skip("]]>");
+				else if (Starts("<?"))
+					Skip("?>");
+				else if (Starts("</")) {
+					Tag();
+					Depth--;
+				} else if (!Tag())
+					Depth++;
+			} while (Depth > 0);
+			F.End = Cur;
+			return true;
+		}
+	};
+
+	/** \brief Document of a fragment; freed with the guard */
+	class FragmentDoc {
+		xmlDocPtr Doc;
+	public:
+		/** Take Doc parsed from text starting on line Line */
+		FragmentDoc(xmlDocPtr Doc, long Line) : Doc(Doc) {
+			LineOffset = Line - 1;
+		}
+
+		~FragmentDoc() {
+			LineOffset = 0;
+			if (Doc)
+				xmlFreeDoc(Doc);
+		}
+
+		inline xmlNodePtr Root() const {
+			return xmlDocGetRootElement(Doc);
+		}
+	};
+
+	/** Parse consecutive object elements as children of a Scene
+	 * element, straight from the document text
+	 * \param ErrorLine	Set to line of a syntax error, counted
+	 *			from the line Begin lies on
+	 * \return NULL if text isn't well-formed */
+	static xmlDocPtr ParseObjectText(const char *Begin, const char *End,
+					 long &ErrorLine)
+	{
+		ErrorLine = 1;
+		xmlParserCtxtPtr Ctx =
+			xmlCreatePushParserCtxt(NULL, NULL, "<Scene>", 7, NULL);
+		if (Ctx == NULL)
+			return NULL;
+		xmlCtxtUseOptions(Ctx, XML_PARSE_NOBLANKS);
+		xmlParseChunk(Ctx, Begin, int(End - Begin), 0);
+		xmlParseChunk(Ctx, "</Scene>", 8, 1);
+		xmlDocPtr Doc = Ctx->myDoc;
+		if (!Ctx->wellFormed) {
+			if (Ctx->lastError.line > 0)
+				ErrorLine = Ctx->lastError.line;
+			if (Doc)
+				xmlFreeDoc(Doc);
+			Doc = NULL;
+		}
+		xmlFreeParserCtxt(Ctx);
+		return Doc;
+	}
+
+	/** Object elements in one parallel work item */
+	static const UInt ChunkSize = 256;
+
+	/** Work items per worker read before objects are created */
+	static const UInt ChunksPerWorker = 16;
+
+	/** \brief Creates objects of chunks of object elements */
+	class ObjectJob : public General::Job {
+		Scene &S;
+		const std::vector<Fragment> &Pending;
+	public:
+		/** Objects, their memory and first error of each chunk */
+		std::vector<std::vector<Object *> > Out;
+		General::Arena *Stores;
+		std::vector<std::string> Errors;
+
+		ObjectJob(Scene &S, const std::vector<Fragment> &Pending)
+			: S(S), Pending(Pending),
+			  Out((Pending.size() + ChunkSize - 1) / ChunkSize),
+			  Stores(new General::Arena[Out.size()]),
+			  Errors(Out.size()) {}
+
+		~ObjectJob() {
+			delete[] Stores;
+		}
+
+		virtual void Run(Int Worker, Int From, Int To) {
+			General::Profile::Scope P(General::Profile::PARSE);
+			for (Int c = From; c < To; c++) {
+				try {
+					Chunk(c, P);
+				} catch (std::exception &e) {
+					/* Later chunks won't be used */
+					Errors[c] = e.what();
+					return;
 				}
+			}
+		}
 
-				if (IsToken(cur, "Plane")) {
-					ParsePlane(cur);
+		void Chunk(Int c, General::Profile::Scope &P) {
+			const UInt First = c * ChunkSize;
+			const UInt Last = std::min(UInt(Pending.size()),
+						   UInt(First + ChunkSize));
+			const Fragment &F = Pending[First];
+			P.Change(General::Profile::PARSE);
+			long ErrorLine;
+			const FragmentDoc Doc(
+				ParseObjectText(F.Begin, Pending[Last - 1].End,
+						ErrorLine),
+				F.Line);
+			if (Doc.Root() == NULL)
+				throw XMLError("On line " +
+					       ToStr(F.Line + ErrorLine - 1) +
+					       ": XML syntax error");
+
+			P.Change(General::Profile::BUILD);
+			Out[c].reserve(Last - First);
+			for (xmlNodePtr N = Doc.Root()->children;
+			     N != NULL; N = N->next) {
+				if (N->type != XML_ELEMENT_NODE)
 					continue;
+				Out[c].push_back(
+					IsToken(N, "Sphere")
+					? S.ParseSphere(N, Stores[c])
+					: IsToken(N, "Plane")
+					? S.ParsePlane(N, Stores[c])
+					: S.ParseBox(N, Stores[c]));
+			}
+		}
+	};
+
+	void Scene::ParseObjects(std::vector<Fragment> &Pending)
+	{
+		ObjectJob Job(*this, Pending);
+		General::Parallel::For(Job, Int(Job.Out.size()));
+		Pending.clear();
+
+		/* Report the first error in document order; objects
+		 * of the batch go away with the chunk arenas */
+		for (UInt c = 0; c < Job.Out.size(); c++)
+			if (Job.Errors[c] != "")
+				throw XMLError(Job.Errors[c]);
+
+		for (UInt c = 0; c < Job.Out.size(); c++) {
+			Memory.Adopt(Job.Stores[c]);
+			Objects.insert(Objects.end(),
+				       Job.Out[c].begin(), Job.Out[c].end());
+		}
+	}
+
+	void Scene::ParseFragment(const Fragment &F)
+	{
+		const FragmentDoc Doc(
+			xmlReadMemory(F.Begin, int(F.End - F.Begin), NULL, NULL,
+				      XML_PARSE_NOBLANKS),
+			F.Line);
+		if (Doc.Root() == NULL) {
+			const xmlErrorPtr E = xmlGetLastError();
+			const long Line = E && E->line > 0 ? E->line : 1;
+			throw XMLError("On line " + ToStr(F.Line + Line - 1) +
+				       ": XML syntax error");
+		}
+		ParseElement(Doc.Root());
+	}
+
+	Bool Scene::ParseChunked(const char *Data, size_t Size)
+	{
+		/* Workers create parser contexts; libxml2 has to be
+		 * initialized once, by this thread, before they do */
+		xmlInitParser();
+
+		General::Profile::Scope S(General::Profile::PARSE);
+		const UInt Batch = ChunkSize * ChunksPerWorker
+			* General::Parallel::Workers();
+		std::vector<Fragment> Pending;
+		try {
+			XMLScanner Scan(Data, Size);
+			if (!Scan.Begin())
+				throw XMLError("Unable to initialize parsing");
+			BeginDocument();
+
+			/* Objects are gathered and created on all workers;
+			 * any other element waits for them, so ids resolve
+			 * exactly as if everything was read in order */
+			Fragment F;
+			Bool More;
+			do {
+				More = Scan.Next(F);
+				if (More && F.Object) {
+					Pending.push_back(F);
+					if (Pending.size() < Batch)
+						continue;
+				}
+				if (!Pending.empty())
+					ParseObjects(Pending);
+				if (More && !F.Object) {
+					S.Change(General::Profile::BUILD);
+					ParseFragment(F);
+					S.Change(General::Profile::PARSE);
 				}
+			} while (More);
+			ReportShared();
+			return true;
+		} catch (std::exception &e) {
+			std::cout << "*** Error while parsing XML file:" << std::endl
+				  << e.what() << std::endl;
+			if (DEBUG) DumpLibrary();
+			return false;
+		}
+	}
+
+	Bool Scene::Chunkable(const char *Data, size_t Size)
+	{
+		return General::Parallel::Workers() > 1 &&
+			XMLScanner(Data, Size).Begin();
+	}
+
+	Bool Scene::ParseFile(const std::string &File)
+	{
+		Directory = File.substr(0, File.rfind('/') + 1);
+		if (IsBinary(File))
+			return LoadBinary(File);
+		try {
+			const General::MappedFile Map(File);
+			if (Chunkable(Map.GetData(), Map.GetSize()))
+				return ParseChunked(Map.GetData(),
+						    Map.GetSize());
+		} catch (std::runtime_error &e) {
+			/* Reader reports the error */
+		}
+		xmlLineNumbersDefault(1);
+		return ParseReader(xmlReaderForFile(File.c_str(), NULL,
+						    XML_PARSE_NOBLANKS));
+	}
+
+	Bool Scene::ParseMemory(const std::string &XML)
+	{
+		Directory.clear();
+		if (Chunkable(XML.data(), XML.size()))
+			return ParseChunked(XML.data(), XML.size());
+		xmlLineNumbersDefault(1);
+		return ParseReader(xmlReaderForMemory(XML.data(), XML.size(),
+						      NULL, NULL,
+						      XML_PARSE_NOBLANKS));
+	}
+
+	/** Syntax error at the current position of the reader */
+	static XMLError SyntaxError(xmlTextReaderPtr Reader)
+	{
+		return XMLError("On line " +
+				ToStr(xmlTextReaderGetParserLineNumber(Reader)) +
+				": XML syntax error");
+	}
 
-				if (IsToken(cur, "Dump")) {
-					std::cout << "*** Dump requested ***" << std::endl;
-					DumpLibrary();
+	void Scene::BeginDocument()
+	{
+		/* Initialize scene object */
+		Cameras.clear();
+		CameraNames.clear();
+		Names.Clear();
+		ColMap.Clear();
+		TexMap.Clear();
+		MatMap.Clear();
+		IdxMap.Clear();
+		Contents.Clear();
+		TexByContent.Clear();
+		MatByContent.Clear();
+		TexturesRead = TexturesShared = 0;
+		MaterialsRead = MaterialsShared = 0;
+		CreateLibrary();
+	}
+
+	void Scene::ParseElement(xmlNodePtr cur)
+	{
+		if (IsToken(cur, "Background")) {
+			this->Background = ParseColor(cur);
+			return;
+		}
+
+		if (IsToken(cur, "Atmosphere")) {
+			this->AtmosphereIdx = ParseIdx(cur);
+			return;
+		}
+
+		if (IsToken(cur, "Color")) {
+			ParseColor(cur);
+			return;
+		}
+
+		if (IsToken(cur, "Texture")) {
+			ParseTexture(cur);
+			return;
+		}
+
+		if (IsToken(cur, "Material")) {
+			ParseMaterial(cur);
+			return;
+		}
+
+		if (IsToken(cur, "Light")) {
+			ParseLight(cur);
+			return;
+		}
+
+		if (IsToken(cur, "Camera")) {
+			ParseCamera(cur);
+			return;
+		}
+
+		if (IsToken(cur, "Sphere")) {
+			this->AddObject(ParseSphere(cur, Memory), ARENA);
+			return;
+		}
+
+		if (IsToken(cur, "Plane")) {
+			this->AddObject(ParsePlane(cur, Memory), ARENA);
+			return;
+		}
+
+		if (IsToken(cur, "Box")) {
+			this->AddObject(ParseBox(cur, Memory), ARENA);
+			return;
+		}
+
+		if (IsToken(cur, "Julia")) {
+			this->AddObject(ParseJulia(cur, Memory), ARENA);
+			return;
+		}
+
+		if (IsToken(cur, "Mesh")) {
+			this->AddAggregate(ParseMesh(cur));
+			return;
+		}
+
+		if (IsToken(cur, "Dump")) {
+			std::cout << "*** Dump requested ***" << std::endl;
+			DumpLibrary();
+			return;
+		}
+
+		throw XMLError("Invalid token in file \""
+			       + ToStr(cur->name) + "\"");
+	}
+
+	Bool Scene::ParseReader(xmlTextReaderPtr Reader)
+	{
+		General::Profile::Scope S(General::Profile::PARSE);
+		try {
+			if (Reader == NULL)
+				throw XMLError("Unable to initialize parsing");
+
+			/* Skip to the root element */
+			int Ret;
+			while ((Ret = xmlTextReaderRead(Reader)) == 1 &&
+			       xmlTextReaderNodeType(Reader)
+			       != XML_READER_TYPE_ELEMENT);
+			if (Ret == -1)
+				throw SyntaxError(Reader);
+			if (Ret == 0)
+				throw XMLError("Document is empty");
+
+			if (xmlStrcmp(xmlTextReaderConstName(Reader),
+				      (const xmlChar *) "Scene"))
+				throw XMLError("Document has wrong type,"
+					       " root node != Scene");
+
+			BeginDocument();
+
+			/* Expand one child of Scene at a time; reader
+			 * frees it when moving to the next one, so only
+			 * a single element is held in memory */
+			Ret = xmlTextReaderIsEmptyElement(Reader) ? 0
+				: xmlTextReaderRead(Reader);
+			while (Ret == 1 && xmlTextReaderDepth(Reader) > 0) {
+				if (xmlTextReaderNodeType(Reader)
+				    != XML_READER_TYPE_ELEMENT) {
+					Ret = xmlTextReaderRead(Reader);
 					continue;
 				}
 
-				throw XMLError("Invalid token in file \""
-					       + ToStr(cur->name) + "\"");
+				xmlNodePtr Node = xmlTextReaderExpand(Reader);
+				if (Node == NULL)
+					throw SyntaxError(Reader);
+				S.Change(General::Profile::BUILD);
+				ParseElement(Node);
+				S.Change(General::Profile::PARSE);
+				Ret = xmlTextReaderNext(Reader);
 			}
-			xmlFreeDoc(doc);
+
+			/* Check the rest of the document */
+			while (Ret == 1)
+				Ret = xmlTextReaderRead(Reader);
+			if (Ret == -1)
+				throw SyntaxError(Reader);
+
+			xmlFreeTextReader(Reader);
+			ReportShared();
 			return true;
 		} catch (std::exception &e) {
-			xmlFreeDoc(doc);
+			if (Reader)
+				xmlFreeTextReader(Reader);
 			std::cout << "*** Error while parsing XML file:" << std::endl
 				  << e.what() << std::endl;
 			if (DEBUG) DumpLibrary();
 			return false;
 		}
-
 	}
 }
@@ -49,6 +49,12 @@ namespace World {
 		virtual Math::Vector NormalAt(const Math::Vector &Point) const;
 		virtual Math::Point UVAt(const Math::Vector &Point) const;
 
+		virtual Bool Bounds(Math::Vector &Center, Double &Radius) const {
+			Center = this->Center;
+			Radius = this->Radius;
+			return true;
+		}
+
 	};
 };
 
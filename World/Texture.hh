@@ -63,6 +63,18 @@ namespace World {
 		/** Get texture color at point (u,v) */
 		virtual Color Get(Math::Point UV) const = 0;
 
+		/**@{ Size and tiling accessors */
+		inline Double GetSizeU() const { return SizeU; }
+		inline Double GetSizeV() const { return SizeV; }
+		inline Bool IsTiled() const { return Tiled; }
+		/*@}*/
+
+		/** Is texture black everywhere? Used to tell whether
+		 * a material filter has any effect at all. */
+		virtual Bool IsBlack() const {
+			return false;
+		}
+
 		/** Pretty-printer */
 		friend std::ostream &operator<<(std::ostream &os, const Texture &T);
 	};
@@ -87,6 +99,15 @@ namespace World {
 			virtual Color Get(Math::Point UV) const	{
 				return C;
 			}
+
+			virtual Bool IsBlack() const {
+				return C == ColLib::Black();
+			}
+
+			/** Color accessor */
+			inline const Color &GetColor() const {
+				return C;
+			}
 		};
 
 		/** \brief Checked texture class */
@@ -123,6 +144,15 @@ namespace World {
 					return A;
 				return B;
 			}
+
+			virtual Bool IsBlack() const {
+				return A == ColLib::Black() && B == ColLib::Black();
+			}
+
+			/**@{ Color accessors */
+			inline const Color &GetColorA() const { return A; }
+			inline const Color &GetColorB() const { return B; }
+			/*@}*/
 		};
 
 		/**@{ Static plain texture */
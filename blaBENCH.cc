@@ -0,0 +1,480 @@
+/**********************************************************************
+ * blaRAY -- photon mapper/raytracer
+ * (C) 2008 by Tomasz bla Fortuna <bla@thera.be>, <bla@af.gliwice.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * See Docs/LICENSE
+ *********************/
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <getopt.h>
+#include <time.h>
+
+#include "General/Types.hh"
+#include "General/Random.hh"
+#include "Math/Constants.hh"
+#include "Math/Matrix.hh"
+#include "Math/Vector.hh"
+#include "World/Scene.hh"
+#include "World/Sphere.hh"
+#include "World/Plane.hh"
+#include "World/Box.hh"
+#include "World/Texture.hh"
+#include "World/Camera.hh"
+#include "World/Generator.hh"
+#include "Render/Raytracer.hh"
+#include "Graphics/HDRImage.hh"
+
+/**
+ * \file
+ *	blaBENCH - timings of math and render hot paths.
+ *
+ * Every case is run a few times untimed (warm up), then timed
+ * repeatedly. Each result is printed as one JSON object per line,
+ * with the median and 10th/90th percentiles over repetitions, so
+ * outputs of two builds can be compared line by line.
+ */
+
+/** Monotonic time in nanoseconds */
+static double Now()
+{
+	struct timespec T;
+	clock_gettime(CLOCK_MONOTONIC, &T);
+	return T.tv_sec * 1e9 + T.tv_nsec;
+}
+
+/** Results are summed here so the compiler can't drop the work */
+static volatile double Sink;
+
+/** \brief Statistics of repeated measurements */
+struct Stats {
+	double Median, P10, P90, Min;
+
+	Stats(std::vector<double> V) {
+		std::sort(V.begin(), V.end());
+		const size_t N = V.size();
+		Min = V[0];
+		Median = N % 2 ? V[N / 2] : 0.5 * (V[N / 2 - 1] + V[N / 2]);
+		P10 = V[(N - 1) / 10];
+		P90 = V[(N - 1) - (N - 1) / 10];
+	}
+};
+
+/** Inputs shared by micro benchmarks */
+static const Int Inputs = 1024;
+static std::vector<Math::Vector> Vectors, Directions;
+static std::vector<Math::Point> UVs;
+static std::vector<Render::Ray> Rays;
+
+static void CreateInputs()
+{
+	General::Random Rnd(1);
+	for (Int i = 0; i < Inputs; i++) {
+		const Math::Vector V(Rnd.Next() * 2.0 - 1.0,
+				     Rnd.Next() * 2.0 - 1.0,
+				     Rnd.Next() * 2.0 - 1.0);
+		Vectors.push_back(V);
+		Math::Vector D(V[0] * 0.2, V[1] * 0.2, 1.0);
+		D.Normalize();
+		Directions.push_back(D);
+		UVs.push_back(Math::Point(Rnd.Next() * 4.0, Rnd.Next() * 4.0));
+		Rays.push_back(Render::Ray(Math::Vector(0.0, 0.5, -5.0), D));
+	}
+}
+
+/** \brief One micro benchmark: Ops calls of the tested function */
+class Micro {
+public:
+	virtual ~Micro() {}
+	virtual double Run(Int Ops) = 0;
+};
+
+class VectorDot : public Micro {
+	double Run(Int Ops) {
+		double S = 0.0;
+		for (Int i = 0; i < Ops; i++)
+			S += Vectors[i & (Inputs - 1)].Dot(
+				Vectors[(i + 1) & (Inputs - 1)]);
+		return S;
+	}
+};
+
+class VectorCross : public Micro {
+	double Run(Int Ops) {
+		double S = 0.0;
+		for (Int i = 0; i < Ops; i++)
+			S += Vectors[i & (Inputs - 1)].Cross(
+				Vectors[(i + 1) & (Inputs - 1)])[0];
+		return S;
+	}
+};
+
+class VectorNormalize : public Micro {
+	double Run(Int Ops) {
+		double S = 0.0;
+		for (Int i = 0; i < Ops; i++) {
+			Math::Vector V = Vectors[i & (Inputs - 1)];
+			S += V.Normalize()[1];
+		}
+		return S;
+	}
+};
+
+class MatrixMultiply : public Micro {
+	Math::Matrix A, B;
+public:
+	MatrixMultiply() {
+		for (Int i = 0; i < 16; i++) {
+			A.SetXY(i % 4, i / 4, Vectors[i][0]);
+			B.SetXY(i % 4, i / 4, Vectors[i + 16][1]);
+		}
+	}
+
+	double Run(Int Ops) {
+		double S = 0.0;
+		for (Int i = 0; i < Ops; i++)
+			S += (A * B)[i & 15];
+		return S;
+	}
+};
+
+class SphereCollide : public Micro {
+	World::Sphere O;
+public:
+	SphereCollide() : O(Math::Vector(0.0, 0.5, 0.0), 1.0) {}
+
+	double Run(Int Ops) {
+		double S = 0.0;
+		Double Pos;
+		for (Int i = 0; i < Ops; i++)
+			if (O.Collide(Rays[i & (Inputs - 1)], Pos))
+				S += Pos;
+		return S;
+	}
+};
+
+class PlaneCollide : public Micro {
+	World::Plane O;
+public:
+	PlaneCollide() : O(Math::Vector(0.0, 1.0, 0.0), -1.0) {}
+
+	double Run(Int Ops) {
+		double S = 0.0;
+		Double Pos;
+		for (Int i = 0; i < Ops; i++)
+			if (O.Collide(Rays[i & (Inputs - 1)], Pos))
+				S += Pos;
+		return S;
+	}
+};
+
+class BoxCollide : public Micro {
+	World::Box O;
+public:
+	BoxCollide() : O(Math::Vector(0.0, 0.5, 0.0),
+			 Math::Vector(2.0, 2.0, 2.0)) {}
+
+	double Run(Int Ops) {
+		double S = 0.0;
+		Double Pos;
+		for (Int i = 0; i < Ops; i++)
+			if (O.Collide(Rays[i & (Inputs - 1)], Pos))
+				S += Pos;
+		return S;
+	}
+};
+
+class JuliaCollide : public Micro {
+	World::QuaternionJulia O;
+public:
+	JuliaCollide() : O(Math::Vector(0.0, 0.5, 0.0), 1.0) {}
+
+	double Run(Int Ops) {
+		double S = 0.0;
+		Double Pos;
+		for (Int i = 0; i < Ops; i++)
+			if (O.Collide(Rays[i & (Inputs - 1)], Pos))
+				S += Pos;
+		return S;
+	}
+};
+
+/** Sphere of SphereCollide as a mesh of 2 * Rings^2 triangles */
+class MeshCollide : public Micro {
+	World::TriangleMesh *O;
+
+	static World::TriangleMesh *Ball(Int Rings) {
+		World::TriangleMesh::Buffers B;
+		for (Int j = 0; j <= Rings; j++)
+			for (Int i = 0; i <= Rings; i++) {
+				const double T = Math::PI * j / Rings;
+				const double P = 2.0 * Math::PI * i / Rings;
+				B.Positions.push_back(std::sin(T) * std::cos(P));
+				B.Positions.push_back(0.5 + std::cos(T));
+				B.Positions.push_back(std::sin(T) * std::sin(P));
+			}
+		for (Int j = 0; j < Rings; j++)
+			for (Int i = 0; i < Rings; i++) {
+				const uint32_t V = j * (Rings + 1) + i;
+				const uint32_t Quad[6] = {
+					V, V + 1, V + Rings + 2,
+					V, V + Rings + 2, V + Rings + 1
+				};
+				B.Indices.insert(B.Indices.end(), Quad, Quad + 6);
+			}
+		return new World::TriangleMesh(B, World::MatLib::Gray());
+	}
+public:
+	MeshCollide() : O(Ball(100)) {}
+	~MeshCollide() { delete O; }
+
+	double Run(Int Ops) {
+		double S = 0.0;
+		for (Int i = 0; i < Ops; i++) {
+			Double Pos = 1e10;
+			World::HitStorage Hit;
+			if (O->Collide(Rays[i & (Inputs - 1)], Pos, Hit))
+				S += Pos;
+		}
+		return S;
+	}
+};
+
+class SphereUVAt : public Micro {
+	World::Sphere O;
+	std::vector<Math::Vector> Points;
+public:
+	SphereUVAt() : O(Math::Vector(0.0, 0.0, 0.0), 1.0) {
+		for (Int i = 0; i < Inputs; i++) {
+			Math::Vector P = Vectors[i];
+			Points.push_back(P.Normalize());
+		}
+	}
+
+	double Run(Int Ops) {
+		double S = 0.0;
+		for (Int i = 0; i < Ops; i++)
+			S += O.UVAt(Points[i & (Inputs - 1)]).GetU();
+		return S;
+	}
+};
+
+class CheckedGet : public Micro {
+	World::TexLib::Checked T;
+	double Run(Int Ops) {
+		double S = 0.0;
+		for (Int i = 0; i < Ops; i++)
+			S += T.Get(UVs[i & (Inputs - 1)])[0];
+		return S;
+	}
+};
+
+class ViewAt : public Micro {
+	World::Camera C;
+	World::Camera::View V;
+public:
+	ViewAt() : V(C.CreateView(640, 480)) {}
+
+	double Run(Int Ops) {
+		double S = 0.0;
+		for (Int i = 0; i < Ops; i++)
+			S += V.At(i % 640, (i / 640) % 480).Direction()[0];
+		return S;
+	}
+};
+
+/** Benchmark settings */
+struct Config {
+	Int Warmup;
+	Int Reps;
+	Int Ops;		/**< Calls per micro repetition */
+	Int Width, Height;	/**< Macro frame size */
+	Int MinSpheres, MaxSpheres;
+	std::string Layout;	/**< Generator layout of macro scenes */
+	Bool Micro, Macro;
+};
+
+static void RunMicro(const Config &Cfg, const std::string &Name, Micro &M)
+{
+	for (Int i = 0; i < Cfg.Warmup; i++)
+		Sink = Sink + M.Run(Cfg.Ops);
+
+	std::vector<double> Times;
+	for (Int i = 0; i < Cfg.Reps; i++) {
+		const double A = Now();
+		Sink = Sink + M.Run(Cfg.Ops);
+		Times.push_back((Now() - A) / Cfg.Ops);
+	}
+
+	const Stats S(Times);
+	std::cout << "{\"bench\": \"micro\", \"name\": \"" << Name
+		  << "\", \"ops\": " << Cfg.Ops
+		  << ", \"reps\": " << Cfg.Reps
+		  << ", \"median_ns\": " << S.Median
+		  << ", \"p10_ns\": " << S.P10
+		  << ", \"p90_ns\": " << S.P90
+		  << ", \"min_ns\": " << S.Min << "}" << std::endl;
+}
+
+/** Render generated scene of Count spheres above a checked plane;
+ * sphere size shrinks with their count so the frame stays similarly
+ * covered */
+static void RunMacro(const Config &Cfg, Int Count)
+{
+	using namespace World;
+	Generator::Config GC = Generator::Parse("layout=" + Cfg.Layout);
+	GC.Spheres = Count;
+	GC.Seed = 7;
+	const double A = Now();
+	const Generator Gen(GC);
+	Scene S(Gen.GetCamera());
+	Gen.Build(S);
+	const double Build = (Now() - A) / 1e6;
+
+	Graphics::HDRImage Img(Cfg.Width, Cfg.Height);
+	Render::Raytracer R(S, false);
+
+	/* Large scenes take long enough to skip repetitions */
+	const Int Reps = Count >= 100000 ? std::min(3, int(Cfg.Reps))
+		: Int(Cfg.Reps);
+	const Int Warmup = Count >= 100000 ? std::min(1, int(Cfg.Warmup))
+		: Int(Cfg.Warmup);
+
+	std::cerr << "*** " << Count << " spheres" << std::endl;
+	std::streambuf *Log = std::cout.rdbuf(std::cerr.rdbuf());
+	std::vector<double> Times;
+	for (Int i = 0; i < Warmup + Reps; i++) {
+		const double B = Now();
+		R.RenderTile(Img, 0, 0, Cfg.Width, Cfg.Height);
+		if (i >= Warmup)
+			Times.push_back((Now() - B) / 1e6);
+	}
+	std::cout.rdbuf(Log);
+
+	const Stats St(Times);
+	std::cout << "{\"bench\": \"macro\", \"name\": \"spheres\""
+		  << ", \"spheres\": " << Count
+		  << ", \"layout\": \"" << Cfg.Layout << "\""
+		  << ", \"width\": " << Cfg.Width
+		  << ", \"height\": " << Cfg.Height
+		  << ", \"reps\": " << Reps
+		  << ", \"build_ms\": " << Build
+		  << ", \"median_ms\": " << St.Median
+		  << ", \"p10_ms\": " << St.P10
+		  << ", \"p90_ms\": " << St.P90
+		  << ", \"min_ms\": " << St.Min << "}" << std::endl;
+}
+
+static void Help()
+{
+	std::cout
+	<< "Usage: ./blaBENCH [options]" << std::endl
+	<< "	--micro			- Only micro benchmarks" << std::endl
+	<< "	--macro			- Only whole-frame renders" << std::endl
+	<< "	--reps <n>		- Timed repetitions (default:15)" << std::endl
+	<< "	--warmup <n>		- Untimed repetitions (default:3)" << std::endl
+	<< "	--ops <n>		- Calls per micro repetition"
+			<< " (default:1000000)" << std::endl
+	<< "	--size <w>x<h>		- Frame of macro renders"
+			<< " (default:64x48)" << std::endl
+	<< "	--spheres <min>,<max>	- Sphere counts, growing 10x"
+			<< " (default:10,1000000)" << std::endl
+	<< "	--layout <name>		- uniform, clustered or nested"
+			<< " spheres (default:uniform)" << std::endl
+	<< "Results are printed as one JSON object per line." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	Config Cfg = { 3, 15, 1000000, 64, 48, 10, 1000000, "uniform",
+		       true, true };
+
+	static struct option Options[] = {
+		{"micro", 0, 0, 'm'},
+		{"macro", 0, 0, 'M'},
+		{"reps", 1, 0, 'r'},
+		{"warmup", 1, 0, 'w'},
+		{"ops", 1, 0, 'o'},
+		{"size", 1, 0, 's'},
+		{"spheres", 1, 0, 'S'},
+		{"layout", 1, 0, 'l'},
+		{"help", 0, 0, 'h'},
+		{NULL, 0, 0, 0}
+	};
+
+	for (;;) {
+		const int c = getopt_long(argc, argv, "h", Options, NULL);
+		if (c == -1)
+			break;
+		std::stringstream s(optarg ? optarg : "");
+		char Sep;
+		switch (c) {
+		case 'm': Cfg.Macro = false; break;
+		case 'M': Cfg.Micro = false; break;
+		case 'r': s >> Cfg.Reps; break;
+		case 'w': s >> Cfg.Warmup; break;
+		case 'o': s >> Cfg.Ops; break;
+		case 's': s >> Cfg.Width >> Sep >> Cfg.Height; break;
+		case 'S': s >> Cfg.MinSpheres >> Sep >> Cfg.MaxSpheres; break;
+		case 'l': s >> Cfg.Layout; break;
+		default:
+			Help();
+			return -1;
+		}
+	}
+	if (Cfg.Reps < 1 || Cfg.Ops < 1 || Cfg.Width < 1 || Cfg.Height < 1) {
+		Help();
+		return -1;
+	}
+	try {
+		World::Generator::Parse("layout=" + Cfg.Layout);
+	} catch (std::invalid_argument &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return -1;
+	}
+
+	if (Cfg.Micro) {
+		CreateInputs();
+		VectorDot Dot;
+		VectorCross Cross;
+		VectorNormalize Normalize;
+		MatrixMultiply Multiply;
+		SphereCollide SphereCol;
+		PlaneCollide PlaneCol;
+		BoxCollide BoxCol;
+		JuliaCollide JuliaCol;
+		MeshCollide MeshCol;
+		SphereUVAt UV;
+		CheckedGet Checked;
+		ViewAt At;
+		RunMicro(Cfg, "Vector::Dot", Dot);
+		RunMicro(Cfg, "Vector::Cross", Cross);
+		RunMicro(Cfg, "Vector::Normalize", Normalize);
+		RunMicro(Cfg, "Matrix::operator*", Multiply);
+		RunMicro(Cfg, "Sphere::Collide", SphereCol);
+		RunMicro(Cfg, "Plane::Collide", PlaneCol);
+		RunMicro(Cfg, "Box::Collide", BoxCol);
+		RunMicro(Cfg, "QuaternionJulia::Collide", JuliaCol);
+		RunMicro(Cfg, "TriangleMesh::Collide", MeshCol);
+		RunMicro(Cfg, "Sphere::UVAt", UV);
+		RunMicro(Cfg, "TexLib::Checked::Get", Checked);
+		RunMicro(Cfg, "Camera::View::At", At);
+	}
+
+	if (Cfg.Macro)
+		for (Int N = Cfg.MinSpheres; N <= Cfg.MaxSpheres; N *= 10)
+			RunMacro(Cfg, N);
+	return 0;
+}
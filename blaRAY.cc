@@ -11,11 +11,15 @@
  *********************/
 
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <sstream>
 
+#include <vector>
+
 #include <sys/time.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -30,8 +34,20 @@
 #include "Math/Vector.hh"
 #include "Math/Transform.hh"
 #include "Render/Raytracer.hh"
+#include "Render/ProgressiveMapper.hh"
+#include "Render/PhotonMapper.hh"
+#include "Render/Distributed.hh"
+#include "Render/Daemon.hh"
+#include "Render/Batch.hh"
+#include "World/Generator.hh"
+#include "Graphics/HDRImage.hh"
+#include "Graphics/StreamImage.hh"
+#include "Graphics/MappedImage.hh"
+#include "Graphics/CostMap.hh"
 
 #include "General/Testcases.hh"
+#include "General/Thread.hh"
+#include "General/Profile.hh"
 
 /** \mainpage blaRAY raytracer/photon mapper
  *
@@ -57,7 +73,7 @@ static void Render1(Graphics::Screen &Scr, Bool Antialiasing)
 	const Math::Vector V1(0.0, 0.0, 0.0);
 	const Math::Vector V2(0.0, 0.0, 1.0);
 
-	Scene::Scene S(Camera(V1, V2), ColLib::Black());
+	Scene S(Camera(V1, V2), ColLib::Black());
 
 	const Texture &Plain = TexLib::Plain(
 		Color(0.2, 0.2, 0.2));
@@ -104,7 +120,7 @@ static void Render2(Graphics::Screen &Scr, Bool Antialiasing)
 
 	const Math::Vector Pos(-2.0, 3.0, -2.0);
 	const Math::Vector Dir(0.2, -0.3, 1.0);
-	Scene::Scene S(Camera(Pos, Dir), ColLib::Black());
+	Scene S(Camera(Pos, Dir), ColLib::Black());
 
 	TexLib::Checked Checked = TexLib::Checked(
 		ColLib::Black(),
@@ -155,14 +171,237 @@ static void Render2(Graphics::Screen &Scr, Bool Antialiasing)
 	R.Render(Scr);
 }
 
+/** Progressive photon mapping settings (--ppm) */
+struct PPMConfig {
+	Int Passes;	/**< 0 - use raytracer */
+	Int Photons;	/**< Photons per pass */
+	Double Radius;	/**< Initial gather radius */
+};
+
+/** Photon map settings (--photonmap) */
+struct PMConfig {
+	Bool Enabled;
+	Render::PhotonMapper::MapConfig Global, Caustic;
+	Render::PhotonMapper::GatherConfig Gather;
+};
+
+/** Parse "count[,k[,distance]]" into map settings */
+static void ParseMapConfig(const std::string &Opt,
+			   Render::PhotonMapper::MapConfig &Cfg)
+{
+	std::stringstream s(Opt);
+	char Comma;
+	s >> Cfg.Photons;
+	if (s >> Comma >> Cfg.K)
+		s >> Comma >> Cfg.MaxDist;
+}
+
+/** Parse "samples[,accuracy]" into final gather settings */
+static void ParseGatherConfig(const std::string &Opt,
+			      Render::PhotonMapper::GatherConfig &Cfg)
+{
+	std::stringstream s(Opt);
+	char Comma;
+	s >> Cfg.Samples;
+	s >> Comma >> Cfg.Accuracy;
+}
+
+/** Output settings */
+struct OutConfig {
+	Bool Display;		/**< Show window (or render off-screen) */
+	Graphics::ToneMap Mapping;	/**< For off-screen LDR output */
+	Bool Progressive;	/**< Coarse preview first */
+	std::string Framebuffer;	/**< Mapped framebuffer file */
+	Bool Resume;		/**< Keep its finished tiles */
+	std::string Profile;	/**< JSON report file */
+	Int CostEvery;		/**< Cost map of every n-th frame (0 - off) */
+};
+
+/**
+ * \brief
+ *	Profiles one run of an entry point if --profile is given.
+ *
+ * The report is written when the session ends, so entry points
+ * which return early on errors still leave one behind.
+ */
+class ProfileSession {
+	/** JSON report file; empty - not profiling */
+	const std::string File;
+
+	/** Was the report written already? */
+	Bool Written;
+
+public:
+	ProfileSession(const std::string &File) : File(File), Written(false) {
+		if (File != "")
+			General::Profile::Start();
+	}
+
+	/** Stop profiling and write the report now, e.g. before
+	 * waiting for the user; later calls do nothing */
+	void Finish() {
+		if (File == "" || Written)
+			return;
+		Written = true;
+		General::Profile::Stop();
+		std::ofstream F(File.c_str());
+		General::Profile::Report(F);
+		if (!F)
+			std::cout << "Unable to write " << File << std::endl;
+	}
+
+	~ProfileSession() {
+		Finish();
+	}
+};
+
+/** Does the file name ask for HDR output? */
+static Bool IsPFM(const std::string &File)
+{
+	return File.size() > 4 && File.substr(File.size() - 4) == ".pfm";
+}
+
+/** File name without extension */
+static std::string Basename(const std::string &File)
+{
+	const std::string::size_type Dot = File.rfind('.');
+	if (Dot == std::string::npos ||
+	    File.find('/', Dot) != std::string::npos)
+		return File;
+	return File.substr(0, Dot);
+}
+
+/** Output file of one view: name (or number) before the extension */
+static std::string ViewOutput(const std::string &OutputFile,
+			      const std::string &Name, Int Idx)
+{
+	std::stringstream s;
+	if (Name != "")
+		s << Name;
+	else
+		s << Idx;
+
+	const std::string Base = Basename(OutputFile);
+	return Base + "." + s.str() + OutputFile.substr(Base.size());
+}
+
+/** Record cost map of a frame if it's one of every Out.CostEvery */
+static Graphics::CostMap *CreateCostMap(const OutConfig &Out, Int Frame,
+					Int Width, Int Height,
+					const std::string &OutputFile)
+{
+	if (Out.CostEvery <= 0 || Frame % Out.CostEvery != 0)
+		return NULL;
+	if (OutputFile == "") {
+		std::cout << "*** Cost map needs --output to be named after"
+			  << std::endl;
+		return NULL;
+	}
+	return new Graphics::CostMap(Width, Height);
+}
+
+/** Save and free cost map (if any) next to Output */
+static void SaveCostMap(Graphics::CostMap *Costs, const std::string &Base)
+{
+	if (!Costs)
+		return;
+	try {
+		Costs->Save(Base);
+		std::cout << "*** Cost map saved to " << Base
+			  << ".cost.{ppm,pfm}" << std::endl;
+	} catch (std::runtime_error &e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+	}
+	delete Costs;
+}
+
+/** Render scene from all its cameras, or from cameras listed in
+ * CameraList ("x,y,z,dx,dy,dz[,fov] [name]" lines) */
+static void RenderViews(const World::Scene &S,
+			Int Width, Int Height,
+			Bool Antialiasing,
+			const OutConfig &Out,
+			const std::string &CameraList,
+			const std::string &OutputFile)
+{
+	std::vector<World::Camera> Cameras;
+	std::vector<std::string> Names;
+	if (CameraList != "") {
+		std::ifstream In(CameraList.c_str());
+		if (!In) {
+			std::cout << "Unable to read " << CameraList
+				  << std::endl;
+			return;
+		}
+		std::string Line;
+		while (std::getline(In, Line)) {
+			std::stringstream s(Line);
+			std::string Desc, Name;
+			if (!(s >> Desc) || Desc[0] == '#')
+				continue;
+			s >> Name;
+			try {
+				Cameras.push_back(World::Camera::Parse(Desc));
+			} catch (std::invalid_argument &e) {
+				std::cout << "ERROR: " << e.what() << std::endl;
+				return;
+			}
+			Names.push_back(Name);
+		}
+	} else
+		for (Int i = 0; i < S.GetCameraCount(); i++) {
+			Cameras.push_back(S.GetCamera(i));
+			Names.push_back(S.GetCameraName(i));
+		}
+
+	if (OutputFile == "") {
+		std::cout << "ERROR: Rendering " << Cameras.size()
+			  << " views requires --output" << std::endl;
+		return;
+	}
+
+	std::vector<Graphics::HDRImage *> Images;
+	Render::Batch B(S, Antialiasing);
+	for (UInt i = 0; i < Cameras.size(); i++) {
+		Images.push_back(new Graphics::HDRImage(Width, Height));
+		Images.back()->SetToneMap(Out.Mapping);
+		B.AddView(Cameras[i], *Images.back());
+	}
+
+	struct timeval A, C;
+	gettimeofday(&A, NULL);
+	B.Render();
+	gettimeofday(&C, NULL);
+	std::cout << "*** Rendering took "
+		  << (C.tv_sec - A.tv_sec) + 0.000001 * (C.tv_usec - A.tv_usec)
+		  << " seconds" << std::endl;
+
+	for (UInt i = 0; i < Images.size(); i++) {
+		const std::string File = ViewOutput(OutputFile, Names[i], i);
+		try {
+			General::Profile::Scope P(General::Profile::OUTPUT);
+			Images[i]->Save(File);
+			std::cout << "*** Saved " << File << std::endl;
+		} catch (std::runtime_error &e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+		}
+		delete Images[i];
+	}
+}
+
 /** Render scene described in XML file */
 static void RenderFile(Int Width, Int Height, 
 		       Bool Antialiasing,
+		       const PPMConfig &PPM,
+		       const PMConfig &PM,
+		       const OutConfig &Out,
 		       const std::string &SceneFile,
+		       const std::string &CameraList,
 		       const std::string &OutputFile)
 {
 	using namespace World;
 	struct timeval A, B;
+	ProfileSession Session(Out.Profile);
 	Scene S;
 	if (S.ParseFile(SceneFile) == false) {
 		std::cout 
@@ -171,12 +410,69 @@ static void RenderFile(Int Width, Int Height,
 		return;
 	}
 
-	Graphics::Screen Scr(Width, Height);
-	Render::Raytracer R(S, Antialiasing);
+	/* Several views are raytraced together, off-screen */
+	if (CameraList != "" || S.GetCameraCount() > 1) {
+		if (PPM.Passes > 0 || PM.Enabled)
+			std::cout << "*** Several views are raytraced"
+				  << " without photon maps" << std::endl;
+		RenderViews(S, Width, Height, Antialiasing, Out,
+			    CameraList, OutputFile);
+		return;
+	}
+
+	/* Float framebuffer keeps HDR values for PFM output */
+	Graphics::Screen *Scr = NULL;
+	Graphics::HDRImage *HDR = NULL;
+	Graphics::Drawable *Target;
+	if (Out.Framebuffer != "") {
+		try {
+			Target = HDR = new Graphics::MappedImage(
+				Out.Framebuffer, Width, Height,
+				32, Out.Resume);
+		} catch (std::runtime_error &e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+			return;
+		}
+		HDR->SetToneMap(Out.Mapping);
+	} else if (Out.Display && !IsPFM(OutputFile))
+		Target = Scr = new Graphics::Screen(Width, Height);
+	else {
+		Target = HDR = new Graphics::HDRImage(Width, Height);
+		HDR->SetToneMap(Out.Mapping);
+	}
+
+	Render::Renderer *R;
+	Render::Raytracer *RT = NULL;
+	if (PPM.Passes > 0)
+		R = new Render::ProgressiveMapper(S, PPM.Passes,
+						  PPM.Photons, PPM.Radius);
+	else if (PM.Enabled)
+		R = RT = new Render::PhotonMapper(S, Antialiasing,
+						  PM.Global, PM.Caustic,
+						  PM.Gather);
+	else
+		R = RT = new Render::Raytracer(S, Antialiasing);
+	Graphics::CostMap *Costs = NULL;
+	if (RT) {
+		RT->SetProgressive(Out.Progressive);
+		Costs = CreateCostMap(Out, 0, Width, Height, OutputFile);
+		RT->SetCostMap(Costs);
+	}
 
 	gettimeofday(&A, NULL);
-	R.Render(Scr);
+	try {
+		R->Render(*Target);
+	} catch (std::runtime_error &e) {
+		/* E.g. a lazily read region with a broken record */
+		std::cout << "ERROR: " << e.what() << std::endl;
+		delete R;
+		delete Costs;
+		delete Scr;
+		delete HDR;
+		return;
+	}
 	gettimeofday(&B, NULL);
+	delete R;
 
 	Double ATime = A.tv_sec + 0.000001 * A.tv_usec;
 	Double BTime = B.tv_sec + 0.000001 * B.tv_usec;
@@ -185,11 +481,258 @@ static void RenderFile(Int Width, Int Height,
 		  << BTime - ATime
 		  << " seconds" << std::endl;
 
-	Scr.Refresh();
-	if (OutputFile != "")
-		Scr.Save(OutputFile);
-	Scr.EventWait();
+	Target->Refresh();
+	if (OutputFile != "") {
+		General::Profile::Scope P(General::Profile::OUTPUT);
+		Target->Save(OutputFile);
+	}
+	Session.Finish();
+	SaveCostMap(Costs, Basename(OutputFile));
+	if (Scr)
+		Scr->EventWait();
+	delete Scr;
+	delete HDR;
+}
 
+/** Render scene files as consecutive frames of one stream
+ * \param Target	"-" for stdout or a path (e.g. a FIFO),
+ *			optionally followed by ",raw"
+ */
+static Int RenderStream(Int Width, Int Height,
+			Bool Antialiasing,
+			const PMConfig &PM,
+			const OutConfig &Out,
+			const std::string &Target,
+			const std::vector<std::string> &Frames,
+			const std::string &OutputFile)
+{
+	ProfileSession Session(Out.Profile);
+	std::string Path = Target;
+	Graphics::StreamImage::Format Type = Graphics::StreamImage::PPM;
+	const std::string::size_type Comma = Target.rfind(',');
+	if (Comma != std::string::npos && Target.substr(Comma) == ",raw") {
+		Path = Target.substr(0, Comma);
+		Type = Graphics::StreamImage::RAW;
+	}
+
+	int Fd;
+	if (Path == "-") {
+		/* Frames get stdout, messages go to stderr */
+		std::cout.flush();
+		Fd = dup(1);
+		if (Fd >= 0)
+			dup2(2, 1);
+	} else
+		Fd = open(Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (Fd < 0) {
+		std::cout << "Unable to open stream " << Path << std::endl;
+		return -1;
+	}
+
+	Int Ret = 0;
+	Graphics::StreamImage Img(Width, Height, Fd, Type);
+	Img.SetToneMap(Out.Mapping);
+	for (UInt f = 0; f < Frames.size() && Ret == 0; f++) {
+		World::Scene S;
+		if (S.ParseFile(Frames[f]) == false) {
+			std::cout << "Error while parsing " << Frames[f]
+				  << ", finishing" << std::endl;
+			Ret = -1;
+			break;
+		}
+
+		Render::Raytracer *R;
+		if (PM.Enabled)
+			R = new Render::PhotonMapper(S, Antialiasing,
+						     PM.Global, PM.Caustic,
+						     PM.Gather);
+		else
+			R = new Render::Raytracer(S, Antialiasing);
+		Graphics::CostMap *Costs =
+			CreateCostMap(Out, f, Width, Height, OutputFile);
+		R->SetCostMap(Costs);
+		try {
+			if (f > 0)
+				Img.NextFrame();
+			R->Render(Img);
+		} catch (std::exception &e) {
+			std::cout << "*** Streaming failed: " << e.what()
+				  << std::endl;
+			Ret = -1;
+		}
+		delete R;
+		if (Costs) {
+			std::stringstream Base;
+			Base << Basename(OutputFile) << "." << f;
+			SaveCostMap(Costs, Base.str());
+		}
+		std::cout << "*** Frame " << f + 1 << "/" << Frames.size()
+			  << " streamed" << std::endl;
+	}
+	close(Fd);
+	return Ret;
+}
+
+/** Distributed rendering settings (--listen, --spawn) */
+struct DistConfig {
+	std::string Listen;	/**< Coordinator address */
+	Int Spawn;		/**< Local workers to fork */
+	Int TileSize;
+	std::string Worker;	/**< Coordinator to serve (--worker) */
+	Int Timeout;		/**< Seconds a worker may take per tile */
+};
+
+/** Render scene file with worker processes */
+static Int RenderDistributed(Int Width, Int Height,
+			     Bool Antialiasing,
+			     const DistConfig &Dist,
+			     const OutConfig &Out,
+			     const std::string &SceneFile,
+			     const std::string &OutputFile)
+{
+	struct timeval A, B;
+	ProfileSession Session(Out.Profile);
+
+	std::ifstream In(SceneFile.c_str());
+	std::stringstream XML;
+	XML << In.rdbuf();
+	if (!In) {
+		std::cout << "Unable to read " << SceneFile << std::endl;
+		return -1;
+	}
+
+	/* Parse once here so workers get only valid scenes */
+	{
+		World::Scene S;
+		if (S.ParseMemory(XML.str()) == false) {
+			std::cout
+				<< "Error while parsing file, finishing"
+				<< std::endl;
+			return -1;
+		}
+	}
+
+	std::string Address = Dist.Listen;
+	if (Address == "") {
+		std::stringstream s;
+		s << "unix:/tmp/blaRAY." << getpid();
+		Address = s.str();
+	}
+
+	Graphics::HDRImage Img(Width, Height);
+	Img.SetToneMap(Out.Mapping);
+	Render::Coordinator C(XML.str(), Width, Height,
+			      Antialiasing, Dist.TileSize, Dist.Timeout);
+	gettimeofday(&A, NULL);
+	try {
+		C.Run(Address, Dist.Spawn, Img);
+	} catch (std::exception &e) {
+		std::cout << "*** Distributed rendering failed: "
+			  << e.what() << std::endl;
+		return -1;
+	}
+	gettimeofday(&B, NULL);
+
+	Double ATime = A.tv_sec + 0.000001 * A.tv_usec;
+	Double BTime = B.tv_sec + 0.000001 * B.tv_usec;
+	std::cout << "*** Rendering took "
+		  << BTime - ATime
+		  << " seconds" << std::endl;
+
+	if (Address.compare(0, 5, "unix:") == 0)
+		unlink(Address.substr(5).c_str());
+	if (OutputFile != "") {
+		General::Profile::Scope P(General::Profile::OUTPUT);
+		Img.Save(OutputFile);
+	}
+	return 0;
+}
+
+/** Make path absolute; daemon may run in another directory */
+static std::string AbsolutePath(const std::string &Path)
+{
+	if (Path == "" || Path[0] == '/')
+		return Path;
+	char Dir[4096];
+	if (getcwd(Dir, sizeof(Dir)) == NULL)
+		return Path;
+	return std::string(Dir) + "/" + Path;
+}
+
+/** Send a render job to a daemon and wait for the reply */
+static Int Submit(const std::string &Address,
+		  Int Width, Int Height, Bool Antialiasing,
+		  const std::string &Camera,
+		  const std::string &ToneMap,
+		  const std::string &SceneFile,
+		  const std::string &OutputFile)
+{
+	std::stringstream Job;
+	Job << "scene=" << AbsolutePath(SceneFile) << std::endl
+	    << "output=" << AbsolutePath(OutputFile) << std::endl
+	    << "width=" << Width << std::endl
+	    << "height=" << Height << std::endl
+	    << "antialiasing=" << (Antialiasing ? 1 : 0) << std::endl;
+	if (Camera != "")
+		Job << "camera=" << Camera << std::endl;
+	if (ToneMap != "")
+		Job << "tonemap=" << ToneMap << std::endl;
+
+	try {
+		General::Socket *S = General::Socket::Connect(Address);
+		UInt Type;
+		std::string Reply;
+		S->Send(Render::Daemon::MSG_JOB, Job.str());
+		S->Receive(Type, Reply);
+		delete S;
+		std::cout << Reply;
+		return Reply.compare(0, 2, "OK") == 0 ? 0 : -1;
+	} catch (std::exception &e) {
+		std::cout << "ERROR " << e.what() << std::endl;
+		return -1;
+	}
+}
+
+/** Write generated scene XML to OutputFile or stdout */
+static Int Generate(const std::string &Spec, const std::string &OutputFile)
+{
+	try {
+		const World::Generator Gen(World::Generator::Parse(Spec));
+		if (OutputFile == "") {
+			Gen.WriteXML(std::cout);
+			return 0;
+		}
+		std::ofstream Out(OutputFile.c_str());
+		Gen.WriteXML(Out);
+		if (!Out) {
+			std::cerr << "ERROR: Unable to write " << OutputFile
+				  << std::endl;
+			return -1;
+		}
+	} catch (std::invalid_argument &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+/** Convert scene file into binary scene format */
+static Int Convert(const std::string &SceneFile, const std::string &Target,
+		   Int Regions)
+{
+	World::Scene S;
+	if (S.ParseFile(SceneFile) == false) {
+		std::cout << "Error while parsing file, finishing" << std::endl;
+		return -1;
+	}
+	try {
+		S.SaveBinary(Target, Regions);
+	} catch (std::runtime_error &e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return -1;
+	}
+	std::cout << "*** Scene written to " << Target << std::endl;
+	return 0;
 }
 
 /** Handle demo selection */
@@ -238,10 +781,78 @@ static void Help()
 	<< "List of options:" << endl
 	<< "	--scene|-s <filename>	- Scene description to render" << endl
 	<< "	--demo|-d <num>		- Render demo 1 or 2 instead of a file" << endl
-	<< "	--output|-o <filename>	- Output rendered scene to filename (BMP)" << endl
+	<< "	--output|-o <filename>	- Output rendered scene to filename"
+			<< " (BMP, or PFM if named *.pfm)" << endl
+	<< "	--nodisplay		- Render off-screen" << endl
+	<< "	--tonemap <op>[,<exposure>] - clamp or reinhard, for"
+			<< " off-screen BMP output" << endl
+	<< "	--progressive		- Show coarse preview before"
+			<< " raytracing full image" << endl
+	<< "	--cameras <path>	- Render views listed in file"
+			<< " (x,y,z,dx,dy,dz[,fov] [name] lines)" << endl
+	<< "				  to --output files named after"
+			<< " each view" << endl
+	<< "	--costmap <n>		- Save per-pixel cost (rays, tests,"
+			<< " cycles) of every n-th frame" << endl
+	<< "				  as <output>.cost.pfm and"
+			<< " false colour <output>.cost.ppm" << endl
+	<< "	--profile <path>	- Write JSON timing report of the"
+			<< " render (of the whole" << endl
+	<< "				  session with --daemon or"
+			<< " --worker)" << endl
+	<< "	--framebuffer <path>	- Render into memory-mapped file"
+			<< " (for huge images)" << endl
+	<< "	--resume		- Skip tiles finished in the"
+			<< " framebuffer file before" << endl
+	<< "	--stream <path|->[,raw]	- Write rows to a stream (PPM or raw"
+			<< " RGB) as they finish;" << endl
+	<< "				  scene files after options are"
+			<< " further frames" << endl
+	<< "	--generate <spec>	- Write generated scene XML to"
+			<< " --output or stdout; spec is" << endl
+	<< "				  key=value,... of spheres, planes,"
+			<< " lights, textures, materials," << endl
+	<< "				  layout (uniform|clustered|nested),"
+			<< " seed and size" << endl
+	<< "	--convert <path>	- Write --scene in binary format;"
+			<< " binary scenes load like XML ones" << endl
+	<< "	--regions <n>		- With --convert group spheres into"
+			<< " regions of n for --lazy" << endl
+	<< "	--lazy <MB>		- Read regions of binary scenes when"
+			<< " rays reach them, keeping" << endl
+	<< "				  at most MB of spheres"
+			<< " in memory" << endl
 	<< "	--width|-x <arg>	- sets screen width (default:640)" << endl
 	<< "	--height|-y <arg>	- sets screen height (default:480)" << endl
 	<< "	--antialiasing|-a	- Turn antialiasing on" << endl
+	<< "	--ppm <passes>		- Progressive photon mapping instead"
+			<< " of raytracing" << endl
+	<< "	--photons <count>	- Photons per PPM pass (default:100000)" << endl
+	<< "	--radius <r>		- Initial PPM gather radius (default:0.25)" << endl
+	<< "	--photonmap		- Raytrace with global and caustic"
+			<< " photon maps" << endl
+	<< "	--global <n>[,<k>[,<d>]]	- Global map: photons emitted,"
+			<< " photons in estimate, max distance" << endl
+	<< "				  (default:200000,100,1.0)" << endl
+	<< "	--caustic <n>[,<k>[,<d>]]	- Caustic map settings"
+			<< " (default:100000,80,0.3)" << endl
+	<< "	--gather <m>[,<a>]	- Final gather with m*3m rays cached"
+			<< " with accuracy a (default:0.2)" << endl
+	<< "	--listen <address>	- Coordinate workers connecting to"
+			<< " unix:<path> or <host>:<port>" << endl
+	<< "	--spawn <count>		- Fork local workers (distributed"
+			<< " rendering)" << endl
+	<< "	--tile <size>		- Tile edge for workers (default:32)" << endl
+	<< "	--timeout <s>		- Drop workers which return no tile"
+			<< " for s seconds (default:600)" << endl
+	<< "	--worker <address>	- Render tiles for a coordinator" << endl
+	<< "	--daemon <address>	- Serve render jobs, keeping"
+			<< " scenes parsed" << endl
+	<< "	--submit <address>	- Send job (--scene, --output, size,"
+			<< " -a, --camera) to a daemon" << endl
+	<< "	--camera <x,y,z,dx,dy,dz[,fov]> - Camera override for"
+			<< " --submit" << endl
+	<< "	--threads|-t <count>	- Worker threads (default: all CPUs)" << endl
 	<< "	--help|-h		- Show this help" << endl
 	<< endl
 	<< "blaRAY (C) 2008 by Tomasz bla Fortuna <bla@thera.be>" << endl
@@ -251,7 +862,12 @@ static void Help()
 int main(int argc, char **argv)
 {
 	using namespace std;
-	enum { WIDTH=0, HEIGHT, SCENE, OUTPUT, ANTIALIASING, DEMO, HELP };
+	enum { WIDTH=0, HEIGHT, SCENE, OUTPUT, ANTIALIASING, DEMO, HELP,
+	       PPM, PHOTONS, RADIUS, THREADS, PHOTONMAP, GLOBAL, CAUSTIC, GATHER,
+	       LISTEN, SPAWN, TILE, WORKER, DAEMON, SUBMIT, CAMERA,
+	       NODISPLAY, TONEMAP, PROGRESSIVE, STREAM, FRAMEBUFFER, RESUME,
+	       CAMERAS, PROFILE, COSTMAP, GENERATE,
+	       CONVERT, REGIONS, LAZY, TIMEOUT };
 	static struct {
 		Int Width;
 		Int Height;
@@ -259,8 +875,27 @@ int main(int argc, char **argv)
 		std::string OutputFile;
 		Bool Antialiasing;
 		Int Demo;
+		PPMConfig PPM;
+		PMConfig PM;
+		DistConfig Dist;
+		std::string Daemon;
+		std::string Submit;
+		std::string Camera;
+		OutConfig Out;
+		std::string ToneMap;
+		std::string Stream;
+		std::string Cameras;
+		std::string Generate;
+		std::string Convert;
+		Int Regions;
 	} Configuration = {
-		640, 480, "", "", false, 0
+		640, 480, "", "", false, 0, { 0, 100000, 0.25 },
+		{ false, { 200000, 100, 1.0 }, { 100000, 80, 0.3 },
+		  { 0, 0.2, 0.05, 5.0 } },
+		{ "", 0, 32, "", 600 },
+		"", "", "",
+		{ true, Graphics::ToneMap(), false, "", false, "", 0 }, "", "", "",
+		"", "", 0
 	};
 
 	static struct option long_options[] = {
@@ -271,12 +906,41 @@ int main(int argc, char **argv)
 		{"antialiasing", 0, 0, 0},
 		{"demo", 1, 0, 0},
 		{"help", 0, 0, 0},
+		{"ppm", 1, 0, 0},
+		{"photons", 1, 0, 0},
+		{"radius", 1, 0, 0},
+		{"threads", 1, 0, 0},
+		{"photonmap", 0, 0, 0},
+		{"global", 1, 0, 0},
+		{"caustic", 1, 0, 0},
+		{"gather", 1, 0, 0},
+		{"listen", 1, 0, 0},
+		{"spawn", 1, 0, 0},
+		{"tile", 1, 0, 0},
+		{"worker", 1, 0, 0},
+		{"daemon", 1, 0, 0},
+		{"submit", 1, 0, 0},
+		{"camera", 1, 0, 0},
+		{"nodisplay", 0, 0, 0},
+		{"tonemap", 1, 0, 0},
+		{"progressive", 0, 0, 0},
+		{"stream", 1, 0, 0},
+		{"framebuffer", 1, 0, 0},
+		{"resume", 0, 0, 0},
+		{"cameras", 1, 0, 0},
+		{"profile", 1, 0, 0},
+		{"costmap", 1, 0, 0},
+		{"generate", 1, 0, 0},
+		{"convert", 1, 0, 0},
+		{"regions", 1, 0, 0},
+		{"lazy", 1, 0, 0},
+		{"timeout", 1, 0, 0},
 		{NULL, 0, 0, 0}
 	};
 
 	for (;;) {
 		int c, index;
-		c = getopt_long(argc, argv, "x:y:s:o:ad:h",
+		c = getopt_long(argc, argv, "x:y:s:o:ad:ht:",
 				long_options, &index);
 		if (c == -1)
 			break; /* End of parameters */
@@ -290,6 +954,7 @@ int main(int argc, char **argv)
 		case 'a': index = ANTIALIASING; break;
 		case 'd': index = DEMO; break;
 		case 'h': index = HELP; break;
+		case 't': index = THREADS; break;
 		}
 
 		std::string opt("");
@@ -321,9 +986,120 @@ int main(int argc, char **argv)
 		case HELP:
 			Help();
 			return -1;
+
+		case PPM:
+			s >> Configuration.PPM.Passes;
+			break;
+		case PHOTONS:
+			s >> Configuration.PPM.Photons;
+			break;
+		case RADIUS:
+			s >> Configuration.PPM.Radius;
+			break;
+
+		case THREADS: {
+			Int Threads = 0;
+			s >> Threads;
+			General::Parallel::SetWorkers(Threads);
+			break;
+		}
+
+		case PHOTONMAP:
+			Configuration.PM.Enabled = true;
+			break;
+		case GLOBAL:
+			ParseMapConfig(opt, Configuration.PM.Global);
+			break;
+		case CAUSTIC:
+			ParseMapConfig(opt, Configuration.PM.Caustic);
+			break;
+		case GATHER:
+			Configuration.PM.Enabled = true;
+			ParseGatherConfig(opt, Configuration.PM.Gather);
+			break;
+
+		case LISTEN:
+			s >> Configuration.Dist.Listen;
+			break;
+		case SPAWN:
+			s >> Configuration.Dist.Spawn;
+			break;
+		case TILE:
+			s >> Configuration.Dist.TileSize;
+			break;
+		case WORKER:
+			s >> Configuration.Dist.Worker;
+			break;
+		case TIMEOUT:
+			s >> Configuration.Dist.Timeout;
+			break;
+
+		case DAEMON:
+			s >> Configuration.Daemon;
+			break;
+		case SUBMIT:
+			s >> Configuration.Submit;
+			break;
+		case CAMERA:
+			s >> Configuration.Camera;
+			break;
+
+		case NODISPLAY:
+			Configuration.Out.Display = false;
+			break;
+		case TONEMAP:
+			try {
+				Configuration.Out.Mapping =
+					Graphics::ToneMap::Parse(opt);
+			} catch (std::invalid_argument &e) {
+				cout << "ERROR: " << e.what() << endl;
+				return -1;
+			}
+			Configuration.ToneMap = opt;
+			break;
+		case PROGRESSIVE:
+			Configuration.Out.Progressive = true;
+			break;
+		case STREAM:
+			s >> Configuration.Stream;
+			break;
+		case FRAMEBUFFER:
+			s >> Configuration.Out.Framebuffer;
+			break;
+		case RESUME:
+			Configuration.Out.Resume = true;
+			break;
+		case CAMERAS:
+			s >> Configuration.Cameras;
+			break;
+		case PROFILE:
+			s >> Configuration.Out.Profile;
+			break;
+		case COSTMAP:
+			s >> Configuration.Out.CostEvery;
+			break;
+		case GENERATE:
+			s >> Configuration.Generate;
+			break;
+		case CONVERT:
+			s >> Configuration.Convert;
+			break;
+		case REGIONS:
+			s >> Configuration.Regions;
+			break;
+		case LAZY: {
+			Double MB = 0.0;
+			s >> MB;
+			World::Scene::SetRegionBudget(size_t(MB * 1048576.0));
+			break;
+		}
 		}
 	}
 
+	if (Configuration.Generate != "")
+		return Generate(Configuration.Generate,
+				Configuration.OutputFile);
+
 	if (Configuration.Demo != 0) {
 		Demo(Configuration.Width,
 		     Configuration.Height,
@@ -333,6 +1109,38 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
+	if (Configuration.Daemon != "") {
+		ProfileSession Session(Configuration.Out.Profile);
+		try {
+			Render::Daemon(Configuration.Daemon).Run();
+		} catch (std::exception &e) {
+			cout << "*** Daemon error: " << e.what() << endl;
+			return -1;
+		}
+		return 0;
+	}
+
+	if (Configuration.Submit != "")
+		return Submit(Configuration.Submit,
+			      Configuration.Width,
+			      Configuration.Height,
+			      Configuration.Antialiasing,
+			      Configuration.Camera,
+			      Configuration.ToneMap,
+			      Configuration.SceneFile,
+			      Configuration.OutputFile);
+
+	if (Configuration.Dist.Worker != "") {
+		ProfileSession Session(Configuration.Out.Profile);
+		try {
+			Render::Worker(Configuration.Dist.Worker).Run();
+		} catch (std::exception &e) {
+			cout << "*** Worker error: " << e.what() << endl;
+			return -1;
+		}
+		return 0;
+	}
+
 	if (Configuration.SceneFile == "") {
 		cout << "ERROR: You must specify scene file to render (or --demo)"
 		     << endl << endl;
@@ -340,14 +1148,48 @@ int main(int argc, char **argv)
 		return -1;
 	}
 
+	if (Configuration.Convert != "")
+		return Convert(Configuration.SceneFile, Configuration.Convert,
+			       Configuration.Regions);
+
 	if (DEBUG)
 		Testcases::All();
 
+	if (Configuration.Dist.Listen != "" || Configuration.Dist.Spawn > 0)
+		return RenderDistributed(Configuration.Width,
+					 Configuration.Height,
+					 Configuration.Antialiasing,
+					 Configuration.Dist,
+					 Configuration.Out,
+					 Configuration.SceneFile,
+					 Configuration.OutputFile);
+
+	if (Configuration.Stream != "") {
+		if (Configuration.PPM.Passes > 0) {
+			cout << "ERROR: PPM passes can't be streamed" << endl;
+			return -1;
+		}
+		std::vector<std::string> Frames(1, Configuration.SceneFile);
+		Frames.insert(Frames.end(), argv + optind, argv + argc);
+		return RenderStream(Configuration.Width,
+				    Configuration.Height,
+				    Configuration.Antialiasing,
+				    Configuration.PM,
+				    Configuration.Out,
+				    Configuration.Stream,
+				    Frames,
+				    Configuration.OutputFile);
+	}
+
 	/* Render something */
 	RenderFile(Configuration.Width,
 		   Configuration.Height,
 		   Configuration.Antialiasing,
+		   Configuration.PPM,
+		   Configuration.PM,
+		   Configuration.Out,
 		   Configuration.SceneFile,
+		   Configuration.Cameras,
 		   Configuration.OutputFile);
 	return 0;
 }